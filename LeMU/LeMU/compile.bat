@@ -1,3 +1,9 @@
 C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\simple_shader.vert -o shaders\simple_shader.vert.spv
 C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\simple_shader.frag -o shaders\simple_shader.frag.spv
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\indirect_shader.vert -o shaders\indirect_shader.vert.spv
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\indirect_shader.frag -o shaders\indirect_shader.frag.spv
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\indirect_cull.comp -o shaders\indirect_cull.comp.spv
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\bindless_shader.vert -o shaders\bindless_shader.vert.spv
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\bindless_shader.frag -o shaders\bindless_shader.frag.spv
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shaders\depth_pyramid.comp -o shaders\depth_pyramid.comp.spv
 pause
\ No newline at end of file
@@ -0,0 +1,75 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// material features, specialized per pipeline, see MaterialFeature. A disabled feature is
+// constant folded away, its texture fetches included
+layout (constant_id = 0) const bool TEXTURED = false;
+layout (constant_id = 1) const bool VERTEX_COLOR = true;
+layout (constant_id = 2) const bool NORMAL_MAPPING = false;
+layout (constant_id = 3) const bool ALPHA_TEST = false;
+layout (constant_id = 4) const float ALPHA_CUTOFF = 0.5;
+
+layout (location = 0) in vec3 vertexColor;
+layout (location = 1) in vec2 vertexUv;
+layout (location = 2) flat in uvec2 textureIndices;
+layout (location = 3) in vec3 worldPosition;
+
+layout (location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 projectionView;
+	vec4 cameraPosition;
+} ubo;
+
+// partially bound, only slots handed out by the texture table are ever indexed
+layout (set = 1, binding = 0) uniform sampler2D textures[];
+
+const vec3 LIGHT_DIRECTION = normalize(vec3(0.4, -1.0, 0.3));	// towards the light, y is down
+
+// tangent frame from screen space derivatives, the mesh needs no tangents
+vec3 perturbNormal(vec3 normalSample)
+{
+	vec3 dpdx = dFdx(worldPosition);
+	vec3 dpdy = dFdy(worldPosition);
+	vec2 duvdx = dFdx(vertexUv);
+	vec2 duvdy = dFdy(vertexUv);
+
+	vec3 normal = normalize(cross(dpdx, dpdy));
+	normal = faceforward(normal, worldPosition - ubo.cameraPosition.xyz, normal);
+
+	vec3 dpdyPerp = cross(dpdy, normal);
+	vec3 dpdxPerp = cross(normal, dpdx);
+	vec3 tangent = dpdyPerp * duvdx.x + dpdxPerp * duvdy.x;
+	vec3 bitangent = dpdyPerp * duvdx.y + dpdxPerp * duvdy.y;
+	float scale = inversesqrt(max(dot(tangent, tangent), dot(bitangent, bitangent)));
+
+	return normalize(mat3(tangent * scale, bitangent * scale, normal) * (normalSample * 2.0 - 1.0));
+}
+
+void main()
+{
+	vec4 baseColor = vec4(1.0);
+
+	// instances of one draw can use different textures
+	if (TEXTURED)
+		baseColor *= texture(textures[nonuniformEXT(textureIndices.x)], vertexUv);
+
+	// derivatives and implicit lod sampling come before any fragment of the quad can discard
+	vec3 normal = vec3(0.0);
+	if (NORMAL_MAPPING)
+		normal = perturbNormal(texture(textures[nonuniformEXT(textureIndices.y)], vertexUv).xyz);
+
+	if (VERTEX_COLOR)
+		baseColor.rgb *= vertexColor;
+
+	if (ALPHA_TEST && baseColor.a < ALPHA_CUTOFF)
+		discard;
+
+	// only normal mapped materials are shaded, the rest stay unlit
+	if (NORMAL_MAPPING)
+		baseColor.rgb *= 0.2 + 0.8 * max(dot(normal, LIGHT_DIRECTION), 0.0);
+
+	outColor = vec4(baseColor.rgb, 1.0);
+}
\ No newline at end of file
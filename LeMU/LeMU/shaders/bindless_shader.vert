@@ -0,0 +1,39 @@
+#version 450
+
+// material features, specialized per pipeline, see MaterialFeature
+layout (constant_id = 2) const bool NORMAL_MAPPING = false;
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec2 uv;
+
+layout(location = 0) out vec3 vertexColor;
+layout(location = 1) out vec2 vertexUv;
+layout(location = 2) flat out uvec2 textureIndices;	// x: base color, y: normal map
+layout(location = 3) out vec3 worldPosition;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 projectionView;
+	vec4 cameraPosition;
+} ubo;
+
+struct ObjectData {
+	mat4 model;
+	vec4 color;
+	uvec4 material;	// x: bindless texture index, y: normal map index
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Objects { ObjectData objects[]; };
+
+void main()
+{
+	ObjectData object = objects[gl_InstanceIndex];
+	vec4 world = object.model * vec4(position, 1.0);
+	gl_Position = ubo.projectionView * world;
+	vertexColor = color * object.color.rgb;
+	vertexUv = uv;
+	textureIndices = object.material.xy;
+	worldPosition = NORMAL_MAPPING ? world.xyz : vec3(0.0);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+// the light set of ClusteredLighting, included by the scene shaders lit by it
+
+// froxel grid the lights were binned into on the CPU, see LightClusterGrid
+layout(set = 1, binding = 0) uniform ClusterGrid {
+	uvec4 size;			// tiles x, tiles y, depth slices, light count
+	vec4 tileScale;		// xy: tiles per pixel, z: slice scale, w: slice bias
+} grid;
+
+struct Light {
+	vec4 positionRange;		// xyz: world position, w: range
+	vec4 colorCosInner;		// rgb: color times intensity, w: cos of the inner cone angle
+	vec4 directionCosOuter;	// xyz: spot direction, w: cos of the outer cone angle
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer Lights { Light lights[]; };
+layout(std430, set = 1, binding = 2) readonly buffer Clusters { uvec2 clusters[]; };	// first index, count
+layout(std430, set = 1, binding = 3) readonly buffer LightIndices { uint lightIndices[]; };
+
+// light reaching the fragment from the point and spot lights of its cluster
+vec3 clusteredLighting(vec3 worldPosition, vec3 normal, float viewDepth)
+{
+	uvec2 tile = min(uvec2(gl_FragCoord.xy * grid.tileScale.xy), grid.size.xy - 1u);
+	float slice = clamp(floor(log(viewDepth) * grid.tileScale.z + grid.tileScale.w), 0.0, float(grid.size.z - 1u));
+	uvec2 cluster = clusters[(uint(slice) * grid.size.y + tile.y) * grid.size.x + tile.x];
+
+	vec3 lighting = vec3(0.0);
+
+	// only the lights whose bounds touch this cluster, however many the scene has
+	for (uint i = 0; i < cluster.y; i++)
+	{
+		Light light = lights[lightIndices[cluster.x + i]];
+
+		vec3 toLight = light.positionRange.xyz - worldPosition;
+		float distanceSquared = dot(toLight, toLight);
+		vec3 direction = toLight * inversesqrt(max(distanceSquared, 1e-8));
+
+		// inverse square falloff windowed to reach 0 at the range, the cluster bounds stay exact
+		float ratio = distanceSquared / (light.positionRange.w * light.positionRange.w);
+		float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+		float attenuation = window * window / (distanceSquared + 1.0);
+
+		// point lights have cone cosines below -1, the factor is 1 everywhere
+		float spot = smoothstep(light.directionCosOuter.w, light.colorCosInner.w, dot(-direction, light.directionCosOuter.xyz));
+
+		lighting += light.colorCosInner.rgb * (max(dot(normal, direction), 0.0) * attenuation * spot);
+	}
+
+	return lighting;
+}
@@ -0,0 +1,18 @@
+#version 450
+
+layout (location = 0) in vec3 vertexColor;
+layout (location = 1) in vec3 worldPosition;
+layout (location = 2) in vec3 worldNormal;
+layout (location = 3) in float viewDepth;
+
+layout (location = 0) out vec4 outColor;
+
+#include "clustered_lighting.glsl"
+
+const vec3 AMBIENT = vec3(0.03);
+
+void main()
+{
+	vec3 lighting = AMBIENT + clusteredLighting(worldPosition, normalize(worldNormal), viewDepth);
+	outColor = vec4(vertexColor * lighting, 1.0);
+}
@@ -0,0 +1,38 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+
+layout(location = 0) out vec3 vertexColor;
+layout(location = 1) out vec3 worldPosition;
+layout(location = 2) out vec3 worldNormal;
+layout(location = 3) out float viewDepth;	// picks the depth slice of the light cluster
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 projectionView;
+	vec4 cameraPosition;
+} ubo;
+
+struct ObjectData {
+	mat4 model;
+	vec4 color;
+	uvec4 material;	// x: bindless texture index, y: normal map index
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Objects { ObjectData objects[]; };
+
+void main()
+{
+	ObjectData object = objects[gl_InstanceIndex];
+	vec4 world = object.model * vec4(position, 1.0);
+	gl_Position = ubo.projectionView * world;
+
+	vertexColor = color * object.color.rgb;
+	worldPosition = world.xyz;
+	// objects are scaled uniformly, the model matrix turns normals like positions
+	worldNormal = mat3(object.model) * normal;
+	viewDepth = (ubo.view * world).z;
+}
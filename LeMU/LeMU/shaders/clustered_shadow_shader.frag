@@ -0,0 +1,53 @@
+#version 450
+
+layout (location = 0) in vec3 vertexColor;
+layout (location = 1) in vec3 worldPosition;
+layout (location = 2) in vec3 worldNormal;
+layout (location = 3) in float viewDepth;
+
+layout (location = 0) out vec4 outColor;
+
+#include "clustered_lighting.glsl"
+
+// the directional light and its cascades, see CascadedShadows
+layout(set = 2, binding = 0) uniform Shadows {
+	mat4 cascadeViewProjection[4];
+	vec4 splitDepths;		// view space depth each cascade ends at
+	vec4 lightDirection;	// xyz: direction the light travels, w: cascade count
+	vec4 lightColor;		// rgb: color times intensity
+} shadows;
+
+layout(set = 2, binding = 1) uniform sampler2DArrayShadow shadowMap;
+
+const vec3 AMBIENT = vec3(0.03);
+
+// lit share of the fragment, 2x2 compare taps around it, each filtered by the sampler
+float directionalShadow()
+{
+	uint cascadeCount = uint(shadows.lightDirection.w);
+	if (viewDepth > shadows.splitDepths[cascadeCount - 1u]) return 1.0;
+
+	uint cascade = 0u;
+	while (cascade + 1u < cascadeCount && viewDepth > shadows.splitDepths[cascade]) cascade++;
+
+	vec4 shadowPosition = shadows.cascadeViewProjection[cascade] * vec4(worldPosition, 1.0);
+	vec2 uv = shadowPosition.xy * 0.5 + 0.5;
+	vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+	float lit = 0.0;
+	for (int y = 0; y < 2; y++)
+		for (int x = 0; x < 2; x++)
+			lit += texture(shadowMap, vec4(uv + (vec2(x, y) - 0.5) * texelSize, float(cascade), shadowPosition.z));
+	return lit * 0.25;
+}
+
+void main()
+{
+	vec3 normal = normalize(worldNormal);
+
+	float sun = max(dot(normal, -shadows.lightDirection.xyz), 0.0);
+	if (sun > 0.0) sun *= directionalShadow();
+
+	vec3 lighting = AMBIENT + shadows.lightColor.rgb * sun + clusteredLighting(worldPosition, normal, viewDepth);
+	outColor = vec4(vertexColor * lighting, 1.0);
+}
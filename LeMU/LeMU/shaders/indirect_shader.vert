@@ -0,0 +1,30 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+
+layout(location = 0) out vec3 vertexColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 projectionView;
+	vec4 cameraPosition;
+} ubo;
+
+struct ObjectData {
+	mat4 model;
+	vec4 color;
+	vec4 sphere;
+	uvec4 lodGroup;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Objects { ObjectData objects[]; };
+
+void main()
+{
+	// the cull shader put the object index into firstInstance
+	ObjectData object = objects[gl_InstanceIndex];
+	gl_Position = ubo.projectionView * object.model * vec4(position, 1.0);
+	vertexColor = color * object.color.rgb;
+}
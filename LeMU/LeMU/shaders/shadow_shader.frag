@@ -0,0 +1,6 @@
+#version 450
+
+// depth only, the shadow maps have no color attachment
+void main()
+{
+}
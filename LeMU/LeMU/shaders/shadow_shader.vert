@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+
+// light view projection of the cascade times the model matrix of the caster
+layout(push_constant) uniform Push {
+	mat4 transform;
+} push;
+
+void main()
+{
+	gl_Position = push.transform * vec4(position, 1.0);
+}
@@ -4,11 +4,6 @@ layout (location = 0) in vec3 vertexColor;
 
 layout (location = 0) out vec4 outColor;
 
-layout (push_constant) uniform Push{
-	mat4 transform;
-	vec3 color;
-} push;
-
 void main()
 {
 	outColor = vec4(vertexColor, 1.0);
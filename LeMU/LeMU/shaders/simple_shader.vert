@@ -5,14 +5,25 @@ layout(location = 1) in vec3 color;
 
 layout(location = 0) out vec3 vertexColor;
 
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 projectionView;
+	vec4 cameraPosition;
+} ubo;
 
-layout(push_constant) uniform Push {
-	mat4 transform;		// 2 X 2 transformation matrix
-	vec3 color;
-} push;
+struct ObjectData {
+	mat4 model;
+	vec4 color;
+	uvec4 material;	// x: bindless texture index, y: normal map index
+};
+
+// written once per frame, the draw puts the object slot into firstInstance
+layout(std430, set = 0, binding = 1) readonly buffer Objects { ObjectData objects[]; };
 
 void main()
 {
-	gl_Position = push.transform * vec4(position, 1.0);
-	vertexColor = color;
-}
+	ObjectData object = objects[gl_InstanceIndex];
+	gl_Position = ubo.projectionView * object.model * vec4(position, 1.0);
+	vertexColor = color * object.color.rgb;
+}
\ No newline at end of file
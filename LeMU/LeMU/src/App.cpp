@@ -2,6 +2,7 @@
 
 #include "App.hpp"
 
+#include "Benchmarks.hpp"
 #include "KeyboardController.hpp"
 #include "Camera.hpp"
 
@@ -11,11 +12,17 @@
 #include <glm.hpp>
 #include <gtc/constants.hpp>
 #include "RenderSystem.hpp"
+#include "CascadedShadows.hpp"
+#include "ClusteredLighting.hpp"
+#include "DynamicResolution.hpp"
 #include "Image.hpp"
+#include "FrameStats.hpp"
+#include "FileWatcher.hpp"
 
 // std
 #include <array>
 #include <chrono>
+#include <memory>
 #include <stdexcept>
 #include <iostream>
 
@@ -25,6 +32,23 @@ namespace LeMU {
 
 
     FirstApp::FirstApp() {
+        // every shader the render systems use, compiled side by side or read from the SPIR-V cache
+        // before the first pipeline asks for one
+        renderer.getShaderCompiler().precompile({
+            "shaders/simple_shader.vert",
+            "shaders/simple_shader.frag",
+            "shaders/bindless_shader.vert",
+            "shaders/bindless_shader.frag",
+            "shaders/clustered_shader.vert",
+            "shaders/clustered_shader.frag",
+            "shaders/clustered_shadow_shader.frag",
+            "shaders/shadow_shader.vert",
+            "shaders/shadow_shader.frag",
+            "shaders/indirect_shader.vert",
+            "shaders/indirect_shader.frag",
+            "shaders/indirect_cull.comp",
+            "shaders/depth_pyramid.comp" }, jobSystem);
+
         loadGameObjects();
         
     }
@@ -33,8 +57,18 @@ namespace LeMU {
 
     void FirstApp::run() {
 
-        // render system
-        RenderSystem renderSystem{device, renderer.getSwapChainRenderPass()};
+        // render system, the scene is lit by its lights through the light clusters and by the sun
+        ClusteredLighting lighting{device, renderer};
+        CascadedShadows shadows{device, renderer};
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget(), nullptr, &lighting, &shadows};
+
+        // the scene is rendered at the scale that keeps the GPU inside the frame limiter's budget and
+        // upscaled into the swap chain image. Without blits to the swap chain it is drawn there directly
+        DynamicResolutionSettings resolutionSettings{};
+        if (TARGET_FPS > 0.0f) resolutionSettings.targetMilliseconds = GPU_BUDGET_SHARE * 1000.0f / TARGET_FPS;
+        std::unique_ptr<DynamicResolution> resolution;
+        if (renderer.canTransferToSwapChain())
+            resolution = std::make_unique<DynamicResolution>(device, renderer, resolutionSettings);
         
         // camera
         Camera camera{};
@@ -49,13 +83,38 @@ namespace LeMU {
 
         Image image("statue.jpg", device);
 
+        FrameStats frameStats{};
+        float statsTime = 0.0f;
+
+        // edited shaders are rebuilt in the background and swapped in by the renderer
+        FileWatcher shaderWatcher{"shaders"};
+
         while (!window.shouldClose()) {
+            // pace before sampling input, so the input is as fresh as possible when the frame is recorded
+            frameLimiter.wait();
             glfwPollEvents();
+            renderer.getPipelineCache().reloadShaders(shaderWatcher.poll());
 
             // declear after glfwPollEvents(), because glfwPollEvents() may block game loop
             auto newTime = std::chrono::high_resolution_clock::now();
             float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;  // update current time
+            frameStats.addSample(frameTime * 1000.0f);
+
+            // an always-on display runs for weeks, report how the last interval went and start over
+            statsTime += frameTime;
+            if (statsTime >= STATS_INTERVAL_SECONDS)
+            {
+                frameStats.print("Main loop");
+                frameStats.reset();
+                if (resolution)
+                {
+                    resolution->getGpuStats().print("Main loop GPU time");
+                    std::cout << "\tresolution scale " << resolution->getScale() << std::endl;
+                    resolution->resetGpuStats();
+                }
+                statsTime = 0.0f;
+            }
 
             // update camera state
             cameraController.moveInPlaneXZ(window.getGLFWwindow(), frameTime, cameraObject);
@@ -67,18 +126,67 @@ namespace LeMU {
 
             if (auto commandBuffer = renderer.beginFrame())
             {
-                renderer.beginSwapChainRenderPass(commandBuffer);
-
-                renderSystem.renderGameObjects(commandBuffer, gameObjects, camera);
-
-                renderer.endSwapChainRenderPass(commandBuffer);
+                // picks this frame's render extent from the GPU times read back so far
+                if (resolution) resolution->beginFrame(commandBuffer);
+
+                VkExtent2D viewportExtent = resolution ? resolution->getRenderExtent() : renderer.getSwapChainExtent();
+                lighting.update(lights, camera, viewportExtent, &jobSystem);
+                shadows.render(commandBuffer, gameObjects, camera, sun);
+
+                renderGraph.reset();
+                RGResource backbuffer = renderGraph.importSwapChainImage();
+
+                if (resolution)
+                {
+                    // the scene pass takes inline contents only
+                    renderGraph.addPass("scene",
+                        [&](RenderGraph::PassBuilder& builder) { builder.write(backbuffer, RGAccess::TransferWrite); },
+                        [&](VkCommandBuffer cmd) {
+                            resolution->beginScenePass(cmd);
+                            renderSystem.renderGameObjects(cmd, gameObjects, camera);
+                            resolution->endScenePass(cmd);
+                            resolution->blitToSwapChain(cmd);
+                        });
+                }
+                else
+                {
+                    renderGraph.addPass("swapchain",
+                        [&](RenderGraph::PassBuilder& builder) { builder.write(backbuffer, RGAccess::ColorAttachmentWrite); },
+                        [&](VkCommandBuffer cmd) {
+                            if (gameObjects.size() >= PARALLEL_RECORDING_THRESHOLD)
+                            {
+                                renderer.beginSwapChainRenderPass(cmd, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                                renderSystem.renderGameObjectsParallel(cmd, jobSystem, gameObjects, camera);
+                            }
+                            else
+                            {
+                                renderer.beginSwapChainRenderPass(cmd);
+                                renderSystem.renderGameObjects(cmd, gameObjects, camera);
+                            }
+                            renderer.endSwapChainRenderPass(cmd);
+                        });
+                }
+
+                renderGraph.compile();
+                renderGraph.execute(commandBuffer);
                 renderer.endFrame();
             }
         }
 
         vkDeviceWaitIdle(device.device());
+        frameStats.print("Main loop");
+        if (resolution) resolution->getGpuStats().print("Main loop GPU time");
+        renderer.getShaderCompiler().printStats("Shader compiler");
+        renderer.getPipelineCache().printStats("Pipeline cache");
+    }
+
+
+
+    bool FirstApp::runBenchmark(const std::string& name)
+    {
+        Benchmarks benchmarks{window, device, jobSystem, renderer, renderGraph, gameObjects};
+        return benchmarks.run(name);
     }
- 
 
 
 
@@ -90,8 +198,26 @@ namespace LeMU {
         obj.model = model;
         obj.transform.translation = { 0.0f, 0.0f, 2.5f };
         obj.transform.scale = {3.0f, 3.0, 3.0};
+        obj.isStatic = true;
 
         gameObjects.push_back(std::move(obj));
+
+        // a warm light over the room and a cold spot light shining down into it
+        Light fill{};
+        fill.position = { 0.0f, -2.0f, 1.0f };
+        fill.range = 6.0f;
+        fill.color = { 1.0f, 0.85f, 0.7f };
+        fill.intensity = 2.0f;
+        lights.push_back(fill);
+
+        Light spot{};
+        spot.type = LightType::Spot;
+        spot.position = { 1.0f, -3.0f, 2.5f };
+        spot.range = 8.0f;
+        spot.color = { 0.6f, 0.7f, 1.0f };
+        spot.intensity = 3.0f;
+        spot.direction = { 0.0f, 1.0f, 0.0f };
+        lights.push_back(spot);
     }
 
 
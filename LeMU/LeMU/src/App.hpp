@@ -4,12 +4,18 @@
 
 #include "Device.hpp"
 
+#include "FrameLimiter.hpp"
+#include "JobSystem.hpp"
+#include "LightClusters.hpp"
+#include "RenderGraph.hpp"
 #include "Renderer.hpp"
+#include "ShadowCascades.hpp"
 #include "window.hpp"
 #include "GameObject.hpp"
 
 // std
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace LeMU {
@@ -18,6 +24,19 @@ namespace LeMU {
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
 
+		// draws are recorded on worker threads once there are this many objects
+		static constexpr size_t PARALLEL_RECORDING_THRESHOLD = 2048;
+
+		// frame cap of the main loop, 0 disables the limiter
+		static constexpr float TARGET_FPS = 60.0f;
+
+		// share of the frame limiter's frame time dynamic resolution keeps the GPU time under,
+		// the rest is headroom for present
+		static constexpr float GPU_BUDGET_SHARE = 0.85f;
+
+		// the main loop prints the frame times of this many seconds and starts over
+		static constexpr float STATS_INTERVAL_SECONDS = 10.0f;
+
 		FirstApp();
 		~FirstApp();
 
@@ -26,14 +45,23 @@ namespace LeMU {
 
 		void run();
 
+		// run the benchmark called name, see Benchmarks::getNames. False if there is none
+		bool runBenchmark(const std::string &name);
+
 	private:
 		void loadGameObjects();
 
 		Window window{ WIDTH, HEIGHT, "Hello Vulkan!" };
 		Device device{ window };
-		Renderer renderer{window, device};
+		JobSystem jobSystem{};
+		Renderer renderer{window, device, jobSystem.getThreadCount()};
+		RenderGraph renderGraph{device, renderer};
 	
 		std::vector<GameObject> gameObjects;
+		std::vector<Light> lights;
+		DirectionalLight sun{};
+
+		FrameLimiter frameLimiter{ TARGET_FPS };
 
 	};
 }  // namespace lve
\ No newline at end of file
@@ -0,0 +1,1375 @@
+#include "pch.h"
+
+#include "Benchmarks.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+#include "BindlessTextures.hpp"
+#include "CascadedShadows.hpp"
+#include "ClusteredLighting.hpp"
+#include "DynamicResolution.hpp"
+#include "FrameLimiter.hpp"
+#include "Image.hpp"
+#include "IndirectRenderSystem.hpp"
+#include "LightClusters.hpp"
+#include "RenderSystem.hpp"
+#include "SoftwareOcclusion.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace LeMU {
+
+    namespace {
+
+        using Clock = std::chrono::high_resolution_clock;
+
+        float millisecondsBetween(Clock::time_point start, Clock::time_point end)
+        {
+            return std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+        }
+
+        void addBindStats(RenderSystem::BindStats& sum, const RenderSystem::BindStats& stats)
+        {
+            sum.pipelineBinds += stats.pipelineBinds;
+            sum.modelBinds += stats.modelBinds;
+            sum.draws += stats.draws;
+            sum.fallbackBinds += stats.fallbackBinds;
+        }
+
+        // look around while stepping down the aisle of createAisle, objects keep getting disoccluded
+        void walkDownAisle(TransformComponent& transform, int frame)
+        {
+            transform.translation.z = -2.0f + (frame % 120) * 0.05f;
+            transform.rotation.y = std::sin(frame * 0.03f) * 0.6f;
+        }
+
+        // GPU time between begin and end of each frame, from two timestamps per frame slot. A slot is
+        // read back when it comes around again, after beginFrame waited on its fence
+        class GpuPassTimer {
+        public:
+            GpuPassTimer(Device& device, uint32_t frameCount) : device{ device }, pending(frameCount, false)
+            {
+                uint32_t queueFamilyCount = 0;
+                vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, nullptr);
+                std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+                vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+                uint32_t timestampBits = queueFamilies[device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+                if (timestampBits == 0) return;
+                timestampPeriod = device.properties.limits.timestampPeriod;
+                timestampMask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+
+                VkQueryPoolCreateInfo queryPoolInfo{};
+                queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+                queryPoolInfo.queryCount = frameCount * 2;
+                if (vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+                    throw std::runtime_error("failed to create timestamp query pool!");
+            }
+
+            // the frames using the pool have to be complete
+            ~GpuPassTimer()
+            {
+                if (queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device.device(), queryPool, nullptr);
+            }
+
+            GpuPassTimer(const GpuPassTimer&) = delete;
+            GpuPassTimer& operator=(const GpuPassTimer&) = delete;
+
+            inline bool isSupported() const { return queryPool != VK_NULL_HANDLE; }
+            inline FrameStats& getStats() { return stats; }
+
+            void begin(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+            {
+                if (queryPool == VK_NULL_HANDLE) return;
+                read(frameIndex);
+                vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * 2, 2);
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frameIndex * 2);
+            }
+
+            void end(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+            {
+                if (queryPool == VK_NULL_HANDLE) return;
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frameIndex * 2 + 1);
+                pending[frameIndex] = true;
+            }
+
+            // read the slots still pending, once the device is idle
+            void collect()
+            {
+                for (uint32_t i = 0; i < pending.size(); i++) read(i);
+            }
+
+        private:
+            void read(uint32_t frameIndex)
+            {
+                if (!pending[frameIndex]) return;
+                pending[frameIndex] = false;
+
+                // each query is followed by its availability
+                std::array<uint64_t, 4> results{};
+                VkResult result = vkGetQueryPoolResults(
+                    device.device(), queryPool, frameIndex * 2, 2,
+                    sizeof(results), results.data(), 2 * sizeof(uint64_t),
+                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+                if (result != VK_SUCCESS || results[1] == 0 || results[3] == 0) return;
+
+                uint64_t ticks = (results[2] - results[0]) & timestampMask;
+                stats.addSample(static_cast<float>(ticks) * timestampPeriod / 1000000.0f);
+            }
+
+            Device& device;
+            VkQueryPool queryPool = VK_NULL_HANDLE;
+            float timestampPeriod = 0.0f;	// nanoseconds per tick
+            uint64_t timestampMask = 0;		// valid bits of the graphics queue
+            std::vector<bool> pending;
+            FrameStats stats;
+        };
+
+        struct BenchmarkEntry {
+            const char* name;
+            void (*run)(Benchmarks& benchmarks);
+        };
+
+        const BenchmarkEntry BENCHMARKS[] = {
+            { "resize-storm", [](Benchmarks& benchmarks) { benchmarks.runResizeStorm(); } },
+            { "draw-scaling", [](Benchmarks& benchmarks) { benchmarks.runDrawScaling(); } },
+            { "latency", [](Benchmarks& benchmarks) { benchmarks.runLatency(); } },
+            { "frame-pacing", [](Benchmarks& benchmarks) { benchmarks.runFramePacing(); } },
+            { "render-graph", [](Benchmarks& benchmarks) { benchmarks.runRenderGraph(); } },
+            { "culling", [](Benchmarks& benchmarks) { benchmarks.runCulling(); } },
+            { "gpu-driven", [](Benchmarks& benchmarks) { benchmarks.runGpuDriven(); } },
+            { "instancing", [](Benchmarks& benchmarks) { benchmarks.runInstancing(); } },
+            { "render-queue", [](Benchmarks& benchmarks) { benchmarks.runRenderQueue(); } },
+            { "bindless", [](Benchmarks& benchmarks) { benchmarks.runBindless(); } },
+            { "occlusion", [](Benchmarks& benchmarks) { benchmarks.runOcclusion(); } },
+            { "software-occlusion", [](Benchmarks& benchmarks) { benchmarks.runSoftwareOcclusion(); } },
+            { "pipeline-compile", [](Benchmarks& benchmarks) { benchmarks.runPipelineCompile(); } },
+            { "dynamic-resolution", [](Benchmarks& benchmarks) { benchmarks.runDynamicResolution(); } },
+            { "clustered-lighting", [](Benchmarks& benchmarks) { benchmarks.runClusteredLighting(); } },
+            { "shadow-cache", [](Benchmarks& benchmarks) { benchmarks.runShadowCache(); } } };
+    }
+
+
+
+    Benchmarks::Benchmarks(Window& window, Device& device, JobSystem& jobSystem, Renderer& renderer, RenderGraph& renderGraph, std::vector<GameObject>& sceneObjects)
+        : window{ window }, device{ device }, jobSystem{ jobSystem }, renderer{ renderer }, renderGraph{ renderGraph }, sceneObjects{ sceneObjects }
+    {
+        assert(!sceneObjects.empty() && sceneObjects.front().model && "Benchmarks need a scene model to repeat");
+    }
+
+
+
+    std::vector<std::string> Benchmarks::getNames()
+    {
+        std::vector<std::string> names;
+        for (const auto& entry : BENCHMARKS)
+            names.push_back(entry.name);
+        return names;
+    }
+
+
+
+    bool Benchmarks::run(const std::string& name)
+    {
+        for (const auto& entry : BENCHMARKS)
+        {
+            if (name == entry.name)
+            {
+                entry.run(*this);
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+
+    FrameStats Benchmarks::runFrames(
+        int frameCount,
+        const std::function<void(int frame)>& update,
+        const std::function<void(VkCommandBuffer commandBuffer, int frame)>& record)
+    {
+        FrameStats frameStats{};
+        auto currentTime = Clock::now();
+
+        for (int frame = 0; frame < frameCount && !window.shouldClose(); frame++)
+        {
+            // before the input, like the main loop paces before sampling it
+            if (update) update(frame);
+            glfwPollEvents();
+
+            if (auto commandBuffer = renderer.beginFrame())
+            {
+                record(commandBuffer, frame);
+                renderer.endFrame();
+            }
+
+            auto newTime = Clock::now();
+            frameStats.addSample(millisecondsBetween(currentTime, newTime));
+            currentTime = newTime;
+        }
+
+        return frameStats;
+    }
+
+
+
+    FrameStats Benchmarks::runTimedRecording(
+        int frameCount,
+        const std::function<void(int frame)>& update,
+        const std::function<void(VkCommandBuffer commandBuffer, int frame)>& record,
+        VkSubpassContents contents)
+    {
+        FrameStats recordStats{};
+
+        runFrames(frameCount, update, [&](VkCommandBuffer commandBuffer, int frame) {
+            renderer.beginSwapChainRenderPass(commandBuffer, contents);
+
+            // culling plus recording, not acquire or submit
+            auto recordStart = Clock::now();
+            record(commandBuffer, frame);
+            recordStats.addSample(millisecondsBetween(recordStart, Clock::now()));
+
+            renderer.endSwapChainRenderPass(commandBuffer);
+        });
+
+        return recordStats;
+    }
+
+
+
+    std::vector<GameObject> Benchmarks::createObjectGrid(const ObjectGrid& grid) const
+    {
+        const float count = static_cast<float>(grid.count);
+        const int gridSize = std::max(1, static_cast<int>(std::ceil(grid.volume ? std::cbrt(count) : std::sqrt(count))));
+
+        std::vector<GameObject> objects;
+        objects.reserve(grid.count);
+        for (size_t i = 0; i < grid.count; i++)
+        {
+            int index = static_cast<int>(i);
+            float column = static_cast<float>(index % gridSize - gridSize / 2);
+            float row = static_cast<float>((grid.volume ? (index / gridSize) % gridSize : index / gridSize) - gridSize / 2);
+            float layer = static_cast<float>(index / (gridSize * gridSize) - gridSize / 2);
+
+            auto obj = GameObject::createGameObject();
+            obj.model = getSceneModel();
+            obj.transform.translation = grid.center + grid.spacing * (grid.volume ?
+                glm::vec3{ column, row, layer } :
+                glm::vec3{ column, 0.0f, row });
+            obj.transform.scale = glm::vec3{ grid.scale };
+            objects.push_back(std::move(obj));
+        }
+
+        return objects;
+    }
+
+
+
+    std::vector<GameObject> Benchmarks::createAisle(size_t objectCount, const std::shared_ptr<Model>& wallModel, const std::shared_ptr<OccluderMesh>& occluder) const
+    {
+        // walls across the aisle every few units, each row of props hides behind the wall in front of it
+        constexpr int wallCount = 8;
+        constexpr float wallSpacing = 4.0f;
+
+        std::vector<GameObject> objects;
+        objects.reserve(objectCount + wallCount);
+        for (int wall = 0; wall < wallCount; wall++)
+        {
+            auto obj = GameObject::createGameObject();
+            obj.model = wallModel;
+            obj.occluder = occluder;
+            obj.color = { 0.6f, 0.6f, 0.6f };
+            obj.transform.translation = { 0.0f, 0.0f, 3.0f + wall * wallSpacing };
+            obj.transform.scale = { 6.0f, 3.0f, 0.1f };
+            objects.push_back(std::move(obj));
+        }
+
+        const size_t propsPerRow = std::max<size_t>(objectCount / wallCount, 1);
+        const int gridSize = std::max(1, static_cast<int>(std::sqrt(static_cast<float>(propsPerRow))));
+        for (size_t i = 0; i < objectCount; i++)
+        {
+            int row = static_cast<int>(std::min<size_t>(i / propsPerRow, wallCount - 1));
+            int index = static_cast<int>(i % propsPerRow);
+
+            auto obj = GameObject::createGameObject();
+            obj.model = getSceneModel();
+            obj.transform.translation = {
+                ((index % gridSize) / static_cast<float>(gridSize) - 0.5f) * 10.0f,
+                ((index / gridSize) % gridSize / static_cast<float>(gridSize) - 0.5f) * 5.0f,
+                3.5f + row * wallSpacing + (index % 7) * 0.4f };
+            obj.transform.scale = { 0.1f, 0.1f, 0.1f };
+            objects.push_back(std::move(obj));
+        }
+
+        return objects;
+    }
+
+
+
+    void Benchmarks::setCamera(Camera& camera, const TransformComponent& transform, float farPlane) const
+    {
+        camera.setViewYXZ(transform.translation, transform.rotation);
+        camera.setPerspectiveProjection(glm::radians(50.0f), renderer.getAspectRatio(), 0.1f, farPlane);
+    }
+
+
+
+    void Benchmarks::turnCamera(Camera& camera, TransformComponent& transform, int frame) const
+    {
+        transform.rotation.y = frame * 0.02f;
+        setCamera(camera, transform);
+    }
+
+
+
+    void Benchmarks::runResizeStorm(int frameCount)
+    {
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        Camera camera{};
+        camera.setViewDirection(glm::vec3(0.0), glm::vec3(0.0f, 0.0f, 1.0f));
+
+        // window sizes cycled through during the storm
+        const int sizes[][2] = { {800, 600}, {1024, 768}, {640, 480}, {1280, 720}, {900, 500} };
+        const int sizeCount = static_cast<int>(sizeof(sizes) / sizeof(sizes[0]));
+
+        FrameStats frameStats = runFrames(frameCount,
+            [&](int frame) {
+                // resize every other frame, every resize forces a swap chain recreation
+                if (frame % 2 == 0)
+                {
+                    const int* size = sizes[(frame / 2) % sizeCount];
+                    glfwSetWindowSize(window.getGLFWwindow(), size[0], size[1]);
+                }
+            },
+            [&](VkCommandBuffer commandBuffer, int) {
+                camera.setPerspectiveProjection(glm::radians(50.0f), renderer.getAspectRatio(), 0.1f, 10.0f);
+                renderer.beginSwapChainRenderPass(commandBuffer);
+                renderSystem.renderGameObjects(commandBuffer, sceneObjects, camera);
+                renderer.endSwapChainRenderPass(commandBuffer);
+            });
+
+        vkDeviceWaitIdle(device.device());
+        frameStats.print("Resize storm");
+    }
+
+
+
+    void Benchmarks::runDrawScaling(size_t objectCount, int framesPerRun)
+    {
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        Camera camera{};
+        camera.setViewDirection(glm::vec3(0.0), glm::vec3(0.0f, 0.0f, 1.0f));
+
+        // a block of small copies of the scene model, all of it in view
+        ObjectGrid grid{};
+        grid.count = objectCount;
+        grid.spacing = 0.1f;
+        grid.center = { 0.0f, 0.0f, 5.0f };
+        grid.scale = 0.05f;
+        std::vector<GameObject> objects = createObjectGrid(grid);
+
+        float singleThreadTime = 0.0f;
+        for (uint32_t threadCount = 1; threadCount <= 8; threadCount *= 2)
+        {
+            if (threadCount > renderer.getRecordingThreadCount()) break;
+
+            FrameStats recordStats = runTimedRecording(framesPerRun,
+                [&](int) { camera.setPerspectiveProjection(glm::radians(50.0f), renderer.getAspectRatio(), 0.1f, 10.0f); },
+                [&](VkCommandBuffer commandBuffer, int) {
+                    renderSystem.renderGameObjectsParallel(commandBuffer, jobSystem, objects, camera, threadCount);
+                },
+                VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+            if (threadCount == 1) singleThreadTime = recordStats.average();
+
+            recordStats.print("Draw recording, " + std::to_string(objectCount) + " objects, " + std::to_string(threadCount) + " threads");
+            if (recordStats.average() > 0.0f)
+                std::cout << "\tspeedup: " << singleThreadTime / recordStats.average() << "x" << std::endl;
+        }
+
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runLatency(int framesPerSetting)
+    {
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        Camera camera{};
+        camera.setViewDirection(glm::vec3(0.0), glm::vec3(0.0f, 0.0f, 1.0f));
+
+        // { frames in flight, swap chain images (0 = driver minimum + 1) }
+        const SwapChainConfig settings[] = { {1, 0}, {1, 2}, {2, 0}, {2, 3}, {3, 0}, {3, 4} };
+
+        for (const auto& config : settings)
+        {
+            renderer.setSwapChainConfig(config);
+            renderer.resetLatencyStats();
+
+            FrameStats frameStats = runFrames(framesPerSetting, nullptr, [&](VkCommandBuffer commandBuffer, int) {
+                camera.setPerspectiveProjection(glm::radians(50.0f), renderer.getAspectRatio(), 0.1f, 10.0f);
+                renderer.beginSwapChainRenderPass(commandBuffer);
+                renderSystem.renderGameObjects(commandBuffer, sceneObjects, camera);
+                renderer.endSwapChainRenderPass(commandBuffer);
+            });
+
+            std::string label = std::to_string(renderer.getFramesInFlight()) + " frames in flight, " +
+                std::to_string(renderer.getSwapChainImageCount()) + " images";
+            frameStats.print("Frame time, " + label);
+            renderer.getLatencyStats().print("Latency, " + label);
+        }
+
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runFramePacing(float targetFps, int framesPerMode)
+    {
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        Camera camera{};
+        camera.setViewDirection(glm::vec3(0.0), glm::vec3(0.0f, 0.0f, 1.0f));
+
+        const VkPresentModeKHR presentModes[] = {
+            VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+            VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+        const char* presentModeNames[] = { "FIFO", "FIFO relaxed", "Mailbox", "Immediate" };
+
+        FrameLimiter limiter{ targetFps };
+        SwapChainConfig config{};
+
+        for (int mode = 0; mode < 4; mode++)
+        {
+            config.presentMode = presentModes[mode];
+            renderer.setSwapChainConfig(config);
+            limiter.setTargetFps(targetFps);
+
+            FrameStats frameStats = runFrames(framesPerMode,
+                [&](int) { limiter.wait(); },
+                [&](VkCommandBuffer commandBuffer, int) {
+                    camera.setPerspectiveProjection(glm::radians(50.0f), renderer.getAspectRatio(), 0.1f, 10.0f);
+                    renderer.beginSwapChainRenderPass(commandBuffer);
+                    renderSystem.renderGameObjects(commandBuffer, sceneObjects, camera);
+                    renderer.endSwapChainRenderPass(commandBuffer);
+                });
+
+            // unsupported modes fall back to FIFO, the swap chain prints what it picked
+            frameStats.print(std::string("Frame pacing, ") + presentModeNames[mode] + " requested, " +
+                std::to_string(static_cast<int>(targetFps)) + " fps target");
+        }
+
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runRenderGraph(int frameCount)
+    {
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        Camera camera{};
+        camera.setViewDirection(glm::vec3(0.0), glm::vec3(0.0f, 0.0f, 1.0f));
+
+        // synthetic passes only clear their outputs, what matters is placement, barriers and culling
+        auto clearColor = [this](VkCommandBuffer cmd, RGResource image) {
+            VkClearColorValue color{};
+            VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            vkCmdClearColorImage(cmd, renderGraph.getImage(image), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &color, 1, &range);
+        };
+        auto clearDepth = [this](VkCommandBuffer cmd, RGResource image) {
+            VkClearDepthStencilValue depth{ 1.0f, 0 };
+            VkImageSubresourceRange range{ VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+            vkCmdClearDepthStencilImage(cmd, renderGraph.getImage(image), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &depth, 1, &range);
+        };
+
+        FrameStats compileStats{};
+
+        runFrames(frameCount, nullptr, [&](VkCommandBuffer commandBuffer, int) {
+            camera.setPerspectiveProjection(glm::radians(50.0f), renderer.getAspectRatio(), 0.1f, 10.0f);
+
+            VkExtent2D extent = renderer.getSwapChainExtent();
+            VkExtent2D halfExtent = { std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u) };
+
+            auto graphStart = Clock::now();
+
+            renderGraph.reset();
+            RGResource backbuffer = renderGraph.importSwapChainImage();
+            RGResource shadowMap = renderGraph.createImage("shadow map", { VK_FORMAT_D32_SFLOAT, { 2048, 2048 }, VK_IMAGE_ASPECT_DEPTH_BIT });
+            RGResource depth = renderGraph.createImage("depth", { VK_FORMAT_D32_SFLOAT, extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+            RGResource hdr = renderGraph.createImage("hdr", { VK_FORMAT_R16G16B16A16_SFLOAT, extent });
+            RGResource bloom = renderGraph.createImage("bloom", { VK_FORMAT_R16G16B16A16_SFLOAT, halfExtent });
+            RGResource ldr = renderGraph.createImage("ldr", { VK_FORMAT_R8G8B8A8_UNORM, extent });
+            RGResource debug = renderGraph.createImage("debug", { VK_FORMAT_R8G8B8A8_UNORM, extent });
+
+            renderGraph.addPass("shadow",
+                [&](RenderGraph::PassBuilder& builder) { builder.write(shadowMap, RGAccess::TransferWrite); },
+                [&](VkCommandBuffer cmd) { clearDepth(cmd, shadowMap); });
+            renderGraph.addPass("depth prepass",
+                [&](RenderGraph::PassBuilder& builder) { builder.write(depth, RGAccess::TransferWrite); },
+                [&](VkCommandBuffer cmd) { clearDepth(cmd, depth); });
+            renderGraph.addPass("lighting",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.read(shadowMap, RGAccess::FragmentShaderRead);
+                    builder.read(depth, RGAccess::DepthAttachmentRead);
+                    builder.write(hdr, RGAccess::TransferWrite);
+                },
+                [&](VkCommandBuffer cmd) { clearColor(cmd, hdr); });
+            renderGraph.addPass("bloom",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.read(hdr, RGAccess::FragmentShaderRead);
+                    builder.write(bloom, RGAccess::TransferWrite);
+                },
+                [&](VkCommandBuffer cmd) { clearColor(cmd, bloom); });
+            renderGraph.addPass("tonemap",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.read(hdr, RGAccess::FragmentShaderRead);
+                    builder.read(bloom, RGAccess::FragmentShaderRead);
+                    builder.write(ldr, RGAccess::TransferWrite);
+                },
+                [&](VkCommandBuffer cmd) { clearColor(cmd, ldr); });
+
+            // nothing reads it, culled
+            renderGraph.addPass("debug overlay",
+                [&](RenderGraph::PassBuilder& builder) { builder.write(debug, RGAccess::TransferWrite); },
+                [&](VkCommandBuffer cmd) { clearColor(cmd, debug); });
+
+            renderGraph.addPass("swapchain",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.read(ldr, RGAccess::FragmentShaderRead);
+                    builder.write(backbuffer, RGAccess::ColorAttachmentWrite);
+                },
+                [&](VkCommandBuffer cmd) {
+                    renderer.beginSwapChainRenderPass(cmd);
+                    renderSystem.renderGameObjects(cmd, sceneObjects, camera);
+                    renderer.endSwapChainRenderPass(cmd);
+                });
+
+            renderGraph.compile();
+            compileStats.addSample(millisecondsBetween(graphStart, Clock::now()));
+
+            renderGraph.execute(commandBuffer);
+        });
+
+        vkDeviceWaitIdle(device.device());
+        compileStats.print("Render graph build + compile");
+        renderGraph.printStats();
+    }
+
+
+
+    void Benchmarks::runCulling(size_t objectCount, int framesPerKernel)
+    {
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+
+        // objects scattered all around the camera, most of them are behind it or off to the side
+        ObjectGrid grid{};
+        grid.count = objectCount;
+        std::vector<GameObject> objects = createObjectGrid(grid);
+
+        struct Setting {
+            const char* name;
+            bool culling;
+            CullingKernel kernel;
+        };
+        const Setting settings[] = {
+            { "no culling", false, CullingKernel::Scalar },
+            { "scalar", true, CullingKernel::Scalar },
+            { "SSE", true, CullingKernel::SSE },
+            { "AVX", true, CullingKernel::AVX } };
+
+        const CullingKernel bestKernel = detectCullingKernel();
+
+        for (const auto& setting : settings)
+        {
+            if (setting.kernel > bestKernel) continue;
+            renderSystem.setFrustumCulling(setting.culling);
+            renderSystem.setCullingKernel(setting.kernel);
+
+            size_t visibleSum = 0;
+
+            FrameStats recordStats = runTimedRecording(framesPerKernel,
+                [&](int frame) { turnCamera(camera, cameraObject.transform, frame); },
+                [&](VkCommandBuffer commandBuffer, int) {
+                    renderSystem.renderGameObjectsParallel(commandBuffer, jobSystem, objects, camera);
+                    visibleSum += renderSystem.getCullingStats().visible;
+                },
+                VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+            recordStats.print(std::string("Cull + record, ") + std::to_string(objectCount) + " objects, " + setting.name);
+            if (recordStats.sampleCount() > 0)
+                std::cout << "\tvisible: " << visibleSum / recordStats.sampleCount() << " of " << objectCount << " per frame" << std::endl;
+        }
+
+        renderSystem.setFrustumCulling(true);
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runGpuDriven(int framesPerRun)
+    {
+        if (!IndirectRenderSystem::isSupported(device))
+        {
+            std::cout << "GPU-driven rendering not supported on this device" << std::endl;
+            return;
+        }
+
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+        IndirectRenderSystem indirectRenderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+
+        for (size_t objectCount : { 10000, 50000, 200000 })
+        {
+            ObjectGrid grid{};
+            grid.count = objectCount;
+            std::vector<GameObject> objects = createObjectGrid(grid);
+
+            indirectRenderSystem.uploadGameObjects(objects);
+
+            for (bool gpuDriven : { false, true })
+            {
+                FrameStats recordStats{};
+
+                runFrames(framesPerRun,
+                    [&](int frame) { turnCamera(camera, cameraObject.transform, frame); },
+                    [&](VkCommandBuffer commandBuffer, int) {
+                        // everything the CPU spends on the objects: culling and recording
+                        auto recordStart = Clock::now();
+                        if (gpuDriven)
+                        {
+                            indirectRenderSystem.cull(commandBuffer, camera);
+                            renderer.beginSwapChainRenderPass(commandBuffer);
+                            indirectRenderSystem.render(commandBuffer, camera);
+                        }
+                        else
+                        {
+                            renderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                            renderSystem.renderGameObjectsParallel(commandBuffer, jobSystem, objects, camera);
+                        }
+                        recordStats.addSample(millisecondsBetween(recordStart, Clock::now()));
+
+                        renderer.endSwapChainRenderPass(commandBuffer);
+                    });
+
+                recordStats.print(std::string(gpuDriven ? "GPU-driven" : "CPU culled, parallel recording") + ", " +
+                    std::to_string(objectCount) + " objects, CPU time");
+            }
+
+            // visibility of the last camera, GPU against CPU
+            indirectRenderSystem.verifyAgainstCpu(camera);
+        }
+
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runInstancing(size_t objectCount, int framesPerRun)
+    {
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+        cameraObject.transform.translation = { 0.0f, -1.0f, 0.0f };
+
+        // a flat forest: every object uses the scene model, scaled a little differently
+        ObjectGrid grid{};
+        grid.count = objectCount;
+        grid.volume = false;
+        std::vector<GameObject> objects = createObjectGrid(grid);
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            float scale = 0.1f + 0.05f * static_cast<float>(i % 3);
+            objects[i].transform.scale = { scale, scale, scale };
+            objects[i].transform.rotation.y = i * 0.7f;
+        }
+
+        // sorted, the render queue turns each run of one model into a single instanced draw
+        for (bool instanced : { false, true })
+        {
+            renderSystem.setDrawSorting(instanced);
+
+            size_t drawCallSum = 0;
+            size_t visibleSum = 0;
+
+            FrameStats recordStats = runTimedRecording(framesPerRun,
+                [&](int frame) { turnCamera(camera, cameraObject.transform, frame); },
+                [&](VkCommandBuffer commandBuffer, int) {
+                    renderSystem.renderGameObjects(commandBuffer, objects, camera);
+                    drawCallSum += renderSystem.getBindStats().draws;
+                    visibleSum += renderSystem.getCullingStats().visible;
+                });
+
+            recordStats.print(std::string(instanced ? "Instanced" : "One draw per object") + ", " +
+                std::to_string(objectCount) + " objects, CPU time");
+            if (recordStats.sampleCount() > 0)
+                std::cout << "\tdraw calls: " << drawCallSum / recordStats.sampleCount() << " for "
+                          << visibleSum / recordStats.sampleCount() << " visible objects per frame" << std::endl;
+        }
+
+        renderSystem.setDrawSorting(true);
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runRenderQueue(size_t objectCount, int modelCount, int framesPerRun)
+    {
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        // separate copies of the scene model, so binds differ between them
+        std::vector<std::shared_ptr<Model>> models;
+        for (int i = 0; i < modelCount; i++)
+            models.push_back(Model::createModelFromFile(device, "models/viking_room.obj"));
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+
+        ObjectGrid grid{};
+        grid.count = objectCount;
+        std::vector<GameObject> objects = createObjectGrid(grid);
+        for (size_t i = 0; i < objects.size(); i++)
+            objects[i].model = models[i % models.size()];
+
+        for (bool sorted : { false, true })
+        {
+            renderSystem.setDrawSorting(sorted);
+
+            RenderSystem::BindStats bindSum{};
+
+            FrameStats recordStats = runTimedRecording(framesPerRun,
+                [&](int frame) { turnCamera(camera, cameraObject.transform, frame); },
+                [&](VkCommandBuffer commandBuffer, int) {
+                    renderSystem.renderGameObjects(commandBuffer, objects, camera);
+                    addBindStats(bindSum, renderSystem.getBindStats());
+                });
+
+            recordStats.print(std::string(sorted ? "Sorted render queue" : "Object order") + ", " +
+                std::to_string(objectCount) + " objects, " + std::to_string(modelCount) + " models, CPU time");
+            if (recordStats.sampleCount() > 0)
+                std::cout << "\tper frame: " << bindSum.pipelineBinds / recordStats.sampleCount() << " pipeline binds, "
+                          << bindSum.modelBinds / recordStats.sampleCount() << " model binds, "
+                          << bindSum.draws / recordStats.sampleCount() << " draws" << std::endl;
+        }
+
+        renderSystem.setDrawSorting(true);
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runBindless(size_t objectCount, int textureCount, int frameCount)
+    {
+        if (!BindlessTextureTable::isSupported(device))
+        {
+            std::cout << "Bindless benchmark skipped, descriptor indexing is not supported" << std::endl;
+            return;
+        }
+
+        BindlessTextureTable textures{device, renderer};
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget(), &textures};
+
+        // separate images, each one is its own descriptor in the table
+        std::vector<std::unique_ptr<Image>> images;
+        std::vector<uint32_t> textureIndices;
+        for (int i = 0; i < textureCount; i++)
+        {
+            images.push_back(std::make_unique<Image>("statue.jpg", device));
+            textureIndices.push_back(textures.add(*images.back()));
+        }
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+
+        ObjectGrid grid{};
+        grid.count = objectCount;
+        std::vector<GameObject> objects = createObjectGrid(grid);
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            objects[i].materialFeatures = TexturedFeature;
+            objects[i].textureIndex = textureIndices[i % textureIndices.size()];
+        }
+
+        RenderSystem::BindStats bindSum{};
+        int textureSwaps = 0;
+
+        FrameStats recordStats = runTimedRecording(frameCount,
+            [&](int frame) {
+                // swap a texture out and back in while earlier frames still sample the table
+                if (frame % 30 == 29)
+                {
+                    size_t swapped = static_cast<size_t>(textureSwaps++) % textureIndices.size();
+                    uint32_t oldIndex = textureIndices[swapped];
+                    textureIndices[swapped] = textures.add(*images[swapped]);
+                    textures.remove(oldIndex);
+
+                    for (size_t i = swapped; i < objects.size(); i += textureIndices.size())
+                        objects[i].textureIndex = textureIndices[swapped];
+                }
+
+                turnCamera(camera, cameraObject.transform, frame);
+            },
+            [&](VkCommandBuffer commandBuffer, int) {
+                renderSystem.renderGameObjects(commandBuffer, objects, camera);
+                addBindStats(bindSum, renderSystem.getBindStats());
+            });
+
+        recordStats.print("Bindless textures, " + std::to_string(objectCount) + " objects, " +
+            std::to_string(textures.getTextureCount()) + " textures, CPU time");
+        if (recordStats.sampleCount() > 0)
+            std::cout << "\tper frame: " << bindSum.pipelineBinds / recordStats.sampleCount() << " pipeline binds, "
+                      << bindSum.modelBinds / recordStats.sampleCount() << " model binds, "
+                      << bindSum.draws / recordStats.sampleCount() << " draws, "
+                      << textureSwaps << " textures swapped at runtime" << std::endl;
+
+        // the images have to outlive every frame that can sample them
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runOcclusion(size_t objectCount, int framesPerRun)
+    {
+        if (!IndirectRenderSystem::isSupported(device))
+        {
+            std::cout << "GPU-driven rendering not supported on this device" << std::endl;
+            return;
+        }
+
+        IndirectRenderSystem indirectRenderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+
+        std::shared_ptr<Model> wallModel = Model::createModelFromFile(device, "models/cube.obj");
+        std::vector<GameObject> objects = createAisle(objectCount, wallModel, nullptr);
+        indirectRenderSystem.uploadGameObjects(objects);
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+        float averageGpuTime[2] = { 0.0f, 0.0f };
+
+        for (bool occlusion : { false, true })
+        {
+            indirectRenderSystem.setOcclusionCulling(occlusion);
+            indirectRenderSystem.resetOcclusionStats();
+            renderer.resetLatencyStats();
+
+            // the frame time is held at the present rate, the GPU time of the cull and raster passes is not
+            GpuPassTimer gpuTimer{ device, renderer.getFramesInFlight() };
+
+            FrameStats frameStats = runFrames(framesPerRun,
+                [&](int frame) {
+                    walkDownAisle(cameraObject.transform, frame);
+                    setCamera(camera, cameraObject.transform);
+                },
+                [&](VkCommandBuffer commandBuffer, int) {
+                    uint32_t frameIndex = static_cast<uint32_t>(renderer.getFrameIndex());
+                    gpuTimer.begin(commandBuffer, frameIndex);
+
+                    indirectRenderSystem.cull(commandBuffer, camera);
+                    renderer.beginSwapChainRenderPass(commandBuffer);
+                    indirectRenderSystem.render(commandBuffer, camera);
+                    renderer.endSwapChainRenderPass(commandBuffer);
+
+                    if (occlusion)
+                    {
+                        indirectRenderSystem.cullOccluded(commandBuffer, camera);
+                        renderer.resumeSwapChainRenderPass(commandBuffer);
+                        indirectRenderSystem.renderOccluded(commandBuffer, camera);
+                        renderer.endSwapChainRenderPass(commandBuffer);
+                    }
+
+                    gpuTimer.end(commandBuffer, frameIndex);
+                });
+
+            vkDeviceWaitIdle(device.device());
+            gpuTimer.collect();
+
+            std::string label = std::string(occlusion ? "Two-phase occlusion culling" : "Frustum culling only") + ", " +
+                std::to_string(objects.size()) + " objects";
+            frameStats.print("Frame time, " + label);
+            renderer.getLatencyStats().print("Latency, " + label);
+            if (gpuTimer.isSupported())
+            {
+                gpuTimer.getStats().print("GPU time of the cull and raster passes, " + label);
+                averageGpuTime[occlusion ? 1 : 0] = gpuTimer.getStats().average();
+            }
+
+            auto stats = indirectRenderSystem.readOcclusionStats();
+            if (occlusion && stats.frustumVisible > 0)
+                std::cout << "\toccluded: " << 100.0 * stats.occluded / stats.frustumVisible << "% of the objects in the frustum, "
+                          << 100.0 * stats.occludedFirstPhase / stats.frustumVisible << "% held back by the first phase" << std::endl;
+        }
+
+        if (averageGpuTime[0] > 0.0f && averageGpuTime[1] > 0.0f)
+            std::cout << "Occlusion culling saved " << averageGpuTime[0] - averageGpuTime[1] << " ms of GPU time per frame" << std::endl;
+        else
+            std::cout << "No GPU timestamps on the graphics queue, occlusion culling savings not measured" << std::endl;
+
+        indirectRenderSystem.setOcclusionCulling(false);
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runSoftwareOcclusion(size_t objectCount, int framesPerRun)
+    {
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget()};
+        SoftwareOcclusionBuffer occlusionBuffer{};
+
+        std::shared_ptr<Model> wallModel = Model::createModelFromFile(device, "models/cube.obj");
+        const auto& wallBounds = wallModel->getBounds();
+        std::vector<GameObject> objects = createAisle(objectCount, wallModel, OccluderMesh::createBox(wallBounds.min, wallBounds.max));
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+
+        occlusionBuffer.setKernel(detectCullingKernel());
+
+        for (bool occlusion : { false, true })
+        {
+            renderSystem.setSoftwareOcclusion(occlusion ? &occlusionBuffer : nullptr);
+
+            FrameStats rasterizeStats{};
+            FrameStats recordStats{};
+            size_t visibleSum = 0;
+            size_t occludedSum = 0;
+
+            runFrames(framesPerRun,
+                [&](int frame) {
+                    walkDownAisle(cameraObject.transform, frame);
+                    setCamera(camera, cameraObject.transform);
+                },
+                [&](VkCommandBuffer commandBuffer, int) {
+                    auto rasterizeStart = Clock::now();
+                    if (occlusion)
+                        occlusionBuffer.render(camera.getProjectionMatrix() * camera.getViewMatrix(), objects, &jobSystem);
+                    auto rasterizeEnd = Clock::now();
+
+                    renderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                    renderSystem.renderGameObjectsParallel(commandBuffer, jobSystem, objects, camera);
+                    auto recordEnd = Clock::now();
+
+                    renderer.endSwapChainRenderPass(commandBuffer);
+
+                    rasterizeStats.addSample(millisecondsBetween(rasterizeStart, rasterizeEnd));
+                    recordStats.addSample(millisecondsBetween(rasterizeEnd, recordEnd));
+                    visibleSum += renderSystem.getCullingStats().visible;
+                    occludedSum += renderSystem.getCullingStats().occluded;
+                });
+
+            std::string label = std::string(occlusion ? "software occlusion" : "frustum culling only") + ", " +
+                std::to_string(objects.size()) + " objects";
+            if (occlusion)
+                rasterizeStats.print(std::string("Occluder rasterization, ") + getCullingKernelName(occlusionBuffer.getKernel()) +
+                    ", " + std::to_string(occlusionBuffer.getTriangleCount()) + " triangles");
+            recordStats.print("Cull + record, " + label);
+            if (recordStats.sampleCount() > 0)
+                std::cout << "\tvisible: " << visibleSum / recordStats.sampleCount() << ", occluded: " << occludedSum / recordStats.sampleCount()
+                          << " of " << objects.size() << " per frame" << std::endl;
+        }
+
+        renderSystem.setSoftwareOcclusion(nullptr);
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runPipelineCompile(size_t objectCount, int frameCount)
+    {
+        if (!BindlessTextureTable::isSupported(device))
+        {
+            std::cout << "Pipeline compile benchmark skipped, descriptor indexing is not supported" << std::endl;
+            return;
+        }
+
+        BindlessTextureTable textures{device, renderer};
+        RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget(), &textures};
+        renderSystem.setAsyncPipelineCompilation(true);
+
+        Image image{"statue.jpg", device};
+        uint32_t textureIndex = textures.add(image);
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+
+        // every object can take any feature mask, normal mapped ones sample the statue as their normal map
+        constexpr uint32_t permutationCount = 1u << MATERIAL_FEATURE_COUNT;
+        ObjectGrid grid{};
+        grid.count = objectCount;
+        std::vector<GameObject> objects = createObjectGrid(grid);
+        for (auto& obj : objects)
+        {
+            obj.materialFeatures = RenderSystem::FALLBACK_MATERIAL_FEATURES;
+            obj.textureIndex = textureIndex;
+            obj.normalMapIndex = textureIndex;
+        }
+
+        renderer.getPipelineCache().resetStats();
+
+        const int introduceEvery = std::max(1, frameCount / static_cast<int>(permutationCount));
+        uint32_t nextFeatures = 0;
+        size_t fallbackBinds = 0;
+        int fallbackFrames = 0;
+
+        FrameStats recordStats = runTimedRecording(frameCount,
+            [&](int frame) {
+                // one sixteenth of the objects moves to the next unused permutation
+                if (frame % introduceEvery == 0 && nextFeatures < permutationCount)
+                {
+                    for (size_t i = nextFeatures; i < objects.size(); i += permutationCount)
+                        objects[i].materialFeatures = nextFeatures;
+                    nextFeatures++;
+                }
+
+                turnCamera(camera, cameraObject.transform, frame);
+            },
+            [&](VkCommandBuffer commandBuffer, int) {
+                renderSystem.renderGameObjects(commandBuffer, objects, camera);
+                fallbackBinds += renderSystem.getBindStats().fallbackBinds;
+                if (renderSystem.getBindStats().fallbackBinds > 0) fallbackFrames++;
+            });
+
+        PipelineCache::Stats compileStats = renderer.getPipelineCache().getStats();
+
+        recordStats.print("Async pipeline compilation, " + std::to_string(objectCount) + " objects, CPU time");
+        std::cout << "\t" << nextFeatures << " permutations introduced, " << renderSystem.getMaterialPipelineCount() << " ready, "
+                  << compileStats.creationMilliseconds << " ms compiled off the frame (slowest "
+                  << compileStats.slowestMilliseconds << " ms), " << fallbackFrames << " frames drew "
+                  << fallbackBinds << " runs with the fallback" << std::endl;
+        renderer.getPipelineCache().printStats("Pipeline cache");
+
+        // the texture has to outlive every frame that can sample it
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runDynamicResolution(size_t objectCount, int framesPerRun)
+    {
+        if (!renderer.canTransferToSwapChain())
+        {
+            std::cout << "Dynamic resolution benchmark skipped, swap chain images can't be blitted to" << std::endl;
+            return;
+        }
+
+        // a block in front of the camera, objects overlap so every pixel is shaded many times
+        ObjectGrid grid{};
+        grid.count = objectCount;
+        grid.spacing = 0.2f;
+        grid.center = { 0.0f, 0.0f, 7.0f };
+        grid.scale = 0.6f;
+        std::vector<GameObject> objects = createObjectGrid(grid);
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+
+        DynamicResolutionSettings fixedSettings{};
+        fixedSettings.minScale = 1.0f;
+        fixedSettings.maxScale = 1.0f;
+
+        struct Run { const char* name; DynamicResolutionSettings settings; };
+        const std::array<Run, 2> runs = { {
+            { "fixed scale 1.0", fixedSettings },
+            { "dynamic scale", DynamicResolutionSettings{} } } };
+
+        for (const auto& run : runs)
+        {
+            DynamicResolution resolution{device, renderer, run.settings};
+            RenderSystem renderSystem{device, renderer, resolution.getRenderTarget()};
+
+            if (!resolution.hasGpuTiming())
+            {
+                std::cout << "Dynamic resolution benchmark skipped, the graphics queue has no timestamps" << std::endl;
+                break;
+            }
+
+            float scaleSum = 0.0f;
+            float lowestScale = resolution.getScale();
+            int recordedFrames = 0;
+            int framesOverBudget = 0;
+            size_t readBack = 0;
+
+            runFrames(framesPerRun,
+                [&](int frame) {
+                    // facing away for the first and last sixth, turning in the second and fifth
+                    float t = static_cast<float>(frame) / framesPerRun;
+                    float turn = std::clamp(std::min(t, 1.0f - t) * 6.0f - 1.0f, 0.0f, 1.0f);
+                    cameraObject.transform.rotation.y = (1.0f - turn) * glm::pi<float>();
+                    setCamera(camera, cameraObject.transform);
+                },
+                [&](VkCommandBuffer commandBuffer, int) {
+                    resolution.beginFrame(commandBuffer);
+                    if (resolution.getGpuStats().sampleCount() > readBack)
+                    {
+                        readBack = resolution.getGpuStats().sampleCount();
+                        if (resolution.getLastGpuMilliseconds() > run.settings.targetMilliseconds) framesOverBudget++;
+                    }
+
+                    resolution.beginScenePass(commandBuffer);
+                    renderSystem.renderGameObjects(commandBuffer, objects, camera);
+                    resolution.endScenePass(commandBuffer);
+                    resolution.blitToSwapChain(commandBuffer);
+
+                    scaleSum += resolution.getScale();
+                    lowestScale = std::min(lowestScale, resolution.getScale());
+                    recordedFrames++;
+                });
+
+            // the remaining frames are waited for, the render system and targets go with them
+            vkDeviceWaitIdle(device.device());
+
+            resolution.getGpuStats().print("Dynamic resolution, " + std::string(run.name) + ", " +
+                std::to_string(objectCount) + " objects, GPU time");
+            if (recordedFrames > 0)
+                std::cout << "\tscale average " << scaleSum / recordedFrames << ", lowest " << lowestScale
+                          << ", " << framesOverBudget << " of " << readBack << " frames over the "
+                          << run.settings.targetMilliseconds << " ms budget" << std::endl;
+        }
+    }
+
+
+
+    void Benchmarks::runClusteredLighting(size_t objectCount, int framesPerRun)
+    {
+        // the GPU timestamps of the dynamic resolution target, held at full scale
+        if (!renderer.canTransferToSwapChain())
+        {
+            std::cout << "Clustered lighting benchmark skipped, swap chain images can't be blitted to" << std::endl;
+            return;
+        }
+
+        // a field of objects on the ground in front of the camera, far wider than the view
+        constexpr float FIELD_HALF_WIDTH = 40.0f;
+        ObjectGrid grid{};
+        grid.count = objectCount;
+        grid.volume = false;
+        grid.spacing = 2.0f * FIELD_HALF_WIDTH / std::max(1.0f, std::ceil(std::sqrt(static_cast<float>(objectCount))));
+        grid.center = { 0.0f, 0.0f, FIELD_HALF_WIDTH + 1.0f };
+        grid.scale = 0.8f;
+        std::vector<GameObject> objects = createObjectGrid(grid);
+
+        // above the field looking down at it, y is down
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+        cameraObject.transform.translation = { 0.0f, -4.0f, 0.0f };
+        cameraObject.transform.rotation.x = -0.35f;
+        camera.setViewYXZ(cameraObject.transform.translation, cameraObject.transform.rotation);
+
+        DynamicResolutionSettings fixedSettings{};
+        fixedSettings.minScale = 1.0f;
+        fixedSettings.maxScale = 1.0f;
+        DynamicResolution resolution{device, renderer, fixedSettings};
+        if (!resolution.hasGpuTiming())
+        {
+            std::cout << "Clustered lighting benchmark skipped, the graphics queue has no timestamps" << std::endl;
+            return;
+        }
+
+        ClusteredLighting lighting{device, renderer};
+        RenderSystem renderSystem{device, renderer, resolution.getRenderTarget(), nullptr, &lighting};
+
+        // spread: the area grows with the light count, as many lights around each object at every count.
+        // packed: every light in the part of the field the camera sees
+        constexpr float VIEW_HALF_WIDTH = 8.0f;
+        struct Layout { const char* name; bool spread; };
+        const std::array<Layout, 2> layouts = { { { "spread", true }, { "packed", false } } };
+        const std::array<size_t, 3> lightCounts = { 10, 100, 1000 };
+
+        for (const auto& layout : layouts)
+        {
+            for (size_t lightCount : lightCounts)
+            {
+                float halfWidth = VIEW_HALF_WIDTH;
+                if (layout.spread) halfWidth *= std::sqrt(static_cast<float>(lightCount) / lightCounts[0]);
+
+                std::vector<Light> sceneLights(lightCount);
+                std::vector<glm::vec3> anchors(lightCount);
+                for (size_t i = 0; i < lightCount; i++)
+                {
+                    // golden ratio sequences, evenly spread and the same every run
+                    float u = std::fmod(i * 0.618034f, 1.0f);
+                    float v = std::fmod(i * 0.754878f + 0.5f, 1.0f);
+                    anchors[i] = { (2.0f * u - 1.0f) * halfWidth, -0.5f, 1.0f + 2.0f * v * halfWidth };
+
+                    Light& light = sceneLights[i];
+                    light.range = 3.0f;
+                    light.color = { 0.5f + 0.5f * u, 0.5f + 0.5f * v, 1.0f - 0.5f * u };
+                    if (i % 4 == 3)
+                    {
+                        light.type = LightType::Spot;
+                        light.direction = { 0.0f, 1.0f, 0.0f };
+                    }
+                }
+
+                resolution.resetGpuStats();
+                FrameStats binStats{};
+                size_t lightsInViewSum = 0;
+                double clusterLightsSum = 0.0;
+                uint32_t maxClusterLights = 0;
+
+                runFrames(framesPerRun,
+                    [&](int frame) {
+                        camera.setPerspectiveProjection(glm::radians(50.0f), renderer.getAspectRatio(), 0.1f, 50.0f);
+
+                        // every light circles its anchor, the clusters are rebuilt each frame
+                        float time = frame * 0.02f;
+                        for (size_t i = 0; i < lightCount; i++)
+                        {
+                            float phase = time + i * 0.37f;
+                            sceneLights[i].position = anchors[i] + glm::vec3(std::cos(phase), 0.0f, std::sin(phase));
+                        }
+                    },
+                    [&](VkCommandBuffer commandBuffer, int) {
+                        resolution.beginFrame(commandBuffer);
+                        lighting.update(sceneLights, camera, resolution.getRenderExtent(), &jobSystem);
+
+                        const auto& gridStats = lighting.getGrid().getStats();
+                        binStats.addSample(gridStats.buildMilliseconds);
+                        lightsInViewSum += gridStats.lightsInView;
+                        if (gridStats.occupiedClusters > 0)
+                            clusterLightsSum += static_cast<double>(gridStats.lightIndices) / gridStats.occupiedClusters;
+                        maxClusterLights = std::max(maxClusterLights, gridStats.maxClusterLights);
+
+                        resolution.beginScenePass(commandBuffer);
+                        renderSystem.renderGameObjects(commandBuffer, objects, camera);
+                        resolution.endScenePass(commandBuffer);
+                        resolution.blitToSwapChain(commandBuffer);
+                    });
+
+                // the last timestamps are read back by the next frames, wait for them before the report
+                vkDeviceWaitIdle(device.device());
+
+                std::string label = "Clustered lighting, " + std::to_string(lightCount) + " lights " + layout.name;
+                resolution.getGpuStats().print(label + ", GPU time");
+                binStats.print(label + ", binning");
+                if (binStats.sampleCount() > 0)
+                    std::cout << "\t" << lightsInViewSum / binStats.sampleCount() << " lights in view, "
+                              << clusterLightsSum / binStats.sampleCount() << " lights per occupied cluster on average, "
+                              << maxClusterLights << " at most" << std::endl;
+            }
+        }
+
+        vkDeviceWaitIdle(device.device());
+    }
+
+
+
+    void Benchmarks::runShadowCache(size_t staticCount, size_t dynamicCount, int framesPerRun)
+    {
+        // a static field the camera walks across, the moving objects circle in front of the camera
+        constexpr float FIELD_HALF_WIDTH = 60.0f;
+        ObjectGrid grid{};
+        grid.count = staticCount + dynamicCount;
+        grid.volume = false;
+        grid.spacing = 2.0f * FIELD_HALF_WIDTH / std::max(1.0f, std::ceil(std::sqrt(static_cast<float>(grid.count))));
+        grid.scale = 0.8f;
+        std::vector<GameObject> objects = createObjectGrid(grid);
+        for (size_t i = 0; i < staticCount; i++)
+            objects[i].isStatic = true;
+
+        // no point lights, the sun only
+        ClusteredLighting lighting{device, renderer};
+        const std::vector<Light> noLights;
+
+        Camera camera{};
+        auto cameraObject = GameObject::createGameObject();
+        DirectionalLight light{};
+
+        ShadowCascadeSettings uncachedSettings{};
+        uncachedSettings.cacheStaticCasters = false;
+
+        struct Run { const char* name; ShadowCascadeSettings settings; };
+        const std::array<Run, 2> runs = { {
+            { "every caster each frame", uncachedSettings },
+            { "static casters cached", ShadowCascadeSettings{} } } };
+
+        for (const auto& run : runs)
+        {
+            CascadedShadows shadows{device, renderer, run.settings};
+            RenderSystem renderSystem{device, renderer, renderer.getSwapChainRenderTarget(), nullptr, &lighting, &shadows};
+
+            if (!shadows.hasGpuTiming())
+            {
+                std::cout << "Shadow cache benchmark skipped, the graphics queue has no timestamps" << std::endl;
+                break;
+            }
+
+            size_t staticCasterSum = 0;
+            size_t mostStaticCasters = 0;
+            size_t dynamicCasterSum = 0;
+            size_t staticCascadeSum = 0;
+            int recordedFrames = 0;
+
+            runFrames(framesPerRun,
+                [&](int frame) {
+                    // walk across the field looking left and right, y is down
+                    float t = static_cast<float>(frame) / framesPerRun;
+                    cameraObject.transform.translation = { 0.0f, -3.0f, FIELD_HALF_WIDTH * (t - 0.5f) };
+                    cameraObject.transform.rotation = { -0.3f, 0.6f * std::sin(t * glm::two_pi<float>()), 0.0f };
+                    setCamera(camera, cameraObject.transform, 60.0f);
+
+                    // the sun turns for the last quarter, every cascade is redrawn while it does
+                    float sunAngle = 0.6f + std::max(t - 0.75f, 0.0f) * 2.0f;
+                    light.direction = glm::normalize(glm::vec3{ 0.5f * std::cos(sunAngle), 1.0f, 0.5f * std::sin(sunAngle) });
+
+                    glm::vec3 circleCenter = cameraObject.transform.translation + glm::vec3{ 0.0f, 3.0f, 8.0f };
+                    for (size_t i = 0; i < dynamicCount; i++)
+                    {
+                        float radius = 2.0f + static_cast<float>(i % 8);
+                        float angle = frame * 0.03f + i * 0.7f;
+                        objects[staticCount + i].transform.translation =
+                            circleCenter + glm::vec3{ radius * std::cos(angle), 0.0f, radius * std::sin(angle) };
+                    }
+                },
+                [&](VkCommandBuffer commandBuffer, int) {
+                    lighting.update(noLights, camera, renderer.getSwapChainExtent());
+                    shadows.render(commandBuffer, objects, camera, light);
+
+                    renderer.beginSwapChainRenderPass(commandBuffer);
+                    renderSystem.renderGameObjects(commandBuffer, objects, camera);
+                    renderer.endSwapChainRenderPass(commandBuffer);
+
+                    const auto& stats = shadows.getStats();
+                    staticCasterSum += stats.staticCasters;
+                    mostStaticCasters = std::max(mostStaticCasters, stats.staticCasters);
+                    dynamicCasterSum += stats.dynamicCasters;
+                    staticCascadeSum += stats.staticCascades;
+                    recordedFrames++;
+                });
+
+            // the last timestamps are read back by the frames still in flight, the maps go with them
+            vkDeviceWaitIdle(device.device());
+
+            shadows.getGpuStats().print("Cascaded shadows, " + std::string(run.name) + ", " +
+                std::to_string(staticCount) + " static and " + std::to_string(dynamicCount) + " moving objects, shadow pass GPU time");
+            if (recordedFrames > 0)
+                std::cout << "\t" << staticCasterSum / recordedFrames << " static casters redrawn per frame ("
+                          << mostStaticCasters << " at most) in " << static_cast<float>(staticCascadeSum) / recordedFrames
+                          << " cascades, " << dynamicCasterSum / recordedFrames << " moving casters per frame" << std::endl;
+        }
+
+        vkDeviceWaitIdle(device.device());
+    }
+
+}  // namespace lve
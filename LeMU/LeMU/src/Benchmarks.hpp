@@ -0,0 +1,153 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "Device.hpp"
+#include "FrameStats.hpp"
+#include "GameObject.hpp"
+#include "JobSystem.hpp"
+#include "RenderGraph.hpp"
+#include "Renderer.hpp"
+#include "window.hpp"
+
+// std
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace LeMU {
+
+	// copies of one model laid out on a regular grid, centered on center
+	struct ObjectGrid {
+		size_t count = 0;
+		bool volume = true;			// a cube of cbrt(count) per side, or a square of sqrt(count) per side in the xz plane
+		float spacing = 0.5f;		// between neighbouring objects
+		glm::vec3 center{ 0.0f };
+		float scale = 0.1f;
+	};
+
+
+
+	// the benchmarks of the renderer, each one renders its own scene on the app's window and
+	// prints its results. They share the app's device, renderer and job system
+	class Benchmarks {
+	public:
+		Benchmarks(Window &window, Device &device, JobSystem &jobSystem, Renderer &renderer, RenderGraph &renderGraph, std::vector<GameObject> &sceneObjects);
+
+		Benchmarks(const Benchmarks&) = delete;
+		Benchmarks& operator=(const Benchmarks&) = delete;
+
+		// names run accepts
+		static std::vector<std::string> getNames();
+
+		// run the benchmark called name with its default settings, false if there is none
+		bool run(const std::string &name);
+
+		// resize the window continuously while rendering and report the worst-case frame time
+		void runResizeStorm(int frameCount = 600);
+
+		// record objectCount draws with 1, 2, 4 and 8 threads and report CPU recording time per frame
+		void runDrawScaling(size_t objectCount = 20000, int framesPerRun = 200);
+
+		// render with several frames-in-flight / image count settings and report CPU-to-present latency
+		void runLatency(int framesPerSetting = 300);
+
+		// render with every present mode, paced to targetFps, and report frame-time jitter
+		void runFramePacing(float targetFps = 60.0f, int framesPerMode = 300);
+
+		// build a shadow / depth prepass / lighting / post chain through the render graph every frame,
+		// report build time, culled passes, barriers and transient memory with and without aliasing
+		void runRenderGraph(int frameCount = 300);
+
+		// objects scattered around a turning camera, compare cull + record time with no culling and
+		// with the scalar, SSE and AVX culling kernels
+		void runCulling(size_t objectCount = 100000, int framesPerKernel = 200);
+
+		// CPU time per frame of the CPU culled path against the GPU-driven path for growing object
+		// counts, then check the GPU visibility against the CPU culling kernel
+		void runGpuDriven(int framesPerRun = 200);
+
+		// forest style scene of a few models repeated objectCount times, draw calls and CPU time of
+		// RenderSystem recording one draw per object against one instanced draw per run of a model
+		void runInstancing(size_t objectCount = 20000, int framesPerRun = 200);
+
+		// objects spread over modelCount models in interleaved order, pipeline / model binds and
+		// CPU time per frame recorded in object order against recorded through the sorted render queue
+		void runRenderQueue(size_t objectCount = 20000, int modelCount = 4, int framesPerRun = 200);
+
+		// objects spread over textureCount textures through the bindless texture table, one texture is
+		// removed and added back every few frames while frames are in flight. Reports draws and binds
+		// per frame, which stay at one per model however many textures there are
+		void runBindless(size_t objectCount = 20000, int textureCount = 64, int frameCount = 300);
+
+		// interior scene: rows of walls with objects behind them, the camera walks down the aisle.
+		// GPU-driven rendering with and without two-phase occlusion culling, reports the occluded
+		// share of the objects in the frustum and the GPU time of the cull and raster passes saved
+		void runOcclusion(size_t objectCount = 50000, int framesPerRun = 300);
+
+		// the same interior scene on the CPU path: walls are rasterized into the software occlusion
+		// buffer on the job system and objects behind them are not recorded. Reports rasterization
+		// and cull + record time with and without it
+		void runSoftwareOcclusion(size_t objectCount = 50000, int framesPerRun = 300);
+
+		// objects switch to a material permutation nobody used before every few frames, so pipelines
+		// keep compiling while frames are recorded. Records with async compilation, the objects draw with
+		// the fallback until theirs is ready, reports CPU time per frame against the compile time and
+		// the compile queue depth and latency
+		void runPipelineCompile(size_t objectCount = 20000, int frameCount = 300);
+
+		// the camera turns towards a block of overlapping objects, holds and turns away again. Renders
+		// through the dynamic resolution target at a fixed full scale and with the scale following the
+		// GPU budget, reports GPU time, the scale and the frames over budget of both
+		void runDynamicResolution(size_t objectCount = 20000, int framesPerRun = 600);
+
+		// a field of objects lit by 10, 100 and 1000 moving lights through clustered forward lighting,
+		// once spread so the lights around each object stay the same and once packed into the view.
+		// Reports GPU time, binning time and lights per cluster, which follow the local light density
+		void runClusteredLighting(size_t objectCount = 4096, int framesPerRun = 300);
+
+		// a field of static objects with a few moving ones, the camera walks across it and the light turns
+		// for the last quarter. Cascaded shadows with every caster redrawn each frame against the static
+		// casters cached, reports shadow pass GPU time and the casters drawn per frame
+		void runShadowCache(size_t staticCount = 20000, size_t dynamicCount = 200, int framesPerRun = 400);
+
+	private:
+		// frameCount frames of update(frame), input, and record(commandBuffer, frame) between the renderer's
+		// beginFrame and endFrame. A frame the swap chain can't take right now is not recorded but still
+		// counts. Returns the wall clock time of every frame
+		FrameStats runFrames(
+			int frameCount,
+			const std::function<void(int frame)> &update,
+			const std::function<void(VkCommandBuffer commandBuffer, int frame)> &record);
+
+		// runFrames with record(commandBuffer, frame) inside the swap chain render pass, begun with contents.
+		// Returns the CPU time of every record call, culling and recording but not acquire or submit
+		FrameStats runTimedRecording(
+			int frameCount,
+			const std::function<void(int frame)> &update,
+			const std::function<void(VkCommandBuffer commandBuffer, int frame)> &record,
+			VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+
+		// the scene model repeated on grid
+		std::vector<GameObject> createObjectGrid(const ObjectGrid &grid) const;
+
+		// rows of walls across an aisle with objectCount props spread over the rows behind them, the walls
+		// come first. Walls get occluder when it is set
+		std::vector<GameObject> createAisle(size_t objectCount, const std::shared_ptr<Model> &wallModel, const std::shared_ptr<OccluderMesh> &occluder) const;
+
+		// look from transform with the benchmarks' perspective projection
+		void setCamera(Camera &camera, const TransformComponent &transform, float farPlane = 50.0f) const;
+
+		// turn in place from transform by frame, so the visible set changes every frame
+		void turnCamera(Camera &camera, TransformComponent &transform, int frame) const;
+
+		inline const std::shared_ptr<Model>& getSceneModel() const { return sceneObjects.front().model; }
+
+		Window &window;
+		Device &device;
+		JobSystem &jobSystem;
+		Renderer &renderer;
+		RenderGraph &renderGraph;
+		std::vector<GameObject> &sceneObjects;		// the app's scene
+	};
+}  // namespace lve
@@ -0,0 +1,129 @@
+#include "pch.h"
+
+#include "BindlessTextures.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace LeMU {
+
+    bool BindlessTextureTable::isSupported(Device& device)
+    {
+        return device.getFeatures().descriptorIndexing;
+    }
+
+
+
+    BindlessTextureTable::BindlessTextureTable(Device& device, Renderer& renderer, uint32_t capacity)
+        : device{device}, renderer{renderer}
+    {
+        assert(isSupported(device) && "bindless textures need descriptor indexing");
+
+        // the whole array counts against the update-after-bind limits of a set and of one stage
+        VkPhysicalDeviceVulkan12Properties vulkan12Properties{};
+        vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &vulkan12Properties;
+        vkGetPhysicalDeviceProperties2(device.getPhysicalDevice(), &properties);
+
+        this->capacity = std::min({ capacity,
+            vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages,
+            vulkan12Properties.maxDescriptorSetUpdateAfterBindSamplers,
+            vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers });
+        if (this->capacity < capacity)
+            std::cout << "bindless texture table clamped to " << this->capacity << " textures" << std::endl;
+
+        descriptorSetLayout = renderer.getDescriptorLayoutCache().createLayout(
+            { makeDescriptorBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, this->capacity) },
+            VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+            { VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+              VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+              VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT });
+
+        // update-after-bind sets need a pool of their own
+        VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, this->capacity };
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+
+        if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create bindless descriptor pool!");
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &descriptorSetLayout;
+
+        if (vkAllocateDescriptorSets(device.device(), &allocInfo, &descriptorSet) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate bindless descriptor set!");
+    }
+
+
+    BindlessTextureTable::~BindlessTextureTable()
+    {
+        // frames still sampling the set keep the pool alive until they complete
+        Device* owner = &device;
+        VkDescriptorPool pool = descriptorPool;
+        renderer.deferDestroy([owner, pool]() {
+            vkDestroyDescriptorPool(owner->device(), pool, nullptr);
+        });
+    }
+
+
+
+    uint32_t BindlessTextureTable::add(const Image& image)
+    {
+        uint32_t slot;
+        if (!freeSlots->empty())
+        {
+            slot = freeSlots->back();
+            freeSlots->pop_back();
+        }
+        else if (nextSlot < capacity)
+        {
+            slot = nextSlot++;
+        }
+        else
+        {
+            throw std::runtime_error("bindless texture table is full!");
+        }
+
+        // the slot is not used by any pending frame, so it can be written while the set is bound
+        VkDescriptorImageInfo imageInfo = image.getDescriptorInfo();
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = descriptorSet;
+        write.dstBinding = 0;
+        write.dstArrayElement = slot;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(device.device(), 1, &write, 0, nullptr);
+
+        textureCount++;
+        return slot;
+    }
+
+
+    void BindlessTextureTable::remove(uint32_t index)
+    {
+        assert(index < nextSlot && "texture index was never handed out");
+        assert(textureCount > 0 && "no texture to remove");
+
+        // the descriptor stays as it is, partially bound slots nobody indexes are never read
+        textureCount--;
+        std::shared_ptr<std::vector<uint32_t>> slots = freeSlots;
+        renderer.deferDestroy([slots, index]() { slots->push_back(index); });
+    }
+}  // namespace lve
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Descriptor.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "Renderer.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace LeMU {
+
+	// every texture lives in one partially bound combined image sampler array (set 1, binding 0),
+	// shaders pick one with the index in the object data. The set is bound once per frame, so
+	// objects with different textures still share draws. Slots are written with update-after-bind,
+	// textures can be added and removed while frames using the set are in flight
+	class BindlessTextureTable {
+	public:
+		static constexpr uint32_t DEFAULT_CAPACITY = 4096;
+
+		static bool isSupported(Device &device);
+
+		// capacity is clamped to the device's update-after-bind limits
+		BindlessTextureTable(Device &device, Renderer &renderer, uint32_t capacity = DEFAULT_CAPACITY);
+		~BindlessTextureTable();
+
+		BindlessTextureTable(const BindlessTextureTable&) = delete;
+		BindlessTextureTable& operator=(const BindlessTextureTable&) = delete;
+
+		// returns the slot index, the image has to stay alive until it is removed
+		uint32_t add(const Image &image);
+
+		// the slot is handed out again once every frame submitted so far has completed,
+		// until then in-flight frames may still sample it
+		void remove(uint32_t index);
+
+		inline VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+		inline VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+		inline uint32_t getCapacity() const { return capacity; }
+		inline uint32_t getTextureCount() const { return textureCount; }
+
+	private:
+		Device &device;
+		Renderer &renderer;
+
+		uint32_t capacity;
+		uint32_t textureCount = 0;
+		uint32_t nextSlot = 0;	// slots below were handed out at least once
+		// shared with pending deletion queue entries, which may run after the table is gone
+		std::shared_ptr<std::vector<uint32_t>> freeSlots = std::make_shared<std::vector<uint32_t>>();
+
+		VkDescriptorSetLayout descriptorSetLayout;	// owned by the renderer's layout cache
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	};
+}  // namespace lve
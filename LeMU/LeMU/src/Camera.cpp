@@ -1,3 +1,5 @@
+#include "pch.h"
+
 #include "Camera.hpp"
 
 // std
@@ -39,6 +41,8 @@ namespace LeMU
 		glm::vec3 position, glm::vec3 direction, glm::vec3 up)
 	{
 		// ortho normal basis
+		this->position = position;
+
 		const glm::vec3 w{ glm::normalize(direction) };
 		const glm::vec3 u{ glm::normalize(glm::cross(w, up)) };
 		const glm::vec3 v{ glm::cross(w, u) };
@@ -71,6 +75,8 @@ namespace LeMU
 	// specify the orientation by using euler angle
 	void Camera::setViewYXZ(glm::vec3 position, glm::vec3 rotation)
 	{
+		this->position = position;
+
 		const float c3 = glm::cos(rotation.z);
 		const float s3 = glm::sin(rotation.z);
 		const float c2 = glm::cos(rotation.x);
@@ -96,4 +102,30 @@ namespace LeMU
 	}
 
 
+
+	// clip space is -w <= x, y <= w and 0 <= z <= w (GLM_FORCE_DEPTH_ZERO_TO_ONE),
+	// every inequality is a plane made of rows of the projection * view matrix
+	Frustum Camera::getFrustum() const
+	{
+		const glm::mat4 m = projectionMatrix * viewMatrix;
+		const glm::vec4 row0{ m[0][0], m[1][0], m[2][0], m[3][0] };
+		const glm::vec4 row1{ m[0][1], m[1][1], m[2][1], m[3][1] };
+		const glm::vec4 row2{ m[0][2], m[1][2], m[2][2], m[3][2] };
+		const glm::vec4 row3{ m[0][3], m[1][3], m[2][3], m[3][3] };
+
+		Frustum frustum{};
+		frustum.planes[Frustum::Left] = row3 + row0;
+		frustum.planes[Frustum::Right] = row3 - row0;
+		frustum.planes[Frustum::Bottom] = row3 + row1;
+		frustum.planes[Frustum::Top] = row3 - row1;
+		frustum.planes[Frustum::Near] = row2;
+		frustum.planes[Frustum::Far] = row3 - row2;
+
+		for (auto& plane : frustum.planes)
+			plane /= glm::length(glm::vec3(plane));
+
+		return frustum;
+	}
+
+
 }
\ No newline at end of file
@@ -10,6 +10,17 @@
 namespace LeMU
 {
 
+	// planes as (normal, distance), normals point inside and are normalized,
+	// so dot(normal, p) + distance is the signed distance of p
+	struct Frustum
+	{
+		enum Plane { Left = 0, Right, Bottom, Top, Near, Far, Count };
+
+		glm::vec4 planes[Count];
+	};
+
+
+
 	class Camera 
 	{
 	public:
@@ -19,6 +30,10 @@ namespace LeMU
 
 		inline const glm::mat4& getProjectionMatrix() const { return projectionMatrix; }
 		inline const glm::mat4& getViewMatrix() const { return viewMatrix; }
+		inline const glm::vec3& getPosition() const { return position; }
+
+		// world space view frustum, extracted from projection * view
+		Frustum getFrustum() const;
 
 		void setViewDirection(  
 			glm::vec3 position, glm::vec3 direction, glm::vec3 up = glm::vec3{0.0f, -1.0f, 0.0f});
@@ -32,6 +47,7 @@ namespace LeMU
 	private:
 		glm::mat4 projectionMatrix{ 1.0f };
 		glm::mat4 viewMatrix{ 1.0f };
+		glm::vec3 position{ 0.0f };
 
 	};
 
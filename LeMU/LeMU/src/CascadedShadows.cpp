@@ -0,0 +1,631 @@
+#include "pch.h"
+
+#include "CascadedShadows.hpp"
+
+#include "Culling.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace LeMU {
+
+    namespace {
+
+        struct ShadowPushConstants
+        {
+            glm::mat4 transform;	// light view projection times the caster's model matrix
+        };
+
+        // slope scaled, the texels of a cascade get large on surfaces at a grazing angle to the light
+        constexpr float DEPTH_BIAS_CONSTANT = 1.25f;
+        constexpr float DEPTH_BIAS_SLOPE = 1.75f;
+
+        bool touchesFrustum(const Frustum& frustum, const glm::vec4& sphere)
+        {
+            for (const auto& plane : frustum.planes)
+                if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) return false;
+            return true;
+        }
+    }
+
+
+
+    CascadedShadows::CascadedShadows(Device& device, Renderer& renderer, const ShadowCascadeSettings& settings)
+        : device{ device }, renderer{ renderer }, cascades{ settings }
+    {
+        // the static maps are copied into the sampled one, both need transfers besides depth and sampling
+        depthFormat = device.findSupportedFormat(
+            { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM },
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+            VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT);
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), depthFormat, &formatProperties);
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+            compareFilter = VK_FILTER_NEAREST;
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+        uint32_t timestampBits = queueFamilies[device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+        timestampPeriod = device.properties.limits.timestampPeriod;
+        timestampMask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+
+        descriptorSetLayout = renderer.getDescriptorLayoutCache().createLayout({
+            makeDescriptorBinding(ShadowUboBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
+            makeDescriptorBinding(ShadowMapBinding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) });
+
+        if (!renderer.usesDynamicRendering()) createRenderPasses();
+        createImages();
+        createSampler();
+        createPipeline();
+        if (timestampBits > 0) createQueryPool(renderer.getFramesInFlight());
+    }
+
+    CascadedShadows::~CascadedShadows()
+    {
+        // the last frames may still draw into the maps or sample them
+        Device* owner = &device;
+        std::vector<VkFramebuffer> retiredFramebuffers = staticFramebuffers;
+        retiredFramebuffers.insert(retiredFramebuffers.end(), shadowFramebuffers.begin(), shadowFramebuffers.end());
+        std::vector<VkImageView> retiredViews = staticLayerViews;
+        retiredViews.insert(retiredViews.end(), shadowLayerViews.begin(), shadowLayerViews.end());
+        retiredViews.push_back(shadowArrayView);
+        std::array<VkImage, 2> retiredImages = { staticImage, shadowImage };
+        std::array<VkDeviceMemory, 2> retiredMemory = { staticMemory, shadowMemory };
+        std::array<VkRenderPass, 2> retiredRenderPasses = { clearRenderPass, loadRenderPass };
+        VkSampler retiredSampler = sampler;
+        VkQueryPool retiredQueryPool = queryPool;
+        std::vector<FrameData> retiredFrames = frames;
+
+        renderer.deferDestroy([owner, retiredFramebuffers, retiredViews, retiredImages, retiredMemory,
+            retiredRenderPasses, retiredSampler, retiredQueryPool, retiredFrames]() {
+            for (auto framebuffer : retiredFramebuffers) vkDestroyFramebuffer(owner->device(), framebuffer, nullptr);
+            for (auto view : retiredViews) vkDestroyImageView(owner->device(), view, nullptr);
+            for (auto image : retiredImages) vkDestroyImage(owner->device(), image, nullptr);
+            for (auto memory : retiredMemory) vkFreeMemory(owner->device(), memory, nullptr);
+            for (auto renderPass : retiredRenderPasses)
+                if (renderPass != VK_NULL_HANDLE) vkDestroyRenderPass(owner->device(), renderPass, nullptr);
+            vkDestroySampler(owner->device(), retiredSampler, nullptr);
+            if (retiredQueryPool != VK_NULL_HANDLE) vkDestroyQueryPool(owner->device(), retiredQueryPool, nullptr);
+
+            for (const auto& frame : retiredFrames)
+            {
+                if (frame.uboBuffer == VK_NULL_HANDLE) continue;
+                vkUnmapMemory(owner->device(), frame.uboMemory);
+                vkDestroyBuffer(owner->device(), frame.uboBuffer, nullptr);
+                vkFreeMemory(owner->device(), frame.uboMemory, nullptr);
+            }
+        });
+    }
+
+
+
+    void CascadedShadows::createRenderPasses()
+    {
+        // layouts are transitioned by barriers around the passes, as on the dynamic rendering path
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef{ 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 0;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &depthAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+
+        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &clearRenderPass) != VK_SUCCESS)
+            throw std::runtime_error("failed to create shadow render pass!");
+
+        // only the load op differs, the passes are compatible and share the pipeline
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &loadRenderPass) != VK_SUCCESS)
+            throw std::runtime_error("failed to create shadow render pass!");
+    }
+
+
+
+    void CascadedShadows::createImages()
+    {
+        const auto& settings = cascades.getSettings();
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { settings.resolution, settings.resolution, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = settings.cascadeCount;
+        imageInfo.format = depthFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, staticImage, staticMemory);
+
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shadowImage, shadowMemory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = depthFormat;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+        // one view per cascade to render into
+        staticLayerViews.resize(settings.cascadeCount);
+        shadowLayerViews.resize(settings.cascadeCount);
+        for (uint32_t i = 0; i < settings.cascadeCount; i++)
+        {
+            viewInfo.subresourceRange.baseArrayLayer = i;
+
+            viewInfo.image = staticImage;
+            if (vkCreateImageView(device.device(), &viewInfo, nullptr, &staticLayerViews[i]) != VK_SUCCESS)
+                throw std::runtime_error("failed to create shadow map view!");
+
+            viewInfo.image = shadowImage;
+            if (vkCreateImageView(device.device(), &viewInfo, nullptr, &shadowLayerViews[i]) != VK_SUCCESS)
+                throw std::runtime_error("failed to create shadow map view!");
+        }
+
+        // and every cascade at once to sample
+        viewInfo.image = shadowImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, settings.cascadeCount };
+
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &shadowArrayView) != VK_SUCCESS)
+            throw std::runtime_error("failed to create shadow map view!");
+
+        if (clearRenderPass == VK_NULL_HANDLE) return;
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.width = settings.resolution;
+        framebufferInfo.height = settings.resolution;
+        framebufferInfo.layers = 1;
+
+        staticFramebuffers.resize(settings.cascadeCount);
+        shadowFramebuffers.resize(settings.cascadeCount);
+        for (uint32_t i = 0; i < settings.cascadeCount; i++)
+        {
+            framebufferInfo.renderPass = clearRenderPass;
+            framebufferInfo.pAttachments = &staticLayerViews[i];
+            if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &staticFramebuffers[i]) != VK_SUCCESS)
+                throw std::runtime_error("failed to create shadow framebuffer!");
+
+            framebufferInfo.renderPass = loadRenderPass;
+            framebufferInfo.pAttachments = &shadowLayerViews[i];
+            if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &shadowFramebuffers[i]) != VK_SUCCESS)
+                throw std::runtime_error("failed to create shadow framebuffer!");
+        }
+    }
+
+
+
+    void CascadedShadows::createSampler()
+    {
+        // the compare sampler returns the lit share of the texels around the lookup, outside of the map is lit
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = compareFilter;
+        samplerInfo.minFilter = compareFilter;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_TRUE;
+        samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = 0.0f;
+
+        if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+            throw std::runtime_error("failed to create shadow sampler!");
+    }
+
+
+
+    void CascadedShadows::createPipeline()
+    {
+        VkPushConstantRange pushRange{};
+        pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushRange.offset = 0;
+        pushRange.size = sizeof(ShadowPushConstants);
+        pipelineLayout = renderer.getPipelineCache().getPipelineLayout({}, { pushRange });
+
+        PipelineConfigInfo pipelineConfig{};
+        Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+        Pipeline::setRenderTarget(pipelineConfig, RenderTargetInfo{ clearRenderPass, VK_FORMAT_UNDEFINED, depthFormat });
+        pipelineConfig.pipelineLayout = pipelineLayout;
+
+        // depth only, from the positions
+        auto& attributes = pipelineConfig.attributeDescriptions;
+        attributes.erase(
+            std::remove_if(attributes.begin(), attributes.end(), [](const VkVertexInputAttributeDescription& attribute) {
+                return attribute.location != 0;
+            }),
+            attributes.end());
+        pipelineConfig.colorBlendInfo.attachmentCount = 0;
+
+        pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
+        pipelineConfig.rasterizationInfo.depthBiasConstantFactor = DEPTH_BIAS_CONSTANT;
+        pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = DEPTH_BIAS_SLOPE;
+
+        pipeline = renderer.getPipelineCache().getPipeline(
+            "shaders/shadow_shader.vert",
+            "shaders/shadow_shader.frag",
+            pipelineConfig);
+    }
+
+
+
+    void CascadedShadows::createQueryPool(uint32_t frameCount)
+    {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = frameCount * 2;
+
+        if (vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create timestamp query pool!");
+
+        queryFrameCount = frameCount;
+        queriesPending.assign(frameCount, false);
+    }
+
+
+
+    void CascadedShadows::readTimestamps(uint32_t frameIndex)
+    {
+        if (!queriesPending[frameIndex]) return;
+        queriesPending[frameIndex] = false;
+
+        // the slot's fence has been waited on, each query is followed by its availability
+        std::array<uint64_t, 4> results{};
+        VkResult result = vkGetQueryPoolResults(
+            device.device(), queryPool, frameIndex * 2, 2,
+            sizeof(results), results.data(), 2 * sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS || results[1] == 0 || results[3] == 0) return;
+
+        uint64_t ticks = (results[2] - results[0]) & timestampMask;
+        gpuStats.addSample(static_cast<float>(ticks) * timestampPeriod / 1000000.0f);
+    }
+
+
+
+    void CascadedShadows::render(
+        VkCommandBuffer commandBuffer,
+        std::vector<GameObject>& objects,
+        const Camera& camera,
+        const DirectionalLight& light)
+    {
+        assert(renderer.isFrameInProgress() && "Can't call render if frame is not in progress");
+
+        // frames in flight can change at runtime
+        uint32_t frameIndex = static_cast<uint32_t>(renderer.getFrameIndex());
+        if (frames.size() <= frameIndex) frames.resize(frameIndex + 1);
+
+        if (queryPool != VK_NULL_HANDLE)
+        {
+            if (queryFrameCount != renderer.getFramesInFlight())
+            {
+                Device* owner = &device;
+                VkQueryPool retiredQueryPool = queryPool;
+                renderer.deferDestroy([owner, retiredQueryPool]() {
+                    vkDestroyQueryPool(owner->device(), retiredQueryPool, nullptr);
+                });
+                createQueryPool(renderer.getFramesInFlight());
+            }
+
+            readTimestamps(frameIndex);
+            vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * 2, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frameIndex * 2);
+        }
+
+        glm::vec3 lightDirection = glm::normalize(light.direction);
+        stats = {};
+        stats.staticCascades = cascades.update(camera, lightDirection);
+
+        staticCasters.clear();
+        staticSpheres.clear();
+        dynamicCasters.clear();
+        dynamicSpheres.clear();
+        for (auto& obj : objects)
+        {
+            if (!obj.model) continue;
+            (obj.isStatic ? staticCasters : dynamicCasters).push_back(&obj);
+            (obj.isStatic ? staticSpheres : dynamicSpheres).push_back(getWorldBoundingSphere(obj));
+        }
+
+        const uint32_t cascadeCount = cascades.getCascadeCount();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, cascadeCount };
+
+        // static maps of moved regions, their old contents are discarded. Copies of earlier frames may still read them
+        if (stats.staticCascades > 0)
+        {
+            std::vector<VkImageMemoryBarrier> staticBarriers;
+            for (uint32_t i = 0; i < cascadeCount; i++)
+            {
+                if (!cascades.getCascade(i).staticDirty) continue;
+
+                VkImageMemoryBarrier layerBarrier = barrier;
+                layerBarrier.srcAccessMask = 0;
+                layerBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                layerBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                layerBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                layerBarrier.image = staticImage;
+                layerBarrier.subresourceRange.baseArrayLayer = i;
+                layerBarrier.subresourceRange.layerCount = 1;
+                staticBarriers.push_back(layerBarrier);
+            }
+
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                0, 0, nullptr, 0, nullptr,
+                static_cast<uint32_t>(staticBarriers.size()), staticBarriers.data());
+
+            for (uint32_t i = 0; i < cascadeCount; i++)
+            {
+                if (!cascades.getCascade(i).staticDirty) continue;
+
+                beginShadowPass(commandBuffer, i, true);
+                stats.staticCasters += drawCasters(commandBuffer, cascades.getCascade(i), staticCasters, staticSpheres);
+                endShadowPass(commandBuffer);
+            }
+
+            for (auto& layerBarrier : staticBarriers)
+            {
+                layerBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                layerBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                layerBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                layerBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            }
+
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, nullptr, 0, nullptr,
+                static_cast<uint32_t>(staticBarriers.size()), staticBarriers.data());
+        }
+
+        // the sampled map starts from the static one every frame, the last frame's scene may still sample it
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.image = shadowImage;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        const uint32_t resolution = cascades.getSettings().resolution;
+        VkImageCopy copyRegion{};
+        copyRegion.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, cascadeCount };
+        copyRegion.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, cascadeCount };
+        copyRegion.extent = { resolution, resolution, 1 };
+
+        vkCmdCopyImage(
+            commandBuffer,
+            staticImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            shadowImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &copyRegion);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        if (!dynamicCasters.empty())
+        {
+            for (uint32_t i = 0; i < cascadeCount; i++)
+            {
+                beginShadowPass(commandBuffer, i, false);
+                stats.dynamicCasters += drawCasters(commandBuffer, cascades.getCascade(i), dynamicCasters, dynamicSpheres);
+                endShadowPass(commandBuffer);
+            }
+        }
+
+        barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        if (queryPool != VK_NULL_HANDLE)
+        {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frameIndex * 2 + 1);
+            queriesPending[frameIndex] = true;
+        }
+
+        auto& frame = frames[frameIndex];
+        if (frame.uboBuffer == VK_NULL_HANDLE)
+        {
+            device.createBuffer(
+                sizeof(ShadowUbo),
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                frame.uboBuffer,
+                frame.uboMemory);
+
+            if (vkMapMemory(device.device(), frame.uboMemory, 0, VK_WHOLE_SIZE, 0, &frame.uboMapped) != VK_SUCCESS)
+                throw std::runtime_error("failed to map shadow uniform buffer!");
+        }
+
+        ShadowUbo ubo{};
+        for (uint32_t i = 0; i < cascadeCount; i++)
+        {
+            const auto& cascade = cascades.getCascade(i);
+            ubo.cascadeViewProjection[i] = cascade.lightCamera.getProjectionMatrix() * cascade.lightCamera.getViewMatrix();
+            ubo.splitDepths[i] = cascade.splitDepth;
+        }
+        ubo.lightDirection = glm::vec4(lightDirection, static_cast<float>(cascadeCount));
+        ubo.lightColor = glm::vec4(light.color * light.intensity, 0.0f);
+        std::memcpy(frame.uboMapped, &ubo, sizeof(ubo));
+
+        VkDescriptorImageInfo imageInfo{ sampler, shadowArrayView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        frame.descriptorSet = DescriptorWriter{ renderer.getDescriptorLayoutCache(), renderer.getFrameDescriptorAllocator() }
+            .writeBuffer(ShadowUboBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, frame.uboBuffer, 0, sizeof(ShadowUbo))
+            .writeImage(ShadowMapBinding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, imageInfo)
+            .build();
+    }
+
+
+
+    void CascadedShadows::beginShadowPass(VkCommandBuffer commandBuffer, uint32_t cascade, bool staticMap)
+    {
+        const uint32_t resolution = cascades.getSettings().resolution;
+        VkRect2D renderArea{ {0, 0}, {resolution, resolution} };
+
+#ifdef VK_KHR_dynamic_rendering
+        if (clearRenderPass == VK_NULL_HANDLE) {
+            VkRenderingAttachmentInfoKHR depthAttachment{};
+            depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            depthAttachment.imageView = staticMap ? staticLayerViews[cascade] : shadowLayerViews[cascade];
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = staticMap ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+            VkRenderingInfoKHR renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+            renderingInfo.renderArea = renderArea;
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = 0;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+
+            device.cmdBeginRendering(commandBuffer, &renderingInfo);
+        }
+        else
+#endif
+        {
+            VkClearValue clearValue{};
+            clearValue.depthStencil = { 1.0f, 0 };
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = staticMap ? clearRenderPass : loadRenderPass;
+            renderPassInfo.framebuffer = staticMap ? staticFramebuffers[cascade] : shadowFramebuffers[cascade];
+            renderPassInfo.renderArea = renderArea;
+            renderPassInfo.clearValueCount = 1;
+            renderPassInfo.pClearValues = &clearValue;
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        }
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(resolution);
+        viewport.height = static_cast<float>(resolution);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
+
+        pipeline->bind(commandBuffer);
+    }
+
+
+
+    void CascadedShadows::endShadowPass(VkCommandBuffer commandBuffer)
+    {
+#ifdef VK_KHR_dynamic_rendering
+        if (clearRenderPass == VK_NULL_HANDLE) {
+            device.cmdEndRendering(commandBuffer);
+            return;
+        }
+#endif
+
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+
+
+    size_t CascadedShadows::drawCasters(
+        VkCommandBuffer commandBuffer,
+        const ShadowCascades::Cascade& cascade,
+        const std::vector<GameObject*>& casters,
+        const std::vector<glm::vec4>& spheres)
+    {
+        // the box reaches casterDistance towards the light, casters outside the view still shadow it
+        Frustum frustum = cascade.lightCamera.getFrustum();
+        glm::mat4 viewProjection = cascade.lightCamera.getProjectionMatrix() * cascade.lightCamera.getViewMatrix();
+
+        size_t drawn = 0;
+        Model* boundModel = nullptr;
+        for (size_t i = 0; i < casters.size(); i++)
+        {
+            if (!touchesFrustum(frustum, spheres[i])) continue;
+
+            GameObject& caster = *casters[i];
+            ShadowPushConstants push{ viewProjection * caster.transform.mat4() };
+            vkCmdPushConstants(
+                commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPushConstants), &push);
+
+            if (caster.model.get() != boundModel)
+            {
+                boundModel = caster.model.get();
+                boundModel->bind(commandBuffer);
+            }
+            boundModel->draw(commandBuffer);
+            drawn++;
+        }
+        return drawn;
+    }
+
+
+
+    VkDescriptorSet CascadedShadows::getDescriptorSet() const
+    {
+        size_t frameIndex = static_cast<size_t>(renderer.getFrameIndex());
+        assert(frameIndex < frames.size() && frames[frameIndex].descriptorSet != VK_NULL_HANDLE &&
+            "CascadedShadows::render was not called this frame");
+        return frames[frameIndex].descriptorSet;
+    }
+}  // namespace lve
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "Device.hpp"
+#include "FrameStats.hpp"
+#include "GameObject.hpp"
+#include "Pipeline.hpp"
+#include "Renderer.hpp"
+#include "ShadowCascades.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace LeMU {
+
+	// what the scene shaders shade the directional light with, uniform buffer at binding 0 of the shadow set
+	struct ShadowUbo {
+		glm::mat4 cascadeViewProjection[MAX_SHADOW_CASCADES]{};
+		glm::vec4 splitDepths{ 0.0f };		// view space depth each cascade ends at
+		glm::vec4 lightDirection{ 0.0f };	// xyz: direction the light travels, w: cascade count
+		glm::vec4 lightColor{ 0.0f };		// rgb: color times intensity
+	};
+
+	// bindings of the shadow set, fragment stage only
+	enum CascadedShadowBinding : uint32_t
+	{
+		ShadowUboBinding = 0,
+		ShadowMapBinding = 1,		// depth array with a compare sampler, one layer per cascade
+	};
+
+
+
+	// cascaded shadow maps of the main directional light with the static casters cached. Objects with
+	// isStatic set are drawn into a static depth map per cascade, which is only redrawn when
+	// ShadowCascades says its region moved or the light turned. Every frame the static maps are copied
+	// into the sampled shadow map and the other objects are drawn on top of the copy. A frame:
+	//
+	//     render(commandBuffer, objects, camera, light);   outside a render pass, before the scene pass
+	//     scene draws with getDescriptorSet() bound
+	class CascadedShadows {
+	public:
+		// of the last render
+		struct Stats {
+			uint32_t staticCascades = 0;	// cascades whose static map was redrawn
+			size_t staticCasters = 0;		// draws into the static maps
+			size_t dynamicCasters = 0;		// draws on top of the copies
+		};
+
+		CascadedShadows(Device &device, Renderer &renderer, const ShadowCascadeSettings &settings = {});
+		~CascadedShadows();
+
+		CascadedShadows(const CascadedShadows&) = delete;
+		CascadedShadows& operator=(const CascadedShadows&) = delete;
+
+		// fit the cascades to camera, draw the casters of objects and write this frame's set
+		void render(VkCommandBuffer commandBuffer, std::vector<GameObject> &objects, const Camera &camera, const DirectionalLight &light);
+
+		// static objects were added, removed or moved, the next render redraws every static map
+		inline void invalidateStatic() { cascades.invalidate(); }
+
+		inline VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+		// set of the current frame, written by its render
+		VkDescriptorSet getDescriptorSet() const;
+
+		inline const ShadowCascades& getCascades() const { return cascades; }
+		inline const Stats& getStats() const { return stats; }
+
+		// false if the graphics queue has no timestamps
+		inline bool hasGpuTiming() const { return queryPool != VK_NULL_HANDLE; }
+
+		// GPU time of the shadow passes of every frame read back so far
+		inline const FrameStats& getGpuStats() const { return gpuStats; }
+		inline void resetGpuStats() { gpuStats.reset(); }
+
+	private:
+		struct FrameData {
+			VkBuffer uboBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory uboMemory = VK_NULL_HANDLE;
+			void *uboMapped = nullptr;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;		// from the frame allocator, rebuilt every frame
+		};
+
+		void createRenderPasses();
+		void createImages();
+		void createSampler();
+		void createPipeline();
+		void createQueryPool(uint32_t frameCount);
+		void readTimestamps(uint32_t frameIndex);
+
+		// draw the objects whose bounding sphere touches the cascade's box, returns how many
+		size_t drawCasters(
+			VkCommandBuffer commandBuffer,
+			const ShadowCascades::Cascade &cascade,
+			const std::vector<GameObject*> &casters,
+			const std::vector<glm::vec4> &spheres);
+
+		void beginShadowPass(VkCommandBuffer commandBuffer, uint32_t cascade, bool staticMap);
+		void endShadowPass(VkCommandBuffer commandBuffer);
+
+		Device &device;
+		Renderer &renderer;
+		ShadowCascades cascades;
+
+		VkFormat depthFormat;
+		VkFilter compareFilter = VK_FILTER_LINEAR;
+		VkRenderPass clearRenderPass = VK_NULL_HANDLE;	// static maps, VK_NULL_HANDLE with dynamic rendering
+		VkRenderPass loadRenderPass = VK_NULL_HANDLE;	// dynamic casters on top of the copy
+
+		// static maps, kept in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL between frames
+		VkImage staticImage = VK_NULL_HANDLE;
+		VkDeviceMemory staticMemory = VK_NULL_HANDLE;
+		std::vector<VkImageView> staticLayerViews;
+		std::vector<VkFramebuffer> staticFramebuffers;
+
+		// sampled by the scene, rebuilt from the static maps every frame
+		VkImage shadowImage = VK_NULL_HANDLE;
+		VkDeviceMemory shadowMemory = VK_NULL_HANDLE;
+		std::vector<VkImageView> shadowLayerViews;
+		std::vector<VkFramebuffer> shadowFramebuffers;
+		VkImageView shadowArrayView = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		VkPipelineLayout pipelineLayout;		// owned by the pipeline cache
+		std::shared_ptr<Pipeline> pipeline;
+		VkDescriptorSetLayout descriptorSetLayout;	// owned by the renderer's layout cache
+		std::vector<FrameData> frames;
+
+		// two timestamps per frame slot around the shadow passes
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		uint32_t queryFrameCount = 0;
+		float timestampPeriod = 0.0f;	// nanoseconds per tick
+		uint64_t timestampMask = 0;		// valid bits of the graphics queue
+		std::vector<bool> queriesPending;
+		FrameStats gpuStats;
+
+		// per render, reused to save allocations
+		std::vector<GameObject*> staticCasters;
+		std::vector<GameObject*> dynamicCasters;
+		std::vector<glm::vec4> staticSpheres;
+		std::vector<glm::vec4> dynamicSpheres;
+		Stats stats{};
+	};
+}  // namespace lve
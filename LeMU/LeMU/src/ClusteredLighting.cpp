@@ -0,0 +1,141 @@
+#include "pch.h"
+
+#include "ClusteredLighting.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace LeMU {
+
+    namespace {
+
+        // a light list can be empty, a buffer can't
+        constexpr VkDeviceSize MIN_BUFFER_SIZE = 4096;
+    }
+
+
+
+    ClusteredLighting::ClusteredLighting(Device& device, Renderer& renderer, uint32_t tilesX, uint32_t tilesY, uint32_t slices)
+        : device{ device }, renderer{ renderer }, grid{ tilesX, tilesY, slices }
+    {
+        descriptorSetLayout = renderer.getDescriptorLayoutCache().createLayout({
+            makeDescriptorBinding(ClusterGridBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
+            makeDescriptorBinding(LightBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
+            makeDescriptorBinding(ClusterBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
+            makeDescriptorBinding(LightIndexBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) });
+    }
+
+    ClusteredLighting::~ClusteredLighting()
+    {
+        for (auto& frame : frames)
+        {
+            retire(frame.gridBuffer);
+            retire(frame.lightBuffer);
+            retire(frame.clusterBuffer);
+            retire(frame.indexBuffer);
+        }
+    }
+
+
+
+    void ClusteredLighting::reserve(MappedBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage)
+    {
+        if (buffer.capacity >= size) return;
+
+        // frames in flight may still read the old one
+        retire(buffer);
+
+        VkDeviceSize capacity = std::max(MIN_BUFFER_SIZE, buffer.capacity * 2);
+        while (capacity < size) capacity *= 2;
+
+        device.createBuffer(
+            capacity,
+            usage,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            buffer.buffer,
+            buffer.memory);
+
+        if (vkMapMemory(device.device(), buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped) != VK_SUCCESS)
+            throw std::runtime_error("failed to map light buffer!");
+        buffer.capacity = capacity;
+    }
+
+
+    void ClusteredLighting::retire(MappedBuffer& buffer)
+    {
+        if (buffer.buffer == VK_NULL_HANDLE) return;
+
+        Device* owner = &device;
+        VkBuffer retiredBuffer = buffer.buffer;
+        VkDeviceMemory retiredMemory = buffer.memory;
+        renderer.deferDestroy([owner, retiredBuffer, retiredMemory]() {
+            vkUnmapMemory(owner->device(), retiredMemory);
+            vkDestroyBuffer(owner->device(), retiredBuffer, nullptr);
+            vkFreeMemory(owner->device(), retiredMemory, nullptr);
+        });
+
+        buffer = {};
+    }
+
+
+
+    void ClusteredLighting::update(
+        const std::vector<Light>& lights,
+        const Camera& camera,
+        VkExtent2D viewportExtent,
+        JobSystem* jobSystem)
+    {
+        grid.build(lights, camera, jobSystem);
+
+        // frames in flight can change at runtime
+        size_t frameIndex = static_cast<size_t>(renderer.getFrameIndex());
+        if (frames.size() <= frameIndex) frames.resize(frameIndex + 1);
+        auto& frame = frames[frameIndex];
+
+        const auto& clusters = grid.getClusters();
+        const auto& lightIndices = grid.getLightIndices();
+
+        reserve(frame.gridBuffer, sizeof(ClusterGridUbo), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        reserve(frame.lightBuffer, lights.size() * sizeof(GpuLight), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        reserve(frame.clusterBuffer, clusters.size() * sizeof(glm::uvec2), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        reserve(frame.indexBuffer, lightIndices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+        ClusterGridUbo ubo{};
+        ubo.size = glm::uvec4(grid.getTilesX(), grid.getTilesY(), grid.getSliceCount(), static_cast<uint32_t>(lights.size()));
+        ubo.tileScale = glm::vec4(
+            static_cast<float>(grid.getTilesX()) / viewportExtent.width,
+            static_cast<float>(grid.getTilesY()) / viewportExtent.height,
+            grid.getSliceScale(),
+            grid.getSliceBias());
+        *static_cast<ClusterGridUbo*>(frame.gridBuffer.mapped) = ubo;
+
+        GpuLight* gpuLights = static_cast<GpuLight*>(frame.lightBuffer.mapped);
+        for (size_t i = 0; i < lights.size(); i++) gpuLights[i] = makeGpuLight(lights[i]);
+
+        std::memcpy(frame.clusterBuffer.mapped, clusters.data(), clusters.size() * sizeof(glm::uvec2));
+        if (!lightIndices.empty())
+            std::memcpy(frame.indexBuffer.mapped, lightIndices.data(), lightIndices.size() * sizeof(uint32_t));
+
+        // the frame allocator was reset when this slot began, a fresh set each frame costs no pool growth
+        const VkShaderStageFlags stages = VK_SHADER_STAGE_FRAGMENT_BIT;
+        frame.descriptorSet = DescriptorWriter{ renderer.getDescriptorLayoutCache(), renderer.getFrameDescriptorAllocator() }
+            .writeBuffer(ClusterGridBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stages, frame.gridBuffer.buffer, 0, sizeof(ClusterGridUbo))
+            .writeBuffer(LightBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, frame.lightBuffer.buffer)
+            .writeBuffer(ClusterBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, frame.clusterBuffer.buffer)
+            .writeBuffer(LightIndexBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, frame.indexBuffer.buffer)
+            .build();
+    }
+
+
+
+    VkDescriptorSet ClusteredLighting::getDescriptorSet() const
+    {
+        size_t frameIndex = static_cast<size_t>(renderer.getFrameIndex());
+        assert(frameIndex < frames.size() && frames[frameIndex].descriptorSet != VK_NULL_HANDLE &&
+            "ClusteredLighting::update was not called this frame");
+        return frames[frameIndex].descriptorSet;
+    }
+}  // namespace lve
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "Descriptor.hpp"
+#include "Device.hpp"
+#include "JobSystem.hpp"
+#include "LightClusters.hpp"
+#include "Renderer.hpp"
+
+// std
+#include <vector>
+
+namespace LeMU {
+
+	// how the fragment shader finds its cluster, uniform buffer at binding 0 of the light set
+	struct ClusterGridUbo {
+		glm::uvec4 size{ 0 };			// tiles x, tiles y, depth slices, light count
+		glm::vec4 tileScale{ 0.0f };	// xy: tiles per pixel, z: slice scale, w: slice bias
+	};
+
+	// bindings of the light set, fragment stage only
+	enum ClusteredLightingBinding : uint32_t
+	{
+		ClusterGridBinding = 0,
+		LightBufferBinding = 1,
+		ClusterBufferBinding = 2,		// uvec2 per cluster: first light index, light count
+		LightIndexBufferBinding = 3,
+	};
+
+
+
+	// clustered forward lighting: the lights of the scene are binned into the froxel grid of the
+	// camera on the job system every frame, and the grid goes to the GPU with the lights in host
+	// visible buffers, one set per frame in flight. The scene shaders bind it as a descriptor set and
+	// shade each fragment with the lights of its cluster only, so the cost of a fragment follows the
+	// number of lights around it, not the number of lights in the scene
+	class ClusteredLighting {
+	public:
+		ClusteredLighting(
+			Device &device,
+			Renderer &renderer,
+			uint32_t tilesX = LightClusterGrid::DEFAULT_TILES_X,
+			uint32_t tilesY = LightClusterGrid::DEFAULT_TILES_Y,
+			uint32_t slices = LightClusterGrid::DEFAULT_SLICES);
+		~ClusteredLighting();
+
+		ClusteredLighting(const ClusteredLighting&) = delete;
+		ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+		// bin lights for camera and write this frame's buffers and set. Once per frame, before the
+		// draws using getDescriptorSet are recorded. viewportExtent is the size the scene is rendered
+		// at, the tiles divide it. jobSystem nullptr bins on this thread
+		void update(
+			const std::vector<Light> &lights,
+			const Camera &camera,
+			VkExtent2D viewportExtent,
+			JobSystem *jobSystem = nullptr);
+
+		inline VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+		// set of the current frame, written by its update
+		VkDescriptorSet getDescriptorSet() const;
+
+		inline const LightClusterGrid& getGrid() const { return grid; }
+
+	private:
+		// persistently mapped, grown by doubling
+		struct MappedBuffer {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			void *mapped = nullptr;
+			VkDeviceSize capacity = 0;	// bytes
+		};
+
+		struct FrameData {
+			MappedBuffer gridBuffer;
+			MappedBuffer lightBuffer;
+			MappedBuffer clusterBuffer;
+			MappedBuffer indexBuffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;	// from the frame allocator, rebuilt every frame
+		};
+
+		void reserve(MappedBuffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage);
+		void retire(MappedBuffer &buffer);
+
+		Device &device;
+		Renderer &renderer;
+		LightClusterGrid grid;
+
+		VkDescriptorSetLayout descriptorSetLayout;	// owned by the renderer's layout cache
+		std::vector<FrameData> frames;
+	};
+}  // namespace lve
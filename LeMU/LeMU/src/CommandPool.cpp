@@ -0,0 +1,64 @@
+#include "pch.h"
+
+#include "CommandPool.hpp"
+
+// std
+#include <stdexcept>
+
+namespace LeMU {
+
+    FrameCommandPool::FrameCommandPool(Device& device)
+        : device(device)
+    {
+        commandPool = device.createTransientCommandPool();
+    }
+
+    // destroying the pool frees every command buffer allocated from it
+    FrameCommandPool::~FrameCommandPool() { vkDestroyCommandPool(device.device(), commandPool, nullptr); }
+
+
+
+    VkCommandBuffer FrameCommandPool::getPrimaryCommandBuffer()
+    {
+        return nextCommandBuffer(primaryCommandBuffers, primaryUsed, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    }
+
+
+    VkCommandBuffer FrameCommandPool::getSecondaryCommandBuffer()
+    {
+        return nextCommandBuffer(secondaryCommandBuffers, secondaryUsed, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    }
+
+
+
+    VkCommandBuffer FrameCommandPool::nextCommandBuffer(
+        std::vector<VkCommandBuffer>& commandBuffers, size_t& usedCount, VkCommandBufferLevel level)
+    {
+        if (usedCount == commandBuffers.size())
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = level;
+            allocInfo.commandPool = commandPool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("failed to allocate command buffers!");
+
+            commandBuffers.push_back(commandBuffer);
+        }
+
+        return commandBuffers[usedCount++];
+    }
+
+
+
+    void FrameCommandPool::reset()
+    {
+        vkResetCommandPool(device.device(), commandPool, 0);
+        primaryUsed = 0;
+        secondaryUsed = 0;
+    }
+
+}  // namespace lve
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Device.hpp"
+
+// std
+#include <vector>
+
+namespace LeMU {
+
+	// transient command pool owned by one frame-in-flight and one recording thread
+	// command buffers are handed out linearly and recycled in bulk by reset(),
+	// which must only be called once the frame's fence has signaled
+	class FrameCommandPool {
+	public:
+		FrameCommandPool(Device& device);
+		~FrameCommandPool();
+
+		FrameCommandPool(const FrameCommandPool&) = delete;
+		FrameCommandPool& operator=(const FrameCommandPool&) = delete;
+
+		// next unused command buffer of this frame, allocated on first use
+		VkCommandBuffer getPrimaryCommandBuffer();
+		VkCommandBuffer getSecondaryCommandBuffer();
+
+		// vkResetCommandPool, all command buffers return to the initial state
+		void reset();
+
+	private:
+		VkCommandBuffer nextCommandBuffer(
+			std::vector<VkCommandBuffer>& commandBuffers, size_t& usedCount, VkCommandBufferLevel level);
+
+		Device& device;
+		VkCommandPool commandPool;
+
+		std::vector<VkCommandBuffer> primaryCommandBuffers;
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+		size_t primaryUsed = 0;
+		size_t secondaryUsed = 0;
+	};
+}  // namespace lve
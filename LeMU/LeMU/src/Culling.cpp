@@ -0,0 +1,210 @@
+#include "pch.h"
+
+#include "Culling.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LEMU_CULLING_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// msvc emits AVX instructions for intrinsics without /arch:AVX, gcc and clang need the target attribute
+#if defined(LEMU_CULLING_X86) && (defined(__GNUC__) || defined(__clang__))
+#define LEMU_TARGET_AVX __attribute__((target("avx")))
+#else
+#define LEMU_TARGET_AVX
+#endif
+
+// std
+#include <algorithm>
+#include <limits>
+
+namespace LeMU {
+
+    void CullingSpheres::resize(size_t count)
+    {
+        centerX.resize(count);
+        centerY.resize(count);
+        centerZ.resize(count);
+        radius.resize(count);
+    }
+
+
+
+    glm::vec4 getWorldBoundingSphere(GameObject& object)
+    {
+        if (!object.model) return glm::vec4(0.0f, 0.0f, 0.0f, -std::numeric_limits<float>::max());
+
+        const auto& bounds = object.model->getBounds();
+        glm::vec3 center{ object.transform.mat4() * glm::vec4(bounds.center, 1.0f) };
+        glm::vec3 scale = glm::abs(object.transform.scale);
+        return glm::vec4(center, bounds.radius * std::max(scale.x, std::max(scale.y, scale.z)));
+    }
+
+
+
+    CullingKernel detectCullingKernel()
+    {
+#if defined(LEMU_CULLING_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+        if ((info[2] & (1 << 28)) && osSavesYmm) return CullingKernel::AVX;
+        return CullingKernel::SSE;
+#elif defined(LEMU_CULLING_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx")) return CullingKernel::AVX;
+        if (__builtin_cpu_supports("sse2")) return CullingKernel::SSE;
+        return CullingKernel::Scalar;
+#else
+        return CullingKernel::Scalar;
+#endif
+    }
+
+
+
+    const char* getCullingKernelName(CullingKernel kernel)
+    {
+        switch (kernel)
+        {
+        case CullingKernel::SSE: return "SSE";
+        case CullingKernel::AVX: return "AVX";
+        default: return "scalar";
+        }
+    }
+
+
+
+    namespace {
+
+        size_t cullSpheresScalar(
+            const Frustum& frustum, const CullingSpheres& spheres,
+            size_t begin, size_t end, uint32_t firstIndex, uint32_t* visible)
+        {
+            size_t visibleCount = 0;
+            for (size_t i = begin; i < end; i++)
+            {
+                bool inside = true;
+                for (const auto& plane : frustum.planes)
+                {
+                    float distance = plane.x * spheres.centerX[i] + plane.y * spheres.centerY[i] +
+                                     plane.z * spheres.centerZ[i] + plane.w;
+                    inside &= distance >= -spheres.radius[i];
+                }
+
+                // branchless append, the slot is overwritten when the sphere is culled
+                visible[visibleCount] = firstIndex + static_cast<uint32_t>(i);
+                visibleCount += inside ? 1 : 0;
+            }
+            return visibleCount;
+        }
+
+
+#ifdef LEMU_CULLING_X86
+        size_t cullSpheresSSE(
+            const Frustum& frustum, const CullingSpheres& spheres,
+            size_t count, uint32_t firstIndex, uint32_t* visible)
+        {
+            __m128 planeX[Frustum::Count], planeY[Frustum::Count], planeZ[Frustum::Count], planeW[Frustum::Count];
+            for (int p = 0; p < Frustum::Count; p++)
+            {
+                planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+                planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+                planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+                planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+            }
+
+            size_t visibleCount = 0;
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128 x = _mm_loadu_ps(&spheres.centerX[i]);
+                __m128 y = _mm_loadu_ps(&spheres.centerY[i]);
+                __m128 z = _mm_loadu_ps(&spheres.centerZ[i]);
+                __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int p = 0; p < Frustum::Count; p++)
+                {
+                    __m128 distance = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                        _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+                }
+
+                int mask = _mm_movemask_ps(inside);
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    visible[visibleCount] = firstIndex + static_cast<uint32_t>(i + lane);
+                    visibleCount += (mask >> lane) & 1;
+                }
+            }
+
+            return visibleCount + cullSpheresScalar(frustum, spheres, i, count, firstIndex, visible + visibleCount);
+        }
+
+
+        LEMU_TARGET_AVX size_t cullSpheresAVX(
+            const Frustum& frustum, const CullingSpheres& spheres,
+            size_t count, uint32_t firstIndex, uint32_t* visible)
+        {
+            __m256 planeX[Frustum::Count], planeY[Frustum::Count], planeZ[Frustum::Count], planeW[Frustum::Count];
+            for (int p = 0; p < Frustum::Count; p++)
+            {
+                planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+                planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+                planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+                planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+            }
+
+            size_t visibleCount = 0;
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 x = _mm256_loadu_ps(&spheres.centerX[i]);
+                __m256 y = _mm256_loadu_ps(&spheres.centerY[i]);
+                __m256 z = _mm256_loadu_ps(&spheres.centerZ[i]);
+                __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+
+                __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (int p = 0; p < Frustum::Count; p++)
+                {
+                    __m256 distance = _mm256_add_ps(
+                        _mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+                        _mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+                }
+
+                int mask = _mm256_movemask_ps(inside);
+                for (int lane = 0; lane < 8; lane++)
+                {
+                    visible[visibleCount] = firstIndex + static_cast<uint32_t>(i + lane);
+                    visibleCount += (mask >> lane) & 1;
+                }
+            }
+
+            return visibleCount + cullSpheresScalar(frustum, spheres, i, count, firstIndex, visible + visibleCount);
+        }
+#endif
+    }
+
+
+
+    size_t cullSpheres(
+        CullingKernel kernel,
+        const Frustum& frustum,
+        const CullingSpheres& spheres,
+        uint32_t firstIndex,
+        uint32_t* visible)
+    {
+        size_t count = spheres.size();
+
+#ifdef LEMU_CULLING_X86
+        if (kernel == CullingKernel::AVX) return cullSpheresAVX(frustum, spheres, count, firstIndex, visible);
+        if (kernel == CullingKernel::SSE) return cullSpheresSSE(frustum, spheres, count, firstIndex, visible);
+#endif
+        return cullSpheresScalar(frustum, spheres, 0, count, firstIndex, visible);
+    }
+}  // namespace lve
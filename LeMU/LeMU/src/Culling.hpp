@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "GameObject.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace LeMU {
+
+	enum class CullingKernel {
+		Scalar,
+		SSE,	// 4 spheres per iteration
+		AVX,	// 8 spheres per iteration
+	};
+
+	// widest kernel the CPU supports
+	CullingKernel detectCullingKernel();
+	const char* getCullingKernelName(CullingKernel kernel);
+
+	// world space bounding spheres in structure-of-arrays layout, so a kernel loads 4 / 8 of
+	// the same component at once
+	struct CullingSpheres {
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> radius;
+
+		void resize(size_t count);
+		inline size_t size() const { return radius.size(); }
+	};
+
+	// model bounding sphere moved to world space as (center, radius), the radius grows with the
+	// largest scale axis. Objects without a model get a negative radius that never passes a test
+	glm::vec4 getWorldBoundingSphere(GameObject& object);
+
+	// write firstIndex + i for every sphere i that is at least partly inside the frustum,
+	// returns how many were written. visible needs room for spheres.size() entries
+	size_t cullSpheres(
+		CullingKernel kernel,
+		const Frustum& frustum,
+		const CullingSpheres& spheres,
+		uint32_t firstIndex,
+		uint32_t* visible);
+}  // namespace lve
@@ -0,0 +1,41 @@
+#include "pch.h"
+
+#include "DeletionQueue.hpp"
+
+namespace LeMU {
+
+    DeletionQueue::~DeletionQueue() { flushAll(); }
+
+
+
+    void DeletionQueue::push(uint64_t retireFrame, std::function<void()>&& deleter)
+    {
+        deleters.emplace_back(retireFrame, std::move(deleter));
+    }
+
+
+
+    void DeletionQueue::flush(uint64_t completedFrame)
+    {
+        // deleters are pushed in frame order, oldest ones are always in the front
+        while (!deleters.empty() && deleters.front().first <= completedFrame)
+        {
+            auto deleter = std::move(deleters.front().second);
+            deleters.pop_front();
+            deleter();
+        }
+    }
+
+
+
+    void DeletionQueue::flushAll()
+    {
+        while (!deleters.empty())
+        {
+            auto deleter = std::move(deleters.front().second);
+            deleters.pop_front();
+            deleter();
+        }
+    }
+
+}  // namespace lve
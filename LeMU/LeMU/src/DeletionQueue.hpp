@@ -0,0 +1,35 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+namespace LeMU {
+
+	// defer destruction of GPU objects until the frames that may still use them have completed,
+	// so that nothing has to stall the device with vkDeviceWaitIdle
+	class DeletionQueue {
+	public:
+		DeletionQueue() = default;
+		~DeletionQueue();
+
+		DeletionQueue(const DeletionQueue&) = delete;
+		DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+		// retireFrame: last frame number that may reference the object
+		void push(uint64_t retireFrame, std::function<void()>&& deleter);
+
+		// run every deleter whose retire frame is not newer than completedFrame
+		void flush(uint64_t completedFrame);
+
+		// run all deleters, only valid once the device is idle
+		void flushAll();
+
+		inline size_t size() const { return deleters.size(); }
+
+	private:
+		std::deque<std::pair<uint64_t, std::function<void()>>> deleters;
+	};
+}  // namespace lve
@@ -0,0 +1,309 @@
+#include "pch.h"
+
+#include "DepthPyramid.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace LeMU {
+
+    namespace {
+
+        struct ReducePushConstants
+        {
+            uint32_t sourceSize[2];
+            uint32_t destinationSize[2];
+        };
+
+        enum Binding : uint32_t { Source = 0, Destination = 1 };
+
+        uint32_t previousPowerOfTwo(uint32_t value)
+        {
+            uint32_t result = 1;
+            while (result * 2 <= value) result *= 2;
+            return result;
+        }
+    }
+
+
+
+    DepthPyramid::DepthPyramid(Device& device, Renderer& renderer)
+        : device{device}, renderer{renderer}
+    {
+        createPipeline();
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+            throw std::runtime_error("failed to create depth pyramid sampler!");
+
+        createResources(renderer.getSwapChainExtent());
+    }
+
+    DepthPyramid::~DepthPyramid()
+    {
+        retireResources();
+
+        // the reduction of the last frames may still be running
+        Device* owner = &device;
+        VkSampler retiredSampler = sampler;
+        renderer.deferDestroy([owner, retiredSampler]() {
+            vkDestroySampler(owner->device(), retiredSampler, nullptr);
+        });
+
+        reducePipeline.reset();
+        vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+    }
+
+
+
+    void DepthPyramid::createPipeline()
+    {
+        descriptorSetLayout = renderer.getDescriptorLayoutCache().createLayout({
+            makeDescriptorBinding(Source, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT),
+            makeDescriptorBinding(Destination, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) });
+
+        VkPushConstantRange pushRange{};
+        pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushRange.offset = 0;
+        pushRange.size = sizeof(ReducePushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create pipeline layout!");
+
+        reducePipeline = std::make_unique<ComputePipeline>(
+            device, renderer.getShaderCompiler().load("shaders/depth_pyramid.comp"), pipelineLayout);
+    }
+
+
+
+    void DepthPyramid::createResources(VkExtent2D sourceExtent)
+    {
+        this->sourceExtent = sourceExtent;
+        extent = { previousPowerOfTwo(sourceExtent.width), previousPowerOfTwo(sourceExtent.height) };
+
+        levelCount = 1;
+        while ((std::max(extent.width, extent.height) >> levelCount) > 0) levelCount++;
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { extent.width, extent.height, 1 };
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &view) != VK_SUCCESS)
+            throw std::runtime_error("failed to create depth pyramid view!");
+
+        levelViews.resize(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+            if (vkCreateImageView(device.device(), &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS)
+                throw std::runtime_error("failed to create depth pyramid view!");
+        }
+
+        // the pyramid can be bound before its first build, so it must already be in its layout
+        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        device.endSingleTimeCommands(commandBuffer);
+        valid = false;
+    }
+
+
+
+    void DepthPyramid::retireResources()
+    {
+        if (image == VK_NULL_HANDLE) return;
+
+        Device* owner = &device;
+        VkImage retiredImage = image;
+        VkDeviceMemory retiredMemory = memory;
+        std::vector<VkImageView> retiredViews = levelViews;
+        retiredViews.push_back(view);
+
+        renderer.deferDestroy([owner, retiredImage, retiredMemory, retiredViews]() {
+            for (auto retiredView : retiredViews) vkDestroyImageView(owner->device(), retiredView, nullptr);
+            vkDestroyImage(owner->device(), retiredImage, nullptr);
+            vkFreeMemory(owner->device(), retiredMemory, nullptr);
+        });
+
+        image = VK_NULL_HANDLE;
+        memory = VK_NULL_HANDLE;
+        view = VK_NULL_HANDLE;
+        levelViews.clear();
+        valid = false;
+    }
+
+
+
+    VkDescriptorImageInfo DepthPyramid::getDescriptorInfo() const
+    {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.sampler = sampler;
+        imageInfo.imageView = view;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        return imageInfo;
+    }
+
+
+
+    void DepthPyramid::build(VkCommandBuffer commandBuffer, VkImage depthImage, VkImageView depthView, VkExtent2D extent)
+    {
+        if (extent.width != sourceExtent.width || extent.height != sourceExtent.height)
+        {
+            retireResources();
+            createResources(extent);
+        }
+
+        // every level is rewritten, the previous contents can be dropped once earlier reads are done
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = depthImage;
+        barriers[0].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+        barriers[1] = barriers[0];
+        barriers[1].srcAccessMask = 0;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].image = image;
+        barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        reducePipeline->bind(commandBuffer);
+
+        uint32_t sourceWidth = sourceExtent.width;
+        uint32_t sourceHeight = sourceExtent.height;
+
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            uint32_t width = std::max(extent.width >> level, 1u);
+            uint32_t height = std::max(extent.height >> level, 1u);
+
+            VkDescriptorImageInfo sourceInfo{};
+            sourceInfo.sampler = sampler;
+            sourceInfo.imageView = level == 0 ? depthView : levelViews[level - 1];
+            sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+            VkDescriptorImageInfo destinationInfo{};
+            destinationInfo.imageView = levelViews[level];
+            destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            VkDescriptorSet descriptorSet = DescriptorWriter{ renderer.getDescriptorLayoutCache(), renderer.getFrameDescriptorAllocator() }
+                .writeImage(Source, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, sourceInfo)
+                .writeImage(Destination, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, destinationInfo)
+                .build();
+
+            vkCmdBindDescriptorSets(
+                commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+            ReducePushConstants push{ { sourceWidth, sourceHeight }, { width, height } };
+            vkCmdPushConstants(
+                commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReducePushConstants), &push);
+
+            vkCmdDispatch(
+                commandBuffer,
+                (width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+                (height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+                1);
+
+            // the next level reads this one, the cull shader reads all of them
+            VkImageMemoryBarrier levelBarrier{};
+            levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            levelBarrier.image = image;
+            levelBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+
+            sourceWidth = width;
+            sourceHeight = height;
+        }
+
+        // back to an attachment for the resumed render pass
+        VkImageMemoryBarrier depthBarrier = barriers[0];
+        depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        depthBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+        valid = true;
+    }
+}  // namespace lve
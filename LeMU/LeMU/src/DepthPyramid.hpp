@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Descriptor.hpp"
+#include "Device.hpp"
+#include "Pipeline.hpp"
+#include "Renderer.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace LeMU {
+
+	// hierarchical depth: level 0 is the depth attachment rounded down to a power of two, every texel
+	// of a level holds the farthest depth of the texels it covers. A bounding rectangle is hidden if
+	// its nearest depth is behind the few texels of the level where it spans at most two of them
+	class DepthPyramid {
+	public:
+		static constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+
+		DepthPyramid(Device &device, Renderer &renderer);
+		~DepthPyramid();
+
+		DepthPyramid(const DepthPyramid&) = delete;
+		DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+		// record the reduction of depthImage, outside of a render pass. The depth image is read in
+		// [0, extent) and left in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL. The pyramid is
+		// recreated when extent changes, the old one stays alive for the frames still reading it
+		void build(VkCommandBuffer commandBuffer, VkImage depthImage, VkImageView depthView, VkExtent2D extent);
+
+		// false until the first build after the pyramid was (re)created, the contents are undefined
+		inline bool isValid() const { return valid; }
+
+		// whole mip chain in VK_IMAGE_LAYOUT_GENERAL with a nearest, clamp to edge sampler
+		VkDescriptorImageInfo getDescriptorInfo() const;
+
+		inline VkExtent2D getExtent() const { return extent; }
+		inline uint32_t getLevelCount() const { return levelCount; }
+
+	private:
+		void createPipeline();
+		void createResources(VkExtent2D sourceExtent);
+		void retireResources();
+
+		Device &device;
+		Renderer &renderer;
+
+		VkDescriptorSetLayout descriptorSetLayout;	// owned by the renderer's layout cache
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<ComputePipeline> reducePipeline;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;			// all levels, sampled
+		std::vector<VkImageView> levelViews;		// one per level, reduction source and target
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		VkExtent2D sourceExtent{};
+		VkExtent2D extent{};
+		uint32_t levelCount = 0;
+		bool valid = false;
+	};
+}  // namespace lve
@@ -1,42 +1,321 @@
+#include "pch.h"
+
 
 #include "Descriptor.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <numeric>
 #include <stdexcept>
+#include <utility>
 
 namespace LeMU
 {
-	Descriptor::Descriptor(Device& d)
-		: device(d)
+	namespace {
+
+		// descriptors per set of each type a pool has room for
+		const std::pair<VkDescriptorType, float> POOL_SIZE_RATIOS[] = {
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f },
+		};
+
+		inline void hashCombine(size_t& seed, size_t value)
+		{
+			seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		}
+	}
+
+
+	VkDescriptorSetLayoutBinding makeDescriptorBinding(
+		uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages, uint32_t count)
+	{
+		VkDescriptorSetLayoutBinding layoutBinding{};
+		layoutBinding.binding = binding;
+		layoutBinding.descriptorType = type;
+		layoutBinding.descriptorCount = count;
+		layoutBinding.stageFlags = stages;
+		layoutBinding.pImmutableSamplers = nullptr;	// not using immutable samplers
+		return layoutBinding;
+	}
+
+
+
+	DescriptorLayoutCache::DescriptorLayoutCache(Device& device)
+		: device(device)
 	{}
 
 
-	Descriptor::~Descriptor()
+	DescriptorLayoutCache::~DescriptorLayoutCache()
+	{
+		for (auto& layout : layouts)
+			vkDestroyDescriptorSetLayout(device.device(), layout.second, nullptr);
+	}
+
+
+	bool DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const
 	{
-		vkDestroyDescriptorSetLayout(device.device(), descriptorSetLayout, nullptr);
+		if (flags != other.flags || bindings.size() != other.bindings.size() || bindingFlags != other.bindingFlags)
+			return false;
+
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			const auto& a = bindings[i];
+			const auto& b = other.bindings[i];
+			if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+				a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags)
+				return false;
+		}
+		return true;
 	}
 
 
-	void Descriptor::createDescriptorSetLayout()
+	size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const
 	{
-		// specify descriptor set layout binding
-		VkDescriptorSetLayoutBinding uboLayoutBinding{};
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.descriptorCount = 1;	// only 1 uniform buffer right now
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;	// only pass to vertex shader
-		uboLayoutBinding.pImmutableSamplers = nullptr;	// not using any sampler to sample images
+		size_t seed = std::hash<uint32_t>()(key.flags);
+		for (const auto& binding : key.bindings)
+		{
+			hashCombine(seed, binding.binding);
+			hashCombine(seed, static_cast<size_t>(binding.descriptorType));
+			hashCombine(seed, binding.descriptorCount);
+			hashCombine(seed, binding.stageFlags);
+		}
+		for (auto bindingFlag : key.bindingFlags) hashCombine(seed, bindingFlag);
+		return seed;
+	}
+
+
+	VkDescriptorSetLayout DescriptorLayoutCache::createLayout(
+		std::vector<VkDescriptorSetLayoutBinding> bindings,
+		VkDescriptorSetLayoutCreateFlags flags,
+		std::vector<VkDescriptorBindingFlags> bindingFlags)
+	{
+		assert((bindingFlags.empty() || bindingFlags.size() == bindings.size()) && "need one binding flag per binding");
+
+		// sort bindings and their flags together
+		std::vector<size_t> order(bindings.size());
+		std::iota(order.begin(), order.end(), size_t{ 0 });
+		std::sort(order.begin(), order.end(),
+			[&](size_t a, size_t b) { return bindings[a].binding < bindings[b].binding; });
+
+		LayoutKey key{};
+		key.flags = flags;
+		for (size_t index : order)
+		{
+			key.bindings.push_back(bindings[index]);
+			if (!bindingFlags.empty()) key.bindingFlags.push_back(bindingFlags[index]);
+		}
+
+		auto found = layouts.find(key);
+		if (found != layouts.end()) return found->second;
 
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = 1;
-		layoutInfo.pBindings = &uboLayoutBinding;
+		layoutInfo.flags = flags;
+		layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+		layoutInfo.pBindings = key.bindings.data();
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(key.bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = key.bindingFlags.data();
+		if (!key.bindingFlags.empty()) layoutInfo.pNext = &bindingFlagsInfo;
 
 		// create layout
-		if (vkCreateDescriptorSetLayout(device.device(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		VkDescriptorSetLayout layout;
+		if (vkCreateDescriptorSetLayout(device.device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
 			throw std::runtime_error("failed to create descriptor set layout!");
+
+		layouts.emplace(std::move(key), layout);
+		return layout;
 	}
 
 
 
+	DescriptorAllocator::DescriptorAllocator(Device& device)
+		: device(device)
+	{}
 
-}
 
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		for (auto pool : usedPools) vkDestroyDescriptorPool(device.device(), pool, nullptr);
+		for (auto pool : freePools) vkDestroyDescriptorPool(device.device(), pool, nullptr);
+	}
+
+
+	VkDescriptorPool DescriptorAllocator::createPool()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const auto& ratio : POOL_SIZE_RATIOS)
+			poolSizes.push_back({ ratio.first, static_cast<uint32_t>(ratio.second * SETS_PER_POOL) });
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = SETS_PER_POOL;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(device.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create descriptor pool!");
+		return pool;
+	}
+
+
+	VkDescriptorPool DescriptorAllocator::grabPool()
+	{
+		VkDescriptorPool pool;
+		if (!freePools.empty())
+		{
+			pool = freePools.back();
+			freePools.pop_back();
+		}
+		else
+		{
+			pool = createPool();
+		}
+
+		usedPools.push_back(pool);
+		return pool;
+	}
+
+
+	VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+	{
+		if (currentPool == VK_NULL_HANDLE) currentPool = grabPool();
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = currentPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(device.device(), &allocInfo, &set);
+
+		// the pool is full, continue in a fresh one
+		if (result == VK_ERROR_FRAGMENTED_POOL || result == VK_ERROR_OUT_OF_POOL_MEMORY)
+		{
+			currentPool = grabPool();
+			allocInfo.descriptorPool = currentPool;
+			result = vkAllocateDescriptorSets(device.device(), &allocInfo, &set);
+		}
+
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate descriptor set!");
+		return set;
+	}
+
+
+	void DescriptorAllocator::resetPools()
+	{
+		for (auto pool : usedPools)
+		{
+			vkResetDescriptorPool(device.device(), pool, 0);
+			freePools.push_back(pool);
+		}
+
+		usedPools.clear();
+		currentPool = VK_NULL_HANDLE;
+	}
+
+
+
+	DescriptorWriter::DescriptorWriter(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator)
+		: layoutCache(layoutCache), allocator(allocator)
+	{}
+
+
+	DescriptorWriter& DescriptorWriter::writeBuffer(
+		uint32_t binding,
+		VkDescriptorType type,
+		VkShaderStageFlags stages,
+		VkBuffer buffer,
+		VkDeviceSize offset,
+		VkDeviceSize range)
+	{
+		bindings.push_back(makeDescriptorBinding(binding, type, stages));
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = buffer;
+		bufferInfo.offset = offset;
+		bufferInfo.range = range;
+		infoIndices.push_back(bufferInfos.size());
+		bufferInfos.push_back(bufferInfo);
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstBinding = binding;
+		write.descriptorCount = 1;
+		write.descriptorType = type;
+		writes.push_back(write);
+
+		return *this;
+	}
+
+
+	DescriptorWriter& DescriptorWriter::writeImage(
+		uint32_t binding,
+		VkDescriptorType type,
+		VkShaderStageFlags stages,
+		const VkDescriptorImageInfo& imageInfo)
+	{
+		bindings.push_back(makeDescriptorBinding(binding, type, stages));
+
+		infoIndices.push_back(imageInfos.size());
+		imageInfos.push_back(imageInfo);
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstBinding = binding;
+		write.descriptorCount = 1;
+		write.descriptorType = type;
+		writes.push_back(write);
+
+		return *this;
+	}
+
+
+	VkDescriptorSetLayout DescriptorWriter::getLayout()
+	{
+		return layoutCache.createLayout(bindings);
+	}
+
+
+	VkDescriptorSet DescriptorWriter::build()
+	{
+		VkDescriptorSet set = allocator.allocate(getLayout());
+		overwrite(set);
+		return set;
+	}
+
+
+	void DescriptorWriter::overwrite(VkDescriptorSet set)
+	{
+		// the info vectors are complete now, their addresses no longer move
+		for (size_t i = 0; i < writes.size(); i++)
+		{
+			auto& write = writes[i];
+			write.dstSet = set;
+
+			bool isImage = write.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+				write.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+				write.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+				write.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+				write.descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+
+			if (isImage) write.pImageInfo = &imageInfos[infoIndices[i]];
+			else write.pBufferInfo = &bufferInfos[infoIndices[i]];
+		}
+
+		vkUpdateDescriptorSets(allocator.getDevice().device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+}
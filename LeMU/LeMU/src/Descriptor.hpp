@@ -3,37 +3,156 @@
 #include "Device.hpp"
 #include "Model.hpp"
 
+// std
+#include <unordered_map>
+#include <vector>
+
 namespace LeMU
 {
-	struct UniformBufferObject
+	// camera data, one uniform buffer per frame in flight
+	struct GlobalUbo
+	{
+		glm::mat4 projection{ 1.0f };
+		glm::mat4 view{ 1.0f };
+		glm::mat4 projectionView{ 1.0f };
+		glm::vec4 cameraPosition{ 0.0f };
+	};
+
+	// std430 element of the object storage buffer, shaders index it with gl_InstanceIndex
+	struct GpuObjectData
+	{
+		glm::mat4 model{ 1.0f };
+		glm::vec4 color{ 0.0f };
+		glm::uvec4 material{ UINT32_MAX, UINT32_MAX, 0, 0 };	// x: bindless texture index, y: normal map index, UINT32_MAX for none
+	};
+
+	// set 0 of the scene shaders
+	enum SceneBinding : uint32_t
 	{
-		glm::mat4 model;
-		glm::mat4 view;
-		glm::mat4 projection;
+		GlobalUboBinding = 0,
+		ObjectBufferBinding = 1,
 	};
 
 
-	class Descriptor 
+	VkDescriptorSetLayoutBinding makeDescriptorBinding(
+		uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages, uint32_t count = 1);
+
+
+
+	// one VkDescriptorSetLayout per distinct set of bindings, owned by the cache. Two systems
+	// asking for the same bindings get the same handle, so their sets are interchangeable
+	class DescriptorLayoutCache
 	{
 	public:
-		Descriptor(Device& d);
-		~Descriptor();
+		DescriptorLayoutCache(Device& device);
+		~DescriptorLayoutCache();
 
+		DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+		DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
 
-		void createDescriptorSetLayout();
-		inline VkDescriptorSetLayout& getDescriptorSetLayout() { return descriptorSetLayout; }
+		// binding order does not matter. bindingFlags is empty or has one entry per binding,
+		// in the same order (descriptor indexing: partially bound, update after bind, ...)
+		VkDescriptorSetLayout createLayout(
+			std::vector<VkDescriptorSetLayoutBinding> bindings,
+			VkDescriptorSetLayoutCreateFlags flags = 0,
+			std::vector<VkDescriptorBindingFlags> bindingFlags = {});
 
+		inline size_t size() const { return layouts.size(); }
 
+	private:
+		struct LayoutKey
+		{
+			std::vector<VkDescriptorSetLayoutBinding> bindings;	// sorted by binding
+			std::vector<VkDescriptorBindingFlags> bindingFlags;	// empty or matching bindings
+			VkDescriptorSetLayoutCreateFlags flags;
+
+			bool operator==(const LayoutKey& other) const;
+		};
+
+		struct LayoutKeyHash
+		{
+			size_t operator()(const LayoutKey& key) const;
+		};
+
+		Device& device;
+		std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+	};
+
+
+
+	// hands out sets from a list of pools, a new pool is created when the current one runs out.
+	// Sets are not freed one by one, resetPools recycles every pool at once
+	class DescriptorAllocator
+	{
+	public:
+		static constexpr uint32_t SETS_PER_POOL = 256;
+
+		DescriptorAllocator(Device& device);
+		~DescriptorAllocator();
+
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+		DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+		// every set allocated so far becomes invalid, pools are kept for reuse
+		void resetPools();
+
+		inline size_t getPoolCount() const { return usedPools.size() + freePools.size(); }
+		inline Device& getDevice() const { return device; }
 
 	private:
-		
-		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorPool grabPool();
+		VkDescriptorPool createPool();
+
 		Device& device;
+		VkDescriptorPool currentPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorPool> usedPools;
+		std::vector<VkDescriptorPool> freePools;
 	};
 
 
 
+	// collects buffer / image writes, then allocates a set of the matching layout and fills it
+	//   VkDescriptorSet set = DescriptorWriter{ cache, allocator }
+	//       .writeBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, buffer)
+	//       .writeImage(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, image.getDescriptorInfo())
+	//       .build();
+	class DescriptorWriter
+	{
+	public:
+		DescriptorWriter(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator);
+
+		DescriptorWriter& writeBuffer(
+			uint32_t binding,
+			VkDescriptorType type,
+			VkShaderStageFlags stages,
+			VkBuffer buffer,
+			VkDeviceSize offset = 0,
+			VkDeviceSize range = VK_WHOLE_SIZE);
 
+		DescriptorWriter& writeImage(
+			uint32_t binding,
+			VkDescriptorType type,
+			VkShaderStageFlags stages,
+			const VkDescriptorImageInfo& imageInfo);
 
-}
+		// layout of the bindings written so far, from the cache
+		VkDescriptorSetLayout getLayout();
+
+		VkDescriptorSet build();
+
+		// rewrite a set that was built from the same bindings
+		void overwrite(VkDescriptorSet set);
 
+	private:
+		DescriptorLayoutCache& layoutCache;
+		DescriptorAllocator& allocator;
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		std::vector<VkWriteDescriptorSet> writes;
+		std::vector<size_t> infoIndices;	// into bufferInfos or imageInfos, pointers are set on update
+		std::vector<VkDescriptorBufferInfo> bufferInfos;
+		std::vector<VkDescriptorImageInfo> imageInfos;
+	};
+}
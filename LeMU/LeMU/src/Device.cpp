@@ -1,6 +1,9 @@
+#include "pch.h"
+
 #include "Device.hpp"
 
 // std headers
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -59,10 +62,16 @@ namespace LeMU {
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        loadExtensionFunctions();
+        createFrameTimeline();
         createCommandPool();
+        createUploadCommandPool();
     }
 
     Device::~Device() {
+        if (frameTimeline != VK_NULL_HANDLE) vkDestroySemaphore(device_, frameTimeline, nullptr);
+        vkDestroyFence(device_, uploadFence, nullptr);
+        vkDestroyCommandPool(device_, uploadCommandPool, nullptr);
         vkDestroyCommandPool(device_, commandPool, nullptr);
         vkDestroyDevice(device_, nullptr);
 
@@ -87,7 +96,7 @@ namespace LeMU {
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = VK_API_VERSION_1_2;   // optional 1.2 features are only used if the device supports them
 
         // tells Vulkan which global extensions and validation layers we want to use
         VkInstanceCreateInfo createInfo = {};
@@ -145,6 +154,143 @@ namespace LeMU {
 
         vkGetPhysicalDeviceProperties(physicalDevice, &properties);
         std::cout << "physical device: " << properties.deviceName << std::endl;
+
+        queryDeviceFeatures();
+    }
+
+    void Device::queryDeviceFeatures() {
+        features = {};
+        enabledDeviceExtensions = deviceExtensions;
+
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        features.multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+        features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+
+#ifdef VK_EXT_calibrated_timestamps
+        // GPU timestamps can only be placed on the CPU clock if the device domain can be sampled
+        if (isDeviceExtensionAvailable(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+            auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+                vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+
+            uint32_t domainCount = 0;
+            if (getTimeDomains != nullptr) getTimeDomains(physicalDevice, &domainCount, nullptr);
+            std::vector<VkTimeDomainEXT> domains(domainCount);
+            if (domainCount > 0) getTimeDomains(physicalDevice, &domainCount, domains.data());
+
+            features.calibratedTimestamps = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+            if (features.calibratedTimestamps) enabledDeviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        }
+#endif
+
+        // core 1.2 features can only be queried (and enabled) on a 1.2 device
+        if (properties.apiVersion < VK_API_VERSION_1_2) return;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+        VkPhysicalDeviceFeatures2 deviceFeatures2{};
+        deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        deviceFeatures2.pNext = &vulkan12Features;
+
+        // extension feature structs are appended to the chain when the extension is available
+        void** chainTail = &vulkan12Features.pNext;
+
+#ifdef VK_KHR_dynamic_rendering
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+        bool hasDynamicRenderingExtension = isDeviceExtensionAvailable(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        if (hasDynamicRenderingExtension) {
+            *chainTail = &dynamicRenderingFeatures;
+            chainTail = &dynamicRenderingFeatures.pNext;
+        }
+#endif
+
+#ifdef VK_KHR_synchronization2
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+        synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+        bool hasSynchronization2Extension = isDeviceExtensionAvailable(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        if (hasSynchronization2Extension) {
+            *chainTail = &synchronization2Features;
+            chainTail = &synchronization2Features.pNext;
+        }
+#endif
+
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+
+        features.timelineSemaphore = vulkan12Features.timelineSemaphore == VK_TRUE;
+        features.drawIndirectCount = vulkan12Features.drawIndirectCount == VK_TRUE;
+        features.descriptorIndexing =
+            vulkan12Features.runtimeDescriptorArray == VK_TRUE &&
+            vulkan12Features.descriptorBindingPartiallyBound == VK_TRUE &&
+            vulkan12Features.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+            vulkan12Features.descriptorBindingUpdateUnusedWhilePending == VK_TRUE &&
+            vulkan12Features.shaderSampledImageArrayNonUniformIndexing == VK_TRUE;
+
+#ifdef VK_KHR_dynamic_rendering
+        features.dynamicRendering = hasDynamicRenderingExtension && dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+        if (features.dynamicRendering) enabledDeviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+#endif
+
+#ifdef VK_KHR_synchronization2
+        features.synchronization2 = hasSynchronization2Extension && synchronization2Features.synchronization2 == VK_TRUE;
+        if (features.synchronization2) enabledDeviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+#endif
+
+        std::cout << "draw indirect count: " << (features.drawIndirectCount ? "yes" : "no") << std::endl;
+        std::cout << "timeline semaphores: " << (features.timelineSemaphore ? "yes" : "no") << std::endl;
+        std::cout << "dynamic rendering: " << (features.dynamicRendering ? "yes" : "no") << std::endl;
+        std::cout << "synchronization2: " << (features.synchronization2 ? "yes" : "no") << std::endl;
+        std::cout << "descriptor indexing: " << (features.descriptorIndexing ? "yes" : "no") << std::endl;
+        std::cout << "calibrated timestamps: " << (features.calibratedTimestamps ? "yes" : "no") << std::endl;
+    }
+
+    bool Device::isDeviceExtensionAvailable(const char* extensionName) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto& extension : availableExtensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) return true;
+        }
+        return false;
+    }
+
+    void Device::loadExtensionFunctions() {
+#ifdef VK_KHR_dynamic_rendering
+        if (features.dynamicRendering) {
+            vkCmdBeginRenderingKHR_ = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+                vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR"));
+            vkCmdEndRenderingKHR_ = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+                vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR"));
+
+            if (vkCmdBeginRenderingKHR_ == nullptr || vkCmdEndRenderingKHR_ == nullptr) {
+                features.dynamicRendering = false;  // fall back to render passes
+            }
+        }
+#endif
+
+#ifdef VK_KHR_synchronization2
+        if (features.synchronization2) {
+            vkCmdPipelineBarrier2KHR_ = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(
+                vkGetDeviceProcAddr(device_, "vkCmdPipelineBarrier2KHR"));
+
+            if (vkCmdPipelineBarrier2KHR_ == nullptr) features.synchronization2 = false;
+        }
+#endif
+
+#ifdef VK_EXT_calibrated_timestamps
+        if (features.calibratedTimestamps) {
+            vkGetCalibratedTimestampsEXT_ = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+                vkGetDeviceProcAddr(device_, "vkGetCalibratedTimestampsEXT"));
+
+            if (vkGetCalibratedTimestampsEXT_ == nullptr) features.calibratedTimestamps = false;
+        }
+#endif
     }
 
     void Device::createLogicalDevice() {
@@ -165,6 +311,47 @@ namespace LeMU {
 
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.multiDrawIndirect = features.multiDrawIndirect ? VK_TRUE : VK_FALSE;
+        deviceFeatures.drawIndirectFirstInstance = features.drawIndirectFirstInstance ? VK_TRUE : VK_FALSE;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.timelineSemaphore = features.timelineSemaphore ? VK_TRUE : VK_FALSE;
+        vulkan12Features.drawIndirectCount = features.drawIndirectCount ? VK_TRUE : VK_FALSE;
+
+        VkBool32 descriptorIndexing = features.descriptorIndexing ? VK_TRUE : VK_FALSE;
+        vulkan12Features.runtimeDescriptorArray = descriptorIndexing;
+        vulkan12Features.descriptorBindingPartiallyBound = descriptorIndexing;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = descriptorIndexing;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending = descriptorIndexing;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing = descriptorIndexing;
+
+        VkPhysicalDeviceFeatures2 deviceFeatures2{};
+        deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        deviceFeatures2.features = deviceFeatures;
+        deviceFeatures2.pNext = &vulkan12Features;
+
+        void** chainTail = &vulkan12Features.pNext;
+
+#ifdef VK_KHR_dynamic_rendering
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+        if (features.dynamicRendering) {
+            *chainTail = &dynamicRenderingFeatures;
+            chainTail = &dynamicRenderingFeatures.pNext;
+        }
+#endif
+
+#ifdef VK_KHR_synchronization2
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+        synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+        synchronization2Features.synchronization2 = VK_TRUE;
+        if (features.synchronization2) {
+            *chainTail = &synchronization2Features;
+            chainTail = &synchronization2Features.pNext;
+        }
+#endif
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -172,9 +359,16 @@ namespace LeMU {
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-        createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        // features are passed through the pNext chain when 1.2 features are enabled
+        if (properties.apiVersion >= VK_API_VERSION_1_2) {
+            createInfo.pNext = &deviceFeatures2;
+            createInfo.pEnabledFeatures = nullptr;
+        }
+        else {
+            createInfo.pEnabledFeatures = &deviceFeatures;
+        }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledDeviceExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledDeviceExtensions.data();
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
@@ -194,6 +388,54 @@ namespace LeMU {
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
     }
 
+    void Device::createFrameTimeline() {
+        if (!features.timelineSemaphore) return;
+
+        VkSemaphoreTypeCreateInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        timelineInfo.initialValue = 0;  // no frame has completed yet
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &timelineInfo;
+
+        if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &frameTimeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame timeline semaphore!");
+        }
+    }
+
+    uint64_t Device::getCompletedFrameValue() {
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(device_, frameTimeline, &value);
+        return value;
+    }
+
+    void Device::waitForFrameValue(uint64_t value) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &frameTimeline;
+        waitInfo.pValues = &value;
+
+        vkWaitSemaphores(device_, &waitInfo, UINT64_MAX);
+    }
+
+    bool Device::getDeviceTimestamp(uint64_t& timestamp) {
+#ifdef VK_EXT_calibrated_timestamps
+        if (!features.calibratedTimestamps) return false;
+
+        VkCalibratedTimestampInfoEXT timestampInfo{};
+        timestampInfo.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        timestampInfo.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+
+        uint64_t maxDeviation = 0;
+        return vkGetCalibratedTimestampsEXT_(device_, 1, &timestampInfo, &timestamp, &maxDeviation) == VK_SUCCESS;
+#else
+        return false;
+#endif
+    }
+
     void Device::createCommandPool() {
         QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
 
@@ -213,6 +455,45 @@ namespace LeMU {
         }
     }
 
+    VkCommandPool Device::createTransientCommandPool() {
+        QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
+
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+
+        // no VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT:
+        // command buffers are never reset one by one, the whole pool is reset at once
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        VkCommandPool pool;
+        if (vkCreateCommandPool(device_, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transient command pool!");
+        }
+        return pool;
+    }
+
+    void Device::createUploadCommandPool() {
+        uploadCommandPool = createTransientCommandPool();
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = uploadCommandPool;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device_, &allocInfo, &uploadCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        if (vkCreateFence(device_, &fenceInfo, nullptr, &uploadFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload fence!");
+        }
+    }
+
     void Device::createSurface() { window.createWindowSurface(instance, &surface_); }
 
     bool Device::isDeviceSuitable(VkPhysicalDevice device) {
@@ -467,21 +748,18 @@ namespace LeMU {
     }
 
     VkCommandBuffer Device::beginSingleTimeCommands() {
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = commandPool;
-        allocInfo.commandBufferCount = 1;
+        // released in endSingleTimeCommands, the upload command buffer is shared by all uploads
+        uploadMutex.lock();
 
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
+        // previous upload has finished (its fence was waited on), recycle its memory in one call
+        vkResetCommandPool(device_, uploadCommandPool, 0);
 
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
-        return commandBuffer;
+        vkBeginCommandBuffer(uploadCommandBuffer, &beginInfo);
+        return uploadCommandBuffer;
     }
 
     void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
@@ -492,10 +770,19 @@ namespace LeMU {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue_);
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (vkQueueSubmit(graphicsQueue_, 1, &submitInfo, uploadFence) != VK_SUCCESS) {
+                uploadMutex.unlock();
+                throw std::runtime_error("failed to submit upload command buffer!");
+            }
+        }
+
+        // only this upload, frames in flight keep running and other threads can submit meanwhile
+        vkWaitForFences(device_, 1, &uploadFence, VK_TRUE, UINT64_MAX);
+        vkResetFences(device_, 1, &uploadFence);
 
-        vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+        uploadMutex.unlock();
     }
 
     void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -5,6 +5,7 @@
 
 
 // std lib headers
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -24,6 +25,21 @@ namespace LeMU {
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    // optional features, enabled when the physical device supports them
+    struct DeviceFeatures {
+        bool multiDrawIndirect = false;
+        bool drawIndirectFirstInstance = false;
+        bool drawIndirectCount = false;     // vkCmdDraw*IndirectCount, core in 1.2
+        bool timelineSemaphore = false;
+        bool dynamicRendering = false;      // VK_KHR_dynamic_rendering, core in 1.3
+        bool synchronization2 = false;      // VK_KHR_synchronization2, core in 1.3
+        // runtime sized, partially bound sampled image arrays updated after bind and indexed
+        // non-uniformly, the parts of descriptor indexing (core in 1.2) bindless textures need
+        bool descriptorIndexing = false;
+        // VK_EXT_calibrated_timestamps with the device time domain, relates GPU timestamps to the CPU clock
+        bool calibratedTimestamps = false;
+    };
+
     class Device {
     public:
 #ifdef NDEBUG
@@ -42,11 +58,43 @@ namespace LeMU {
         Device& operator=(Device&&) = delete;
 
         VkCommandPool getCommandPool() { return commandPool; }
+        VkCommandPool getUploadCommandPool() { return uploadCommandPool; }
+
+        // transient pool without per-buffer reset, buffers are recycled with vkResetCommandPool
+        VkCommandPool createTransientCommandPool();
         VkDevice device() { return device_; }
         VkSurfaceKHR surface() { return surface_; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
+
+        // held around every vkQueueSubmit and vkQueuePresentKHR, the queues may be one and the same and
+        // uploads submit from whichever thread they run on
+        std::mutex& getQueueMutex() { return queueMutex; }
         VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
+        const DeviceFeatures& getFeatures() const { return features; }
+
+        // frame timeline: one timeline semaphore whose value is the number of the last completed frame
+        // VK_NULL_HANDLE if timeline semaphores are not supported
+        VkSemaphore getFrameTimeline() { return frameTimeline; }
+        uint64_t getCompletedFrameValue();
+        void waitForFrameValue(uint64_t value);
+
+        // current value of the GPU timestamp counter, in the ticks of timestamp queries.
+        // False without features.calibratedTimestamps
+        bool getDeviceTimestamp(uint64_t& timestamp);
+
+#ifdef VK_KHR_dynamic_rendering
+        // extension entry points are not exported by the loader, they are fetched at device creation
+        void cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR* renderingInfo) {
+            vkCmdBeginRenderingKHR_(commandBuffer, renderingInfo);
+        }
+        void cmdEndRendering(VkCommandBuffer commandBuffer) { vkCmdEndRenderingKHR_(commandBuffer); }
+#endif
+#ifdef VK_KHR_synchronization2
+        void cmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfoKHR* dependencyInfo) {
+            vkCmdPipelineBarrier2KHR_(commandBuffer, dependencyInfo);
+        }
+#endif
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -62,6 +110,7 @@ namespace LeMU {
             VkMemoryPropertyFlags properties,
             VkBuffer& buffer,
             VkDeviceMemory& bufferMemory);
+        // single time commands are recorded into the upload pool, one upload at a time
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
         void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -83,8 +132,12 @@ namespace LeMU {
 
         // select a graphic card in the system that supports the features we need
         void pickPhysicalDevice();
+        void queryDeviceFeatures();
         void createLogicalDevice();
+        void createFrameTimeline();
+        void loadExtensionFunctions();
         void createCommandPool();
+        void createUploadCommandPool();
 
         // helper functions
         bool isDeviceSuitable(VkPhysicalDevice device);
@@ -96,6 +149,7 @@ namespace LeMU {
         // retrieve a list of supported extensions and print them
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool isDeviceExtensionAvailable(const char* extensionName);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
         VkInstance instance;
@@ -107,15 +161,39 @@ namespace LeMU {
         Window& window;
         VkCommandPool commandPool;
 
+        // dedicated pool for staging uploads, reset in bulk after every upload. The upload waits on its
+        // fence, so frames already submitted to the queue are not waited for
+        VkCommandPool uploadCommandPool;
+        VkCommandBuffer uploadCommandBuffer;
+        VkFence uploadFence;
+        std::mutex uploadMutex;
+        std::mutex queueMutex;
+
         VkDevice device_;
         VkSurfaceKHR surface_;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
 
+        DeviceFeatures features;
+        VkSemaphore frameTimeline = VK_NULL_HANDLE;
+
+#ifdef VK_KHR_dynamic_rendering
+        PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR_ = nullptr;
+        PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR_ = nullptr;
+#endif
+#ifdef VK_KHR_synchronization2
+        PFN_vkCmdPipelineBarrier2KHR vkCmdPipelineBarrier2KHR_ = nullptr;
+#endif
+#ifdef VK_EXT_calibrated_timestamps
+        PFN_vkGetCalibratedTimestampsEXT vkGetCalibratedTimestampsEXT_ = nullptr;
+#endif
         
 
         const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
         const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+
+        // required extensions plus the optional ones the device supports
+        std::vector<const char*> enabledDeviceExtensions;
     };
 
 }  
\ No newline at end of file
@@ -0,0 +1,537 @@
+#include "pch.h"
+
+#include "DynamicResolution.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace LeMU {
+
+    namespace {
+
+        uint32_t scaleDimension(uint32_t dimension, float scale)
+        {
+            return std::max(1u, static_cast<uint32_t>(std::lround(dimension * scale)));
+        }
+    }
+
+
+
+    ResolutionController::ResolutionController(const DynamicResolutionSettings& settings)
+        : settings{ settings }, scale{ settings.maxScale }
+    {
+        assert(settings.minScale > 0.0f && settings.minScale <= settings.maxScale && "Invalid resolution scale range");
+    }
+
+
+
+    float ResolutionController::update(float gpuMilliseconds, float sampleScale)
+    {
+        if (gpuMilliseconds <= 0.0f || sampleScale <= 0.0f) return scale;
+
+        // the average has to follow the scene, not the scale changes made meanwhile
+        float sample = gpuMilliseconds / (sampleScale * sampleScale);
+        fullResolutionMilliseconds = fullResolutionMilliseconds == 0.0f
+            ? sample
+            : fullResolutionMilliseconds + settings.smoothing * (sample - fullResolutionMilliseconds);
+
+        float desired = std::clamp(
+            std::sqrt(settings.targetMilliseconds / fullResolutionMilliseconds), settings.minScale, settings.maxScale);
+        float step = std::clamp(desired - scale, -settings.maxStep, settings.maxStep);
+
+        // small raises would only make the image shimmer, except the last bit up to maxScale. Over
+        // budget the scale always goes down, so it settles just under the budget instead of around it
+        if (step > 0.0f && step < settings.deadband && desired != settings.maxScale) return scale;
+
+        scale = std::clamp(scale + step, settings.minScale, settings.maxScale);
+        return scale;
+    }
+
+
+
+    void ResolutionController::setSettings(const DynamicResolutionSettings& settings)
+    {
+        assert(settings.minScale > 0.0f && settings.minScale <= settings.maxScale && "Invalid resolution scale range");
+
+        this->settings = settings;
+        scale = std::clamp(scale, settings.minScale, settings.maxScale);
+    }
+
+
+
+    DynamicResolution::DynamicResolution(Device& device, Renderer& renderer, const DynamicResolutionSettings& settings)
+        : device{ device }, renderer{ renderer }, controller{ settings }
+    {
+        RenderTargetInfo swapChainTarget = renderer.getSwapChainRenderTarget();
+        colorFormat = swapChainTarget.colorFormat;
+        depthFormat = swapChainTarget.depthFormat;
+
+        if (!renderer.canTransferToSwapChain())
+            throw std::runtime_error("failed to find transfer support for the swap chain images!");
+
+        // the scene color has the swap chain format, the blit reads and writes the same format
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), colorFormat, &formatProperties);
+        VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+        if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures)
+            throw std::runtime_error("failed to find blit support for the swap chain format!");
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+            blitFilter = VK_FILTER_NEAREST;
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+        uint32_t timestampBits = queueFamilies[device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+        timestampPeriod = device.properties.limits.timestampPeriod;
+        timestampMask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+
+        if (!renderer.usesDynamicRendering()) createRenderPass();
+        if (timestampBits > 0) createQueryPool(renderer.getFramesInFlight());
+        createTargets(renderer.getSwapChainExtent());
+    }
+
+    DynamicResolution::~DynamicResolution()
+    {
+        retireTargets();
+
+        // the last frames may still render into the pass or write their timestamps
+        Device* owner = &device;
+        VkRenderPass retiredRenderPass = renderPass;
+        VkQueryPool retiredQueryPool = queryPool;
+        renderer.deferDestroy([owner, retiredRenderPass, retiredQueryPool]() {
+            if (retiredRenderPass != VK_NULL_HANDLE) vkDestroyRenderPass(owner->device(), retiredRenderPass, nullptr);
+            if (retiredQueryPool != VK_NULL_HANDLE) vkDestroyQueryPool(owner->device(), retiredQueryPool, nullptr);
+        });
+    }
+
+
+
+    void DynamicResolution::createRenderPass()
+    {
+        // layouts are transitioned by barriers around the pass, the same ones the dynamic rendering path
+        // needs, so the pass keeps them as they are
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = colorFormat;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        // nothing reads the scene depth after the pass
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorAttachmentRef{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        VkAttachmentReference depthAttachmentRef{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+
+        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+            throw std::runtime_error("failed to create scene render pass!");
+    }
+
+
+
+    void DynamicResolution::createQueryPool(uint32_t frameCount)
+    {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = frameCount * 2;
+
+        if (vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create timestamp query pool!");
+
+        queryFrameCount = frameCount;
+        queriesPending.assign(frameCount, false);
+        queryScales.assign(frameCount, controller.getScale());
+    }
+
+
+
+    void DynamicResolution::createTargets(VkExtent2D swapChainExtent)
+    {
+        this->swapChainExtent = swapChainExtent;
+        float maxScale = controller.getSettings().maxScale;
+        targetExtent = { scaleDimension(swapChainExtent.width, maxScale), scaleDimension(swapChainExtent.height, maxScale) };
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { targetExtent.width, targetExtent.height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = colorFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorMemory);
+
+        imageInfo.format = depthFormat;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthMemory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = colorImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = colorFormat;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &colorView) != VK_SUCCESS)
+            throw std::runtime_error("failed to create scene color view!");
+
+        viewInfo.image = depthImage;
+        viewInfo.format = depthFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &depthView) != VK_SUCCESS)
+            throw std::runtime_error("failed to create scene depth view!");
+
+        if (renderPass != VK_NULL_HANDLE)
+        {
+            std::array<VkImageView, 2> attachments = { colorView, depthView };
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = targetExtent.width;
+            framebufferInfo.height = targetExtent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+                throw std::runtime_error("failed to create scene framebuffer!");
+        }
+
+        updateRenderExtent();
+    }
+
+
+
+    void DynamicResolution::retireTargets()
+    {
+        if (colorImage == VK_NULL_HANDLE) return;
+
+        Device* owner = &device;
+        VkFramebuffer retiredFramebuffer = framebuffer;
+        std::array<VkImageView, 2> retiredViews = { colorView, depthView };
+        std::array<VkImage, 2> retiredImages = { colorImage, depthImage };
+        std::array<VkDeviceMemory, 2> retiredMemory = { colorMemory, depthMemory };
+
+        renderer.deferDestroy([owner, retiredFramebuffer, retiredViews, retiredImages, retiredMemory]() {
+            if (retiredFramebuffer != VK_NULL_HANDLE) vkDestroyFramebuffer(owner->device(), retiredFramebuffer, nullptr);
+            for (auto retiredView : retiredViews) vkDestroyImageView(owner->device(), retiredView, nullptr);
+            for (auto retiredImage : retiredImages) vkDestroyImage(owner->device(), retiredImage, nullptr);
+            for (auto memory : retiredMemory) vkFreeMemory(owner->device(), memory, nullptr);
+        });
+
+        colorImage = VK_NULL_HANDLE;
+        colorMemory = VK_NULL_HANDLE;
+        colorView = VK_NULL_HANDLE;
+        depthImage = VK_NULL_HANDLE;
+        depthMemory = VK_NULL_HANDLE;
+        depthView = VK_NULL_HANDLE;
+        framebuffer = VK_NULL_HANDLE;
+    }
+
+
+
+    void DynamicResolution::updateRenderExtent()
+    {
+        // the allocation is rounded from maxScale the same way, a full scale frame fits exactly
+        float scale = controller.getScale();
+        renderExtent = {
+            std::min(targetExtent.width, scaleDimension(swapChainExtent.width, scale)),
+            std::min(targetExtent.height, scaleDimension(swapChainExtent.height, scale)) };
+    }
+
+
+
+    void DynamicResolution::setSettings(const DynamicResolutionSettings& settings)
+    {
+        float previousMaxScale = controller.getSettings().maxScale;
+        controller.setSettings(settings);
+
+        if (settings.maxScale != previousMaxScale)
+        {
+            retireTargets();
+            createTargets(swapChainExtent);
+        }
+        updateRenderExtent();
+    }
+
+
+
+    void DynamicResolution::readTimestamps(uint32_t frameIndex)
+    {
+        if (!queriesPending[frameIndex]) return;
+        queriesPending[frameIndex] = false;
+
+        // the slot's fence has been waited on, the results are there unless the frame was dropped.
+        // Each query is followed by its availability
+        std::array<uint64_t, 4> results{};
+        VkResult result = vkGetQueryPoolResults(
+            device.device(), queryPool, frameIndex * 2, 2,
+            sizeof(results), results.data(), 2 * sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS || results[1] == 0 || results[3] == 0) return;
+
+        uint64_t ticks = (results[2] - results[0]) & timestampMask;
+        float milliseconds = static_cast<float>(ticks) * timestampPeriod / 1000000.0f;
+
+        lastGpuMilliseconds = milliseconds;
+        gpuStats.addSample(milliseconds);
+        controller.update(milliseconds, queryScales[frameIndex]);
+    }
+
+
+
+    void DynamicResolution::beginFrame(VkCommandBuffer commandBuffer)
+    {
+        assert(renderer.isFrameInProgress() && "Can't call beginFrame if frame is not in progress");
+
+        currentFrameIndex = static_cast<uint32_t>(renderer.getFrameIndex());
+
+        VkExtent2D extent = renderer.getSwapChainExtent();
+        if (extent.width != swapChainExtent.width || extent.height != swapChainExtent.height)
+        {
+            retireTargets();
+            createTargets(extent);
+        }
+
+        if (queryPool != VK_NULL_HANDLE)
+        {
+            // frames in flight changed, the results of the old slots are dropped
+            if (queryFrameCount != renderer.getFramesInFlight())
+            {
+                Device* owner = &device;
+                VkQueryPool retiredQueryPool = queryPool;
+                renderer.deferDestroy([owner, retiredQueryPool]() {
+                    vkDestroyQueryPool(owner->device(), retiredQueryPool, nullptr);
+                });
+                createQueryPool(renderer.getFramesInFlight());
+            }
+
+            readTimestamps(currentFrameIndex);
+            queryScales[currentFrameIndex] = controller.getScale();
+
+            vkCmdResetQueryPool(commandBuffer, queryPool, currentFrameIndex * 2, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, currentFrameIndex * 2);
+        }
+
+        updateRenderExtent();
+    }
+
+
+
+    void DynamicResolution::beginScenePass(VkCommandBuffer commandBuffer)
+    {
+        assert(renderer.isFrameInProgress() && "Can't call beginScenePass if frame is not in progress");
+
+        // previous contents are discarded. The last frame's blit may still read the color, its depth
+        // may still be tested
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = 0;
+        barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = colorImage;
+        barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        barriers[1] = barriers[0];
+        barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[1].image = depthImage;
+        barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        VkRect2D renderArea{ {0, 0}, renderExtent };
+
+#ifdef VK_KHR_dynamic_rendering
+        if (renderPass == VK_NULL_HANDLE) {
+            VkRenderingAttachmentInfoKHR colorAttachment{};
+            colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            colorAttachment.imageView = colorView;
+            colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            colorAttachment.clearValue.color = { 0.1f, 0.1f, 0.1f, 1.0f };
+
+            VkRenderingAttachmentInfoKHR depthAttachment{};
+            depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            depthAttachment.imageView = depthView;
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+            VkRenderingInfoKHR renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+            renderingInfo.renderArea = renderArea;
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachments = &colorAttachment;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+
+            device.cmdBeginRendering(commandBuffer, &renderingInfo);
+        }
+        else
+#endif
+        {
+            std::array<VkClearValue, 2> clearValues{};
+            clearValues[0].color = { 0.1f, 0.1f, 0.1f, 1.0f };
+            clearValues[1].depthStencil = { 1.0f, 0 };
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = renderPass;
+            renderPassInfo.framebuffer = framebuffer;
+            renderPassInfo.renderArea = renderArea;
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+            renderPassInfo.pClearValues = clearValues.data();
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        }
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(renderExtent.width);
+        viewport.height = static_cast<float>(renderExtent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
+    }
+
+
+
+    void DynamicResolution::endScenePass(VkCommandBuffer commandBuffer)
+    {
+#ifdef VK_KHR_dynamic_rendering
+        if (renderPass == VK_NULL_HANDLE) {
+            device.cmdEndRendering(commandBuffer);
+            return;
+        }
+#endif
+
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+
+
+    void DynamicResolution::blitToSwapChain(VkCommandBuffer commandBuffer)
+    {
+        assert(renderer.isFrameInProgress() && "Can't call blitToSwapChain if frame is not in progress");
+
+        VkImage swapChainImage = renderer.getCurrentSwapChainImage();
+
+        // the swap chain image waits on the acquire semaphore, which is signalled at COLOR_ATTACHMENT_OUTPUT,
+        // its previous contents are discarded
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = colorImage;
+        barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        barriers[1] = barriers[0];
+        barriers[1].srcAccessMask = 0;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].image = swapChainImage;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        VkImageBlit region{};
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.dstOffsets[1] = { static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1 };
+
+        vkCmdBlitImage(
+            commandBuffer,
+            colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &region, blitFilter);
+
+        VkImageMemoryBarrier presentBarrier = barriers[1];
+        presentBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        presentBarrier.dstAccessMask = 0;
+        presentBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        presentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &presentBarrier);
+
+        if (queryPool != VK_NULL_HANDLE)
+        {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, currentFrameIndex * 2 + 1);
+            queriesPending[currentFrameIndex] = true;
+        }
+    }
+
+
+
+    RenderTargetInfo DynamicResolution::getRenderTarget() const
+    {
+        // the scene pass has the formats of the swap chain pass, which makes the two compatible. Pipelines
+        // are created against the swap chain's, whose render pass outlives the pipeline cache keyed on it
+        return renderer.getSwapChainRenderTarget();
+    }
+}  // namespace lve
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Device.hpp"
+#include "FrameStats.hpp"
+#include "Pipeline.hpp"
+#include "Renderer.hpp"
+
+// std
+#include <vector>
+
+namespace LeMU {
+
+	struct DynamicResolutionSettings {
+		float targetMilliseconds = 14.0f;	// GPU budget of a frame, 60 Hz less headroom for present
+		float minScale = 0.5f;				// of the swap chain extent, per axis
+		float maxScale = 1.0f;
+		float smoothing = 0.25f;			// weight of the newest sample in the moving average
+		float deadband = 0.03f;				// scale raises smaller than this are not made
+		float maxStep = 0.1f;				// largest scale change of one update
+	};
+
+	// picks the resolution scale of the next frames from measured GPU frame times. GPU time is taken as
+	// proportional to the pixel count, so each sample is divided by the area it was rendered at and the
+	// average is the cost of a frame at full resolution. The scale is the one whose area fits that cost
+	// into the budget, moved at most maxStep per update
+	class ResolutionController {
+	public:
+		ResolutionController(const DynamicResolutionSettings &settings = {});
+
+		// gpuMilliseconds was measured for a frame rendered at sampleScale, which lags the current
+		// scale by the frames in flight. Returns the new scale
+		float update(float gpuMilliseconds, float sampleScale);
+
+		inline float getScale() const { return scale; }
+
+		// moving average of the GPU time a frame would take at scale 1, 0 before the first sample
+		inline float getFullResolutionMilliseconds() const { return fullResolutionMilliseconds; }
+
+		// clamps the current scale into the new range, the average is kept
+		void setSettings(const DynamicResolutionSettings &settings);
+		inline const DynamicResolutionSettings& getSettings() const { return settings; }
+
+	private:
+		DynamicResolutionSettings settings;
+		float scale;
+		float fullResolutionMilliseconds = 0.0f;
+	};
+
+
+
+	// offscreen scene color and depth rendered at a scale of the swap chain extent that follows the GPU
+	// frame budget, then upscaled to the swap chain image with a bilinear blit. GPU time is measured with
+	// timestamps around the frame's commands and read back when its slot comes around again. A frame:
+	//
+	//     beginFrame(commandBuffer);       right after Renderer::beginFrame
+	//     beginScenePass(commandBuffer);   draws with pipelines created against getRenderTarget()
+	//     endScenePass(commandBuffer);
+	//     blitToSwapChain(commandBuffer);  instead of the swap chain render pass, right before endFrame
+	//
+	// the images are allocated for maxScale and only the top left getRenderExtent() of them is drawn to,
+	// a scale change never reallocates. They are recreated when the swap chain extent changes
+	class DynamicResolution {
+	public:
+		DynamicResolution(Device &device, Renderer &renderer, const DynamicResolutionSettings &settings = {});
+		~DynamicResolution();
+
+		DynamicResolution(const DynamicResolution&) = delete;
+		DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+		// read back the GPU time of the frame that last used this slot, update the scale and start
+		// timing this frame. Outside of a render pass
+		void beginFrame(VkCommandBuffer commandBuffer);
+
+		// clears and begins the scene target at the current render extent, viewport and scissor are set.
+		// Inline contents only, secondary command buffers of the renderer continue the swap chain pass
+		void beginScenePass(VkCommandBuffer commandBuffer);
+		void endScenePass(VkCommandBuffer commandBuffer);
+
+		// upscale the scene color to the whole swap chain image and leave it in
+		// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, then end the frame's timing
+		void blitToSwapChain(VkCommandBuffer commandBuffer);
+
+		// what pipelines drawing the scene are created against: the swap chain's, the scene pass has its
+		// formats and is compatible with it
+		RenderTargetInfo getRenderTarget() const;
+
+		inline float getScale() const { return controller.getScale(); }
+		inline VkExtent2D getRenderExtent() const { return renderExtent; }
+
+		// false if the graphics queue has no timestamps, the scale then stays at maxScale
+		inline bool hasGpuTiming() const { return queryPool != VK_NULL_HANDLE; }
+
+		// GPU time of the newest frame read back, 0 before the first
+		inline float getLastGpuMilliseconds() const { return lastGpuMilliseconds; }
+
+		// GPU time of every frame read back so far
+		inline const FrameStats& getGpuStats() const { return gpuStats; }
+		inline void resetGpuStats() { gpuStats.reset(); }
+
+		void setSettings(const DynamicResolutionSettings &settings);
+		inline const DynamicResolutionSettings& getSettings() const { return controller.getSettings(); }
+
+	private:
+		void createRenderPass();
+		void createQueryPool(uint32_t frameCount);
+		void createTargets(VkExtent2D swapChainExtent);
+		void retireTargets();
+		void readTimestamps(uint32_t frameIndex);
+		void updateRenderExtent();
+
+		Device &device;
+		Renderer &renderer;
+		ResolutionController controller;
+
+		VkFormat colorFormat;
+		VkFormat depthFormat;
+		VkFilter blitFilter = VK_FILTER_LINEAR;
+		VkRenderPass renderPass = VK_NULL_HANDLE;	// VK_NULL_HANDLE with dynamic rendering
+
+		VkImage colorImage = VK_NULL_HANDLE;
+		VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+		VkImageView colorView = VK_NULL_HANDLE;
+		VkImage depthImage = VK_NULL_HANDLE;
+		VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+		VkImageView depthView = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+		VkExtent2D swapChainExtent{};	// the targets were created for
+		VkExtent2D targetExtent{};		// allocated, maxScale of swapChainExtent
+		VkExtent2D renderExtent{};		// drawn this frame, scale of swapChainExtent
+
+		// two timestamps per frame slot, begin and end
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		uint32_t queryFrameCount = 0;
+		float timestampPeriod = 0.0f;	// nanoseconds per tick
+		uint64_t timestampMask = 0;		// valid bits of the graphics queue
+		std::vector<bool> queriesPending;
+		std::vector<float> queryScales;	// scale the frame of each slot was rendered at
+		uint32_t currentFrameIndex = 0;
+
+		float lastGpuMilliseconds = 0.0f;
+		FrameStats gpuStats;
+	};
+}  // namespace lve
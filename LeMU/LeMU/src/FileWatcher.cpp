@@ -0,0 +1,119 @@
+#include "pch.h"
+
+#include "FileWatcher.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// std
+#include <algorithm>
+#include <iostream>
+
+namespace LeMU {
+
+    FileWatcher::FileWatcher(const std::string& directory)
+        : directory{ directory }
+    {
+#ifdef __linux__
+        // written in place or saved next to the file and renamed over it, as most editors do
+        inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyDescriptor >= 0 &&
+            inotify_add_watch(inotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) >= 0)
+            return;
+
+        std::cerr << "inotify unavailable for " << directory << ", polling modification times" << std::endl;
+        if (inotifyDescriptor >= 0) close(inotifyDescriptor);
+        inotifyDescriptor = -1;
+#endif
+
+        // the first scan only records the current times
+        scanWriteTimes();
+    }
+
+    FileWatcher::~FileWatcher()
+    {
+#ifdef __linux__
+        if (inotifyDescriptor >= 0) close(inotifyDescriptor);
+#endif
+    }
+
+
+
+    std::vector<std::string> FileWatcher::poll()
+    {
+        std::vector<std::string> changed = inotifyDescriptor >= 0 ? readEvents() : scanWriteTimes();
+
+        // one save can report a file several times
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        return changed;
+    }
+
+
+
+    std::vector<std::string> FileWatcher::readEvents()
+    {
+        std::vector<std::string> changed;
+
+#ifdef __linux__
+        alignas(inotify_event) char buffer[4096];
+
+        while (true)
+        {
+            ssize_t length = read(inotifyDescriptor, buffer, sizeof(buffer));
+            if (length <= 0) break;	// EAGAIN, nothing more queued
+
+            for (char* cursor = buffer; cursor < buffer + length;)
+            {
+                const auto* event = reinterpret_cast<const inotify_event*>(cursor);
+                if (event->len > 0 && !(event->mask & IN_ISDIR))
+                    changed.push_back((std::filesystem::path{ directory } / event->name).generic_string());
+                cursor += sizeof(inotify_event) + event->len;
+            }
+        }
+#endif
+
+        return changed;
+    }
+
+
+
+    std::vector<std::string> FileWatcher::scanWriteTimes()
+    {
+        std::vector<std::string> changed;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastScan < SCAN_INTERVAL) return changed;
+        bool firstScan = lastScan == std::chrono::steady_clock::time_point{};
+        lastScan = now;
+
+        // a file being replaced can vanish for a moment, errors skip it until the next scan
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator{ directory, error })
+        {
+            if (!entry.is_regular_file(error)) continue;
+
+            auto writeTime = entry.last_write_time(error);
+            if (error) continue;
+
+            std::string path = entry.path().generic_string();
+            auto found = writeTimes.find(path);
+            if (found == writeTimes.end())
+            {
+                // new files count as changed, except on the first scan
+                if (!firstScan) changed.push_back(path);
+                writeTimes.emplace(path, writeTime);
+            }
+            else if (found->second != writeTime)
+            {
+                found->second = writeTime;
+                changed.push_back(path);
+            }
+        }
+
+        return changed;
+    }
+}  // namespace lve
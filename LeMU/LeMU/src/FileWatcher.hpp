@@ -0,0 +1,38 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace LeMU {
+
+	// files of one directory written since the last poll, not its subdirectories. Uses inotify on Linux,
+	// elsewhere, or when inotify is not available, the modification times are compared at most every
+	// SCAN_INTERVAL
+	class FileWatcher {
+	public:
+		static constexpr std::chrono::milliseconds SCAN_INTERVAL{ 250 };
+
+		FileWatcher(const std::string &directory);
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		// never blocks, each changed file once as directory/name
+		std::vector<std::string> poll();
+
+	private:
+		std::vector<std::string> readEvents();
+		std::vector<std::string> scanWriteTimes();
+
+		std::string directory;
+		int inotifyDescriptor = -1;
+
+		std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+		std::chrono::steady_clock::time_point lastScan{};
+	};
+}  // namespace lve
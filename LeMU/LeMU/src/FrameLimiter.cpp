@@ -0,0 +1,84 @@
+#include "pch.h"
+
+#include "FrameLimiter.hpp"
+
+// std
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+namespace LeMU {
+
+    FrameLimiter::FrameLimiter(float targetFps)
+    {
+#ifdef _WIN32
+        // the default timer ticks every 15.6 ms, far too coarse for the sleep phase
+        timeBeginPeriod(1);
+#endif
+        setTargetFps(targetFps);
+    }
+
+    FrameLimiter::~FrameLimiter()
+    {
+#ifdef _WIN32
+        timeEndPeriod(1);
+#endif
+    }
+
+
+
+    void FrameLimiter::setTargetFps(float targetFps)
+    {
+        this->targetFps = std::max(targetFps, 0.0f);
+        framePeriod = (this->targetFps > 0.0f)
+            ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / this->targetFps))
+            : Clock::duration::zero();
+        nextFrame = Clock::now() + framePeriod;
+    }
+
+
+
+    void FrameLimiter::wait()
+    {
+        if (framePeriod == Clock::duration::zero()) return;
+
+        // forget old overshoots, a single slow sleep must not keep the limiter spinning for good
+        spinThreshold = std::max<Clock::duration>(spinThreshold - spinThreshold / 16, MIN_SPIN_THRESHOLD);
+
+        // hybrid wait: coarse sleeps while far away from the deadline
+        auto now = Clock::now();
+        while (nextFrame - now > spinThreshold)
+        {
+            auto sleepStart = now;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            now = Clock::now();
+
+            // learn how much the OS oversleeps, so the next deadline is not missed
+            auto overshoot = (now - sleepStart) - std::chrono::milliseconds(1);
+            if (overshoot > spinThreshold)
+                spinThreshold = std::min<Clock::duration>(overshoot, framePeriod);
+        }
+
+        // then spin for the final stretch
+        while (Clock::now() < nextFrame)
+            std::this_thread::yield();
+
+        // schedule from the deadline, not from now, so errors do not accumulate.
+        // After a long hitch restart the schedule instead of rendering a burst of frames to catch up
+        nextFrame += framePeriod;
+        now = Clock::now();
+        if (now > nextFrame + framePeriod)
+            nextFrame = now + framePeriod;
+    }
+
+}  // namespace lve
@@ -0,0 +1,39 @@
+#pragma once
+
+// std
+#include <chrono>
+
+namespace LeMU {
+
+	// paces the main loop to a target frame rate
+	// OS sleeps are coarse, so the limiter sleeps for most of the remaining time
+	// and busy-waits the last part of it to hit the deadline precisely.
+	// On Windows it raises the system timer resolution to 1 ms while it lives
+	class FrameLimiter {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		// targetFps 0: unlimited
+		FrameLimiter(float targetFps = 0.0f);
+		~FrameLimiter();
+
+		FrameLimiter(const FrameLimiter&) = delete;
+		FrameLimiter& operator=(const FrameLimiter&) = delete;
+
+		void setTargetFps(float targetFps);
+		inline float getTargetFps() const { return targetFps; }
+
+		// block until the next frame is due
+		void wait();
+
+	private:
+		float targetFps = 0.0f;
+		Clock::duration framePeriod{};
+		Clock::time_point nextFrame{};
+
+		// remaining time below which the limiter spins instead of sleeping. Follows the
+		// worst recent sleep overshoot: jumps up with a worse one, decays every frame
+		static constexpr std::chrono::microseconds MIN_SPIN_THRESHOLD{ 500 };
+		Clock::duration spinThreshold = std::chrono::microseconds(1500);
+	};
+}  // namespace lve
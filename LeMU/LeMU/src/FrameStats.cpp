@@ -0,0 +1,95 @@
+#include "pch.h"
+
+#include "FrameStats.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+namespace LeMU {
+
+    FrameStats::FrameStats(size_t capacity) : capacity{ std::max<size_t>(capacity, 1) } {}
+
+
+
+    void FrameStats::addSample(float milliseconds)
+    {
+        if (samples.size() < capacity)
+            samples.push_back(milliseconds);
+        else
+            samples[next] = milliseconds;
+
+        next = (next + 1) % capacity;
+    }
+
+    void FrameStats::reset()
+    {
+        samples.clear();
+        next = 0;
+    }
+
+
+
+    float FrameStats::average() const
+    {
+        if (samples.empty()) return 0.0f;
+        return std::accumulate(samples.begin(), samples.end(), 0.0f) / static_cast<float>(samples.size());
+    }
+
+
+    float FrameStats::best() const
+    {
+        if (samples.empty()) return 0.0f;
+        return *std::min_element(samples.begin(), samples.end());
+    }
+
+
+    float FrameStats::worst() const
+    {
+        if (samples.empty()) return 0.0f;
+        return *std::max_element(samples.begin(), samples.end());
+    }
+
+
+    float FrameStats::percentile(float p) const
+    {
+        if (samples.empty()) return 0.0f;
+
+        std::vector<float> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+
+        // nearest-rank percentile
+        float rank = std::ceil(std::clamp(p, 0.0f, 100.0f) / 100.0f * static_cast<float>(sorted.size()));
+        size_t index = static_cast<size_t>(std::max(rank, 1.0f)) - 1;
+        return sorted[index];
+    }
+
+
+
+    float FrameStats::jitter() const
+    {
+        if (samples.size() < 2) return 0.0f;
+
+        float mean = average();
+        float sumSquares = 0.0f;
+        for (float sample : samples)
+            sumSquares += (sample - mean) * (sample - mean);
+
+        return std::sqrt(sumSquares / static_cast<float>(samples.size() - 1));
+    }
+
+
+
+    void FrameStats::print(const std::string& label) const
+    {
+        std::cout << label << ": " << sampleCount() << " frames"
+            << ", avg " << average() << " ms"
+            << ", best " << best() << " ms"
+            << ", p99 " << percentile(99.0f) << " ms"
+            << ", worst " << worst() << " ms"
+            << ", jitter " << jitter() << " ms" << std::endl;
+    }
+
+}  // namespace lve
@@ -0,0 +1,41 @@
+#pragma once
+
+// std
+#include <string>
+#include <vector>
+
+namespace LeMU {
+
+	// collect per-frame timings (in milliseconds) and summarize them for benchmarks.
+	// Keeps the last capacity samples, so it can run for the lifetime of the app
+	class FrameStats {
+	public:
+		static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+		FrameStats(size_t capacity = DEFAULT_CAPACITY);
+
+		// replaces the oldest sample once the window is full
+		void addSample(float milliseconds);
+		void reset();
+
+		// samples in the window
+		inline size_t sampleCount() const { return samples.size(); }
+
+		float average() const;
+		float best() const;
+		float worst() const;
+
+		// p in [0, 100], e.g. 99 for the 99th percentile
+		float percentile(float p) const;
+
+		// standard deviation of the samples, how uneven the frames are paced
+		float jitter() const;
+
+		void print(const std::string& label) const;
+
+	private:
+		std::vector<float> samples;		// ring buffer, in no particular order once full
+		size_t capacity;
+		size_t next = 0;				// slot the next sample goes to
+	};
+}  // namespace lve
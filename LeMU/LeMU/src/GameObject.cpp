@@ -1,3 +1,5 @@
+#include "pch.h"
+
 #include "GameObject.hpp"
 
 #include <gtc/matrix_transform.hpp>
@@ -1,13 +1,17 @@
 #pragma once
 
+#include "Material.hpp"
 #include "Model.hpp"
 #include <gtc/constants.hpp>
 
 // std
+#include <cstdint>
 #include <memory>
 
 namespace LeMU
 {
+	struct OccluderMesh;
+
 	struct TransformComponent
 	{
 		glm::vec3 translation{};
@@ -25,6 +29,7 @@ namespace LeMU
 	{
 		public:
 			using id_t = unsigned int;		// each object has unique ID
+			static constexpr uint32_t NO_TEXTURE = UINT32_MAX;
 
 			static GameObject createGameObject();
 
@@ -40,8 +45,13 @@ namespace LeMU
 
 
 			std::shared_ptr<Model> model{};
-			glm::vec3 color{};
+			glm::vec3 color{ 1.0f };		// tints the vertex colors
 			TransformComponent transform{};
+			MaterialFeatures materialFeatures = VertexColorFeature;	// picks the material pipeline
+			uint32_t textureIndex = NO_TEXTURE;		// slot in the bindless texture table
+			uint32_t normalMapIndex = NO_TEXTURE;	// slot in the bindless texture table
+			std::shared_ptr<OccluderMesh> occluder{};	// rasterized by the software occlusion buffer when set
+			bool isStatic = false;		// never moves, its shadow is drawn once into the cached cascade maps
 
 		private:
 			GameObject(id_t objectID) :id(objectID){}	// private constructor, make sure id is unique
@@ -1,3 +1,5 @@
+#include "pch.h"
+
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -122,6 +124,16 @@ namespace LeMU
 
 
 	
+	VkDescriptorImageInfo Image::getDescriptorInfo() const
+	{
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.sampler = textureSampler;
+		imageInfo.imageView = textureImageView;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		return imageInfo;
+	}
+
+
 	void Image::transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
 	{
 		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
@@ -10,6 +10,9 @@ namespace LeMU
 	public:
 		Image(const std::string& textureName, Device &device);
 		~Image();
+
+		// sampler and view in shader read layout, for DescriptorWriter::writeImage
+		VkDescriptorImageInfo getDescriptorInfo() const;
 	
 
 	private:
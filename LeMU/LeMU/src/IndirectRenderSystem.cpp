@@ -0,0 +1,655 @@
+#include "pch.h"
+
+#include "IndirectRenderSystem.hpp"
+
+#include "Culling.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace LeMU {
+
+    namespace {
+
+        struct CullPushConstants
+        {
+            glm::vec4 planes[Frustum::Count];
+            glm::vec4 cameraPosition;
+            uint32_t objectCount;
+        };
+
+        // bindings of the storage buffers, see indirect_cull.comp
+        enum Binding : uint32_t { Objects = 0, Meshes, LodGroups, Commands, DrawCounts, Visibility, Occluded, Stats, BindingCount };
+
+        // set 1 of the cull shader, rebuilt for every dispatch
+        enum OcclusionBinding : uint32_t { OcclusionUniformBinding = 0, DepthPyramidBinding = 1 };
+
+        // covers any minUniformBufferOffsetAlignment
+        constexpr VkDeviceSize UNIFORM_SLOT_SIZE = 256;
+
+        // one stats counter per member of IndirectRenderSystem::OcclusionStats
+        constexpr uint32_t STATS_COUNTERS = 3;
+
+        // indexed and non-indexed commands share one slot size
+        constexpr VkDeviceSize COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+    }
+
+
+
+    bool IndirectRenderSystem::isSupported(Device& device)
+    {
+        return device.getFeatures().multiDrawIndirect && device.getFeatures().drawIndirectFirstInstance;
+    }
+
+
+
+    IndirectRenderSystem::IndirectRenderSystem(Device& device, Renderer& renderer, const RenderTargetInfo& renderTarget)
+        : device{device}, renderer{renderer}, layoutCache{renderer.getDescriptorLayoutCache()}, depthPyramid{device, renderer}
+    {
+        assert(isSupported(device) && "GPU-driven rendering needs multiDrawIndirect and drawIndirectFirstInstance");
+
+        createBuffer(occlusionUniformBuffer, UNIFORM_SLOT_SIZE * 2,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        createBuffer(statsBuffer, sizeof(uint32_t) * STATS_COUNTERS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        void* mapped = nullptr;
+        if (vkMapMemory(device.device(), statsBuffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+            throw std::runtime_error("failed to map occlusion stats buffer!");
+        statsMapped = static_cast<uint32_t*>(mapped);
+        resetOcclusionStats();
+
+        createDescriptorResources();
+        createPipelineLayouts();
+        createPipelines(renderTarget);
+    }
+
+    IndirectRenderSystem::~IndirectRenderSystem()
+    {
+        retireBuffers();
+
+        Device* owner = &device;
+        for (auto& frame : frames)
+        {
+            if (frame.globalBuffer == VK_NULL_HANDLE) continue;
+            renderer.deferDestroy([owner, buffer = frame.globalBuffer, memory = frame.globalMemory]() {
+                vkUnmapMemory(owner->device(), memory);
+                vkDestroyBuffer(owner->device(), buffer, nullptr);
+                vkFreeMemory(owner->device(), memory, nullptr);
+            });
+        }
+
+        vkUnmapMemory(device.device(), statsBuffer.memory);
+        destroyBuffer(statsBuffer);
+        destroyBuffer(occlusionUniformBuffer);
+
+        cullPipeline.reset();
+        drawPipeline.reset();
+        vkDestroyPipelineLayout(device.device(), cullPipelineLayout, nullptr);
+    }
+
+
+
+    void IndirectRenderSystem::createDescriptorResources()
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        for (uint32_t i = 0; i < BindingCount; i++)
+            bindings.push_back(makeDescriptorBinding(i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT));
+
+        cullSetLayout = layoutCache.createLayout(bindings);
+
+        occlusionSetLayout = layoutCache.createLayout({
+            makeDescriptorBinding(OcclusionUniformBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+            makeDescriptorBinding(DepthPyramidBinding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT) });
+
+        // the same bindings as RenderSystem's set 0, the objects are this system's own
+        drawSetLayout = layoutCache.createLayout({
+            makeDescriptorBinding(GlobalUboBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
+            makeDescriptorBinding(ObjectBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) });
+    }
+
+
+
+    void IndirectRenderSystem::createPipelineLayouts()
+    {
+        VkPushConstantRange cullPushRange{};
+        cullPushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        cullPushRange.offset = 0;
+        cullPushRange.size = sizeof(CullPushConstants);
+
+        VkDescriptorSetLayout cullSetLayouts[] = { cullSetLayout, occlusionSetLayout };
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 2;
+        pipelineLayoutInfo.pSetLayouts = cullSetLayouts;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &cullPushRange;
+
+        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create pipeline layout!");
+
+        // the draw only reads the camera and the objects, its layout is shared through the pipeline cache
+        drawPipelineLayout = renderer.getPipelineCache().getPipelineLayout({ drawSetLayout });
+    }
+
+
+
+    void IndirectRenderSystem::createPipelines(const RenderTargetInfo& renderTarget)
+    {
+        cullPipeline = std::make_unique<ComputePipeline>(
+            device, renderer.getShaderCompiler().load("shaders/indirect_cull.comp"), cullPipelineLayout);
+
+        PipelineConfigInfo pipelineConfig{};
+        Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+        Pipeline::setRenderTarget(pipelineConfig, renderTarget);
+        pipelineConfig.pipelineLayout = drawPipelineLayout;
+        drawPipeline = renderer.getPipelineCache().getPipeline(
+            "shaders/indirect_shader.vert",
+            "shaders/indirect_shader.frag",
+            pipelineConfig);
+    }
+
+
+
+    void IndirectRenderSystem::setModelLods(const std::shared_ptr<Model>& model, std::vector<LodLevel> lods)
+    {
+        assert(!lods.empty() && lods.size() <= MAX_LOD_LEVELS && "LOD count must be between 1 and MAX_LOD_LEVELS");
+
+        std::sort(lods.begin(), lods.end(),
+            [](const LodLevel& a, const LodLevel& b) { return a.maxDistance < b.maxDistance; });
+        modelLods[model.get()] = std::move(lods);
+    }
+
+
+
+    void IndirectRenderSystem::uploadGameObjects(std::vector<GameObject>& gameObjects)
+    {
+        assert(!renderer.isFrameInProgress() && "Can't upload game objects while a frame is recorded");
+
+        // frames in flight may still read the buffers of the last upload
+        retireBuffers();
+
+        meshes.clear();
+        objects.clear();
+        objects.reserve(gameObjects.size());
+
+        std::unordered_map<Model*, uint32_t> meshIndices;
+        auto getMeshIndex = [&](const std::shared_ptr<Model>& model) {
+            auto found = meshIndices.find(model.get());
+            if (found != meshIndices.end()) return found->second;
+
+            uint32_t index = static_cast<uint32_t>(meshes.size());
+            meshIndices.emplace(model.get(), index);
+            meshes.push_back({ model, 0, 0 });
+            return index;
+        };
+
+        // one LOD group per distinct object model, a single level unless setModelLods was called
+        std::unordered_map<Model*, uint32_t> groupIndices;
+        std::vector<LodGroupData> lodGroups;
+
+        for (auto& obj : gameObjects)
+        {
+            if (!obj.model) continue;
+
+            uint32_t groupIndex;
+            auto found = groupIndices.find(obj.model.get());
+            if (found != groupIndices.end())
+            {
+                groupIndex = found->second;
+            }
+            else
+            {
+                LodGroupData group{};
+                auto lods = modelLods.find(obj.model.get());
+                if (lods != modelLods.end())
+                {
+                    for (uint32_t level = 0; level < lods->second.size(); level++)
+                    {
+                        group.meshes[level] = getMeshIndex(lods->second[level].model);
+                        group.maxDistance[level] = lods->second[level].maxDistance;
+                    }
+                    group.levelCount.x = static_cast<uint32_t>(lods->second.size());
+                }
+                else
+                {
+                    group.meshes[0] = getMeshIndex(obj.model);
+                    group.maxDistance[0] = std::numeric_limits<float>::max();
+                    group.levelCount.x = 1;
+                }
+
+                groupIndex = static_cast<uint32_t>(lodGroups.size());
+                groupIndices.emplace(obj.model.get(), groupIndex);
+                lodGroups.push_back(group);
+            }
+
+            // every level of the group needs room for this object
+            const auto& group = lodGroups[groupIndex];
+            for (uint32_t level = 0; level < group.levelCount.x; level++)
+                meshes[group.meshes[level]].commandCapacity++;
+
+            ObjectData data{};
+            data.model = obj.transform.mat4();
+            data.color = glm::vec4(obj.color, 1.0f);
+            data.sphere = getWorldBoundingSphere(obj);
+            data.lodGroup.x = groupIndex;
+            objects.push_back(data);
+        }
+
+        objectCount = objects.size();
+        if (objectCount == 0) return;
+
+        std::vector<MeshData> meshData(meshes.size());
+        commandCount = 0;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            meshes[i].commandOffset = commandCount;
+            commandCount += meshes[i].commandCapacity;
+
+            meshData[i].indexCount = meshes[i].model->getIndexCount();
+            meshData[i].vertexCount = meshes[i].model->getVertexCount();
+            meshData[i].indexed = meshes[i].model->isIndexed() ? 1 : 0;
+            meshData[i].commandOffset = meshes[i].commandOffset;
+        }
+
+        const VkMemoryPropertyFlags deviceLocal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        createBuffer(objectBuffer, sizeof(ObjectData) * objects.size(),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, deviceLocal);
+        createBuffer(meshBuffer, sizeof(MeshData) * meshData.size(),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, deviceLocal);
+        createBuffer(lodGroupBuffer, sizeof(LodGroupData) * lodGroups.size(),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, deviceLocal);
+        // commands and counts of both occlusion phases
+        createBuffer(drawCommandBuffer, COMMAND_STRIDE * commandCount * 2,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, deviceLocal);
+        createBuffer(countBuffer, sizeof(uint32_t) * meshes.size() * 2,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, deviceLocal);
+        createBuffer(visibilityBuffer, sizeof(uint32_t) * objects.size(),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, deviceLocal);
+        createBuffer(occludedBuffer, sizeof(uint32_t) * objects.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, deviceLocal);
+
+        uploadBuffer(objectBuffer, objects.data(), sizeof(ObjectData) * objects.size());
+        uploadBuffer(meshBuffer, meshData.data(), sizeof(MeshData) * meshData.size());
+        uploadBuffer(lodGroupBuffer, lodGroups.data(), sizeof(LodGroupData) * lodGroups.size());
+    }
+
+
+
+    void IndirectRenderSystem::cull(VkCommandBuffer commandBuffer, const Camera& camera)
+    {
+        if (objectCount == 0) return;
+        recordCull(commandBuffer, camera, 0, renderer.getFrameDescriptorAllocator());
+    }
+
+
+
+    void IndirectRenderSystem::cullOccluded(VkCommandBuffer commandBuffer, const Camera& camera)
+    {
+        if (objectCount == 0 || !occlusionCulling) return;
+
+        // only what the first phase drew is in the depth yet, objects drawn by the second phase
+        // are missing from the pyramid, which makes it conservative for the next frame
+        depthPyramid.build(
+            commandBuffer, renderer.getCurrentDepthImage(), renderer.getCurrentDepthImageView(), renderer.getSwapChainExtent());
+        pyramidViewProjection = camera.getProjectionMatrix() * camera.getViewMatrix();
+
+        recordCull(commandBuffer, camera, 1, renderer.getFrameDescriptorAllocator());
+    }
+
+
+
+    void IndirectRenderSystem::recordCull(
+        VkCommandBuffer commandBuffer, const Camera& camera, uint32_t phase, DescriptorAllocator& allocator)
+    {
+        if (phase == 0)
+        {
+            // the previous frame's indirect draws read the commands that are about to be rewritten,
+            // its cull dispatches read the occlusion uniforms
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+            vkCmdFillBuffer(commandBuffer, countBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+            // without indirect count every slot is drawn, unused ones must have zero instances
+            if (!device.getFeatures().drawIndirectCount)
+                vkCmdFillBuffer(commandBuffer, drawCommandBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+        }
+
+        // phase 0 tests against last frame's pyramid with the camera it was built with,
+        // phase 1 against the pyramid just built from this frame's camera
+        OcclusionUniforms uniforms{};
+        uniforms.viewProjection = pyramidViewProjection;
+        uniforms.pyramidSize = glm::vec4(
+            static_cast<float>(depthPyramid.getExtent().width),
+            static_cast<float>(depthPyramid.getExtent().height),
+            static_cast<float>(depthPyramid.getLevelCount()),
+            0.0f);
+        uniforms.phase = glm::uvec4(
+            phase,
+            occlusionCulling && depthPyramid.isValid() ? 1 : 0,
+            phase * commandCount,
+            phase * static_cast<uint32_t>(meshes.size()));
+        vkCmdUpdateBuffer(
+            commandBuffer, occlusionUniformBuffer.buffer, UNIFORM_SLOT_SIZE * phase, sizeof(OcclusionUniforms), &uniforms);
+
+        VkMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+        CullPushConstants push{};
+        Frustum frustum = camera.getFrustum();
+        for (int i = 0; i < Frustum::Count; i++) push.planes[i] = frustum.planes[i];
+        push.cameraPosition = glm::vec4(camera.getPosition(), 1.0f);
+        push.objectCount = static_cast<uint32_t>(objectCount);
+
+        VkDescriptorSet occlusionSet = DescriptorWriter{ layoutCache, allocator }
+            .writeBuffer(OcclusionUniformBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT,
+                occlusionUniformBuffer.buffer, UNIFORM_SLOT_SIZE * phase, sizeof(OcclusionUniforms))
+            .writeImage(DepthPyramidBinding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT,
+                depthPyramid.getDescriptorInfo())
+            .build();
+
+        VkDescriptorSet sets[] = { buildCullSet(allocator), occlusionSet };
+        cullPipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(
+            commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 2, sets, 0, nullptr);
+        vkCmdPushConstants(
+            commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push);
+
+        uint32_t groupCount = static_cast<uint32_t>((objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE);
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+        // the draws read the commands and counts, the second phase reads the held back objects
+        VkMemoryBarrier cullBarrier{};
+        cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+        // the fence wait alone doesn't make shader writes visible to the host, readOcclusionStats
+        // relies on this. Host writes of resetOcclusionStats are visible to the next submit by itself
+        VkBufferMemoryBarrier statsBarrier{};
+        statsBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        statsBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        statsBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        statsBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        statsBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        statsBarrier.buffer = statsBuffer.buffer;
+        statsBarrier.offset = 0;
+        statsBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 0, nullptr, 1, &statsBarrier, 0, nullptr);
+    }
+
+
+
+    void IndirectRenderSystem::render(VkCommandBuffer commandBuffer, const Camera& camera)
+    {
+        if (objectCount == 0) return;
+        recordDraws(commandBuffer, camera, 0);
+    }
+
+
+
+    void IndirectRenderSystem::renderOccluded(VkCommandBuffer commandBuffer, const Camera& camera)
+    {
+        if (objectCount == 0 || !occlusionCulling) return;
+        recordDraws(commandBuffer, camera, 1);
+    }
+
+
+
+    void IndirectRenderSystem::recordDraws(VkCommandBuffer commandBuffer, const Camera& camera, uint32_t phase)
+    {
+        VkDescriptorSet drawSet = prepareDrawSet(camera);
+        drawPipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(
+            commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipelineLayout, 0, 1, &drawSet, 0, nullptr);
+
+        const bool indirectCount = device.getFeatures().drawIndirectCount;
+        const uint32_t stride = static_cast<uint32_t>(COMMAND_STRIDE);
+
+        // one call per mesh whatever the object count, the GPU decides how many draws there are
+        for (uint32_t i = 0; i < meshes.size(); i++)
+        {
+            const auto& mesh = meshes[i];
+            if (mesh.commandCapacity == 0) continue;
+
+            VkDeviceSize offset = COMMAND_STRIDE * (phase * commandCount + mesh.commandOffset);
+            VkDeviceSize countOffset = sizeof(uint32_t) * (phase * meshes.size() + i);
+
+            mesh.model->bind(commandBuffer);
+            if (mesh.model->isIndexed())
+            {
+                if (indirectCount)
+                    vkCmdDrawIndexedIndirectCount(commandBuffer, drawCommandBuffer.buffer, offset,
+                        countBuffer.buffer, countOffset, mesh.commandCapacity, stride);
+                else
+                    vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer.buffer, offset, mesh.commandCapacity, stride);
+            }
+            else
+            {
+                if (indirectCount)
+                    vkCmdDrawIndirectCount(commandBuffer, drawCommandBuffer.buffer, offset,
+                        countBuffer.buffer, countOffset, mesh.commandCapacity, stride);
+                else
+                    vkCmdDrawIndirect(commandBuffer, drawCommandBuffer.buffer, offset, mesh.commandCapacity, stride);
+            }
+        }
+    }
+
+
+
+    size_t IndirectRenderSystem::verifyAgainstCpu(const Camera& camera)
+    {
+        if (objectCount == 0) return 0;
+
+        GpuBuffer readback;
+        createBuffer(readback, sizeof(uint32_t) * objectCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        // outside of a frame, the occlusion set comes from a pool of its own
+        DescriptorAllocator scratchAllocator{ device };
+
+        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+        recordCull(commandBuffer, camera, 0, scratchAllocator);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = sizeof(uint32_t) * objectCount;
+        vkCmdCopyBuffer(commandBuffer, visibilityBuffer.buffer, readback.buffer, 1, &copyRegion);
+        device.endSingleTimeCommands(commandBuffer);
+
+        std::vector<uint32_t> gpuVisible(objectCount);
+        void* data;
+        vkMapMemory(device.device(), readback.memory, 0, readback.size, 0, &data);
+        memcpy(gpuVisible.data(), data, sizeof(uint32_t) * objectCount);
+        vkUnmapMemory(device.device(), readback.memory);
+        destroyBuffer(readback);
+
+        // same spheres through the CPU kernel
+        CullingSpheres spheres;
+        spheres.resize(objectCount);
+        for (size_t i = 0; i < objectCount; i++)
+        {
+            spheres.centerX[i] = objects[i].sphere.x;
+            spheres.centerY[i] = objects[i].sphere.y;
+            spheres.centerZ[i] = objects[i].sphere.z;
+            spheres.radius[i] = objects[i].sphere.w;
+        }
+
+        Frustum frustum = camera.getFrustum();
+        std::vector<uint32_t> visibleIndices(objectCount);
+        size_t visibleCount = cullSpheres(detectCullingKernel(), frustum, spheres, 0, visibleIndices.data());
+
+        std::vector<uint32_t> cpuVisible(objectCount, 0);
+        for (size_t i = 0; i < visibleCount; i++) cpuVisible[visibleIndices[i]] = 1;
+
+        size_t mismatches = 0;
+        size_t boundaryCases = 0;
+        for (size_t i = 0; i < objectCount; i++)
+        {
+            if (cpuVisible[i] == gpuVisible[i]) continue;
+
+            // fused multiply-add on the GPU may flip spheres that touch a plane
+            float margin = std::numeric_limits<float>::max();
+            for (const auto& plane : frustum.planes)
+                margin = std::min(margin, glm::dot(glm::vec3(plane), glm::vec3(objects[i].sphere)) + plane.w + objects[i].sphere.w);
+
+            float tolerance = 1e-4f * std::max(1.0f, glm::length(glm::vec3(objects[i].sphere)) + objects[i].sphere.w);
+            if (std::abs(margin) <= tolerance) boundaryCases++;
+            else mismatches++;
+        }
+
+        std::cout << "GPU culling check: " << visibleCount << " of " << objectCount << " visible on the CPU, "
+            << mismatches << " mismatches, " << boundaryCases << " boundary cases" << std::endl;
+        return mismatches;
+    }
+
+
+
+    IndirectRenderSystem::OcclusionStats IndirectRenderSystem::readOcclusionStats() const
+    {
+        OcclusionStats stats{};
+        stats.frustumVisible = statsMapped[0];
+        stats.occludedFirstPhase = statsMapped[1];
+        stats.occluded = statsMapped[2];
+        return stats;
+    }
+
+
+    void IndirectRenderSystem::resetOcclusionStats()
+    {
+        memset(statsMapped, 0, sizeof(uint32_t) * STATS_COUNTERS);
+    }
+
+
+
+    void IndirectRenderSystem::createBuffer(
+        GpuBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+    {
+        // storage buffers can't be empty
+        buffer.size = std::max<VkDeviceSize>(size, 16);
+        device.createBuffer(buffer.size, usage, properties, buffer.buffer, buffer.memory);
+    }
+
+
+
+    void IndirectRenderSystem::uploadBuffer(GpuBuffer& buffer, const void* data, VkDeviceSize size)
+    {
+        GpuBuffer staging;
+        createBuffer(staging, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        void* mapped;
+        vkMapMemory(device.device(), staging.memory, 0, size, 0, &mapped);
+        memcpy(mapped, data, static_cast<size_t>(size));
+        vkUnmapMemory(device.device(), staging.memory);
+
+        device.copyBuffer(staging.buffer, buffer.buffer, size);
+        destroyBuffer(staging);
+    }
+
+
+
+    void IndirectRenderSystem::destroyBuffer(GpuBuffer& buffer)
+    {
+        if (buffer.buffer == VK_NULL_HANDLE) return;
+
+        vkDestroyBuffer(device.device(), buffer.buffer, nullptr);
+        vkFreeMemory(device.device(), buffer.memory, nullptr);
+        buffer = {};
+    }
+
+
+
+    void IndirectRenderSystem::retireBuffers()
+    {
+        std::vector<GpuBuffer> retired = {
+            objectBuffer, meshBuffer, lodGroupBuffer, drawCommandBuffer, countBuffer, visibilityBuffer, occludedBuffer };
+        objectBuffer = meshBuffer = lodGroupBuffer = drawCommandBuffer = countBuffer = visibilityBuffer = occludedBuffer = {};
+        objectCount = 0;
+
+        Device* owner = &device;
+        renderer.deferDestroy([owner, retired]() {
+            for (const auto& buffer : retired)
+            {
+                if (buffer.buffer == VK_NULL_HANDLE) continue;
+                vkDestroyBuffer(owner->device(), buffer.buffer, nullptr);
+                vkFreeMemory(owner->device(), buffer.memory, nullptr);
+            }
+        });
+    }
+
+
+
+    VkDescriptorSet IndirectRenderSystem::buildCullSet(DescriptorAllocator& allocator)
+    {
+        const GpuBuffer* buffers[BindingCount] = {
+            &objectBuffer, &meshBuffer, &lodGroupBuffer, &drawCommandBuffer, &countBuffer, &visibilityBuffer,
+            &occludedBuffer, &statsBuffer };
+
+        DescriptorWriter writer{ layoutCache, allocator };
+        for (uint32_t i = 0; i < BindingCount; i++)
+            writer.writeBuffer(i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, buffers[i]->buffer);
+        return writer.build();
+    }
+
+
+
+    VkDescriptorSet IndirectRenderSystem::prepareDrawSet(const Camera& camera)
+    {
+        // frames in flight can change at runtime
+        size_t frameIndex = static_cast<size_t>(renderer.getFrameIndex());
+        if (frames.size() <= frameIndex) frames.resize(frameIndex + 1);
+
+        auto& frame = frames[frameIndex];
+        if (frame.globalBuffer == VK_NULL_HANDLE)
+        {
+            device.createBuffer(
+                sizeof(GlobalUbo),
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                frame.globalBuffer,
+                frame.globalMemory);
+
+            void* mapped = nullptr;
+            if (vkMapMemory(device.device(), frame.globalMemory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+                throw std::runtime_error("failed to map global uniform buffer!");
+            frame.globalMapped = static_cast<GlobalUbo*>(mapped);
+        }
+
+        GlobalUbo ubo{};
+        ubo.projection = camera.getProjectionMatrix();
+        ubo.view = camera.getViewMatrix();
+        ubo.projectionView = ubo.projection * ubo.view;
+        ubo.cameraPosition = glm::vec4(camera.getPosition(), 1.0f);
+        *frame.globalMapped = ubo;
+
+        return DescriptorWriter{ layoutCache, renderer.getFrameDescriptorAllocator() }
+            .writeBuffer(GlobalUboBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                frame.globalBuffer, 0, sizeof(GlobalUbo))
+            .writeBuffer(ObjectBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, objectBuffer.buffer)
+            .build();
+    }
+}  // namespace lve
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "DepthPyramid.hpp"
+#include "Descriptor.hpp"
+#include "Device.hpp"
+#include "GameObject.hpp"
+#include "Pipeline.hpp"
+#include "Renderer.hpp"
+
+// std
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace LeMU {
+
+	// GPU-driven path: object transforms and bounds live in storage buffers, a compute shader
+	// frustum culls them, picks a LOD and appends indirect draw commands. The raster pass issues one
+	// indirect count draw per mesh, so the CPU cost does not depend on the object count. The draws read
+	// the camera from a per-frame GlobalUbo, set 0 is laid out like RenderSystem's.
+	//
+	// With occlusion culling a frame has two phases:
+	//   cull, begin render pass, render, end render pass,
+	//   cullOccluded, resume render pass, renderOccluded, end render pass
+	// the first phase also rejects objects hidden in last frame's depth pyramid, the second builds
+	// the pyramid from the first phase's depth and retests only those, so nothing pops in
+	class IndirectRenderSystem {
+	public:
+		static constexpr uint32_t MAX_LOD_LEVELS = 4;
+		static constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+		struct LodLevel {
+			std::shared_ptr<Model> model;
+			float maxDistance;		// camera distance up to which this level is used
+		};
+
+		// needs multi draw indirect and a non-zero firstInstance in indirect draws
+		static bool isSupported(Device &device);
+
+		IndirectRenderSystem(Device &device, Renderer &renderer, const RenderTargetInfo &renderTarget);
+		~IndirectRenderSystem();
+
+		IndirectRenderSystem(const IndirectRenderSystem&) = delete;
+		IndirectRenderSystem& operator=(const IndirectRenderSystem&) = delete;
+
+		// objects using model are drawn with these levels instead, sorted by maxDistance.
+		// Takes effect on the next uploadGameObjects
+		void setModelLods(const std::shared_ptr<Model> &model, std::vector<LodLevel> lods);
+
+		// copy transforms, colors and world bounds to the GPU. Call again when objects change, outside
+		// of a frame. The previous buffers are retired until the frames in flight reading them complete
+		void uploadGameObjects(std::vector<GameObject> &gameObjects);
+
+		// record culling, outside of a render pass
+		void cull(VkCommandBuffer commandBuffer, const Camera &camera);
+
+		// draw what the last cull produced, inside the swap chain render pass
+		void render(VkCommandBuffer commandBuffer, const Camera &camera);
+
+		// second phase of occlusion culling, between endSwapChainRenderPass and
+		// resumeSwapChainRenderPass. Does nothing when occlusion culling is off
+		void cullOccluded(VkCommandBuffer commandBuffer, const Camera &camera);
+
+		// draw the objects cullOccluded found visible after all, inside the resumed render pass
+		void renderOccluded(VkCommandBuffer commandBuffer, const Camera &camera);
+
+		// off by default, the caller has to record the second phase when turning it on
+		inline void setOcclusionCulling(bool enabled) { occlusionCulling = enabled; }
+		inline bool getOcclusionCulling() const { return occlusionCulling; }
+
+		// object counts summed over every cull since resetOcclusionStats
+		struct OcclusionStats {
+			size_t frustumVisible = 0;
+			size_t occludedFirstPhase = 0;		// hidden by last frame's pyramid
+			size_t occluded = 0;				// still hidden by this frame's pyramid, never drawn
+		};
+
+		// the GPU writes the counters, only read or reset them once every frame that culled has
+		// completed (vkDeviceWaitIdle). Each cull ends with a barrier making them visible to the host
+		OcclusionStats readOcclusionStats() const;
+		void resetOcclusionStats();
+
+		// run the GPU cull once and compare per object visibility with cullSpheres on the CPU.
+		// Returns the number of objects the two disagree on, spheres touching a plane within
+		// floating point tolerance are not counted
+		size_t verifyAgainstCpu(const Camera &camera);
+
+		inline size_t getObjectCount() const { return objectCount; }
+		inline size_t getMeshCount() const { return meshes.size(); }
+
+	private:
+		// std430 layouts shared with indirect_cull.comp and indirect_shader.vert
+		struct ObjectData {
+			glm::mat4 model;
+			glm::vec4 color;
+			glm::vec4 sphere;		// world space center, radius
+			glm::uvec4 lodGroup;	// x: index into the LOD groups
+		};
+
+		struct MeshData {
+			uint32_t indexCount;
+			uint32_t vertexCount;
+			uint32_t indexed;
+			uint32_t commandOffset;	// first draw command slot of this mesh
+		};
+
+		struct LodGroupData {
+			glm::uvec4 meshes;
+			glm::vec4 maxDistance;
+			glm::uvec4 levelCount;
+		};
+
+		// std140, set 1 of indirect_cull.comp, one slot per phase
+		struct OcclusionUniforms {
+			glm::mat4 viewProjection;
+			glm::vec4 pyramidSize;		// xy: level 0 size, z: level count
+			glm::uvec4 phase;			// x: phase, y: test enabled, z: first command slot, w: first count slot
+		};
+
+		struct GpuBuffer {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+		};
+
+		struct Mesh {
+			std::shared_ptr<Model> model;
+			uint32_t commandOffset = 0;
+			uint32_t commandCapacity = 0;	// objects that may pick this mesh
+		};
+
+		void createDescriptorResources();
+		void createPipelineLayouts();
+		void createPipelines(const RenderTargetInfo &renderTarget);
+
+		// camera uniform buffer of one frame in flight, persistently mapped
+		struct FrameData {
+			VkBuffer globalBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory globalMemory = VK_NULL_HANDLE;
+			GlobalUbo *globalMapped = nullptr;
+		};
+
+		void createBuffer(GpuBuffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+		void uploadBuffer(GpuBuffer &buffer, const void *data, VkDeviceSize size);
+		void destroyBuffer(GpuBuffer &buffer);
+
+		// the per-object buffers of the last upload, destroyed once the frames submitted so far completed
+		void retireBuffers();
+
+		// storage buffers of the cull shader, set 0
+		VkDescriptorSet buildCullSet(DescriptorAllocator &allocator);
+
+		// writes camera into the current frame's uniform buffer, returns the draw set built from it
+		VkDescriptorSet prepareDrawSet(const Camera &camera);
+
+		// phase 0 resets the draw counts and tests the frustum, phase 1 retests held back objects.
+		// The per-dispatch set comes from allocator
+		void recordCull(VkCommandBuffer commandBuffer, const Camera &camera, uint32_t phase, DescriptorAllocator &allocator);
+		void recordDraws(VkCommandBuffer commandBuffer, const Camera &camera, uint32_t phase);
+
+		Device &device;
+		Renderer &renderer;
+		DescriptorLayoutCache &layoutCache;
+
+		// owned by the layout cache, the sets are built per frame from the frame allocator
+		VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout occlusionSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout drawSetLayout = VK_NULL_HANDLE;
+
+		VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+		VkPipelineLayout drawPipelineLayout = VK_NULL_HANDLE;	// owned by the renderer's pipeline cache
+		std::unique_ptr<ComputePipeline> cullPipeline;
+		std::shared_ptr<Pipeline> drawPipeline;
+
+		GpuBuffer objectBuffer;
+		GpuBuffer meshBuffer;
+		GpuBuffer lodGroupBuffer;
+		GpuBuffer drawCommandBuffer;
+		GpuBuffer countBuffer;
+		GpuBuffer visibilityBuffer;
+		GpuBuffer occludedBuffer;
+
+		// live as long as the system, not rebuilt by uploadGameObjects
+		GpuBuffer occlusionUniformBuffer;
+		GpuBuffer statsBuffer;
+		uint32_t *statsMapped = nullptr;
+		std::vector<FrameData> frames;
+
+		DepthPyramid depthPyramid;
+		bool occlusionCulling = false;
+		glm::mat4 pyramidViewProjection{ 1.0f };	// camera of the last pyramid build
+		uint32_t commandCount = 0;					// per phase, the second phase's commands follow
+
+		std::unordered_map<Model*, std::vector<LodLevel>> modelLods;
+		std::vector<Mesh> meshes;
+		std::vector<ObjectData> objects;	// CPU copy, used by verifyAgainstCpu
+		size_t objectCount = 0;
+	};
+}  // namespace lve
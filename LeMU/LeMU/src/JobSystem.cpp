@@ -0,0 +1,169 @@
+#include "pch.h"
+
+#include "JobSystem.hpp"
+
+// std
+#include <algorithm>
+#include <exception>
+
+namespace LeMU {
+
+    JobSystem::JobSystem(uint32_t threadCount)
+        : threadCount(threadCount)
+    {
+        if (this->threadCount == 0)
+            this->threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        // calling thread is thread 0, it does not need a worker
+        for (uint32_t i = 1; i < this->threadCount; i++)
+            workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+
+
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+
+
+    void JobSystem::workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+                if (stopping && jobs.empty()) return;
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job();
+
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                unfinishedJobs--;
+            }
+            jobsFinished.notify_all();
+        }
+    }
+
+
+
+    bool JobSystem::runPendingJob()
+    {
+        std::function<void()> job;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (jobs.empty()) return false;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            unfinishedJobs--;
+        }
+        jobsFinished.notify_all();
+        return true;
+    }
+
+
+
+    void JobSystem::submit(std::function<void()>&& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            jobs.push_back(std::move(job));
+            unfinishedJobs++;
+        }
+        jobAvailable.notify_one();
+    }
+
+
+
+    void JobSystem::wait()
+    {
+        // help out instead of sleeping while there is queued work
+        while (runPendingJob()) {}
+
+        std::unique_lock<std::mutex> lock(queueMutex);
+        jobsFinished.wait(lock, [this]() { return unfinishedJobs == 0; });
+    }
+
+
+
+    void JobSystem::parallelFor(size_t count, uint32_t chunkCount,
+        const std::function<void(size_t begin, size_t end, uint32_t chunkIndex)>& job)
+    {
+        if (count == 0) return;
+
+        chunkCount = static_cast<uint32_t>(std::min<size_t>(std::max(chunkCount, 1u), count));
+        const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+        std::atomic<uint32_t> remainingChunks{ chunkCount - 1 };
+
+        // the chunks reference this stack frame, so a throwing chunk must not unwind it before the
+        // others are done. The first exception is kept and rethrown once every chunk has finished
+        std::exception_ptr firstError;
+        std::mutex errorMutex;
+
+        auto runChunk = [&job, &firstError, &errorMutex](size_t begin, size_t end, uint32_t chunk) {
+            try
+            {
+                if (begin < end) job(begin, end, chunk);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!firstError) firstError = std::current_exception();
+            }
+        };
+
+        // chunk 0 runs on the calling thread, the rest go to the workers
+        for (uint32_t chunk = 1; chunk < chunkCount; chunk++)
+        {
+            size_t begin = chunk * chunkSize;
+            size_t end = std::min(begin + chunkSize, count);
+
+            submit([&runChunk, &remainingChunks, begin, end, chunk]() {
+                runChunk(begin, end, chunk);
+                remainingChunks--;
+            });
+        }
+
+        runChunk(0, std::min(chunkSize, count), 0);
+
+        // parallelFor may be called from inside a job, keep draining the queue so it can't deadlock
+        while (remainingChunks.load() > 0)
+        {
+            if (!runPendingJob())
+                std::this_thread::yield();
+        }
+
+        if (firstError) std::rethrow_exception(firstError);
+    }
+
+
+
+    void JobSystem::parallelFor(size_t count, const std::function<void(size_t begin, size_t end, uint32_t chunkIndex)>& job)
+    {
+        parallelFor(count, threadCount, job);
+    }
+
+}  // namespace lve
@@ -0,0 +1,59 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace LeMU {
+
+	// fixed size thread pool, the thread calling parallelFor takes part in the work
+	class JobSystem {
+	public:
+		// threadCount includes the calling thread, 0 picks the hardware concurrency
+		JobSystem(uint32_t threadCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		inline uint32_t getThreadCount() const { return threadCount; }
+
+		// split [0, count) into chunkCount contiguous ranges and run job(begin, end, chunkIndex) on each,
+		// returns once every range is done. A chunk index is never used by two threads at once,
+		// so it can select per-thread resources such as command pools. If chunks throw, the first exception
+		// is rethrown on the calling thread after every chunk has finished
+		void parallelFor(size_t count, uint32_t chunkCount,
+			const std::function<void(size_t begin, size_t end, uint32_t chunkIndex)>& job);
+
+		// one chunk per thread
+		void parallelFor(size_t count, const std::function<void(size_t begin, size_t end, uint32_t chunkIndex)>& job);
+
+		// run a job on a worker thread without waiting for it
+		void submit(std::function<void()>&& job);
+
+		// block until every submitted job has finished
+		void wait();
+
+	private:
+		void workerLoop();
+
+		// pop and run one queued job on the calling thread, false if the queue was empty
+		bool runPendingJob();
+
+		uint32_t threadCount;
+		std::vector<std::thread> workers;
+
+		std::deque<std::function<void()>> jobs;
+		std::mutex queueMutex;
+		std::condition_variable jobAvailable;
+		std::condition_variable jobsFinished;
+		size_t unfinishedJobs = 0;
+		bool stopping = false;
+	};
+}  // namespace lve
@@ -0,0 +1,254 @@
+#include "pch.h"
+
+#include "LightClusters.hpp"
+
+#include <gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+namespace LeMU {
+
+    namespace {
+
+        // smallest sphere around the lit cone, narrow cones fit better in one through the apex
+        glm::vec4 getBoundingSphere(const Light& light)
+        {
+            if (light.type == LightType::Point || light.outerConeAngle >= glm::half_pi<float>())
+                return glm::vec4(light.position, light.range);
+
+            float cosOuter = std::cos(light.outerConeAngle);
+            if (light.outerConeAngle > glm::quarter_pi<float>())
+                return glm::vec4(light.position + light.direction * (light.range * cosOuter), light.range * std::sin(light.outerConeAngle));
+
+            float radius = light.range / (2.0f * cosOuter);
+            return glm::vec4(light.position + light.direction * radius, radius);
+        }
+
+        uint32_t toTile(float ndc, uint32_t tileCount)
+        {
+            float tile = std::floor((ndc * 0.5f + 0.5f) * tileCount);
+            return static_cast<uint32_t>(std::clamp(tile, 0.0f, static_cast<float>(tileCount - 1)));
+        }
+    }
+
+
+
+    GpuLight makeGpuLight(const Light& light)
+    {
+        GpuLight gpuLight{};
+        gpuLight.positionRange = glm::vec4(light.position, light.range);
+
+        if (light.type == LightType::Spot)
+        {
+            gpuLight.colorCosInner = glm::vec4(light.color * light.intensity, std::cos(light.innerConeAngle));
+            gpuLight.directionCosOuter = glm::vec4(light.direction, std::cos(light.outerConeAngle));
+        }
+        else
+        {
+            // smoothstep(-2, -1, cosine) is 1 for any cosine
+            gpuLight.colorCosInner = glm::vec4(light.color * light.intensity, -1.0f);
+            gpuLight.directionCosOuter = glm::vec4(0.0f, 0.0f, 0.0f, -2.0f);
+        }
+        return gpuLight;
+    }
+
+
+
+    LightClusterGrid::LightClusterGrid(uint32_t tilesX, uint32_t tilesY, uint32_t slices)
+        : tilesX{ tilesX }, tilesY{ tilesY }, slices{ slices }
+    {
+        assert(tilesX > 0 && tilesY > 0 && slices > 0 && "Light cluster grid can't be empty");
+        sliceScratch.resize(slices);
+        clusters.resize(getClusterCount());
+    }
+
+
+
+    uint32_t LightClusterGrid::getSlice(float viewDepth) const
+    {
+        float slice = std::floor(std::log(std::max(viewDepth, nearPlane)) * sliceScale + sliceBias);
+        return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(slices - 1)));
+    }
+
+
+
+    void LightClusterGrid::build(const std::vector<Light>& lights, const Camera& camera, JobSystem* jobSystem)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // recover the frustum from the projection: x' = x / (tanHalfFovX z), z' = far (z - near) / ((far - near) z)
+        const glm::mat4& projection = camera.getProjectionMatrix();
+        assert(projection[2][3] == 1.0f && "Light clusters need a perspective projection");
+
+        nearPlane = -projection[3][2] / projection[2][2];
+        farPlane = projection[3][2] / (1.0f - projection[2][2]);
+        tanHalfFovX = 1.0f / projection[0][0];
+        tanHalfFovY = 1.0f / projection[1][1];
+
+        float logDepthRatio = std::log(farPlane / nearPlane);
+        sliceScale = slices / logDepthRatio;
+        sliceBias = -(slices * std::log(nearPlane)) / logDepthRatio;
+
+        sliceDepths.resize(slices + 1);
+        for (uint32_t slice = 0; slice <= slices; slice++)
+            sliceDepths[slice] = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / slices);
+
+        // side planes through the eye, inward normals in view space
+        float xPlaneScale = 1.0f / std::sqrt(1.0f + tanHalfFovX * tanHalfFovX);
+        float yPlaneScale = 1.0f / std::sqrt(1.0f + tanHalfFovY * tanHalfFovY);
+        const glm::mat4& view = camera.getViewMatrix();
+
+        viewLights.resize(lights.size());
+        auto transformLights = [&](size_t begin, size_t end, uint32_t)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                glm::vec4 sphere = getBoundingSphere(lights[i]);
+                ViewLight& viewLight = viewLights[i];
+                viewLight.center = glm::vec3(view * glm::vec4(glm::vec3(sphere), 1.0f));
+                viewLight.radius = sphere.w;
+                viewLight.firstSlice = 1;
+                viewLight.lastSlice = 0;
+
+                const glm::vec3& center = viewLight.center;
+                float radius = viewLight.radius;
+                if (center.z + radius < nearPlane || center.z - radius > farPlane) continue;
+                if ((center.z * tanHalfFovX - center.x) * xPlaneScale < -radius ||
+                    (center.z * tanHalfFovX + center.x) * xPlaneScale < -radius ||
+                    (center.z * tanHalfFovY - center.y) * yPlaneScale < -radius ||
+                    (center.z * tanHalfFovY + center.y) * yPlaneScale < -radius) continue;
+
+                viewLight.firstSlice = getSlice(center.z - radius);
+                viewLight.lastSlice = getSlice(std::min(center.z + radius, farPlane));
+            }
+        };
+
+        auto binSlices = [&](size_t begin, size_t end, uint32_t)
+        {
+            for (size_t slice = begin; slice < end; slice++)
+                binSlice(static_cast<uint32_t>(slice), viewLights, sliceScratch[slice]);
+        };
+
+        if (jobSystem)
+        {
+            if (!lights.empty()) jobSystem->parallelFor(lights.size(), transformLights);
+            jobSystem->parallelFor(slices, binSlices);
+        }
+        else
+        {
+            transformLights(0, lights.size(), 0);
+            binSlices(0, slices, 0);
+        }
+
+        // the slices are concatenated in order, a cluster's list starts where the previous one ended
+        stats = {};
+        size_t totalIndices = 0;
+        for (const auto& scratch : sliceScratch) totalIndices += scratch.sortedLights.size();
+        lightIndices.resize(totalIndices);
+
+        const uint32_t tileCount = tilesX * tilesY;
+        uint32_t base = 0;
+        for (uint32_t slice = 0; slice < slices; slice++)
+        {
+            const auto& scratch = sliceScratch[slice];
+            for (uint32_t tile = 0; tile < tileCount; tile++)
+            {
+                uint32_t count = scratch.counts[tile];
+                clusters[slice * tileCount + tile] = glm::uvec2(base + scratch.offsets[tile], count);
+                stats.occupiedClusters += count > 0 ? 1 : 0;
+                stats.maxClusterLights = std::max(stats.maxClusterLights, count);
+            }
+
+            std::copy(scratch.sortedLights.begin(), scratch.sortedLights.end(), lightIndices.begin() + base);
+            base += static_cast<uint32_t>(scratch.sortedLights.size());
+        }
+
+        for (const auto& viewLight : viewLights)
+            stats.lightsInView += viewLight.firstSlice <= viewLight.lastSlice ? 1 : 0;
+        stats.lightIndices = totalIndices;
+        stats.buildMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+
+
+    void LightClusterGrid::binSlice(uint32_t slice, const std::vector<ViewLight>& viewLights, SliceScratch& scratch) const
+    {
+        const uint32_t tileCount = tilesX * tilesY;
+        scratch.pairClusters.clear();
+        scratch.pairLights.clear();
+        scratch.counts.assign(tileCount, 0);
+
+        const float sliceNear = sliceDepths[slice];
+        const float sliceFar = sliceDepths[slice + 1];
+
+        for (uint32_t lightIndex = 0; lightIndex < static_cast<uint32_t>(viewLights.size()); lightIndex++)
+        {
+            const ViewLight& light = viewLights[lightIndex];
+            if (slice < light.firstSlice || slice > light.lastSlice) continue;
+
+            const glm::vec3& center = light.center;
+            float radiusSquared = light.radius * light.radius;
+
+            // widest cross-section of the sphere inside the slice, seen at the slice's near and far depth
+            float zNear = std::max(sliceNear, center.z - light.radius);
+            float zFar = std::min(sliceFar, center.z + light.radius);
+            float dz = center.z < zNear ? zNear - center.z : (center.z > zFar ? center.z - zFar : 0.0f);
+            float crossRadius = std::sqrt(std::max(radiusSquared - dz * dz, 0.0f));
+
+            float minX = std::min((center.x - crossRadius) / (zNear * tanHalfFovX), (center.x - crossRadius) / (zFar * tanHalfFovX));
+            float maxX = std::max((center.x + crossRadius) / (zNear * tanHalfFovX), (center.x + crossRadius) / (zFar * tanHalfFovX));
+            float minY = std::min((center.y - crossRadius) / (zNear * tanHalfFovY), (center.y - crossRadius) / (zFar * tanHalfFovY));
+            float maxY = std::max((center.y + crossRadius) / (zNear * tanHalfFovY), (center.y + crossRadius) / (zFar * tanHalfFovY));
+            if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) continue;
+
+            uint32_t firstX = toTile(minX, tilesX), lastX = toTile(maxX, tilesX);
+            uint32_t firstY = toTile(minY, tilesY), lastY = toTile(maxY, tilesY);
+
+            for (uint32_t y = firstY; y <= lastY; y++)
+            {
+                // tile edges in NDC, the view space box of the froxel spans them at both slice depths
+                float top = (2.0f * y / tilesY - 1.0f) * tanHalfFovY;
+                float bottom = (2.0f * (y + 1) / tilesY - 1.0f) * tanHalfFovY;
+                float boxMinY = std::min(top * sliceNear, top * sliceFar);
+                float boxMaxY = std::max(bottom * sliceNear, bottom * sliceFar);
+                float distanceY = center.y - std::clamp(center.y, boxMinY, boxMaxY);
+
+                for (uint32_t x = firstX; x <= lastX; x++)
+                {
+                    float left = (2.0f * x / tilesX - 1.0f) * tanHalfFovX;
+                    float right = (2.0f * (x + 1) / tilesX - 1.0f) * tanHalfFovX;
+                    float boxMinX = std::min(left * sliceNear, left * sliceFar);
+                    float boxMaxX = std::max(right * sliceNear, right * sliceFar);
+                    float distanceX = center.x - std::clamp(center.x, boxMinX, boxMaxX);
+                    float distanceZ = center.z - std::clamp(center.z, sliceNear, sliceFar);
+
+                    if (distanceX * distanceX + distanceY * distanceY + distanceZ * distanceZ > radiusSquared) continue;
+
+                    uint32_t tile = y * tilesX + x;
+                    scratch.pairClusters.push_back(tile);
+                    scratch.pairLights.push_back(lightIndex);
+                    scratch.counts[tile]++;
+                }
+            }
+        }
+
+        // counting sort by tile, lights keep their order within a cluster
+        scratch.offsets.resize(tileCount);
+        uint32_t offset = 0;
+        for (uint32_t tile = 0; tile < tileCount; tile++)
+        {
+            scratch.offsets[tile] = offset;
+            offset += scratch.counts[tile];
+        }
+
+        scratch.sortedLights.resize(scratch.pairLights.size());
+        std::vector<uint32_t> cursor = scratch.offsets;
+        for (size_t i = 0; i < scratch.pairLights.size(); i++)
+            scratch.sortedLights[cursor[scratch.pairClusters[i]]++] = scratch.pairLights[i];
+    }
+}  // namespace lve
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "JobSystem.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace LeMU {
+
+	enum class LightType : uint32_t { Point = 0, Spot = 1 };
+
+	// dynamic light of the scene, moved and changed freely between frames
+	struct Light {
+		LightType type = LightType::Point;
+		glm::vec3 position{ 0.0f };		// world space
+		float range = 5.0f;				// no light reaches further, the falloff ends here
+		glm::vec3 color{ 1.0f };
+		float intensity = 1.0f;
+		glm::vec3 direction{ 0.0f, 1.0f, 0.0f };	// spot lights only, normalized, y is down
+		float innerConeAngle = 0.3f;	// spot lights only, half angles in radians, full intensity inside
+		float outerConeAngle = 0.5f;	// the inner cone and none outside the outer one
+	};
+
+	// std430 element of the light storage buffer
+	struct GpuLight {
+		glm::vec4 positionRange{ 0.0f };		// xyz: world position, w: range
+		glm::vec4 colorCosInner{ 0.0f };		// rgb: color times intensity, w: cos of the inner cone angle
+		glm::vec4 directionCosOuter{ 0.0f };	// xyz: spot direction, w: cos of the outer cone angle
+	};
+
+	// point lights get cone angles that make the spot factor 1 in every direction
+	GpuLight makeGpuLight(const Light &light);
+
+
+
+	// lights binned into a froxel grid: tilesX x tilesY screen tiles, each split into depth slices
+	// whose far / near ratio is the same for every slice, so slices stay about as deep as they are
+	// wide. The grid is built from the camera's projection, which must be a perspective one from
+	// Camera::setPerspectiveProjection. Every cluster lists the lights whose bounding sphere touches
+	// its view space box, a fragment only shades the lights of the cluster it falls into
+	class LightClusterGrid {
+	public:
+		static constexpr uint32_t DEFAULT_TILES_X = 16;
+		static constexpr uint32_t DEFAULT_TILES_Y = 9;
+		static constexpr uint32_t DEFAULT_SLICES = 24;
+
+		struct Stats {
+			size_t lightsInView = 0;		// bounding sphere inside the view frustum
+			size_t lightIndices = 0;		// entries of all cluster lists together
+			size_t occupiedClusters = 0;	// clusters with at least one light
+			uint32_t maxClusterLights = 0;	// longest cluster list
+			float buildMilliseconds = 0.0f;
+		};
+
+		LightClusterGrid(
+			uint32_t tilesX = DEFAULT_TILES_X,
+			uint32_t tilesY = DEFAULT_TILES_Y,
+			uint32_t slices = DEFAULT_SLICES);
+
+		// bin lights as seen by camera. Lights are transformed in chunks and depth slices are binned
+		// in chunks on the job system, jobSystem nullptr does everything on this thread
+		void build(const std::vector<Light> &lights, const Camera &camera, JobSystem *jobSystem = nullptr);
+
+		// cluster of tile (x, y) in depth slice, x grows to the right and y downwards on screen
+		inline uint32_t getClusterIndex(uint32_t x, uint32_t y, uint32_t slice) const {
+			return (slice * tilesY + y) * tilesX + x;
+		}
+
+		// depth slice of a view space depth in [near, far]
+		uint32_t getSlice(float viewDepth) const;
+
+		// per cluster the first entry of its list in getLightIndices and the list length
+		inline const std::vector<glm::uvec2>& getClusters() const { return clusters; }
+		inline const std::vector<uint32_t>& getLightIndices() const { return lightIndices; }
+
+		inline uint32_t getTilesX() const { return tilesX; }
+		inline uint32_t getTilesY() const { return tilesY; }
+		inline uint32_t getSliceCount() const { return slices; }
+		inline uint32_t getClusterCount() const { return tilesX * tilesY * slices; }
+
+		// slice = log(viewDepth) * sliceScale + sliceBias, what the fragment shader computes
+		inline float getSliceScale() const { return sliceScale; }
+		inline float getSliceBias() const { return sliceBias; }
+
+		// of the last build
+		inline const Stats& getStats() const { return stats; }
+
+	private:
+		// light bounds in view space and the depth slices they touch
+		struct ViewLight {
+			glm::vec3 center;
+			float radius;
+			uint32_t firstSlice;
+			uint32_t lastSlice;		// below firstSlice if the light is outside the view
+		};
+
+		// (cluster, light) pairs found in one depth slice, sorted by cluster when the slice is done
+		struct SliceScratch {
+			std::vector<uint32_t> pairClusters;
+			std::vector<uint32_t> pairLights;
+			std::vector<uint32_t> counts;			// per tile of the slice
+			std::vector<uint32_t> offsets;			// first entry of each tile in sortedLights
+			std::vector<uint32_t> sortedLights;		// lights of the slice in cluster order
+		};
+
+		void binSlice(uint32_t slice, const std::vector<ViewLight> &viewLights, SliceScratch &scratch) const;
+
+		uint32_t tilesX;
+		uint32_t tilesY;
+		uint32_t slices;
+
+		// of the camera of the last build
+		float nearPlane = 0.0f;
+		float farPlane = 0.0f;
+		float tanHalfFovX = 0.0f;
+		float tanHalfFovY = 0.0f;
+		float sliceScale = 0.0f;
+		float sliceBias = 0.0f;
+		std::vector<float> sliceDepths;		// slices + 1 boundaries from near to far
+
+		std::vector<ViewLight> viewLights;
+		std::vector<SliceScratch> sliceScratch;
+		std::vector<glm::uvec2> clusters;
+		std::vector<uint32_t> lightIndices;
+		Stats stats{};
+	};
+}  // namespace lve
@@ -0,0 +1,23 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+namespace LeMU {
+
+	// optional parts of the material shaders. Every combination in use gets a pipeline of its own
+	// with feature bit i as bool specialization constant i, see PipelinePermutations
+	enum MaterialFeature : uint32_t {
+		TexturedFeature = 1 << 0,		// base color sampled from the bindless table at textureIndex
+		VertexColorFeature = 1 << 1,	// base color multiplied by the vertex color
+		NormalMapFeature = 1 << 2,		// diffuse shading with the normal map at normalMapIndex
+		AlphaTestFeature = 1 << 3,		// fragments with base alpha below the cutoff are discarded
+	};
+
+	using MaterialFeatures = uint32_t;
+
+	constexpr uint32_t MATERIAL_FEATURE_COUNT = 4;
+
+	// specialization constant ids after the feature bits
+	constexpr uint32_t ALPHA_CUTOFF_CONSTANT = MATERIAL_FEATURE_COUNT;
+}  // namespace lve
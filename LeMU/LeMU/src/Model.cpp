@@ -1,8 +1,12 @@
+#include "pch.h"
+
 #include "Model.hpp"
 
 #include <cassert>
 #include <cstring>
 #include <iostream>
+#include <map>
+#include <tuple>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "../tiny_obj_loader.h"
@@ -14,6 +18,30 @@ namespace LeMU
 	{
 		createVertexBuffer(builder.vertices);
 		createIndexBuffer(builder.indices);
+		computeBounds(builder.vertices);
+	}
+
+
+
+	void Model::computeBounds(const std::vector<Vertex>& vertices)
+	{
+		// nothing to bound, keep the zero bounds
+		if (vertices.empty())
+		{
+			bounds = {};
+			return;
+		}
+
+		bounds.min = vertices[0].position;
+		bounds.max = vertices[0].position;
+		for (const auto& vertex : vertices)
+		{
+			bounds.min = glm::min(bounds.min, vertex.position);
+			bounds.max = glm::max(bounds.max, vertex.position);
+		}
+
+		bounds.center = (bounds.min + bounds.max) * 0.5f;
+		bounds.radius = glm::length(bounds.max - bounds.center);
 	}
 
 
@@ -108,12 +136,12 @@ namespace LeMU
 	}
 
 
-	void Model::draw(VkCommandBuffer commandBuffer)
+	void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance)
 	{
 		if (hasIndexBuffer)
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, firstInstance);
 		else
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
 	}
 
 
@@ -183,7 +211,7 @@ namespace LeMU
 
 		builder.loadModel(filePath);
 
-		std::cout << "Vertex count: " << builder.vertices.size() << std::endl;
+		std::cout << "Vertex count: " << builder.vertices.size() << ", index count: " << builder.indices.size() << std::endl;
 
 		return std::make_unique<Model>(device, builder);
 	}
@@ -205,10 +233,22 @@ namespace LeMU
 		vertices.clear();
 		indices.clear();
 
+		// obj corners referencing the same position / normal / uv triple share one vertex,
+		// so the model is drawn indexed (instanced and indirect draws rely on it)
+		std::map<std::tuple<int, int, int>, uint32_t> uniqueVertices{};
+
 		for (const auto &shape: shapes)
 		{
 			for (const auto& index : shape.mesh.indices)
 			{
+				auto key = std::make_tuple(index.vertex_index, index.normal_index, index.texcoord_index);
+				auto found = uniqueVertices.find(key);
+				if (found != uniqueVertices.end())
+				{
+					indices.push_back(found->second);
+					continue;
+				}
+
 				Vertex vertex{};
 
 				// vertex position
@@ -225,9 +265,9 @@ namespace LeMU
 				if (index.normal_index >= 0)
 				{
 					vertex.normal = {
-						attrib.vertices[3 * index.normal_index + 0],
-						attrib.vertices[3 * index.normal_index + 1],
-						attrib.vertices[3 * index.normal_index + 2]
+						attrib.normals[3 * index.normal_index + 0],
+						attrib.normals[3 * index.normal_index + 1],
+						attrib.normals[3 * index.normal_index + 2]
 					};
 				}
 
@@ -240,6 +280,8 @@ namespace LeMU
 					};
 				}
 
+				uniqueVertices.emplace(key, static_cast<uint32_t>(vertices.size()));
+				indices.push_back(static_cast<uint32_t>(vertices.size()));
 				vertices.push_back(vertex);
 			}
 		}
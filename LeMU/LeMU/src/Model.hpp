@@ -30,6 +30,15 @@ namespace LeMU
 			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
 		};
 
+		// object space bounds of the vertices, the sphere is centered on the box
+		struct Bounds
+		{
+			glm::vec3 min{ 0.0f };
+			glm::vec3 max{ 0.0f };
+			glm::vec3 center{ 0.0f };
+			float radius = 0.0f;
+		};
+
 		struct Builder
 		{
 			std::vector<Vertex> vertices{};
@@ -46,8 +55,13 @@ namespace LeMU
 		Model(const Model&) = delete;
 		Model& operator=(const Model&) = delete;
 
+		inline const Bounds& getBounds() const { return bounds; }
+		inline bool isIndexed() const { return hasIndexBuffer; }
+		inline uint32_t getVertexCount() const { return vertexCount; }
+		inline uint32_t getIndexCount() const { return indexCount; }
+
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
 
 		// a helper funtion that creates model object returns unique ptr
 		static std::unique_ptr<Model> createModelFromFile(Device &device, const std::string& filePath);
@@ -69,6 +83,8 @@ namespace LeMU
 
 		void deleteBuffer(VkBuffer buffer, VkDeviceMemory deviceMemory);
 
+		void computeBounds(const std::vector<Vertex> &vertices);
+
 		// copy data from host memory to device memory
 		// deviceMemory: memory in device(GPU)
 		// memSize: size of copied data
@@ -76,6 +92,8 @@ namespace LeMU
 		void copyHostMemToDeviceMem(VkDeviceMemory deviceMemory, VkDeviceSize memSize, const void* source);
 
 		Device &device;
+		Bounds bounds{};
+
 		VkBuffer vertexBuffer;
 		VkDeviceMemory vertexBufferMemory;
 		uint32_t vertexCount;
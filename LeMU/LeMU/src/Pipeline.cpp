@@ -1,22 +1,69 @@
+#include "pch.h"
+
 #include "Pipeline.hpp"
 
 #include "Model.hpp"
 
 // std
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <utility>
 
 namespace LeMU {
 
+    namespace {
+
+        // SPIR-V is a stream of 32-bit words, the file bytes are copied so the words are aligned
+        std::vector<uint32_t> toWords(const std::vector<char>& bytes) {
+            std::vector<uint32_t> words(bytes.size() / sizeof(uint32_t));
+            std::memcpy(words.data(), bytes.data(), words.size() * sizeof(uint32_t));
+            return words;
+        }
+    }
+
+
+
+    void ShaderSpecialization::setBool(uint32_t constantId, bool value) {
+        setUint(constantId, value ? VK_TRUE : VK_FALSE);
+    }
+
+    void ShaderSpecialization::setUint(uint32_t constantId, uint32_t value) {
+        for (const auto& entry : entries) {
+            if (entry.constantID == constantId) {
+                data[entry.offset / sizeof(uint32_t)] = value;
+                return;
+            }
+        }
+
+        entries.push_back({ constantId, static_cast<uint32_t>(data.size() * sizeof(uint32_t)), sizeof(uint32_t) });
+        data.push_back(value);
+    }
+
+    void ShaderSpecialization::setFloat(uint32_t constantId, float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        setUint(constantId, bits);
+    }
+
+
+
     Pipeline::Pipeline(
         Device& device,
         const std::string& vertFilepath,
         const std::string& fragFilepath,
         const PipelineConfigInfo& configInfo)
+        : Pipeline{ device, toWords(readFile(vertFilepath)), toWords(readFile(fragFilepath)), configInfo } {}
+
+    Pipeline::Pipeline(
+        Device& device,
+        const std::vector<uint32_t>& vertCode,
+        const std::vector<uint32_t>& fragCode,
+        const PipelineConfigInfo& configInfo)
         : device{ device } {
-        createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+        createGraphicsPipeline(vertCode, fragCode, configInfo);
     }
 
     Pipeline::~Pipeline() {
@@ -43,22 +90,28 @@ namespace LeMU {
     }
 
     void Pipeline::createGraphicsPipeline(
-        const std::string& vertFilepath,
-        const std::string& fragFilepath,
+        const std::vector<uint32_t>& vertCode,
+        const std::vector<uint32_t>& fragCode,
         const PipelineConfigInfo& configInfo) {
         assert(
             configInfo.pipelineLayout != VK_NULL_HANDLE &&
             "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
         assert(
-            configInfo.renderPass != VK_NULL_HANDLE &&
-            "Cannot create graphics pipeline: no renderPass provided in configInfo");
-
-        auto vertCode = readFile(vertFilepath);
-        auto fragCode = readFile(fragFilepath);
+            (configInfo.renderPass != VK_NULL_HANDLE || configInfo.colorAttachmentFormat != VK_FORMAT_UNDEFINED ||
+                configInfo.depthAttachmentFormat != VK_FORMAT_UNDEFINED) &&
+            "Cannot create graphics pipeline: no renderPass or attachment format provided in configInfo");
 
         createShaderModule(vertCode, &vertShaderModule);
         createShaderModule(fragCode, &fragShaderModule);
 
+        const auto& specialization = configInfo.specialization;
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(specialization.entries.size());
+        specializationInfo.pMapEntries = specialization.entries.data();
+        specializationInfo.dataSize = specialization.data.size() * sizeof(uint32_t);
+        specializationInfo.pData = specialization.data.data();
+        const VkSpecializationInfo* pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
+
         VkPipelineShaderStageCreateInfo shaderStages[2];
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -66,18 +119,18 @@ namespace LeMU {
         shaderStages[0].pName = "main";
         shaderStages[0].flags = 0;
         shaderStages[0].pNext = nullptr;
-        shaderStages[0].pSpecializationInfo = nullptr;
+        shaderStages[0].pSpecializationInfo = pSpecializationInfo;
         shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         shaderStages[1].module = fragShaderModule;
         shaderStages[1].pName = "main";
         shaderStages[1].flags = 0;
         shaderStages[1].pNext = nullptr;
-        shaderStages[1].pSpecializationInfo = nullptr;
+        shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
 
-        auto bindingDescriptions = Model::Vertex::getBindingDescription();
-        auto attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+        const auto& bindingDescriptions = configInfo.bindingDescriptions;
+        const auto& attributeDescriptions = configInfo.attributeDescriptions;
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
         vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -102,6 +155,20 @@ namespace LeMU {
         pipelineInfo.renderPass = configInfo.renderPass;
         pipelineInfo.subpass = configInfo.subpass;
 
+#ifdef VK_KHR_dynamic_rendering
+        // without a render pass the pipeline is only bound to attachment formats,
+        // so it stays valid across resizes and for any target with the same formats
+        VkPipelineRenderingCreateInfoKHR renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        // depth only pipelines, e.g. shadow maps, have no color attachment
+        renderingInfo.colorAttachmentCount = configInfo.colorAttachmentFormat != VK_FORMAT_UNDEFINED ? 1 : 0;
+        renderingInfo.pColorAttachmentFormats = &configInfo.colorAttachmentFormat;
+        renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+
+        if (configInfo.renderPass == VK_NULL_HANDLE)
+            pipelineInfo.pNext = &renderingInfo;
+#endif
+
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
@@ -116,11 +183,11 @@ namespace LeMU {
         }
     }
 
-    void Pipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+    void Pipeline::createShaderModule(const std::vector<uint32_t>& code, VkShaderModule* shaderModule) {
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        createInfo.codeSize = code.size() * sizeof(uint32_t);
+        createInfo.pCode = code.data();
 
         if (vkCreateShaderModule(device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
             throw std::runtime_error("failed to create shader module");
@@ -131,7 +198,66 @@ namespace LeMU {
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
     }
 
+    void Pipeline::swap(Pipeline& other) {
+        assert(&device == &other.device && "pipelines of different devices can't be swapped");
+        std::swap(graphicsPipeline, other.graphicsPipeline);
+        std::swap(vertShaderModule, other.vertShaderModule);
+        std::swap(fragShaderModule, other.fragShaderModule);
+    }
+
+
+
+    ComputePipeline::ComputePipeline(Device& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+        : ComputePipeline{ device, toWords(Pipeline::readFile(compFilepath)), pipelineLayout } {}
+
+    ComputePipeline::ComputePipeline(Device& device, const std::vector<uint32_t>& compCode, VkPipelineLayout pipelineLayout)
+        : device{ device } {
+        assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = compCode.size() * sizeof(uint32_t);
+        moduleInfo.pCode = compCode.data();
+
+        // the module is not needed once the pipeline exists
+        VkShaderModule compShaderModule;
+        if (vkCreateShaderModule(device.device(), &moduleInfo, nullptr, &compShaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shader module");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = compShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+
+        VkResult result = vkCreateComputePipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline);
+        vkDestroyShaderModule(device.device(), compShaderModule, nullptr);
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline");
+        }
+    }
+
+    ComputePipeline::~ComputePipeline() { vkDestroyPipeline(device.device(), computePipeline, nullptr); }
+
+    void ComputePipeline::bind(VkCommandBuffer commandBuffer) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    }
+
+    void Pipeline::setRenderTarget(PipelineConfigInfo& configInfo, const RenderTargetInfo& renderTarget) {
+        configInfo.renderPass = renderTarget.renderPass;
+        configInfo.colorAttachmentFormat = renderTarget.colorFormat;
+        configInfo.depthAttachmentFormat = renderTarget.depthFormat;
+    }
+
     void Pipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
+        configInfo.bindingDescriptions = Model::Vertex::getBindingDescription();
+        configInfo.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+
         configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         configInfo.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
@@ -201,4 +327,28 @@ namespace LeMU {
         configInfo.dynamicStateInfo.flags = 0;
     }
 
+    void Pipeline::copyConfigInfo(const PipelineConfigInfo& source, PipelineConfigInfo& destination) {
+        destination.viewportInfo = source.viewportInfo;
+        destination.inputAssemblyInfo = source.inputAssemblyInfo;
+        destination.rasterizationInfo = source.rasterizationInfo;
+        destination.multisampleInfo = source.multisampleInfo;
+        destination.colorBlendAttachment = source.colorBlendAttachment;
+        destination.colorBlendInfo = source.colorBlendInfo;
+        destination.depthStencilInfo = source.depthStencilInfo;
+        destination.dynamicStateEnables = source.dynamicStateEnables;
+        destination.dynamicStateInfo = source.dynamicStateInfo;
+        destination.pipelineLayout = source.pipelineLayout;
+        destination.renderPass = source.renderPass;
+        destination.subpass = source.subpass;
+        destination.colorAttachmentFormat = source.colorAttachmentFormat;
+        destination.depthAttachmentFormat = source.depthAttachmentFormat;
+        destination.bindingDescriptions = source.bindingDescriptions;
+        destination.attributeDescriptions = source.attributeDescriptions;
+        destination.specialization = source.specialization;
+
+        // blend attachments somewhere else are shared, they have to outlive the copy
+        if (source.colorBlendInfo.pAttachments == &source.colorBlendAttachment)
+            destination.colorBlendInfo.pAttachments = &destination.colorBlendAttachment;
+        destination.dynamicStateInfo.pDynamicStates = destination.dynamicStateEnables.data();
+    }
 }  // namespace lve
\ No newline at end of file
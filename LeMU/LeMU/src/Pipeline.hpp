@@ -8,6 +8,28 @@
 
 namespace LeMU {
 
+    // what a pipeline renders into: a render pass on the legacy path,
+    // or only the attachment formats with dynamic rendering (renderPass is VK_NULL_HANDLE).
+    // colorFormat VK_FORMAT_UNDEFINED renders depth only
+    struct RenderTargetInfo {
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    };
+
+    // specialization constant values, handed to every stage of a pipeline. Stages ignore ids they
+    // don't declare. Every constant is 4 bytes, a GLSL bool constant takes a VkBool32
+    struct ShaderSpecialization {
+        std::vector<VkSpecializationMapEntry> entries;
+        std::vector<uint32_t> data;
+
+        void setBool(uint32_t constantId, bool value);
+        void setUint(uint32_t constantId, uint32_t value);
+        void setFloat(uint32_t constantId, float value);
+
+        inline bool empty() const { return entries.empty(); }
+    };
+
     struct PipelineConfigInfo {
         PipelineConfigInfo(const PipelineConfigInfo&) = delete;
         PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
@@ -25,6 +47,17 @@ namespace LeMU {
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+
+        // dynamic rendering, used when renderPass is VK_NULL_HANDLE
+        VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
+        VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+        // vertex input, the default is Model::Vertex at binding 0
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+
+        // nothing by default, the shaders use their declared default values
+        ShaderSpecialization specialization;
     };
 
     class Pipeline {
@@ -34,6 +67,13 @@ namespace LeMU {
             const std::string& vertFilepath,
             const std::string& fragFilepath,
             const PipelineConfigInfo& configInfo);
+
+        // from SPIR-V already in memory, e.g. from the ShaderCompiler
+        Pipeline(
+            Device& device,
+            const std::vector<uint32_t>& vertCode,
+            const std::vector<uint32_t>& fragCode,
+            const PipelineConfigInfo& configInfo);
         ~Pipeline();
 
         Pipeline(const Pipeline&) = delete;
@@ -41,21 +81,50 @@ namespace LeMU {
 
         void bind(VkCommandBuffer commandBuffer);
 
+        // exchange the compiled pipeline and shader modules with other. Whoever holds this object
+        // binds the other's pipeline from then on, used to swap in a reloaded pipeline
+        void swap(Pipeline& other);
+
         static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
-    private:
+        // PipelineConfigInfo points into itself, the copy points into destination instead
+        static void copyConfigInfo(const PipelineConfigInfo& source, PipelineConfigInfo& destination);
+
+        // fill render pass or attachment formats of configInfo
+        static void setRenderTarget(PipelineConfigInfo& configInfo, const RenderTargetInfo& renderTarget);
+
         static std::vector<char> readFile(const std::string& filepath);
 
+    private:
+
         void createGraphicsPipeline(
-            const std::string& vertFilepath,
-            const std::string& fragFilepath,
+            const std::vector<uint32_t>& vertCode,
+            const std::vector<uint32_t>& fragCode,
             const PipelineConfigInfo& configInfo);
 
-        void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+        void createShaderModule(const std::vector<uint32_t>& code, VkShaderModule* shaderModule);
 
         Device& device;
         VkPipeline graphicsPipeline;
         VkShaderModule vertShaderModule;
         VkShaderModule fragShaderModule;
     };
+
+
+
+    class ComputePipeline {
+    public:
+        ComputePipeline(Device& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+        ComputePipeline(Device& device, const std::vector<uint32_t>& compCode, VkPipelineLayout pipelineLayout);
+        ~ComputePipeline();
+
+        ComputePipeline(const ComputePipeline&) = delete;
+        ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+        void bind(VkCommandBuffer commandBuffer);
+
+    private:
+        Device& device;
+        VkPipeline computePipeline;
+    };
 }  // namespace lve
\ No newline at end of file
@@ -0,0 +1,593 @@
+#include "pch.h"
+
+#include "PipelineCache.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace LeMU {
+
+    namespace {
+
+        inline void hashCombine(size_t& seed, size_t value) {
+            seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+
+        // appends the 32-bit words of a key
+        class KeyWriter {
+        public:
+            KeyWriter(std::vector<uint32_t>& words) : words{ words } {}
+
+            void add(uint32_t value) { words.push_back(value); }
+
+            void add(float value) {
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                words.push_back(bits);
+            }
+
+            // dispatchable and non-dispatchable handles are pointers or uint64_t depending on the platform
+            template <typename Handle>
+            void addHandle(Handle handle) {
+                uint64_t bits = 0;
+                std::memcpy(&bits, &handle, sizeof(handle));
+                words.push_back(static_cast<uint32_t>(bits));
+                words.push_back(static_cast<uint32_t>(bits >> 32));
+            }
+
+            void add(const VkStencilOpState& state) {
+                add(static_cast<uint32_t>(state.failOp));
+                add(static_cast<uint32_t>(state.passOp));
+                add(static_cast<uint32_t>(state.depthFailOp));
+                add(static_cast<uint32_t>(state.compareOp));
+                add(state.compareMask);
+                add(state.writeMask);
+                add(state.reference);
+            }
+
+        private:
+            std::vector<uint32_t>& words;
+        };
+
+        std::unique_ptr<PipelineConfigInfo> copyConfigInfo(const PipelineConfigInfo& source) {
+            // the config has no default constructor for make_unique, it is an aggregate
+            std::unique_ptr<PipelineConfigInfo> copy{ new PipelineConfigInfo{} };
+            Pipeline::copyConfigInfo(source, *copy);
+            return copy;
+        }
+    }
+
+
+
+    // JobSystem counts the calling thread as one of its threads, it never runs a job here since
+    // the cache only submits
+    PipelineCache::PipelineCache(Device& device, ShaderCompiler& shaderCompiler, uint32_t compileThreadCount)
+        : device{ device }, shaderCompiler{ shaderCompiler }, compileJobs{ std::make_unique<JobSystem>(compileThreadCount + 1) } {
+        assert(compileThreadCount > 0 && "async compiles need at least one compile thread");
+    }
+
+    PipelineCache::~PipelineCache() {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            shuttingDown = true;
+        }
+        compileJobs.reset();
+
+        readyReloads.clear();
+        pipelines.clear();
+        for (auto& entry : pipelineLayouts)
+            vkDestroyPipelineLayout(device.device(), entry.second, nullptr);
+    }
+
+
+
+    bool PipelineCache::PipelineKey::operator==(const PipelineKey& other) const {
+        return state == other.state && vertFilepath == other.vertFilepath && fragFilepath == other.fragFilepath;
+    }
+
+    size_t PipelineCache::PipelineKeyHash::operator()(const PipelineKey& key) const {
+        size_t seed = std::hash<std::string>()(key.vertFilepath);
+        hashCombine(seed, std::hash<std::string>()(key.fragFilepath));
+        for (uint32_t word : key.state) hashCombine(seed, word);
+        return seed;
+    }
+
+
+
+    PipelineCache::PipelineKey PipelineCache::makeKey(
+        const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo) {
+        assert(configInfo.multisampleInfo.pSampleMask == nullptr && "sample masks are not part of the pipeline key");
+        assert(configInfo.viewportInfo.pViewports == nullptr && configInfo.viewportInfo.pScissors == nullptr &&
+            "static viewports are not part of the pipeline key, make them dynamic");
+
+        PipelineKey key{ vertFilepath, fragFilepath, {} };
+        KeyWriter writer{ key.state };
+
+        // the counts keep variable length lists from running into each other. Constants are sorted
+        // by id, the order they were set in makes no difference to the pipeline
+        const auto& specialization = configInfo.specialization;
+        std::vector<std::pair<uint32_t, uint32_t>> constants;
+        for (const auto& entry : specialization.entries)
+            constants.emplace_back(entry.constantID, specialization.data[entry.offset / sizeof(uint32_t)]);
+        std::sort(constants.begin(), constants.end());
+
+        writer.add(static_cast<uint32_t>(constants.size()));
+        for (const auto& constant : constants) {
+            writer.add(constant.first);
+            writer.add(constant.second);
+        }
+
+        writer.add(static_cast<uint32_t>(configInfo.bindingDescriptions.size()));
+        for (const auto& binding : configInfo.bindingDescriptions) {
+            writer.add(binding.binding);
+            writer.add(binding.stride);
+            writer.add(static_cast<uint32_t>(binding.inputRate));
+        }
+
+        writer.add(static_cast<uint32_t>(configInfo.attributeDescriptions.size()));
+        for (const auto& attribute : configInfo.attributeDescriptions) {
+            writer.add(attribute.location);
+            writer.add(attribute.binding);
+            writer.add(static_cast<uint32_t>(attribute.format));
+            writer.add(attribute.offset);
+        }
+
+        writer.add(static_cast<uint32_t>(configInfo.inputAssemblyInfo.topology));
+        writer.add(configInfo.inputAssemblyInfo.primitiveRestartEnable);
+
+        writer.add(configInfo.viewportInfo.viewportCount);
+        writer.add(configInfo.viewportInfo.scissorCount);
+
+        const auto& raster = configInfo.rasterizationInfo;
+        writer.add(raster.depthClampEnable);
+        writer.add(raster.rasterizerDiscardEnable);
+        writer.add(static_cast<uint32_t>(raster.polygonMode));
+        writer.add(raster.cullMode);
+        writer.add(static_cast<uint32_t>(raster.frontFace));
+        writer.add(raster.depthBiasEnable);
+        writer.add(raster.depthBiasConstantFactor);
+        writer.add(raster.depthBiasClamp);
+        writer.add(raster.depthBiasSlopeFactor);
+        writer.add(raster.lineWidth);
+
+        const auto& multisample = configInfo.multisampleInfo;
+        writer.add(static_cast<uint32_t>(multisample.rasterizationSamples));
+        writer.add(multisample.sampleShadingEnable);
+        writer.add(multisample.minSampleShading);
+        writer.add(multisample.alphaToCoverageEnable);
+        writer.add(multisample.alphaToOneEnable);
+
+        const auto& blend = configInfo.colorBlendInfo;
+        writer.add(blend.logicOpEnable);
+        writer.add(static_cast<uint32_t>(blend.logicOp));
+        writer.add(blend.attachmentCount);
+        for (uint32_t i = 0; i < blend.attachmentCount; i++) {
+            const auto& attachment = blend.pAttachments[i];
+            writer.add(attachment.blendEnable);
+            writer.add(static_cast<uint32_t>(attachment.srcColorBlendFactor));
+            writer.add(static_cast<uint32_t>(attachment.dstColorBlendFactor));
+            writer.add(static_cast<uint32_t>(attachment.colorBlendOp));
+            writer.add(static_cast<uint32_t>(attachment.srcAlphaBlendFactor));
+            writer.add(static_cast<uint32_t>(attachment.dstAlphaBlendFactor));
+            writer.add(static_cast<uint32_t>(attachment.alphaBlendOp));
+            writer.add(attachment.colorWriteMask);
+        }
+        for (float constant : blend.blendConstants) writer.add(constant);
+
+        const auto& depth = configInfo.depthStencilInfo;
+        writer.add(depth.depthTestEnable);
+        writer.add(depth.depthWriteEnable);
+        writer.add(static_cast<uint32_t>(depth.depthCompareOp));
+        writer.add(depth.depthBoundsTestEnable);
+        writer.add(depth.stencilTestEnable);
+        writer.add(depth.front);
+        writer.add(depth.back);
+        writer.add(depth.minDepthBounds);
+        writer.add(depth.maxDepthBounds);
+
+        writer.add(static_cast<uint32_t>(configInfo.dynamicStateEnables.size()));
+        for (auto state : configInfo.dynamicStateEnables) writer.add(static_cast<uint32_t>(state));
+
+        writer.addHandle(configInfo.pipelineLayout);
+        writer.addHandle(configInfo.renderPass);
+        writer.add(configInfo.subpass);
+        writer.add(static_cast<uint32_t>(configInfo.colorAttachmentFormat));
+        writer.add(static_cast<uint32_t>(configInfo.depthAttachmentFormat));
+
+        return key;
+    }
+
+
+
+    std::shared_ptr<Pipeline> PipelineCache::compile(
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        const PipelineConfigInfo& configInfo,
+        float& milliseconds) {
+        // a source missing the SPIR-V cache is compiled here too, on whichever thread compiles the pipeline
+        auto start = std::chrono::high_resolution_clock::now();
+        auto pipeline = std::make_shared<Pipeline>(
+            device, shaderCompiler.load(vertFilepath), shaderCompiler.load(fragFilepath), configInfo);
+        milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        return pipeline;
+    }
+
+
+
+    std::shared_ptr<Pipeline> PipelineCache::getPipeline(
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        const PipelineConfigInfo& configInfo) {
+        PipelineKey key = makeKey(vertFilepath, fragFilepath, configInfo);
+
+        std::unique_lock<std::mutex> lock{ mutex };
+        stats.requests++;
+
+        // another thread compiling the same state, async or not, is waited for instead of compiling it twice
+        while (true) {
+            auto found = pipelines.find(key);
+            if (found != pipelines.end()) return found->second.pipeline;
+            if (compilingKeys.count(key) == 0) break;
+            compileFinished.wait(lock);
+        }
+
+        // compile without the lock so other threads keep getting their pipelines meanwhile
+        compilingKeys.insert(key);
+        lock.unlock();
+
+        std::shared_ptr<Pipeline> pipeline;
+        float milliseconds = 0.0f;
+        try {
+            pipeline = compile(vertFilepath, fragFilepath, configInfo, milliseconds);
+        } catch (...) {
+            lock.lock();
+            compilingKeys.erase(key);
+            lock.unlock();
+            compileFinished.notify_all();
+            throw;
+        }
+
+        lock.lock();
+        compilingKeys.erase(key);
+        stats.created++;
+        stats.creationMilliseconds += milliseconds;
+        stats.slowestMilliseconds = std::max(stats.slowestMilliseconds, milliseconds);
+        pipelines.emplace(std::move(key), Entry{ pipeline, copyConfigInfo(configInfo) });
+        lock.unlock();
+
+        compileFinished.notify_all();
+        return pipeline;
+    }
+
+
+
+    std::shared_ptr<Pipeline> PipelineCache::getPipelineAsync(
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        const ConfigureFunction& configure) {
+        PipelineConfigInfo configInfo{};
+        Pipeline::defaultPipelineConfigInfo(configInfo);
+        configure(configInfo);
+        PipelineKey key = makeKey(vertFilepath, fragFilepath, configInfo);
+
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        // polls of a compile in flight are not counted as requests
+        auto found = pipelines.find(key);
+        if (found != pipelines.end()) {
+            stats.requests++;
+            return found->second.pipeline;
+        }
+        if (compilingKeys.count(key) != 0 || failedKeys.count(key) != 0) return nullptr;
+
+        stats.requests++;
+        stats.queued++;
+        stats.maxQueued = std::max(stats.maxQueued, stats.queued);
+        compilingKeys.insert(key);
+
+        // the config holds pointers into itself, the compile thread builds its own copy
+        auto requestTime = std::chrono::high_resolution_clock::now();
+        compileJobs->submit([this, key = std::move(key), configure, requestTime]() mutable {
+            compileAsync(std::move(key), std::move(configure), requestTime);
+        });
+        return nullptr;
+    }
+
+
+
+    void PipelineCache::compileAsync(
+        PipelineKey key,
+        ConfigureFunction configure,
+        std::chrono::high_resolution_clock::time_point requestTime) {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            if (shuttingDown) return;
+        }
+
+        PipelineConfigInfo configInfo{};
+        Pipeline::defaultPipelineConfigInfo(configInfo);
+        configure(configInfo);
+        assert(makeKey(key.vertFilepath, key.fragFilepath, configInfo) == key &&
+            "configure function gave a different config on the compile thread");
+
+        std::shared_ptr<Pipeline> pipeline;
+        float milliseconds = 0.0f;
+        try {
+            pipeline = compile(key.vertFilepath, key.fragFilepath, configInfo, milliseconds);
+        } catch (const std::exception& e) {
+            std::cerr << "failed to compile pipeline " << key.vertFilepath << " + " << key.fragFilepath
+                << ": " << e.what() << std::endl;
+        }
+
+        float latency = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - requestTime).count();
+
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            compilingKeys.erase(key);
+            stats.queued--;
+
+            if (pipeline) {
+                stats.created++;
+                stats.asyncCreated++;
+                stats.creationMilliseconds += milliseconds;
+                stats.slowestMilliseconds = std::max(stats.slowestMilliseconds, milliseconds);
+                stats.asyncLatencyMilliseconds += latency;
+                stats.slowestAsyncLatencyMilliseconds = std::max(stats.slowestAsyncLatencyMilliseconds, latency);
+                pipelines.emplace(std::move(key), Entry{ pipeline, copyConfigInfo(configInfo) });
+            } else {
+                stats.failed++;
+                failedKeys.insert(std::move(key));
+            }
+        }
+        compileFinished.notify_all();
+    }
+
+
+
+    void PipelineCache::reloadShaders(const std::vector<std::string>& changedFiles) {
+        if (changedFiles.empty()) return;
+
+        std::unordered_set<std::string> sources = shaderCompiler.getDependents(changedFiles);
+        auto usesChangedSource = [&](const PipelineKey& key) {
+            return sources.count(ShaderCompiler::normalizePath(key.vertFilepath)) != 0 ||
+                sources.count(ShaderCompiler::normalizePath(key.fragFilepath)) != 0;
+        };
+
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        // failed async compiles get another try with the new sources
+        for (auto it = failedKeys.begin(); it != failedKeys.end();) {
+            if (usesChangedSource(*it)) it = failedKeys.erase(it);
+            else ++it;
+        }
+
+        // elements of an unordered_map stay where they are when it grows, the jobs can keep pointers
+        for (auto& cached : pipelines) {
+            if (!usesChangedSource(cached.first)) continue;
+
+            const PipelineKey* key = &cached.first;
+            Entry* entry = &cached.second;
+            uint64_t generation = ++entry->reloadGeneration;
+
+            stats.queued++;
+            stats.maxQueued = std::max(stats.maxQueued, stats.queued);
+            compileJobs->submit([this, key, entry, generation]() { reloadPipeline(*key, *entry, generation); });
+        }
+    }
+
+
+
+    void PipelineCache::reloadPipeline(const PipelineKey& key, Entry& entry, uint64_t generation) {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            if (shuttingDown) return;
+        }
+
+        // the entry's config is never written after the entry was added
+        PipelineConfigInfo configInfo{};
+        Pipeline::copyConfigInfo(*entry.configInfo, configInfo);
+
+        std::shared_ptr<Pipeline> replacement;
+        float milliseconds = 0.0f;
+        try {
+            replacement = compile(key.vertFilepath, key.fragFilepath, configInfo, milliseconds);
+        } catch (const std::exception& e) {
+            std::cerr << "failed to reload pipeline " << key.vertFilepath << " + " << key.fragFilepath
+                << ", keeping the old one: " << e.what() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        stats.queued--;
+
+        if (!replacement) {
+            stats.reloadFailures++;
+            return;
+        }
+
+        stats.creationMilliseconds += milliseconds;
+        stats.slowestMilliseconds = std::max(stats.slowestMilliseconds, milliseconds);
+        readyReloads.push_back({ &entry, generation, std::move(replacement) });
+    }
+
+
+
+    size_t PipelineCache::applyReloads(const std::function<void(std::shared_ptr<Pipeline>)>& retire) {
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        size_t applied = 0;
+        for (auto& reload : readyReloads) {
+            // a reload finishing after a newer one was swapped in is stale
+            if (reload.generation > reload.entry->appliedGeneration) {
+                reload.entry->pipeline->swap(*reload.replacement);
+                reload.entry->appliedGeneration = reload.generation;
+                stats.reloaded++;
+                applied++;
+            }
+
+            // after the swap the replacement holds the old pipeline
+            retire(std::move(reload.replacement));
+        }
+        readyReloads.clear();
+
+        return applied;
+    }
+
+
+
+    VkPipelineLayout PipelineCache::getPipelineLayout(
+        const std::vector<VkDescriptorSetLayout>& setLayouts,
+        const std::vector<VkPushConstantRange>& pushConstantRanges) {
+        std::vector<uint64_t> key;
+        key.push_back(setLayouts.size());
+        for (auto setLayout : setLayouts) {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &setLayout, sizeof(setLayout));
+            key.push_back(bits);
+        }
+        for (const auto& range : pushConstantRanges) {
+            key.push_back(range.stageFlags);
+            key.push_back((static_cast<uint64_t>(range.offset) << 32) | range.size);
+        }
+
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        auto found = pipelineLayouts.find(key);
+        if (found != pipelineLayouts.end()) return found->second;
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+        pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+        VkPipelineLayout pipelineLayout;
+        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        pipelineLayouts.emplace(std::move(key), pipelineLayout);
+        return pipelineLayout;
+    }
+
+
+
+    PipelineCache::Stats PipelineCache::getStats() const {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return stats;
+    }
+
+    void PipelineCache::resetStats() {
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        // compiles still queued stay counted
+        size_t queued = stats.queued;
+        stats = {};
+        stats.queued = queued;
+        stats.maxQueued = queued;
+    }
+
+    void PipelineCache::printStats(const std::string& label) const {
+        Stats current = getStats();
+        std::cout << label << ": " << current.created << " pipelines created"
+            << ", " << current.requests - current.created << " of " << current.requests << " requests shared"
+            << ", " << current.creationMilliseconds << " ms compiling"
+            << ", slowest " << current.slowestMilliseconds << " ms" << std::endl;
+
+        if (current.reloaded > 0 || current.reloadFailures > 0)
+            std::cout << label << " reloads: " << current.reloaded << " pipelines swapped"
+                << ", " << current.reloadFailures << " kept after compile errors" << std::endl;
+
+        if (current.asyncCreated == 0 && current.maxQueued == 0 && current.failed == 0) return;
+
+        float averageLatency = current.asyncCreated > 0
+            ? current.asyncLatencyMilliseconds / current.asyncCreated : 0.0f;
+        std::cout << label << " async: " << current.asyncCreated << " compiled"
+            << ", " << current.failed << " failed"
+            << ", queue depth " << current.queued << " (max " << current.maxQueued << ")"
+            << ", latency avg " << averageLatency << " ms"
+            << ", slowest " << current.slowestAsyncLatencyMilliseconds << " ms" << std::endl;
+    }
+
+    size_t PipelineCache::size() const {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return pipelines.size();
+    }
+
+
+
+    PipelinePermutations::PipelinePermutations(
+        PipelineCache& pipelineCache,
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        uint32_t featureBitCount,
+        ConfigureFunction configure)
+        : pipelineCache{ pipelineCache },
+          vertFilepath{ vertFilepath },
+          fragFilepath{ fragFilepath },
+          featureBitCount{ featureBitCount },
+          configure{ std::move(configure) } {
+        assert(featureBitCount <= 32 && "a feature mask has at most 32 bits");
+    }
+
+    void PipelinePermutations::setFeatureConstants(
+        PipelineConfigInfo& configInfo, uint32_t featureBitCount, uint32_t features) {
+        for (uint32_t bit = 0; bit < featureBitCount; bit++)
+            configInfo.specialization.setBool(bit, (features >> bit) & 1);
+    }
+
+    Pipeline& PipelinePermutations::get(uint32_t features) {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            auto found = pipelines.find(features);
+            if (found != pipelines.end()) return *found->second;
+        }
+
+        assert((featureBitCount == 32 || (features >> featureBitCount) == 0) && "feature bit outside the permutation's features");
+
+        PipelineConfigInfo configInfo{};
+        Pipeline::defaultPipelineConfigInfo(configInfo);
+        configure(configInfo, features);
+        setFeatureConstants(configInfo, featureBitCount, features);
+
+        // compiled without the lock so other threads keep getting the permutations that are ready. A second
+        // thread asking for this one waits in the pipeline cache for the first one's compile
+        auto pipeline = pipelineCache.getPipeline(vertFilepath, fragFilepath, configInfo);
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        return *pipelines.emplace(features, pipeline).first->second;
+    }
+
+    Pipeline* PipelinePermutations::tryGet(uint32_t features) {
+        std::lock_guard<std::mutex> lock{ mutex };
+
+        auto found = pipelines.find(features);
+        if (found != pipelines.end()) return found->second.get();
+
+        assert((featureBitCount == 32 || (features >> featureBitCount) == 0) && "feature bit outside the permutation's features");
+
+        // captured by value, the compile may finish after these permutations are gone
+        auto pipeline = pipelineCache.getPipelineAsync(vertFilepath, fragFilepath,
+            [configure = configure, featureBitCount = featureBitCount, features](PipelineConfigInfo& configInfo) {
+                configure(configInfo, features);
+                setFeatureConstants(configInfo, featureBitCount, features);
+            });
+        if (!pipeline) return nullptr;
+
+        pipelines.emplace(features, pipeline);
+        return pipeline.get();
+    }
+
+    size_t PipelinePermutations::size() const {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return pipelines.size();
+    }
+}  // namespace lve
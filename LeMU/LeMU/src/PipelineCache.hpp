@@ -0,0 +1,204 @@
+#pragma once
+
+#include "Device.hpp"
+#include "JobSystem.hpp"
+#include "Pipeline.hpp"
+#include "ShaderCompiler.hpp"
+
+// std
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace LeMU {
+
+	// graphics pipelines keyed by their whole state: shaders, specialization, vertex layout, raster,
+	// blend, depth, dynamic states, layout and render target. Asking twice for the same state returns
+	// the same pipeline, whichever system asks. Pipelines live as long as the cache, a shader reload
+	// swaps what they hold in place. Layouts and render passes are part of the key by handle, so they
+	// have to outlive the cache too, which is why the cache also hands out pipeline layouts. Shader
+	// paths are GLSL sources or .spv files, either is loaded through the shader compiler.
+	// getPipelineAsync and reloads compile on the cache's own worker threads, not the frame's job system,
+	// whose calling thread picks up queued jobs while it waits and could end up compiling mid-frame
+	class PipelineCache {
+	public:
+		static constexpr uint32_t DEFAULT_COMPILE_THREADS = 2;
+
+		struct Stats {
+			size_t requests = 0;				// getPipeline and getPipelineAsync calls
+			size_t created = 0;					// pipelines compiled, the other requests were shared
+			float creationMilliseconds = 0.0f;	// total compile time
+			float slowestMilliseconds = 0.0f;
+
+			size_t queued = 0;					// async compiles waiting or running right now
+			size_t maxQueued = 0;				// deepest the async queue got
+			size_t asyncCreated = 0;			// pipelines compiled by getPipelineAsync
+			size_t failed = 0;					// async compiles that threw, never retried
+			float asyncLatencyMilliseconds = 0.0f;	// total time from the first request to ready
+			float slowestAsyncLatencyMilliseconds = 0.0f;
+
+			size_t reloaded = 0;				// pipelines swapped for ones built from changed shaders
+			size_t reloadFailures = 0;			// reloads that did not compile, the old pipeline stayed
+		};
+
+		// fills the config of an async request, default values already set. Runs once on the
+		// requesting thread for the key and again on a compile thread, so it must capture by value
+		using ConfigureFunction = std::function<void(PipelineConfigInfo &configInfo)>;
+
+		PipelineCache(Device &device, ShaderCompiler &shaderCompiler, uint32_t compileThreadCount = DEFAULT_COMPILE_THREADS);
+		~PipelineCache();
+
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache& operator=(const PipelineCache&) = delete;
+
+		// safe to call from recording threads, a pipeline not in the cache yet is compiled on the
+		// calling thread. configInfo.pipelineLayout should come from getPipelineLayout
+		std::shared_ptr<Pipeline> getPipeline(
+			const std::string &vertFilepath,
+			const std::string &fragFilepath,
+			const PipelineConfigInfo &configInfo);
+
+		// never blocks on a compile: returns the pipeline if it is ready, otherwise queues its compile
+		// on the compile threads, if not queued yet, and returns nullptr until it is done. Callers draw
+		// with a fallback pipeline or skip the draw meanwhile. A pipeline that failed to compile keeps
+		// returning nullptr
+		std::shared_ptr<Pipeline> getPipelineAsync(
+			const std::string &vertFilepath,
+			const std::string &fragFilepath,
+			const ConfigureFunction &configure);
+
+		// rebuild, on the compile threads, every cached pipeline using one of the changed files as
+		// its shader or through an #include. Returns right away. A shader that does not compile
+		// is logged and its pipelines keep the old one
+		void reloadShaders(const std::vector<std::string> &changedFiles);
+
+		// swap the finished reloads into the pipelines handed out, every holder binds the new one
+		// from then on. Only at a frame boundary, while no thread records. Each replaced pipeline goes
+		// to retire, which keeps it alive until the frames that used it have completed. Returns the
+		// number of pipelines swapped
+		size_t applyReloads(const std::function<void(std::shared_ptr<Pipeline>)> &retire);
+
+		// one layout per distinct set layouts and push constant ranges, owned by the cache
+		VkPipelineLayout getPipelineLayout(
+			const std::vector<VkDescriptorSetLayout> &setLayouts,
+			const std::vector<VkPushConstantRange> &pushConstantRanges = {});
+
+		Stats getStats() const;
+		void resetStats();
+
+		// creations, shared requests, compile time and async queue since the last resetStats
+		void printStats(const std::string &label) const;
+
+		size_t size() const;
+
+	private:
+		struct PipelineKey {
+			std::string vertFilepath;
+			std::string fragFilepath;
+			std::vector<uint32_t> state;	// every other field of the config, flattened
+
+			bool operator==(const PipelineKey &other) const;
+		};
+
+		struct PipelineKeyHash {
+			size_t operator()(const PipelineKey &key) const;
+		};
+
+		struct Entry {
+			std::shared_ptr<Pipeline> pipeline;
+			std::unique_ptr<PipelineConfigInfo> configInfo;	// a copy, to rebuild the pipeline from on reload
+			uint64_t reloadGeneration = 0;	// newest reload asked for
+			uint64_t appliedGeneration = 0;	// newest reload swapped in
+		};
+
+		struct PendingReload {
+			Entry *entry;
+			uint64_t generation;
+			std::shared_ptr<Pipeline> replacement;
+		};
+
+		static PipelineKey makeKey(
+			const std::string &vertFilepath, const std::string &fragFilepath, const PipelineConfigInfo &configInfo);
+
+		// called without the lock held, milliseconds receives the compile time
+		std::shared_ptr<Pipeline> compile(
+			const std::string &vertFilepath,
+			const std::string &fragFilepath,
+			const PipelineConfigInfo &configInfo,
+			float &milliseconds);
+
+		void compileAsync(
+			PipelineKey key,
+			ConfigureFunction configure,
+			std::chrono::high_resolution_clock::time_point requestTime);
+
+		void reloadPipeline(const PipelineKey &key, Entry &entry, uint64_t generation);
+
+		Device &device;
+		ShaderCompiler &shaderCompiler;
+
+		mutable std::mutex mutex;
+		std::condition_variable compileFinished;	// a key left compilingKeys
+		std::unordered_map<PipelineKey, Entry, PipelineKeyHash> pipelines;	// never erased, reloads point into it
+		std::unordered_set<PipelineKey, PipelineKeyHash> compilingKeys;	// sync or async compile in flight
+		std::unordered_set<PipelineKey, PipelineKeyHash> failedKeys;
+		std::map<std::vector<uint64_t>, VkPipelineLayout> pipelineLayouts;
+		std::vector<PendingReload> readyReloads;
+		Stats stats{};
+		bool shuttingDown = false;	// queued compiles are dropped
+
+		// only ever submitted to, destroyed first so no compile outlives the maps above
+		std::unique_ptr<JobSystem> compileJobs;
+	};
+
+
+
+	// one pipeline per feature mask of the same pair of shaders, taken from the pipeline cache the first
+	// time its mask is asked for. Feature bit i becomes the bool specialization constant i, so the driver
+	// compiles the code of disabled features out instead of branching over it at runtime
+	class PipelinePermutations {
+	public:
+		// fills the config of one permutation, the feature constants are set after it returns.
+		// Further constants of its own need ids from featureBitCount on
+		using ConfigureFunction = std::function<void(PipelineConfigInfo &configInfo, uint32_t features)>;
+
+		PipelinePermutations(
+			PipelineCache &pipelineCache,
+			const std::string &vertFilepath,
+			const std::string &fragFilepath,
+			uint32_t featureBitCount,
+			ConfigureFunction configure);
+
+		PipelinePermutations(const PipelinePermutations&) = delete;
+		PipelinePermutations& operator=(const PipelinePermutations&) = delete;
+
+		// safe to call from recording threads, a permutation the cache doesn't have yet is compiled
+		// on the calling thread without blocking the threads getting other permutations. configure
+		// may run on several threads at once
+		Pipeline& get(uint32_t features);
+
+		// same without blocking, nullptr while the permutation compiles on the cache's compile threads
+		Pipeline* tryGet(uint32_t features);
+
+		size_t size() const;
+
+	private:
+		static void setFeatureConstants(PipelineConfigInfo &configInfo, uint32_t featureBitCount, uint32_t features);
+
+		PipelineCache &pipelineCache;
+		std::string vertFilepath;
+		std::string fragFilepath;
+		uint32_t featureBitCount;
+		ConfigureFunction configure;
+
+		mutable std::mutex mutex;
+		std::unordered_map<uint32_t, std::shared_ptr<Pipeline>> pipelines;
+	};
+}  // namespace lve
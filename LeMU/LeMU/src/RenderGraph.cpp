@@ -0,0 +1,709 @@
+#include "pch.h"
+
+#include "RenderGraph.hpp"
+
+#include "Renderer.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <stdexcept>
+
+namespace LeMU {
+
+    namespace {
+
+        struct AccessInfo {
+            VkPipelineStageFlags stage;
+            VkAccessFlags access;
+            VkImageLayout layout;
+            VkImageUsageFlags usage;
+        };
+
+        constexpr VkAccessFlags WRITE_ACCESS_MASK =
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        constexpr VkPipelineStageFlags FRAGMENT_TESTS_STAGES =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+        AccessInfo getAccessInfo(RGAccess access)
+        {
+            switch (access)
+            {
+            case RGAccess::ColorAttachmentWrite:
+                return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
+            case RGAccess::DepthAttachmentWrite:
+                return { FRAGMENT_TESTS_STAGES,
+                         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+            case RGAccess::DepthAttachmentRead:
+                return { FRAGMENT_TESTS_STAGES,
+                         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+            case RGAccess::FragmentShaderRead:
+                return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_ACCESS_SHADER_READ_BIT,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_IMAGE_USAGE_SAMPLED_BIT };
+            case RGAccess::ComputeShaderRead:
+                return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_ACCESS_SHADER_READ_BIT,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_IMAGE_USAGE_SAMPLED_BIT };
+            case RGAccess::ComputeShaderWrite:
+                return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                         VK_IMAGE_LAYOUT_GENERAL,
+                         VK_IMAGE_USAGE_STORAGE_BIT };
+            case RGAccess::TransferRead:
+                return { VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_ACCESS_TRANSFER_READ_BIT,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         VK_IMAGE_USAGE_TRANSFER_SRC_BIT };
+            case RGAccess::TransferWrite:
+                return { VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_ACCESS_TRANSFER_WRITE_BIT,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         VK_IMAGE_USAGE_TRANSFER_DST_BIT };
+            }
+            throw std::runtime_error("unknown render graph access!");
+        }
+    }
+
+
+
+    void RenderGraph::PassBuilder::read(RGResource resource, RGAccess access)
+    {
+        assert(resource < graph.resources.size() && "Render graph resource out of range");
+
+        auto& usages = graph.passes[passIndex].usages;
+        for (auto& usage : usages)
+            if (usage.resource == resource) return;     // already written by this pass, the write covers it
+
+        usages.push_back({ resource, access, false });
+        graph.resources[resource].usage |= getAccessInfo(access).usage;
+    }
+
+
+
+    void RenderGraph::PassBuilder::write(RGResource resource, RGAccess access)
+    {
+        assert(resource < graph.resources.size() && "Render graph resource out of range");
+
+        graph.resources[resource].usage |= getAccessInfo(access).usage;
+
+        // one usage per resource and pass, read-modify-write becomes a write
+        auto& usages = graph.passes[passIndex].usages;
+        for (auto& usage : usages) {
+            if (usage.resource == resource) {
+                usage.access = access;
+                usage.write = true;
+                return;
+            }
+        }
+        usages.push_back({ resource, access, true });
+    }
+
+
+
+    RenderGraph::RenderGraph(Device& device, Renderer& renderer) : device{device}, renderer{renderer} {}
+
+    RenderGraph::~RenderGraph() { releasePhysicalImages(); }
+
+
+
+    void RenderGraph::reset()
+    {
+        passes.clear();
+        resources.clear();
+        executionOrder.clear();
+        barrierBatches.clear();
+        compiled = false;
+    }
+
+
+
+    RGResource RenderGraph::createImage(const std::string& name, const RGImageDesc& desc)
+    {
+        Resource resource{};
+        resource.name = name;
+        resource.desc = desc;
+        resources.push_back(resource);
+        return static_cast<RGResource>(resources.size() - 1);
+    }
+
+
+
+    RGResource RenderGraph::importImage(
+        const std::string& name,
+        VkImage image,
+        VkImageView imageView,
+        VkImageAspectFlags aspect,
+        VkImageLayout initialLayout,
+        VkImageLayout finalLayout,
+        bool externalTransitions)
+    {
+        Resource resource{};
+        resource.name = name;
+        resource.desc.aspect = aspect;
+        resource.imported = true;
+        resource.externalTransitions = externalTransitions;
+        resource.initialLayout = initialLayout;
+        resource.finalLayout = finalLayout;
+        resource.image = image;
+        resource.imageView = imageView;
+        resources.push_back(resource);
+        return static_cast<RGResource>(resources.size() - 1);
+    }
+
+
+
+    RGResource RenderGraph::importSwapChainImage()
+    {
+        return importImage(
+            "swapchain",
+            renderer.getCurrentSwapChainImage(),
+            renderer.getCurrentSwapChainImageView(),
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            true);
+    }
+
+
+
+    void RenderGraph::addPass(
+        const std::string& name,
+        const std::function<void(PassBuilder&)>& setup,
+        std::function<void(VkCommandBuffer)>&& execute)
+    {
+        assert(!compiled && "Can't add passes to a compiled render graph, reset it first");
+
+        Pass pass{};
+        pass.name = name;
+        pass.execute = std::move(execute);
+        passes.push_back(std::move(pass));
+
+        PassBuilder builder{ *this, static_cast<uint32_t>(passes.size() - 1) };
+        setup(builder);
+        passes.back().sideEffects = builder.sideEffects;
+    }
+
+
+
+    void RenderGraph::compile()
+    {
+        assert(!compiled && "Render graph is already compiled");
+
+        sortPasses();
+        cullPasses();
+        computeLifetimes();
+        allocatePhysicalImages();
+        buildBarriers();
+
+        stats.passCount = static_cast<uint32_t>(passes.size());
+        stats.culledPassCount = static_cast<uint32_t>(passes.size() - executionOrder.size());
+        compiled = true;
+    }
+
+
+
+    // passes may be added in any order: writers of a resource run in the order they were added,
+    // readers run after all of its writers. Among ready passes the earliest added goes first
+    void RenderGraph::sortPasses()
+    {
+        std::vector<std::vector<uint32_t>> dependents(passes.size());
+        std::vector<uint32_t> dependencyCount(passes.size(), 0);
+
+        auto addEdge = [&](uint32_t from, uint32_t to) {
+            dependents[from].push_back(to);
+            dependencyCount[to]++;
+        };
+
+        std::vector<std::vector<uint32_t>> writers(resources.size());
+        for (uint32_t i = 0; i < passes.size(); i++)
+            for (auto& usage : passes[i].usages)
+                if (usage.write) writers[usage.resource].push_back(i);
+
+        for (auto& resourceWriters : writers)
+            for (size_t i = 1; i < resourceWriters.size(); i++)
+                addEdge(resourceWriters[i - 1], resourceWriters[i]);
+
+        for (uint32_t i = 0; i < passes.size(); i++)
+            for (auto& usage : passes[i].usages)
+                if (!usage.write && !writers[usage.resource].empty())
+                    addEdge(writers[usage.resource].back(), i);
+
+        std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+        for (uint32_t i = 0; i < passes.size(); i++)
+            if (dependencyCount[i] == 0) ready.push(i);
+
+        executionOrder.clear();
+        while (!ready.empty())
+        {
+            uint32_t pass = ready.top();
+            ready.pop();
+            executionOrder.push_back(pass);
+
+            for (uint32_t dependent : dependents[pass])
+                if (--dependencyCount[dependent] == 0) ready.push(dependent);
+        }
+
+        if (executionOrder.size() != passes.size())
+            throw std::runtime_error("render graph has a dependency cycle!");
+    }
+
+
+
+    // a pass survives if it has side effects, writes an imported image, or a surviving pass uses
+    // something it writes
+    void RenderGraph::cullPasses()
+    {
+        std::vector<uint32_t> position(passes.size());
+        for (uint32_t i = 0; i < executionOrder.size(); i++) position[executionOrder[i]] = i;
+
+        std::vector<std::vector<uint32_t>> writers(resources.size());
+        for (uint32_t pass : executionOrder)
+        {
+            passes[pass].alive = passes[pass].sideEffects;
+            for (auto& usage : passes[pass].usages)
+            {
+                if (!usage.write) continue;
+                writers[usage.resource].push_back(pass);
+                if (resources[usage.resource].imported) passes[pass].alive = true;
+            }
+        }
+
+        // walking backwards, every writer is visited after the passes that depend on it
+        for (auto it = executionOrder.rbegin(); it != executionOrder.rend(); ++it)
+        {
+            if (!passes[*it].alive) continue;
+            for (auto& usage : passes[*it].usages)
+                for (uint32_t writer : writers[usage.resource])
+                    if (position[writer] < position[*it]) passes[writer].alive = true;
+        }
+
+        executionOrder.erase(
+            std::remove_if(executionOrder.begin(), executionOrder.end(),
+                [&](uint32_t pass) { return !passes[pass].alive; }),
+            executionOrder.end());
+    }
+
+
+
+    void RenderGraph::computeLifetimes()
+    {
+        for (uint32_t i = 0; i < executionOrder.size(); i++)
+        {
+            for (auto& usage : passes[executionOrder[i]].usages)
+            {
+                auto& resource = resources[usage.resource];
+                resource.firstUse = std::min(resource.firstUse, i);
+                resource.lastUse = std::max(resource.lastUse, i);
+            }
+        }
+    }
+
+
+
+    // transient images are placed largest first into the first memory block none of whose images
+    // are alive at the same time. Images and memory are kept while the frame's transient resources
+    // stay the same, so in the steady state nothing is allocated
+    void RenderGraph::allocatePhysicalImages()
+    {
+        std::vector<RGResource> transients;
+        for (RGResource i = 0; i < resources.size(); i++)
+            if (!resources[i].imported && resources[i].firstUse != UINT32_MAX) transients.push_back(i);
+
+        bool reusable = transients.size() == physicalImages.size();
+        for (size_t i = 0; reusable && i < transients.size(); i++)
+        {
+            const auto& resource = resources[transients[i]];
+            const auto& physical = physicalImages[i];
+            reusable = resource.desc == physical.desc && resource.usage == physical.usage &&
+                resource.firstUse == physical.firstUse && resource.lastUse == physical.lastUse;
+        }
+
+        if (!reusable)
+        {
+            releasePhysicalImages();
+
+            std::vector<VkMemoryRequirements> requirements(transients.size());
+            physicalImages.resize(transients.size());
+            for (size_t i = 0; i < transients.size(); i++)
+            {
+                const auto& resource = resources[transients[i]];
+                auto& physical = physicalImages[i];
+                physical.desc = resource.desc;
+                physical.usage = resource.usage;
+                physical.firstUse = resource.firstUse;
+                physical.lastUse = resource.lastUse;
+
+                VkImageCreateInfo imageInfo{};
+                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageInfo.format = resource.desc.format;
+                imageInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+                imageInfo.mipLevels = 1;
+                imageInfo.arrayLayers = 1;
+                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.usage = resource.usage;
+                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+                if (vkCreateImage(device.device(), &imageInfo, nullptr, &physical.image) != VK_SUCCESS)
+                    throw std::runtime_error("failed to create render graph image!");
+
+                vkGetImageMemoryRequirements(device.device(), physical.image, &requirements[i]);
+                physical.size = requirements[i].size;
+            }
+
+            std::vector<size_t> placementOrder(transients.size());
+            for (size_t i = 0; i < placementOrder.size(); i++) placementOrder[i] = i;
+            std::stable_sort(placementOrder.begin(), placementOrder.end(),
+                [&](size_t a, size_t b) { return requirements[a].size > requirements[b].size; });
+
+            // images are bound at offset 0, the largest one decides the block size
+            std::vector<std::vector<size_t>> blockImages;
+            for (size_t i : placementOrder)
+            {
+                const auto& physical = physicalImages[i];
+                uint32_t block = 0;
+                for (; block < memoryBlocks.size(); block++)
+                {
+                    if (memoryBlocks[block].size < requirements[i].size) continue;
+                    if ((memoryBlocks[block].memoryTypeBits & requirements[i].memoryTypeBits) == 0) continue;
+
+                    bool overlaps = false;
+                    for (size_t other : blockImages[block])
+                        overlaps |= physical.firstUse <= physicalImages[other].lastUse &&
+                                    physicalImages[other].firstUse <= physical.lastUse;
+                    if (!overlaps) break;
+                }
+
+                if (block == memoryBlocks.size())
+                {
+                    MemoryBlock newBlock{};
+                    newBlock.size = requirements[i].size;
+                    newBlock.memoryTypeBits = requirements[i].memoryTypeBits;
+                    memoryBlocks.push_back(newBlock);
+                    blockImages.emplace_back();
+                }
+
+                memoryBlocks[block].memoryTypeBits &= requirements[i].memoryTypeBits;
+                blockImages[block].push_back(i);
+                physicalImages[i].memoryBlock = block;
+            }
+
+            for (auto& block : memoryBlocks)
+            {
+                VkMemoryAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                allocInfo.allocationSize = block.size;
+                allocInfo.memoryTypeIndex = device.findMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+                if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &block.memory) != VK_SUCCESS)
+                    throw std::runtime_error("failed to allocate render graph memory!");
+            }
+
+            for (auto& physical : physicalImages)
+            {
+                if (vkBindImageMemory(device.device(), physical.image, memoryBlocks[physical.memoryBlock].memory, 0) != VK_SUCCESS)
+                    throw std::runtime_error("failed to bind render graph image memory!");
+
+                VkImageViewCreateInfo viewInfo{};
+                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                viewInfo.image = physical.image;
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                viewInfo.format = physical.desc.format;
+                viewInfo.subresourceRange = { physical.desc.aspect, 0, 1, 0, 1 };
+
+                if (vkCreateImageView(device.device(), &viewInfo, nullptr, &physical.imageView) != VK_SUCCESS)
+                    throw std::runtime_error("failed to create render graph image view!");
+            }
+
+            stats.transientImageCount = static_cast<uint32_t>(physicalImages.size());
+            stats.memoryBlockCount = static_cast<uint32_t>(memoryBlocks.size());
+            stats.transientMemory = 0;
+            stats.unaliasedMemory = 0;
+            for (auto& block : memoryBlocks) stats.transientMemory += block.size;
+            for (auto& physical : physicalImages) stats.unaliasedMemory += physical.size;
+        }
+
+        for (size_t i = 0; i < transients.size(); i++)
+        {
+            auto& resource = resources[transients[i]];
+            resource.physicalIndex = static_cast<int>(i);
+            resource.image = physicalImages[i].image;
+            resource.imageView = physicalImages[i].imageView;
+        }
+    }
+
+
+
+    void RenderGraph::buildBarriers()
+    {
+        struct ResourceState {
+            VkImageLayout layout;
+            VkPipelineStageFlags writeStages;       // stages of the last write (or layout transition)
+            VkAccessFlags writeAccess;
+            VkPipelineStageFlags readStages;        // stages that have read since, or already see the write
+            bool touched = false;
+        };
+
+        // previous contents of an aliased block belong to whatever image used it last, possibly in
+        // the previous frame, so the first use of an image waits for every stage that touches the block
+        for (auto& block : memoryBlocks) { block.stages = 0; block.writeAccess = 0; }
+        for (uint32_t pass : executionOrder)
+        {
+            for (auto& usage : passes[pass].usages)
+            {
+                const auto& resource = resources[usage.resource];
+                if (resource.physicalIndex < 0) continue;
+
+                AccessInfo info = getAccessInfo(usage.access);
+                auto& block = memoryBlocks[physicalImages[resource.physicalIndex].memoryBlock];
+                block.stages |= info.stage;
+                block.writeAccess |= (info.access & WRITE_ACCESS_MASK);
+            }
+        }
+
+        std::vector<ResourceState> states(resources.size());
+        for (RGResource i = 0; i < resources.size(); i++)
+        {
+            auto& state = states[i];
+            const auto& resource = resources[i];
+            if (resource.imported) {
+                // unknown previous work outside the graph
+                state.layout = resource.initialLayout;
+                state.writeStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+                state.writeAccess = VK_ACCESS_MEMORY_WRITE_BIT;
+            }
+            else if (resource.physicalIndex >= 0) {
+                const auto& block = memoryBlocks[physicalImages[resource.physicalIndex].memoryBlock];
+                state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+                state.writeStages = block.stages;
+                state.writeAccess = block.writeAccess;
+            }
+            state.readStages = 0;
+        }
+
+        barrierBatches.clear();
+        stats.imageBarrierCount = 0;
+
+        for (uint32_t position = 0; position < executionOrder.size(); position++)
+        {
+            BarrierBatch batch{ position, {} };
+
+            for (auto& usage : passes[executionOrder[position]].usages)
+            {
+                if (resources[usage.resource].externalTransitions) continue;
+
+                AccessInfo info = getAccessInfo(usage.access);
+                auto& state = states[usage.resource];
+
+                bool layoutChange = state.layout != info.layout;
+                bool needsBarrier = !state.touched || layoutChange || usage.write || (info.stage & ~state.readStages) != 0;
+
+                if (needsBarrier)
+                {
+                    Barrier barrier{};
+                    barrier.resource = usage.resource;
+                    barrier.oldLayout = state.layout;
+                    barrier.newLayout = info.layout;
+                    barrier.srcStage = state.writeStages | state.readStages;
+                    barrier.srcAccess = state.writeAccess;
+                    barrier.dstStage = info.stage;
+                    barrier.dstAccess = info.access;
+                    if (barrier.srcStage == 0) barrier.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                    batch.barriers.push_back(barrier);
+                }
+
+                // a layout transition counts as a write, later readers have to wait for it
+                if (usage.write || layoutChange || !state.touched) {
+                    state.writeStages = info.stage;
+                    state.writeAccess = info.access & WRITE_ACCESS_MASK;
+                    state.readStages = usage.write ? 0 : info.stage;
+                }
+                else {
+                    state.readStages |= info.stage;
+                }
+                state.layout = info.layout;
+                state.touched = true;
+            }
+
+            if (!batch.barriers.empty()) {
+                stats.imageBarrierCount += static_cast<uint32_t>(batch.barriers.size());
+                barrierBatches.push_back(std::move(batch));
+            }
+        }
+
+        // leave imported images the way their owner expects them
+        BarrierBatch finalBatch{ UINT32_MAX, {} };
+        for (RGResource i = 0; i < resources.size(); i++)
+        {
+            const auto& resource = resources[i];
+            const auto& state = states[i];
+            if (!resource.imported || resource.externalTransitions || !state.touched) continue;
+            if (state.layout == resource.finalLayout) continue;
+
+            Barrier barrier{};
+            barrier.resource = i;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = resource.finalLayout;
+            barrier.srcStage = state.writeStages | state.readStages;
+            barrier.srcAccess = state.writeAccess;
+            barrier.dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+            barrier.dstAccess = 0;
+            finalBatch.barriers.push_back(barrier);
+        }
+        if (!finalBatch.barriers.empty()) {
+            stats.imageBarrierCount += static_cast<uint32_t>(finalBatch.barriers.size());
+            barrierBatches.push_back(std::move(finalBatch));
+        }
+
+        stats.barrierBatchCount = static_cast<uint32_t>(barrierBatches.size());
+    }
+
+
+
+    void RenderGraph::execute(VkCommandBuffer commandBuffer)
+    {
+        assert(compiled && "Render graph must be compiled before it is executed");
+
+        size_t nextBatch = 0;
+        for (uint32_t position = 0; position < executionOrder.size(); position++)
+        {
+            if (nextBatch < barrierBatches.size() && barrierBatches[nextBatch].beforePass == position)
+                recordBarriers(commandBuffer, barrierBatches[nextBatch++]);
+
+            passes[executionOrder[position]].execute(commandBuffer);
+        }
+
+        if (nextBatch < barrierBatches.size())
+            recordBarriers(commandBuffer, barrierBatches[nextBatch]);
+    }
+
+
+
+    // all barriers in front of a pass go out in a single call
+    void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch)
+    {
+#ifdef VK_KHR_synchronization2
+        if (device.getFeatures().synchronization2)
+        {
+            // per-barrier stage masks, no union of every source and destination stage
+            std::vector<VkImageMemoryBarrier2KHR> imageBarriers(batch.barriers.size());
+            for (size_t i = 0; i < batch.barriers.size(); i++)
+            {
+                const auto& barrier = batch.barriers[i];
+                const auto& resource = resources[barrier.resource];
+                auto& imageBarrier = imageBarriers[i];
+                imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+                imageBarrier.srcStageMask = barrier.srcStage;
+                imageBarrier.srcAccessMask = barrier.srcAccess;
+                imageBarrier.dstStageMask = barrier.dstStage;
+                imageBarrier.dstAccessMask = barrier.dstAccess;
+                imageBarrier.oldLayout = barrier.oldLayout;
+                imageBarrier.newLayout = barrier.newLayout;
+                imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageBarrier.image = resource.image;
+                imageBarrier.subresourceRange = { resource.desc.aspect, 0, 1, 0, 1 };
+            }
+
+            VkDependencyInfoKHR dependencyInfo{};
+            dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+            dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+            dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+
+            device.cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+            return;
+        }
+#endif
+
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<VkImageMemoryBarrier> imageBarriers(batch.barriers.size());
+        for (size_t i = 0; i < batch.barriers.size(); i++)
+        {
+            const auto& barrier = batch.barriers[i];
+            const auto& resource = resources[barrier.resource];
+            auto& imageBarrier = imageBarriers[i];
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.srcAccessMask = barrier.srcAccess;
+            imageBarrier.dstAccessMask = barrier.dstAccess;
+            imageBarrier.oldLayout = barrier.oldLayout;
+            imageBarrier.newLayout = barrier.newLayout;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = resource.image;
+            imageBarrier.subresourceRange = { resource.desc.aspect, 0, 1, 0, 1 };
+
+            srcStages |= barrier.srcStage;
+            dstStages |= barrier.dstStage;
+        }
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            srcStages, dstStages,
+            0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    }
+
+
+
+    VkImage RenderGraph::getImage(RGResource resource) const
+    {
+        assert(resource < resources.size() && "Render graph resource out of range");
+        return resources[resource].image;
+    }
+
+    VkImageView RenderGraph::getImageView(RGResource resource) const
+    {
+        assert(resource < resources.size() && "Render graph resource out of range");
+        return resources[resource].imageView;
+    }
+
+
+
+    // images may still be used by frames in flight
+    void RenderGraph::releasePhysicalImages()
+    {
+        if (physicalImages.empty() && memoryBlocks.empty()) return;
+
+        renderer.deferDestroy([device = &device, images = std::move(physicalImages), blocks = std::move(memoryBlocks)]() {
+            for (auto& physical : images) {
+                vkDestroyImageView(device->device(), physical.imageView, nullptr);
+                vkDestroyImage(device->device(), physical.image, nullptr);
+            }
+            for (auto& block : blocks) vkFreeMemory(device->device(), block.memory, nullptr);
+        });
+
+        physicalImages.clear();
+        memoryBlocks.clear();
+    }
+
+
+
+    void RenderGraph::printStats() const
+    {
+        std::cout << "render graph: " << stats.passCount << " passes, "
+            << stats.culledPassCount << " culled, "
+            << stats.imageBarrierCount << " image barriers in " << stats.barrierBatchCount << " batches" << std::endl;
+        std::cout << "  transient images: " << stats.transientImageCount
+            << " in " << stats.memoryBlockCount << " memory blocks, "
+            << stats.transientMemory / (1024.0 * 1024.0) << " MiB (unaliased "
+            << stats.unaliasedMemory / (1024.0 * 1024.0) << " MiB)" << std::endl;
+    }
+}  // namespace lve
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "Device.hpp"
+
+// std
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace LeMU {
+
+	class Renderer;
+
+	// handle of an image declared in the render graph
+	using RGResource = uint32_t;
+
+	// how a pass uses an image, decides layout, pipeline stage, access mask and image usage
+	enum class RGAccess {
+		ColorAttachmentWrite,
+		DepthAttachmentWrite,	// depth test and write
+		DepthAttachmentRead,	// depth test only
+		FragmentShaderRead,		// sampled in fragment shader
+		ComputeShaderRead,		// sampled in compute shader
+		ComputeShaderWrite,		// storage image
+		TransferRead,
+		TransferWrite,
+	};
+
+	// transient image, only lives during the frame. Memory is shared with other transient
+	// images whose lifetimes do not overlap
+	struct RGImageDesc {
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent = { 0, 0 };
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+		bool operator==(const RGImageDesc& other) const {
+			return format == other.format && extent.width == other.extent.width &&
+				extent.height == other.extent.height && aspect == other.aspect;
+		}
+	};
+
+	// frame graph rebuilt every frame: passes declare what they read and write, compile() orders them,
+	// culls the ones nothing depends on, places transient images in aliased memory and works out
+	// the barriers between passes. execute() records everything into one command buffer
+	class RenderGraph {
+	public:
+		class PassBuilder {
+		public:
+			void read(RGResource resource, RGAccess access);
+			void write(RGResource resource, RGAccess access);
+
+			// pass is never culled, even if nothing reads what it writes
+			void setSideEffects() { sideEffects = true; }
+
+		private:
+			friend class RenderGraph;
+			PassBuilder(RenderGraph& graph, uint32_t passIndex) : graph{graph}, passIndex{passIndex} {}
+
+			RenderGraph& graph;
+			uint32_t passIndex;
+			bool sideEffects = false;
+		};
+
+		struct Stats {
+			uint32_t passCount = 0;
+			uint32_t culledPassCount = 0;
+			uint32_t barrierBatchCount = 0;
+			uint32_t imageBarrierCount = 0;
+			uint32_t transientImageCount = 0;
+			uint32_t memoryBlockCount = 0;
+			VkDeviceSize transientMemory = 0;		// bytes actually allocated
+			VkDeviceSize unaliasedMemory = 0;		// bytes one allocation per image would take
+		};
+
+		RenderGraph(Device& device, Renderer& renderer);
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		// drop the passes and resources of the previous frame, physical images are kept for reuse
+		void reset();
+
+		RGResource createImage(const std::string& name, const RGImageDesc& desc);
+
+		// image owned outside the graph. It is assumed to be in initialLayout when the graph starts and
+		// is left in finalLayout. Passes writing an imported image are never culled.
+		// externalTransitions: the passes using it transition it themselves (a render pass),
+		// the graph only orders passes around it
+		RGResource importImage(
+			const std::string& name,
+			VkImage image,
+			VkImageView imageView,
+			VkImageAspectFlags aspect,
+			VkImageLayout initialLayout,
+			VkImageLayout finalLayout,
+			bool externalTransitions = false);
+
+		// the swap chain image acquired for this frame. begin/endSwapChainRenderPass transition it
+		RGResource importSwapChainImage();
+
+		void addPass(
+			const std::string& name,
+			const std::function<void(PassBuilder&)>& setup,
+			std::function<void(VkCommandBuffer)>&& execute);
+
+		void compile();
+		void execute(VkCommandBuffer commandBuffer);
+
+		// only valid inside a pass that declared the resource
+		VkImage getImage(RGResource resource) const;
+		VkImageView getImageView(RGResource resource) const;
+
+		inline const Stats& getStats() const { return stats; }
+		void printStats() const;
+
+	private:
+		struct ResourceUsage {
+			RGResource resource;
+			RGAccess access;
+			bool write;
+		};
+
+		struct Pass {
+			std::string name;
+			std::vector<ResourceUsage> usages;
+			std::function<void(VkCommandBuffer)> execute;
+			bool sideEffects = false;
+			bool alive = false;
+		};
+
+		struct Resource {
+			std::string name;
+			RGImageDesc desc{};
+			bool imported = false;
+			bool externalTransitions = false;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageUsageFlags usage = 0;
+
+			// execution order positions of the first and last pass using it, transient only
+			uint32_t firstUse = UINT32_MAX;
+			uint32_t lastUse = 0;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView imageView = VK_NULL_HANDLE;
+			int physicalIndex = -1;
+		};
+
+		struct Barrier {
+			RGResource resource;
+			VkImageLayout oldLayout;
+			VkImageLayout newLayout;
+			VkPipelineStageFlags srcStage;
+			VkAccessFlags srcAccess;
+			VkPipelineStageFlags dstStage;
+			VkAccessFlags dstAccess;
+		};
+
+		// barriers recorded before executionOrder[beforePass], UINT32_MAX is after the last pass
+		struct BarrierBatch {
+			uint32_t beforePass;
+			std::vector<Barrier> barriers;
+		};
+
+		// image and memory kept across frames while the transient resources do not change
+		struct PhysicalImage {
+			RGImageDesc desc{};
+			VkImageUsageFlags usage = 0;
+			uint32_t firstUse = 0;
+			uint32_t lastUse = 0;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView imageView = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryBlock = 0;
+		};
+
+		struct MemoryBlock {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeBits = 0;
+			// union of every stage / write access of the images placed here, used as the source
+			// scope when an image takes over the memory
+			VkPipelineStageFlags stages = 0;
+			VkAccessFlags writeAccess = 0;
+		};
+
+		void sortPasses();
+		void cullPasses();
+		void computeLifetimes();
+		void allocatePhysicalImages();
+		void buildBarriers();
+		void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch);
+		void releasePhysicalImages();
+
+		Device& device;
+		Renderer& renderer;
+
+		std::vector<Pass> passes;
+		std::vector<Resource> resources;
+		std::vector<uint32_t> executionOrder;
+		std::vector<BarrierBatch> barrierBatches;
+		bool compiled = false;
+
+		std::vector<PhysicalImage> physicalImages;
+		std::vector<MemoryBlock> memoryBlocks;
+
+		Stats stats{};
+	};
+}  // namespace lve
@@ -0,0 +1,166 @@
+#include "pch.h"
+
+#include "RenderQueue.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace LeMU {
+
+    namespace {
+
+        constexpr uint32_t PASS_SHIFT = 60;
+
+        // opaque: state, then depth
+        constexpr uint32_t OPAQUE_PIPELINE_SHIFT = 50;
+        constexpr uint32_t OPAQUE_MATERIAL_SHIFT = 40;
+        constexpr uint32_t OPAQUE_MODEL_SHIFT = 24;
+        constexpr uint32_t OPAQUE_DEPTH_SHIFT = 0;
+
+        // transparent: depth, then state
+        constexpr uint32_t TRANSPARENT_DEPTH_SHIFT = 36;
+        constexpr uint32_t TRANSPARENT_PIPELINE_SHIFT = 26;
+        constexpr uint32_t TRANSPARENT_MATERIAL_SHIFT = 16;
+        constexpr uint32_t TRANSPARENT_MODEL_SHIFT = 0;
+
+        inline uint32_t getField(uint64_t key, uint32_t shift, uint32_t bits)
+        {
+            return static_cast<uint32_t>((key >> shift) & ((uint64_t{ 1 } << bits) - 1));
+        }
+    }
+
+
+
+    void RenderQueue::clear()
+    {
+        items.clear();
+    }
+
+
+    void RenderQueue::reserve(size_t count)
+    {
+        items.reserve(count);
+        sortScratch.reserve(count);
+    }
+
+
+
+    uint32_t RenderQueue::quantizeDepth(float depth) const
+    {
+        constexpr uint32_t maxValue = (1u << DEPTH_BITS) - 1;
+
+        // also catches NaN
+        if (!(depth > 0.0f)) return 0;
+        if (depth >= maxDepth) return maxValue;
+        return static_cast<uint32_t>(depth / maxDepth * static_cast<float>(maxValue));
+    }
+
+
+
+    void RenderQueue::push(Pass pass, uint32_t pipeline, uint32_t material, uint32_t model, float depth, uint32_t payload)
+    {
+        assert(pipeline < (1u << PIPELINE_BITS) && "pipeline id does not fit the sort key");
+        assert(material < (1u << MATERIAL_BITS) && "material id does not fit the sort key");
+        assert(model < (1u << MODEL_BITS) && "model id does not fit the sort key");
+
+        uint64_t key = static_cast<uint64_t>(pass) << PASS_SHIFT;
+        uint32_t quantized = quantizeDepth(depth);
+
+        if (pass == Pass::Transparent)
+        {
+            // far to near
+            uint32_t inverted = ((1u << DEPTH_BITS) - 1) - quantized;
+            key |= static_cast<uint64_t>(inverted) << TRANSPARENT_DEPTH_SHIFT;
+            key |= static_cast<uint64_t>(pipeline) << TRANSPARENT_PIPELINE_SHIFT;
+            key |= static_cast<uint64_t>(material) << TRANSPARENT_MATERIAL_SHIFT;
+            key |= static_cast<uint64_t>(model) << TRANSPARENT_MODEL_SHIFT;
+        }
+        else
+        {
+            key |= static_cast<uint64_t>(pipeline) << OPAQUE_PIPELINE_SHIFT;
+            key |= static_cast<uint64_t>(material) << OPAQUE_MATERIAL_SHIFT;
+            key |= static_cast<uint64_t>(model) << OPAQUE_MODEL_SHIFT;
+            key |= static_cast<uint64_t>(quantized) << OPAQUE_DEPTH_SHIFT;
+        }
+
+        items.push_back({ key, payload });
+    }
+
+
+
+    void RenderQueue::sort()
+    {
+        const size_t count = items.size();
+        if (count < 2) return;
+
+        // histograms of all 8 bytes in one pass over the keys
+        std::array<std::array<uint32_t, 256>, 8> histograms{};
+        for (const auto& item : items)
+            for (uint32_t byte = 0; byte < 8; byte++)
+                histograms[byte][(item.key >> (byte * 8)) & 0xff]++;
+
+        sortScratch.resize(count);
+        Item* source = items.data();
+        Item* destination = sortScratch.data();
+
+        for (uint32_t byte = 0; byte < 8; byte++)
+        {
+            auto& histogram = histograms[byte];
+
+            // every key has the same value in this byte, the pass would not move anything
+            uint32_t firstValue = static_cast<uint32_t>((source[0].key >> (byte * 8)) & 0xff);
+            if (histogram[firstValue] == count) continue;
+
+            uint32_t offset = 0;
+            for (auto& bucket : histogram)
+            {
+                uint32_t bucketCount = bucket;
+                bucket = offset;
+                offset += bucketCount;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                uint32_t value = static_cast<uint32_t>((source[i].key >> (byte * 8)) & 0xff);
+                destination[histogram[value]++] = source[i];
+            }
+            std::swap(source, destination);
+        }
+
+        // an odd number of passes left the result in the scratch buffer
+        if (source != items.data()) items.swap(sortScratch);
+    }
+
+
+
+    RenderQueue::Pass RenderQueue::getPass(uint64_t key)
+    {
+        return static_cast<Pass>(key >> PASS_SHIFT);
+    }
+
+
+    uint32_t RenderQueue::getPipeline(uint64_t key)
+    {
+        return getPass(key) == Pass::Transparent
+            ? getField(key, TRANSPARENT_PIPELINE_SHIFT, PIPELINE_BITS)
+            : getField(key, OPAQUE_PIPELINE_SHIFT, PIPELINE_BITS);
+    }
+
+
+    uint32_t RenderQueue::getMaterial(uint64_t key)
+    {
+        return getPass(key) == Pass::Transparent
+            ? getField(key, TRANSPARENT_MATERIAL_SHIFT, MATERIAL_BITS)
+            : getField(key, OPAQUE_MATERIAL_SHIFT, MATERIAL_BITS);
+    }
+
+
+    uint32_t RenderQueue::getModel(uint64_t key)
+    {
+        return getPass(key) == Pass::Transparent
+            ? getField(key, TRANSPARENT_MODEL_SHIFT, MODEL_BITS)
+            : getField(key, OPAQUE_MODEL_SHIFT, MODEL_BITS);
+    }
+}  // namespace lve
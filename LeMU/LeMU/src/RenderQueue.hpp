@@ -0,0 +1,60 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace LeMU {
+
+	// draws of one frame, ordered by a packed 64-bit key so state changes only happen where the key
+	// changes. Opaque layout, most significant first:
+	//   pass (4) | pipeline (10) | material (10) | model (16) | depth (24)
+	// so draws sharing state are adjacent and each state run is drawn front-to-back for early-Z.
+	// Transparent draws need back-to-front order across all state instead:
+	//   pass (4) | inverted depth (24) | pipeline (10) | material (10) | model (16)
+	class RenderQueue {
+	public:
+		enum class Pass : uint32_t {
+			Opaque = 0,
+			Transparent = 1,
+		};
+
+		static constexpr uint32_t PIPELINE_BITS = 10;
+		static constexpr uint32_t MATERIAL_BITS = 10;
+		static constexpr uint32_t MODEL_BITS = 16;
+		static constexpr uint32_t DEPTH_BITS = 24;
+
+		struct Item {
+			uint64_t key;
+			uint32_t payload;	// caller's draw index
+		};
+
+		// depth is quantized linearly over [0, maxDepth], further draws share the last bucket
+		inline void setDepthRange(float maxDepth) { this->maxDepth = maxDepth; }
+
+		void clear();
+		void reserve(size_t count);
+
+		// ids must fit their field, see the *_BITS constants
+		void push(Pass pass, uint32_t pipeline, uint32_t material, uint32_t model, float depth, uint32_t payload);
+
+		// LSD radix sort over the key bytes, bytes that are equal for every item are skipped
+		void sort();
+
+		inline const std::vector<Item>& getItems() const { return items; }
+		inline size_t size() const { return items.size(); }
+
+		static Pass getPass(uint64_t key);
+		static uint32_t getPipeline(uint64_t key);
+		static uint32_t getMaterial(uint64_t key);
+		static uint32_t getModel(uint64_t key);
+
+	private:
+		uint32_t quantizeDepth(float depth) const;
+
+		std::vector<Item> items;
+		std::vector<Item> sortScratch;
+		float maxDepth = 100.0f;
+	};
+}  // namespace lve
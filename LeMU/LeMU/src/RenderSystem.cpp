@@ -1,3 +1,5 @@
+#include "pch.h"
+
 #include "RenderSystem.hpp"
 
 #define GLM_FORCE_RADIANS
@@ -7,94 +9,490 @@
 
 
 // std
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
 #include <stdexcept>
 #include <iostream>
 
 namespace LeMU {
 
-    struct SimplePushConstantData
-    {
-        glm::mat4 transform{ 1.f };   // default identity matrix as transformation matrix
-        alignas(16) glm::vec3 color;
-    };
+    namespace {
+
+        constexpr size_t MIN_OBJECT_CAPACITY = 1024;
+
+        // mapped host visible buffer, released once the frames using it have completed
+        void retireBuffer(Renderer& renderer, Device& device, VkBuffer buffer, VkDeviceMemory memory)
+        {
+            if (buffer == VK_NULL_HANDLE) return;
+
+            Device* owner = &device;
+            renderer.deferDestroy([owner, buffer, memory]() {
+                vkUnmapMemory(owner->device(), memory);
+                vkDestroyBuffer(owner->device(), buffer, nullptr);
+                vkFreeMemory(owner->device(), memory, nullptr);
+            });
+        }
+    }
 
-    RenderSystem::RenderSystem(Device& device, VkRenderPass renderPass) 
-        : device(device)
+    RenderSystem::RenderSystem(
+        Device& device, Renderer& renderer, const RenderTargetInfo& renderTarget, BindlessTextureTable* textures, ClusteredLighting* lighting,
+        CascadedShadows* shadows)
+        : device(device), renderer(renderer), textures(textures), lighting(lighting), shadows(shadows)
     {
+        assert(!(textures && lighting) && "The material shaders are not lit, set 1 is either textures or lights");
+        assert((!shadows || lighting) && "Shadows are drawn by the lit shaders only");
+
+        descriptorSetLayout = renderer.getDescriptorLayoutCache().createLayout({
+            makeDescriptorBinding(GlobalUboBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
+            makeDescriptorBinding(ObjectBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) });
+
         createPipelineLayout();
-        createPipeline(renderPass);
+        createPipeline(renderTarget);
     }
 
-    RenderSystem::~RenderSystem() { vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr); }
+    RenderSystem::~RenderSystem() 
+    { 
+        for (auto& frame : frames)
+        {
+            retireBuffer(renderer, device, frame.globalBuffer, frame.globalMemory);
+            retireBuffer(renderer, device, frame.objectBuffer, frame.objectMemory);
+        }
+    }
 
     
 
     void RenderSystem::createPipelineLayout() {
 
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(SimplePushConstantData);
-
-
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pSetLayouts = nullptr;
-        pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("failed to create pipeline layout!");
-        }
+        // set 0: camera and objects, set 1: bindless textures or light clusters, set 2: shadows
+        std::vector<VkDescriptorSetLayout> setLayouts{ descriptorSetLayout };
+        if (textures) setLayouts.push_back(textures->getDescriptorSetLayout());
+        if (lighting) setLayouts.push_back(lighting->getDescriptorSetLayout());
+        if (shadows) setLayouts.push_back(shadows->getDescriptorSetLayout());
+
+        pipelineLayout = renderer.getPipelineCache().getPipelineLayout(setLayouts);
     }
 
 
-    void RenderSystem::createPipeline(VkRenderPass renderPass)
+    void RenderSystem::createPipeline(const RenderTargetInfo& renderTarget)
     {
         //assert(swapChain != nullptr && "Cannot create pipeline before swap chain");
         //assert(swapChain != nullptr && "Cannot create pipeline before pipeline layout");
 
         PipelineConfigInfo pipelineConfig{};
         Pipeline::defaultPipelineConfigInfo(pipelineConfig);
-        pipelineConfig.renderPass = renderPass;
+        Pipeline::setRenderTarget(pipelineConfig, renderTarget);
         pipelineConfig.pipelineLayout = pipelineLayout;
-        pipeline = std::make_unique<Pipeline>(
-            device,
-            "shaders/simple_shader.vert.spv",
-            "shaders/simple_shader.frag.spv",
-            pipelineConfig);
+
+        if (lighting)
+        {
+            // the lit shaders also read the normals
+            VkVertexInputAttributeDescription normalAttribute{};
+            normalAttribute.binding = 0;
+            normalAttribute.location = 2;
+            normalAttribute.offset = offsetof(Model::Vertex, normal);
+            normalAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+            pipelineConfig.attributeDescriptions.push_back(normalAttribute);
+
+            pipeline = renderer.getPipelineCache().getPipeline(
+                "shaders/clustered_shader.vert",
+                shadows ? "shaders/clustered_shadow_shader.frag" : "shaders/clustered_shader.frag",
+                pipelineConfig);
+            return;
+        }
+
+        if (!textures)
+        {
+            pipeline = renderer.getPipelineCache().getPipeline(
+                "shaders/simple_shader.vert",
+                "shaders/simple_shader.frag",
+                pipelineConfig);
+            return;
+        }
+
+        // a pipeline per material feature mask, compiled the first time an object uses it
+        VkPipelineLayout layout = pipelineLayout;
+        materialPipelines = std::make_unique<PipelinePermutations>(
+            renderer.getPipelineCache(),
+            "shaders/bindless_shader.vert",
+            "shaders/bindless_shader.frag",
+            MATERIAL_FEATURE_COUNT,
+            [renderTarget, layout](PipelineConfigInfo& config, uint32_t features) {
+                Pipeline::setRenderTarget(config, renderTarget);
+                config.pipelineLayout = layout;
+
+                // the material shaders also read the texture coordinates
+                VkVertexInputAttributeDescription uvAttribute{};
+                uvAttribute.binding = 0;
+                uvAttribute.location = 2;
+                uvAttribute.offset = offsetof(Model::Vertex, uv);
+                uvAttribute.format = VK_FORMAT_R32G32_SFLOAT;
+                config.attributeDescriptions.push_back(uvAttribute);
+
+                if (features & AlphaTestFeature)
+                    config.specialization.setFloat(ALPHA_CUTOFF_CONSTANT, ALPHA_CUTOFF);
+            });
+
+        materialPipelines->get(FALLBACK_MATERIAL_FEATURES);
     }
 
 
 
 
+    void RenderSystem::createFrameData(FrameData& frame)
+    {
+        device.createBuffer(
+            sizeof(GlobalUbo),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            frame.globalBuffer,
+            frame.globalMemory);
+
+        void* mapped = nullptr;
+        if (vkMapMemory(device.device(), frame.globalMemory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+            throw std::runtime_error("failed to map global uniform buffer!");
+        frame.globalMapped = static_cast<GlobalUbo*>(mapped);
+    }
+
+
+    void RenderSystem::growObjectBuffer(FrameData& frame, size_t objectCount)
+    {
+        retireBuffer(renderer, device, frame.objectBuffer, frame.objectMemory);
+
+        size_t capacity = std::max(MIN_OBJECT_CAPACITY, frame.objectCapacity * 2);
+        while (capacity < objectCount) capacity *= 2;
+
+        device.createBuffer(
+            capacity * sizeof(GpuObjectData),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            frame.objectBuffer,
+            frame.objectMemory);
+
+        void* mapped = nullptr;
+        if (vkMapMemory(device.device(), frame.objectMemory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+            throw std::runtime_error("failed to map object buffer!");
+        frame.objectMapped = static_cast<GpuObjectData*>(mapped);
+        frame.objectCapacity = capacity;
+    }
+
+
+    RenderSystem::FrameData& RenderSystem::prepareFrame(size_t objectCount, const Camera& camera)
+    {
+        // frames in flight can change at runtime
+        size_t frameIndex = static_cast<size_t>(renderer.getFrameIndex());
+        if (frames.size() <= frameIndex) frames.resize(frameIndex + 1);
+
+        auto& frame = frames[frameIndex];
+        if (frame.globalBuffer == VK_NULL_HANDLE) createFrameData(frame);
+        if (frame.objectCapacity < objectCount) growObjectBuffer(frame, objectCount);
+
+        GlobalUbo ubo{};
+        ubo.projection = camera.getProjectionMatrix();
+        ubo.view = camera.getViewMatrix();
+        ubo.projectionView = ubo.projection * ubo.view;
+        ubo.cameraPosition = glm::vec4(camera.getPosition(), 1.0f);
+        *frame.globalMapped = ubo;
+
+        // the frame allocator was reset when this slot began, so a fresh set each frame costs no pool growth
+        frame.descriptorSet = DescriptorWriter{ renderer.getDescriptorLayoutCache(), renderer.getFrameDescriptorAllocator() }
+            .writeBuffer(GlobalUboBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                frame.globalBuffer, 0, sizeof(GlobalUbo))
+            .writeBuffer(ObjectBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, frame.objectBuffer)
+            .build();
+
+        return frame;
+    }
+
+
+
     void RenderSystem::renderGameObjects( VkCommandBuffer commandBuffer, 
                                           std::vector<GameObject>& gameObjects, 
                                           const Camera& camera )
     {
-        pipeline->bind(commandBuffer);
+        auto& frame = prepareFrame(gameObjects.size(), camera);
+        auto frustum = camera.getFrustum();
+
+        if (cullingScratch.empty()) cullingScratch.resize(1);
+        auto& scratch = cullingScratch[0];
+        cullGameObjects(gameObjects.data(), 0, gameObjects.size(), frustum, scratch);
+
+        cullingStats.visible = scratch.visibleCount;
+        cullingStats.culled = gameObjects.size() - scratch.visibleCount;
+        cullingStats.occluded = scratch.occludedCount;
+
+        recordDraws(commandBuffer, gameObjects.data(), frustum, frame, 0, scratch);
+        bindStats = scratch.bindStats;
+    }
+
+
+
+    void RenderSystem::renderGameObjectsParallel( VkCommandBuffer commandBuffer,
+                                                  JobSystem& jobSystem,
+                                                  std::vector<GameObject>& gameObjects,
+                                                  const Camera& camera,
+                                                  uint32_t threadCount )
+    {
+        // every chunk needs its own command pool
+        uint32_t maxThreads = std::min(renderer.getRecordingThreadCount(), jobSystem.getThreadCount());
+        threadCount = (threadCount == 0) ? maxThreads : std::min(threadCount, maxThreads);
 
-        auto projectionView = camera.getProjectionMatrix() * camera.getViewMatrix();
+        auto& frame = prepareFrame(gameObjects.size(), camera);
+        auto frustum = camera.getFrustum();
 
-        for (auto& obj : gameObjects)
+        std::vector<VkCommandBuffer> secondaryBuffers(threadCount, VK_NULL_HANDLE);
+        if (cullingScratch.size() < threadCount) cullingScratch.resize(threadCount);
+        for (auto& scratch : cullingScratch)
         {
-            SimplePushConstantData push{};
-            push.color = obj.color;
-            push.transform = projectionView * obj.transform.mat4();
-
-            vkCmdPushConstants(
-                commandBuffer,
-                pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                sizeof(SimplePushConstantData),
-                &push);
-
-            obj.model->bind(commandBuffer);
-            obj.model->draw(commandBuffer);
+            scratch.visibleCount = 0;
+            scratch.occludedCount = 0;
+            scratch.bindStats = {};
+        }
+
+        // every chunk culls its own range right before recording it
+        jobSystem.parallelFor(gameObjects.size(), threadCount, 
+            [&](size_t begin, size_t end, uint32_t chunkIndex)
+            {
+                auto& scratch = cullingScratch[chunkIndex];
+                cullGameObjects(gameObjects.data(), begin, end, frustum, scratch);
+
+                VkCommandBuffer secondary = renderer.beginSecondaryCommandBuffer(chunkIndex);
+
+                // a chunk writes object data only into the slots of its own range
+                recordDraws(secondary, gameObjects.data(), frustum, frame, static_cast<uint32_t>(begin), scratch);
+
+                if (vkEndCommandBuffer(secondary) != VK_SUCCESS)
+                    throw std::runtime_error("failed to record secondary command buffer!");
+
+                secondaryBuffers[chunkIndex] = secondary;
+            });
+
+        // fewer chunks than threads when there are only a few objects
+        secondaryBuffers.erase(
+            std::remove(secondaryBuffers.begin(), secondaryBuffers.end(), VK_NULL_HANDLE), 
+            secondaryBuffers.end());
+
+        if (!secondaryBuffers.empty())
+            vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+
+        cullingStats.visible = 0;
+        cullingStats.occluded = 0;
+        for (auto& scratch : cullingScratch)
+        {
+            cullingStats.visible += scratch.visibleCount;
+            cullingStats.occluded += scratch.occludedCount;
+        }
+        cullingStats.culled = gameObjects.size() - cullingStats.visible;
+
+        bindStats = {};
+        for (auto& scratch : cullingScratch)
+        {
+            bindStats.pipelineBinds += scratch.bindStats.pipelineBinds;
+            bindStats.modelBinds += scratch.bindStats.modelBinds;
+            bindStats.draws += scratch.bindStats.draws;
+            bindStats.fallbackBinds += scratch.bindStats.fallbackBinds;
+        }
+    }
+
+
+
+    void RenderSystem::cullGameObjects( GameObject* objects,
+                                        size_t begin,
+                                        size_t end,
+                                        const Frustum& frustum,
+                                        CullingScratch& scratch )
+    {
+        size_t count = end - begin;
+        scratch.visible.resize(count);
+        scratch.occludedCount = 0;
+
+        if (!frustumCulling)
+        {
+            std::iota(scratch.visible.begin(), scratch.visible.end(), static_cast<uint32_t>(begin));
+            scratch.visibleCount = count;
+        }
+        else
+        {
+            scratch.spheres.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                glm::vec4 sphere = getWorldBoundingSphere(objects[begin + i]);
+                scratch.spheres.centerX[i] = sphere.x;
+                scratch.spheres.centerY[i] = sphere.y;
+                scratch.spheres.centerZ[i] = sphere.z;
+                scratch.spheres.radius[i] = sphere.w;
+            }
+
+            scratch.visibleCount = cullSpheres(
+                cullingKernel, frustum, scratch.spheres, static_cast<uint32_t>(begin), scratch.visible.data());
+        }
+
+        if (!softwareOcclusion) return;
+
+        // the box test is far more expensive than the sphere test, so it only sees frustum survivors
+        size_t unoccluded = 0;
+        for (size_t i = 0; i < scratch.visibleCount; i++)
+        {
+            uint32_t index = scratch.visible[i];
+            scratch.visible[unoccluded] = index;
+            unoccluded += softwareOcclusion->isVisible(objects[index]) ? 1 : 0;
+        }
+        scratch.occludedCount = scratch.visibleCount - unoccluded;
+        scratch.visibleCount = unoccluded;
+    }
+
+
+
+    void RenderSystem::recordDraws( VkCommandBuffer commandBuffer,
+                                    GameObject* objects,
+                                    const Frustum& frustum,
+                                    FrameData& frame,
+                                    uint32_t firstSlot,
+                                    CullingScratch& scratch )
+    {
+        auto& stats = scratch.bindStats;
+        stats = {};
+
+        // the draw in slot i reads objects[i] through gl_InstanceIndex
+        auto writeObject = [&](uint32_t slot, GameObject& obj) {
+            GpuObjectData& data = frame.objectMapped[slot];
+            data.model = obj.transform.mat4();
+            data.color = glm::vec4(obj.color, 1.0f);
+            data.material = glm::uvec4(obj.textureIndex, obj.normalMapIndex, 0, 0);
+        };
+
+        // every material pipeline shares the layout, the sets stay bound across pipeline binds
+        VkDescriptorSet sets[] = { frame.descriptorSet, VK_NULL_HANDLE, VK_NULL_HANDLE };
+        uint32_t setCount = 1;
+        if (textures) sets[setCount++] = textures->getDescriptorSet();
+        if (lighting) sets[setCount++] = lighting->getDescriptorSet();
+        if (shadows) sets[setCount++] = shadows->getDescriptorSet();
+        vkCmdBindDescriptorSets(
+            commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, setCount, sets, 0, nullptr);
+
+        // pipeline id is the material feature mask, always 0 without material pipelines
+        auto getPipelineId = [&](const GameObject& obj) -> uint32_t {
+            return materialPipelines ? obj.materialFeatures : 0;
+        };
+
+        auto bindPipeline = [&](uint32_t pipelineId) {
+            if (!materialPipelines) pipeline->bind(commandBuffer);
+            else if (!asyncPipelineCompilation) materialPipelines->get(pipelineId).bind(commandBuffer);
+            else
+            {
+                Pipeline* material = materialPipelines->tryGet(pipelineId);
+                if (!material)
+                {
+                    material = &materialPipelines->get(FALLBACK_MATERIAL_FEATURES);
+                    stats.fallbackBinds++;
+                }
+                material->bind(commandBuffer);
+            }
+            stats.pipelineBinds++;
+        };
+
+        if (!drawSorting)
+        {
+            uint32_t boundPipeline = UINT32_MAX;
+
+            for (size_t i = 0; i < scratch.visibleCount; i++)
+            {
+                auto& obj = objects[scratch.visible[i]];
+                if (!obj.model) continue;
+
+                uint32_t slot = firstSlot + static_cast<uint32_t>(i);
+                writeObject(slot, obj);
+
+                if (getPipelineId(obj) != boundPipeline)
+                {
+                    boundPipeline = getPipelineId(obj);
+                    bindPipeline(boundPipeline);
+                }
+
+                obj.model->bind(commandBuffer);
+                obj.model->draw(commandBuffer, 1, slot);
+                stats.modelBinds++;
+                stats.draws++;
+            }
+            return;
+        }
+
+        // depth is the distance in front of the near plane, near and far planes are parallel
+        // so their distances add up to the depth range
+        const glm::vec4& nearPlane = frustum.planes[Frustum::Near];
+        scratch.queue.setDepthRange(nearPlane.w + frustum.planes[Frustum::Far].w);
+
+        scratch.queue.clear();
+        scratch.queue.reserve(scratch.visibleCount);
+        scratch.modelIds.clear();
+        scratch.models.clear();
+
+        for (size_t i = 0; i < scratch.visibleCount; i++)
+        {
+            auto& obj = objects[scratch.visible[i]];
+            if (!obj.model) continue;
+
+            uint32_t modelId;
+            auto found = scratch.modelIds.find(obj.model.get());
+            if (found != scratch.modelIds.end()) modelId = found->second;
+            else
+            {
+                modelId = static_cast<uint32_t>(scratch.models.size());
+                scratch.modelIds.emplace(obj.model.get(), modelId);
+                scratch.models.push_back(obj.model.get());
+            }
+
+            float depth = glm::dot(glm::vec3(nearPlane), obj.transform.translation) + nearPlane.w;
+
+            // textures are indexed per object so they do not split draws, only the material features
+            // pick a pipeline and the material key field stays 0
+            scratch.queue.push(RenderQueue::Pass::Opaque, getPipelineId(obj), 0, modelId, depth, scratch.visible[i]);
+        }
+
+        scratch.queue.sort();
+
+        // slots follow the sorted order, so a run of the same model and pipeline is one instanced draw
+        const auto& items = scratch.queue.getItems();
+        uint32_t boundPipeline = UINT32_MAX;
+        uint32_t boundModel = UINT32_MAX;
+        uint32_t runStart = 0;
+
+        auto flushRun = [&](uint32_t runEnd) {
+            if (runEnd == runStart) return;
+            scratch.models[boundModel]->draw(commandBuffer, runEnd - runStart, firstSlot + runStart);
+            stats.draws++;
+            runStart = runEnd;
+        };
+
+        for (uint32_t i = 0; i < static_cast<uint32_t>(items.size()); i++)
+        {
+            uint64_t key = items[i].key;
+            uint32_t pipelineId = RenderQueue::getPipeline(key);
+            uint32_t modelId = RenderQueue::getModel(key);
+
+            if (pipelineId != boundPipeline || modelId != boundModel) flushRun(i);
+
+            if (pipelineId != boundPipeline)
+            {
+                bindPipeline(pipelineId);
+                boundPipeline = pipelineId;
+            }
+
+            if (modelId != boundModel)
+            {
+                scratch.models[modelId]->bind(commandBuffer);
+                boundModel = modelId;
+                stats.modelBinds++;
+            }
+
+            writeObject(firstSlot + i, objects[items[i].payload]);
         }
+        flushRun(static_cast<uint32_t>(items.size()));
     }
 
 
@@ -1,20 +1,44 @@
 #pragma once
 
 
+#include "BindlessTextures.hpp"
 #include "Camera.hpp"
+#include "CascadedShadows.hpp"
+#include "ClusteredLighting.hpp"
+#include "Culling.hpp"
+#include "Descriptor.hpp"
 #include "Device.hpp"
 #include "Pipeline.hpp"
 #include "GameObject.hpp"
+#include "JobSystem.hpp"
+#include "Renderer.hpp"
+#include "RenderQueue.hpp"
+#include "SoftwareOcclusion.hpp"
 
 // std
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace LeMU {
 	class RenderSystem {
 	public:
 
-		RenderSystem(Device &device, VkRenderPass renderPass);
+		// camera data goes into a per-frame uniform buffer and object data into a per-frame storage
+		// buffer indexed by gl_InstanceIndex, render at most once per frame.
+		// With a texture table the objects sample their textureIndex from it as set 1, and every
+		// object is drawn with the pipeline permutation of its materialFeatures.
+		// With clustered lighting, and no texture table, the objects are lit by the lights of its
+		// clusters, bound as set 1. Its update has to run before the frame's draws are recorded.
+		// Shadows add the directional light and its cascaded shadow maps as set 2, lit objects only,
+		// rendered before the frame's draws are recorded too
+		RenderSystem(
+			Device &device,
+			Renderer &renderer,
+			const RenderTargetInfo &renderTarget,
+			BindlessTextureTable *textures = nullptr,
+			ClusteredLighting *lighting = nullptr,
+			CascadedShadows *shadows = nullptr);
 		~RenderSystem();
 
 		RenderSystem(const RenderSystem&) = delete;
@@ -24,14 +48,133 @@ namespace LeMU {
 								std::vector<GameObject> &gameObjects, 
 								const Camera &camera);
 
+		// objects are partitioned across worker threads, each records a secondary command buffer,
+		// the primary executes them. The swap chain render pass must be begun with 
+		// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. threadCount 0 uses every recording thread
+		void renderGameObjectsParallel( VkCommandBuffer commandBuffer,
+										JobSystem &jobSystem,
+										std::vector<GameObject> &gameObjects,
+										const Camera &camera,
+										uint32_t threadCount = 0);
+
+		// objects whose bounding sphere is outside the camera frustum are not recorded
+		struct CullingStats {
+			size_t visible = 0;
+			size_t culled = 0;
+			size_t occluded = 0;	// part of culled, passed the frustum test but hidden by occluders
+		};
+
+		// counts of the last renderGameObjects / renderGameObjectsParallel call
+		inline const CullingStats& getCullingStats() const { return cullingStats; }
+
+		inline void setFrustumCulling(bool enabled) { frustumCulling = enabled; }
+		inline void setCullingKernel(CullingKernel kernel) { cullingKernel = kernel; }
+		inline CullingKernel getCullingKernel() const { return cullingKernel; }
+
+		// objects passing the frustum test are also tested against the occluders rendered into
+		// buffer, which has to be rendered for this frame's camera first. nullptr turns it off
+		inline void setSoftwareOcclusion(const SoftwareOcclusionBuffer *buffer) { softwareOcclusion = buffer; }
+
+		// state changes issued by the last renderGameObjects / renderGameObjectsParallel call
+		struct BindStats {
+			size_t pipelineBinds = 0;
+			size_t modelBinds = 0;
+			size_t draws = 0;
+			size_t fallbackBinds = 0;	// binds of the fallback while the material's permutation compiles
+		};
+
+		inline const BindStats& getBindStats() const { return bindStats; }
+
+		// alpha tested materials discard fragments with base alpha below this
+		static constexpr float ALPHA_CUTOFF = 0.5f;
+
+		// material permutations compiled so far, 0 without a texture table
+		inline size_t getMaterialPipelineCount() const { return materialPipelines ? materialPipelines->size() : 0; }
+
+		// permutation every material draws with until its own is compiled, built up front
+		static constexpr MaterialFeatures FALLBACK_MATERIAL_FEATURES = VertexColorFeature;
+
+		// on, a material permutation seen for the first time is compiled on the pipeline cache's compile
+		// threads and its objects draw with the fallback permutation meanwhile. Off compiles it while recording
+		inline void setAsyncPipelineCompilation(bool enabled) { asyncPipelineCompilation = enabled; }
+
+		// visible objects go through a RenderQueue, sorted by state and front-to-back, and
+		// pipeline / model are only bound when they change, runs of one model are a single
+		// instanced draw. Off records in object order with one bind and draw per object
+		inline void setDrawSorting(bool enabled) { drawSorting = enabled; }
+
 	private:
+		// bounding spheres, visible indices and draw queue of one range of objects, reused across frames
+		struct CullingScratch {
+			CullingSpheres spheres;
+			std::vector<uint32_t> visible;
+			size_t visibleCount = 0;
+			size_t occludedCount = 0;
+
+			RenderQueue queue;
+			std::unordered_map<Model*, uint32_t> modelIds;	// sort key model field
+			std::vector<Model*> models;
+			BindStats bindStats{};
+		};
+
+		// fills scratch.visible with the indices in [begin, end) that pass the frustum and occlusion tests
+		void cullGameObjects( GameObject *objects,
+							  size_t begin,
+							  size_t end,
+							  const Frustum &frustum,
+							  CullingScratch &scratch);
+
+		// uniform and storage buffer of one frame in flight, persistently mapped
+		struct FrameData {
+			VkBuffer globalBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory globalMemory = VK_NULL_HANDLE;
+			GlobalUbo *globalMapped = nullptr;
+
+			VkBuffer objectBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory objectMemory = VK_NULL_HANDLE;
+			GpuObjectData *objectMapped = nullptr;
+			size_t objectCapacity = 0;
+
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;	// from the frame allocator, rebuilt every frame
+		};
+
+		// buffers of the current frame, with room for objectCount objects and the camera written
+		FrameData& prepareFrame(size_t objectCount, const Camera &camera);
+		void createFrameData(FrameData &frame);
+		void growObjectBuffer(FrameData &frame, size_t objectCount);
+
+		// binds the pipeline and draws the visible objects of scratch, their object data goes
+		// to the slots from firstSlot on
+		void recordDraws( VkCommandBuffer commandBuffer,
+						  GameObject *objects,
+						  const Frustum &frustum,
+						  FrameData &frame,
+						  uint32_t firstSlot,
+						  CullingScratch &scratch);
 
 		void createPipelineLayout();
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(const RenderTargetInfo &renderTarget);
 
 		Device &device;
+		Renderer &renderer;
+		BindlessTextureTable *textures;
+		ClusteredLighting *lighting;
+		CascadedShadows *shadows;
+		VkDescriptorSetLayout descriptorSetLayout;	// owned by the renderer's layout cache
+
+		std::shared_ptr<Pipeline> pipeline;						// without a texture table
+		std::unique_ptr<PipelinePermutations> materialPipelines;	// with a texture table
+		VkPipelineLayout pipelineLayout;	// owned by the renderer's pipeline cache
+
+		std::vector<FrameData> frames;
 
-		std::unique_ptr<Pipeline> pipeline;
-		VkPipelineLayout pipelineLayout;
+		bool frustumCulling = true;
+		CullingKernel cullingKernel = detectCullingKernel();
+		CullingStats cullingStats{};
+		const SoftwareOcclusionBuffer *softwareOcclusion = nullptr;
+		bool drawSorting = true;
+		bool asyncPipelineCompilation = true;
+		BindStats bindStats{};
+		std::vector<CullingScratch> cullingScratch;	// one per recording chunk
 	};
 }  // namespace lve
\ No newline at end of file
@@ -1,8 +1,11 @@
+#include "pch.h"
+
 #include "Renderer.hpp"
 
 #include <cassert>
 
 // std
+#include <algorithm>
 #include <array>
 #include <stdexcept>
 #include <iostream>
@@ -13,17 +16,25 @@ namespace LeMU {
 	VkCommandBuffer Renderer::getCurrentCommandBuffer() const 
 	{ 
 		assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
-		return commandBuffers[currentFrameIndex]; 
+		return currentCommandBuffer; 
 	}
 
-    Renderer::Renderer(Window &window, Device &device) 
-        :window(window), device(device)
+    Renderer::Renderer(Window &window, Device &device, uint32_t recordingThreadCount, const SwapChainConfig &config) 
+        :window(window), device(device), recordingThreadCount(recordingThreadCount), descriptorLayoutCache(device), shaderCompiler(), pipelineCache(device, shaderCompiler), swapChainConfig(config)
     {
+        assert(recordingThreadCount > 0 && "Renderer needs at least one recording thread");
         recreateSwapChain();
-        createCommandBuffers();
+        createFrameCommandPools();
+        createFrameDescriptorAllocators();
+        createLatencyQueryPool();
     }
 
-    Renderer::~Renderer() { freeCommandBuffers(); }
+    Renderer::~Renderer()
+    {
+        retiredSwapChains.clear();
+        deletionQueue.flushAll();
+        if (latencyQueryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device.device(), latencyQueryPool, nullptr);
+    }
 
 
 
@@ -36,25 +47,58 @@ namespace LeMU {
             glfwWaitEvents();   // pause events if window is minimized
         }
 
-        vkDeviceWaitIdle(device.device());  // pause device before SwapChain recreation
-
         if (swapChain == nullptr)
         {
-            swapChain = std::make_unique<SwapChain>(device, extent);
+            swapChain = std::make_unique<SwapChain>(device, extent, swapChainConfig);
         }
         else
         {
-            // acquire old swapchain
+            // acquire old swapchain, it is retired through oldSwapchain instead of stalling the device
             std::shared_ptr<SwapChain> oldSwapChain = std::move(swapChain);
-            swapChain = std::make_unique<SwapChain>(device, extent, oldSwapChain);
+            swapChain = std::make_unique<SwapChain>(device, extent, oldSwapChain, swapChainConfig);
 
             if (!oldSwapChain->compareSwapFormats(*swapChain.get()))
                 throw std::runtime_error("Swap chain image(or depth) format has changed!");
+
+            // frames in flight may still render to or present images of the old swap chain
+            retiredSwapChains.push_back({ std::move(oldSwapChain), 0 });
         } 
     }
 
 
 
+    void Renderer::releaseRetiredSwapChains(uint64_t completedFrame)
+    {
+        retiredSwapChains.erase(
+            std::remove_if(retiredSwapChains.begin(), retiredSwapChains.end(), [completedFrame](const RetiredSwapChain& retired) {
+                return retired.releaseFrame != 0 && retired.releaseFrame <= completedFrame;
+            }),
+            retiredSwapChains.end());
+    }
+
+
+
+    uint64_t Renderer::getCompletedFrameCount() const
+    {
+        // timeline value is the number of the last completed frame
+        if (swapChain->usesTimelineSemaphore())
+            return device.getCompletedFrameValue();
+
+        // acquireNextImage waits on the fence of the current frame slot, 
+        // which was last signaled framesInFlight frames ago
+        uint64_t pendingFrames = swapChain->getFramesInFlight() - 1;
+        return submittedFrames > pendingFrames ? submittedFrames - pendingFrames : 0;
+    }
+
+
+
+    void Renderer::deferDestroy(std::function<void()>&& deleter)
+    {
+        deletionQueue.push(submittedFrames, std::move(deleter));
+    }
+
+
+
     int Renderer::getFrameIndex() const
     {
         assert(isFrameStarted && "Cannot get frame index when frame not in progress");
@@ -62,33 +106,122 @@ namespace LeMU {
     }
 
 
-    void Renderer::createCommandBuffers() {
-        commandBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
-
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = device.getCommandPool();
-        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    void Renderer::createFrameCommandPools() 
+    {
+        framePools.resize(swapChain->getFramesInFlight());
 
-        if (vkAllocateCommandBuffers(device.device(), &allocInfo, commandBuffers.data()) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate command buffers!");
+        for (auto& threadPools : framePools)
+        {
+            threadPools.clear();
+            for (uint32_t i = 0; i < recordingThreadCount; i++)
+                threadPools.push_back(std::make_unique<FrameCommandPool>(device));
         }
+    }
+
+
+    void Renderer::createFrameDescriptorAllocators()
+    {
+        frameDescriptorAllocators.resize(swapChain->getFramesInFlight());
+        for (auto& allocator : frameDescriptorAllocators)
+            allocator = std::make_unique<DescriptorAllocator>(device);
+    }
 
 
+    void Renderer::setSwapChainConfig(const SwapChainConfig &config)
+    {
+        assert(!isFrameStarted && "Can't change swap chain config while frame is in progress");
+
+        // the number of frame slots changes, nothing may be in flight while slots are reallocated
+        vkDeviceWaitIdle(device.device());
+
+        swapChainConfig = config;
+        recreateSwapChain();
+        deletionQueue.flushAll();
+
+        framePools.clear();
+        createFrameCommandPools();
+        createFrameDescriptorAllocators();
+
+        frameStartTimes.clear();
+        frameLatencyPending.clear();
+        createLatencyQueryPool();
+    }
+
+
+    void Renderer::createLatencyQueryPool()
+    {
+        // called again when the number of frame slots changes, nothing is in flight then
+        if (latencyQueryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device.device(), latencyQueryPool, nullptr);
+        latencyQueryPool = VK_NULL_HANDLE;
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+        uint32_t timestampBits = queueFamilies[device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+        if (timestampBits == 0 || !device.getFeatures().calibratedTimestamps) return;
+
+        timestampPeriod = device.properties.limits.timestampPeriod;
+        timestampMask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = swapChain->getFramesInFlight();
+
+        if (vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &latencyQueryPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create latency query pool!");
+    }
+
+
+    void Renderer::collectFrameLatencies()
+    {
+        frameStartTimes.resize(swapChain->getFramesInFlight());
+        frameLatencyPending.resize(swapChain->getFramesInFlight(), false);
+
+        // the GPU clock right now, finished frames are placed on the CPU clock relative to it
+        uint64_t gpuNow = 0;
+        bool calibrated = latencyQueryPool != VK_NULL_HANDLE && device.getDeviceTimestamp(gpuNow);
+        auto now = std::chrono::high_resolution_clock::now();
+
+        for (size_t frame = 0; frame < frameLatencyPending.size(); frame++)
+        {
+            if (!frameLatencyPending[frame] || !swapChain->isFrameComplete(frame)) continue;
+            frameLatencyPending[frame] = false;
+
+            // the GPU may have finished long before the fence is polled here, count up to the
+            // timestamp written at the end of the frame instead
+            auto frameEnd = now;
+            std::array<uint64_t, 2> result{};
+            if (calibrated && vkGetQueryPoolResults(
+                    device.device(), latencyQueryPool, static_cast<uint32_t>(frame), 1,
+                    sizeof(result), result.data(), sizeof(result),
+                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) == VK_SUCCESS && result[1] != 0)
+            {
+                uint64_t ticks = (gpuNow - result[0]) & timestampMask;
+                frameEnd -= std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+                    std::chrono::duration<double, std::nano>(static_cast<double>(ticks) * timestampPeriod));
+            }
+
+            frameEnd = std::max(frameEnd, frameStartTimes[frame]);
+            latencyStats.addSample(std::chrono::duration<float, std::chrono::milliseconds::period>(frameEnd - frameStartTimes[frame]).count());
+        }
     }
 
 
-    void Renderer::freeCommandBuffers()
+    FrameCommandPool& Renderer::getFrameCommandPool(uint32_t threadIndex)
     {
-        vkFreeCommandBuffers(
-            device.device(),
-            device.getCommandPool(),
-            static_cast<uint32_t>(commandBuffers.size()),
-            commandBuffers.data());
+        assert(isFrameStarted && "Cannot get command pool when frame not in progress");
+        assert(threadIndex < recordingThreadCount && "Recording thread index out of range");
+        return *framePools[currentFrameIndex][threadIndex];
+    }
+
 
-        commandBuffers.clear();
+    DescriptorAllocator& Renderer::getFrameDescriptorAllocator()
+    {
+        assert(isFrameStarted && "Cannot get frame descriptor allocator when frame not in progress");
+        return *frameDescriptorAllocators[currentFrameIndex];
     }
 
 
@@ -97,9 +230,26 @@ namespace LeMU {
     {
         assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
+        // input for this frame has already been sampled, latency is measured from here
+        currentFrameStartTime = std::chrono::high_resolution_clock::now();
+        collectFrameLatencies();
+
+        // frame slot is chosen by the swap chain, it owns the fence that guards this slot
+        currentFrameIndex = static_cast<int>(swapChain->getCurrentFrame());
+
         // check if the next framebuffer is ready to render
         auto result = swapChain->acquireNextImage(&currentImageIndex);
 
+        // the frame slot fence has been waited on, release everything its previous frame was using
+        deletionQueue.flush(getCompletedFrameCount());
+        releaseRetiredSwapChains(getCompletedFrameCount());
+
+        // shaders rebuilt in the background are swapped in before anything records, the pipelines
+        // they replace may still be used by frames in flight
+        pipelineCache.applyReloads([this](std::shared_ptr<Pipeline> retired) {
+            deferDestroy([retired = std::move(retired)]() mutable { retired.reset(); });
+        });
+
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
         {
             recreateSwapChain();
@@ -112,14 +262,23 @@ namespace LeMU {
 
         isFrameStarted = true;
 
-        auto commandBuffer = getCurrentCommandBuffer();
+        // fence of this slot has signaled, recycle every command buffer the slot recorded last time
+        for (auto& pool : framePools[currentFrameIndex])
+            pool->reset();
+        frameDescriptorAllocators[currentFrameIndex]->resetPools();
+
+        currentCommandBuffer = framePools[currentFrameIndex][0]->getPrimaryCommandBuffer();
+        auto commandBuffer = currentCommandBuffer;
 
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) 
             throw std::runtime_error("failed to begin recording command buffer!");
         
+        if (latencyQueryPool != VK_NULL_HANDLE)
+            vkCmdResetQueryPool(commandBuffer, latencyQueryPool, currentFrameIndex, 1);
 
         return commandBuffer;
     }
@@ -130,10 +289,29 @@ namespace LeMU {
         assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
         auto commandBuffer = getCurrentCommandBuffer();
 
+        // marks when every command of the frame is done, see collectFrameLatencies
+        if (latencyQueryPool != VK_NULL_HANDLE)
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, latencyQueryPool, currentFrameIndex);
+
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) 
             throw std::runtime_error("failed to record command buffer!");
         
-        auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+        // acquire has waited on this slot, pick up its latency before the fence is reset by the submit
+        collectFrameLatencies();
+        frameStartTimes[currentFrameIndex] = currentFrameStartTime;
+        frameLatencyPending[currentFrameIndex] = true;
+
+        auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex, submittedFrames + 1);
+        submittedFrames++;
+
+        // an image of the current swap chain is queued for presentation, the presents of the chains
+        // retired before it are done once framesInFlight more frames have completed
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+        {
+            for (auto& retired : retiredSwapChains)
+                if (retired.releaseFrame == 0) retired.releaseFrame = submittedFrames + swapChain->getFramesInFlight();
+        }
+
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.wasWindowResized())
         {
             window.resetWindowResizeFlag();
@@ -143,18 +321,42 @@ namespace LeMU {
             throw std::runtime_error("failed to present swap chain image!");
         
         isFrameStarted = false;
-        currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
     }
 
 
-    void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+    void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
     {
         assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
         assert(commandBuffer == getCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
+
+        beginRenderPass(commandBuffer, contents, false);
+    }
+
+
+
+    void Renderer::resumeSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
+    {
+        assert(isFrameStarted && "Can't call resumeSwapChainRenderPass if frame is not in progress");
+        assert(commandBuffer == getCurrentCommandBuffer() && "Can't resume render pass on command buffer from a different frame");
+
+        beginRenderPass(commandBuffer, contents, true);
+    }
+
+
+
+    void Renderer::beginRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents, bool resume)
+    {
+#ifdef VK_KHR_dynamic_rendering
+        if (swapChain->usesDynamicRendering()) {
+            beginSwapChainRendering(commandBuffer, contents, resume);
+            return;
+        }
+#endif
     
+        // both passes are compatible, framebuffers and pipelines work with either
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = swapChain->getRenderPass();
+        renderPassInfo.renderPass = resume ? swapChain->getResumeRenderPass() : swapChain->getRenderPass();
         renderPassInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex);
 
         renderPassInfo.renderArea.offset = { 0, 0 };
@@ -166,8 +368,151 @@ namespace LeMU {
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+        // only vkCmdExecuteCommands is allowed in a render pass with secondary contents,
+        // secondary command buffers set their own dynamic state
+        if (contents == VK_SUBPASS_CONTENTS_INLINE)
+            setViewportAndScissor(commandBuffer);
+    }
 
+
+
+#ifdef VK_KHR_dynamic_rendering
+    void Renderer::beginSwapChainRendering(VkCommandBuffer commandBuffer, VkSubpassContents contents, bool resume)
+    {
+        if (resume) {
+            // endSwapChainRenderPass moved color to present layout, depth was left as an attachment
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = swapChain->getImage(currentImageIndex);
+            barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+        else {
+            // without a render pass the layout transitions are ours, previous contents are discarded
+            std::array<VkImageMemoryBarrier, 2> barriers{};
+            barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barriers[0].srcAccessMask = 0;
+            barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[0].image = swapChain->getImage(currentImageIndex);
+            barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            // depth is written by the previous frame that used this image, its writes have to be
+            // made available before the transition and this frame's writes
+            barriers[1] = barriers[0];
+            barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            barriers[1].image = swapChain->getDepthImage(currentImageIndex);
+            barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+            // color waits on the acquire semaphore, which is signalled at COLOR_ATTACHMENT_OUTPUT,
+            // depth of the previous frame using this image may still be tested
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                0, 0, nullptr, 0, nullptr,
+                static_cast<uint32_t>(barriers.size()), barriers.data());
+        }
+
+        VkRenderingAttachmentInfoKHR colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        colorAttachment.imageView = swapChain->getImageView(currentImageIndex);
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = resume ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue.color = { 0.1f, 0.1f, 0.1f, 1.0f };
+
+        VkRenderingAttachmentInfoKHR depthAttachment{};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        depthAttachment.imageView = swapChain->getDepthImageView(currentImageIndex);
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = resume ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;   // may be read before the pass is resumed
+        depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+        VkRenderingInfoKHR renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+        renderingInfo.flags = contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+            ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+        renderingInfo.renderArea.offset = { 0, 0 };
+        renderingInfo.renderArea.extent = swapChain->getSwapChainExtent();
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+
+        device.cmdBeginRendering(commandBuffer, &renderingInfo);
+
+        if (contents == VK_SUBPASS_CONTENTS_INLINE)
+            setViewportAndScissor(commandBuffer);
+    }
+#endif
+
+
+
+    VkCommandBuffer Renderer::beginSecondaryCommandBuffer(uint32_t threadIndex)
+    {
+        assert(isFrameStarted && "Can't begin secondary command buffer if frame is not in progress");
+
+        VkCommandBuffer commandBuffer = getFrameCommandPool(threadIndex).getSecondaryCommandBuffer();
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = swapChain->getRenderPass();
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex);
+
+#ifdef VK_KHR_dynamic_rendering
+        // no render pass to inherit, the attachment formats are given instead
+        VkFormat colorFormat = swapChain->getSwapChainImageFormat();
+        VkCommandBufferInheritanceRenderingInfoKHR renderingInheritance{};
+        renderingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+        renderingInheritance.colorAttachmentCount = 1;
+        renderingInheritance.pColorAttachmentFormats = &colorFormat;
+        renderingInheritance.depthAttachmentFormat = swapChain->getSwapChainDepthFormat();
+        renderingInheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        if (swapChain->usesDynamicRendering()) {
+            inheritanceInfo.renderPass = VK_NULL_HANDLE;
+            inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+            inheritanceInfo.pNext = &renderingInheritance;
+        }
+#endif
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+            throw std::runtime_error("failed to begin recording secondary command buffer!");
+
+        // dynamic state is not inherited from the primary command buffer
+        setViewportAndScissor(commandBuffer);
+        return commandBuffer;
+    }
+
+
+
+    void Renderer::setViewportAndScissor(VkCommandBuffer commandBuffer)
+    {
         VkViewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
@@ -186,8 +531,43 @@ namespace LeMU {
         assert(isFrameStarted && "Can't call endSwapChainRenderPass if frame is not in progress");
         assert(commandBuffer == getCurrentCommandBuffer() && "Can't end render pass on command buffer from a different frame");
 
+#ifdef VK_KHR_dynamic_rendering
+        if (swapChain->usesDynamicRendering()) {
+            device.cmdEndRendering(commandBuffer);
+
+            // the render pass did this as its final layout transition
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = swapChain->getImage(currentImageIndex);
+            barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &barrier);
+            return;
+        }
+#endif
+
         vkCmdEndRenderPass(commandBuffer);
     }
 
 
+
+    RenderTargetInfo Renderer::getSwapChainRenderTarget() const
+    {
+        RenderTargetInfo renderTarget{};
+        renderTarget.renderPass = swapChain->getRenderPass();
+        renderTarget.colorFormat = swapChain->getSwapChainImageFormat();
+        renderTarget.depthFormat = swapChain->getSwapChainDepthFormat();
+        return renderTarget;
+    }
+
+
 }
\ No newline at end of file
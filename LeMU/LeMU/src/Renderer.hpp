@@ -1,11 +1,19 @@
 #pragma once
 
+#include "CommandPool.hpp"
+#include "DeletionQueue.hpp"
+#include "Descriptor.hpp"
 #include "Device.hpp"
+#include "FrameStats.hpp"
+#include "Pipeline.hpp"
+#include "PipelineCache.hpp"
+#include "ShaderCompiler.hpp"
 #include "SwapChain.hpp"
 #include "window.hpp"
 
 
 // std
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -14,45 +22,153 @@ namespace LeMU {
 	class Renderer {
 	public:
 
-		Renderer(Window &window, Device &device);
+		// recordingThreadCount: number of threads that record command buffers,
+		// every frame-in-flight gets one transient command pool per thread
+		Renderer(Window &window, Device &device, uint32_t recordingThreadCount = 1, const SwapChainConfig &config = {});
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer& operator=(const Renderer&) = delete;
 
 		inline VkRenderPass getSwapChainRenderPass() const { return swapChain->getRenderPass(); }
+		// what pipelines drawing to the swap chain are created against, render pass is
+		// VK_NULL_HANDLE when the swap chain uses dynamic rendering
+		RenderTargetInfo getSwapChainRenderTarget() const;
+		inline bool usesDynamicRendering() const { return swapChain->usesDynamicRendering(); }
+		// swap chain images can be written with vkCmdBlitImage / vkCmdCopyImage
+		inline bool canTransferToSwapChain() const { return (swapChain->getImageUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0; }
 		inline bool isFrameInProgress()const { return isFrameStarted; };
 
 		inline float getAspectRatio() const { return swapChain->extentAspectRatio(); }
+		inline VkExtent2D getSwapChainExtent() const { return swapChain->getSwapChainExtent(); }
+
+		// image acquired by beginFrame, only valid while the frame is in progress
+		inline VkImage getCurrentSwapChainImage() const { return swapChain->getImage(currentImageIndex); }
+		inline VkImageView getCurrentSwapChainImageView() const { return swapChain->getImageView(currentImageIndex); }
+		inline VkImage getCurrentDepthImage() const { return swapChain->getDepthImage(currentImageIndex); }
+		inline VkImageView getCurrentDepthImageView() const { return swapChain->getDepthImageView(currentImageIndex); }
 
 		VkCommandBuffer getCurrentCommandBuffer() const;
 
 		int getFrameIndex() const;
 
+		inline uint32_t getRecordingThreadCount() const { return recordingThreadCount; }
+		inline uint32_t getFramesInFlight() const { return swapChain->getFramesInFlight(); }
+		inline size_t getSwapChainImageCount() const { return swapChain->imageCount(); }
+
+		// change frames in flight / image count at runtime, per-frame command pools and
+		// synchronization objects are reallocated. Waits for the device, not meant for every frame
+		void setSwapChainConfig(const SwapChainConfig &config);
+
+		// time from beginFrame until the GPU has finished the frame and it can be presented. Taken from
+		// a timestamp at the end of the frame placed on the CPU clock with calibrated timestamps, without
+		// them from when the frame's fence is seen signaled, which is polled once per beginFrame/endFrame
+		inline const FrameStats& getLatencyStats() const { return latencyStats; }
+		inline void resetLatencyStats() { latencyStats.reset(); }
+
+		// command pool of the current frame for the given recording thread (0 is the main thread)
+		FrameCommandPool& getFrameCommandPool(uint32_t threadIndex);
+
+		// layouts shared by every render system
+		inline DescriptorLayoutCache& getDescriptorLayoutCache() { return descriptorLayoutCache; }
+
+		// GLSL sources to SPIR-V, cached on disk
+		inline ShaderCompiler& getShaderCompiler() { return shaderCompiler; }
+
+		// graphics pipelines and pipeline layouts shared by every render system
+		inline PipelineCache& getPipelineCache() { return pipelineCache; }
+
+		// sets that only live for the current frame, the pools are reset in bulk when the frame slot
+		// comes around again. Main thread only
+		DescriptorAllocator& getFrameDescriptorAllocator();
+
 		// acquire next image, begin command buffer
 		VkCommandBuffer beginFrame();
 		
 		// end command buffer, submit command buffer
 		void endFrame();
 
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// contents: VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS when draws are recorded on worker threads
+		void beginSwapChainRenderPass(
+			VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		// begin the swap chain render pass again after endSwapChainRenderPass in the same frame,
+		// color and depth are kept. Whatever ran in between must leave the depth image in
+		// VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		void resumeSwapChainRenderPass(
+			VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+
+		// secondary command buffer continuing the swap chain render pass, from the pool of threadIndex
+		// viewport and scissor are already set, the caller ends it with vkEndCommandBuffer
+		VkCommandBuffer beginSecondaryCommandBuffer(uint32_t threadIndex);
+
+		// number of frames submitted so far, and the newest frame known to be finished on the GPU
+		inline uint64_t getSubmittedFrameCount() const { return submittedFrames; }
+		uint64_t getCompletedFrameCount() const;
+
+		// destroy an object once every frame submitted up to now has completed
+		void deferDestroy(std::function<void()>&& deleter);
+
 
 	private:
-		void createCommandBuffers();
-		void freeCommandBuffers();
+		void createFrameCommandPools();
+		void createFrameDescriptorAllocators();
 		void recreateSwapChain();
+		void setViewportAndScissor(VkCommandBuffer commandBuffer);
+		void beginRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents, bool resume);
+#ifdef VK_KHR_dynamic_rendering
+		void beginSwapChainRendering(VkCommandBuffer commandBuffer, VkSubpassContents contents, bool resume);
+#endif
+		void releaseRetiredSwapChains(uint64_t completedFrame);
+		void createLatencyQueryPool();
+		void collectFrameLatencies();
 
 
 		Window &window;
 		Device &device;
 		std::unique_ptr<SwapChain> swapChain;
-		std::vector<VkCommandBuffer> commandBuffers;
+
+		// [frame in flight][recording thread]
+		std::vector<std::vector<std::unique_ptr<FrameCommandPool>>> framePools;
+		uint32_t recordingThreadCount;
+		VkCommandBuffer currentCommandBuffer = VK_NULL_HANDLE;
+
+		DescriptorLayoutCache descriptorLayoutCache;
+		ShaderCompiler shaderCompiler;
+		PipelineCache pipelineCache;
+		std::vector<std::unique_ptr<DescriptorAllocator>> frameDescriptorAllocators;
+
+		// objects waiting for their frames to complete
+		DeletionQueue deletionQueue;
+
+		// swap chains replaced by recreateSwapChain. A present of their images may still be pending and
+		// presents are not tracked by frame fences, so they are kept until an image of a newer swap chain
+		// has been presented and the frames in flight after it have completed
+		struct RetiredSwapChain {
+			std::shared_ptr<SwapChain> swapChain;
+			uint64_t releaseFrame = 0;		// 0 until a newer swap chain has presented
+		};
+		std::vector<RetiredSwapChain> retiredSwapChains;
 
 		// keep track of current frame
-		uint32_t currentImageIndex;
-		int currentFrameIndex;
-		bool isFrameStarted;
+		uint32_t currentImageIndex = 0;
+		int currentFrameIndex = 0;
+		bool isFrameStarted = false;
+		uint64_t submittedFrames = 0;
+
+		SwapChainConfig swapChainConfig;
+
+		// CPU start time of the frame submitted from each slot, pending until its fence signals
+		std::vector<std::chrono::high_resolution_clock::time_point> frameStartTimes;
+		std::vector<bool> frameLatencyPending;
+		std::chrono::high_resolution_clock::time_point currentFrameStartTime;
+		FrameStats latencyStats;
+
+		// one timestamp per frame slot written when the frame's commands are done,
+		// VK_NULL_HANDLE without timestamps or calibrated timestamps
+		VkQueryPool latencyQueryPool = VK_NULL_HANDLE;
+		float timestampPeriod = 0.0f;	// nanoseconds per tick
+		uint64_t timestampMask = 0;		// valid bits of the graphics queue
 	};
 }  // namespace lve
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "pch.h"
+
+#include "ShaderCompiler.hpp"
+
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace LeMU {
+
+    namespace {
+
+        // bump when the compile options change, old cache entries stop matching
+        constexpr const char* CACHE_VERSION = "lemu-spirv-1";
+
+        constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+        std::once_flag glslangInitialized;
+
+        // FNV-1a, stable across runs and platforms unlike std::hash
+        void hashBytes(uint64_t& hash, const void* data, size_t size)
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3ull;
+            }
+        }
+
+        void hashString(uint64_t& hash, const std::string& value)
+        {
+            // the terminator keeps "ab" + "c" apart from "a" + "bc"
+            hashBytes(hash, value.c_str(), value.size() + 1);
+        }
+
+        bool readBinaryFile(const std::string& filepath, std::vector<char>& bytes)
+        {
+            std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
+            if (!file.is_open()) return false;
+
+            bytes.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(bytes.data(), bytes.size());
+            return static_cast<bool>(file);
+        }
+
+        bool toSpirv(const std::vector<char>& bytes, std::vector<uint32_t>& spirv)
+        {
+            if (bytes.empty() || bytes.size() % sizeof(uint32_t) != 0) return false;
+
+            spirv.resize(bytes.size() / sizeof(uint32_t));
+            std::copy(bytes.begin(), bytes.end(), reinterpret_cast<char*>(spirv.data()));
+            return spirv[0] == SPIRV_MAGIC;
+        }
+
+        bool stageFromPath(const std::filesystem::path& path, EShLanguage& stage)
+        {
+            std::string extension = path.extension().string();
+            if (extension == ".vert") stage = EShLangVertex;
+            else if (extension == ".frag") stage = EShLangFragment;
+            else if (extension == ".comp") stage = EShLangCompute;
+            else return false;
+            return true;
+        }
+    }
+
+    ShaderCompiler::ShaderCompiler(const std::string& cacheDirectory)
+        : cacheDirectory{ cacheDirectory }
+    {
+    }
+
+
+
+    std::vector<uint32_t> ShaderCompiler::load(const std::string& filepath, const std::vector<std::string>& defines)
+    {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            stats.requests++;
+        }
+
+        std::filesystem::path path{ filepath };
+        std::vector<uint32_t> spirv;
+
+        // prebuilt SPIR-V, e.g. from compile.bat
+        if (path.extension() == ".spv")
+        {
+            std::vector<char> bytes;
+            if (!readBinaryFile(filepath, bytes)) throw std::runtime_error("failed to open file: " + filepath);
+            if (!toSpirv(bytes, spirv)) throw std::runtime_error("not a SPIR-V file: " + filepath);
+            return spirv;
+        }
+
+        EShLanguage stage;
+        if (!stageFromPath(path, stage)) throw std::runtime_error("unknown shader stage of " + filepath);
+
+        std::vector<std::string> includeStack;
+        std::vector<std::string> includedFiles;
+        std::string source = expandIncludes(filepath, 0, includeStack, includedFiles);
+
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            auto& sourceIncludes = includes[normalizePath(filepath)];
+            sourceIncludes.clear();
+            for (const auto& included : includedFiles) sourceIncludes.push_back(normalizePath(included));
+        }
+
+        uint64_t hash = 0xcbf29ce484222325ull;
+        hashString(hash, CACHE_VERSION);
+        hashBytes(hash, &stage, sizeof(stage));
+        for (const auto& define : defines) hashString(hash, define);
+        hashString(hash, source);
+
+        char hashText[17];
+        std::snprintf(hashText, sizeof(hashText), "%016llx", static_cast<unsigned long long>(hash));
+        std::string cachePath = (std::filesystem::path{ cacheDirectory } /
+            (path.filename().string() + "-" + hashText + ".spv")).string();
+
+        if (readCache(cachePath, spirv))
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            stats.cacheHits++;
+            return spirv;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        try
+        {
+            spirv = compileSource(stage, source, filepath, defines);
+        }
+        catch (const std::runtime_error& e)
+        {
+            // glslang reports locations as <source string>:<line>, the included files are numbered from 1
+            std::string message = e.what();
+            message += "source strings: 0 " + filepath;
+            for (size_t i = 0; i < includedFiles.size(); i++)
+                message += ", " + std::to_string(i + 1) + " " + includedFiles[i];
+            throw std::runtime_error(message);
+        }
+        float milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+
+        writeCache(cachePath, spirv);
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        stats.compiled++;
+        stats.compileMilliseconds += milliseconds;
+        return spirv;
+    }
+
+
+
+    void ShaderCompiler::precompile(const std::vector<std::string>& filepaths, JobSystem& jobSystem)
+    {
+        if (filepaths.empty()) return;
+
+        // compile times differ a lot between shaders, one chunk per file balances them
+        std::mutex logMutex;
+        jobSystem.parallelFor(filepaths.size(), static_cast<uint32_t>(filepaths.size()),
+            [&](size_t begin, size_t end, uint32_t)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    try
+                    {
+                        load(filepaths[i]);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        std::lock_guard<std::mutex> lock{ logMutex };
+                        std::cerr << e.what() << std::endl;
+                    }
+                }
+            });
+    }
+
+
+
+    std::vector<uint32_t> ShaderCompiler::compileSource(
+        EShLanguage stage,
+        const std::string& source,
+        const std::string& name,
+        const std::vector<std::string>& defines)
+    {
+        // process wide glslang state, the shaders and programs below are per call so threads don't share any
+        std::call_once(glslangInitialized, []() { glslang::InitializeProcess(); });
+
+        std::string preamble;
+        for (auto define : defines)
+        {
+            std::replace(define.begin(), define.end(), '=', ' ');
+            preamble += "#define " + define + "\n";
+        }
+
+        const char* text = source.c_str();
+        const char* names[] = { name.c_str() };
+
+        glslang::TShader shader{ stage };
+        shader.setStringsWithLengthsAndNames(&text, nullptr, names, 1);
+        shader.setPreamble(preamble.c_str());
+
+        // same target as glslc without options, so the SPIR-V matches what compile.bat produced
+        shader.setEnvInput(glslang::EShSourceGlsl, stage, glslang::EShClientVulkan, 100);
+        shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_0);
+        shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_0);
+
+        EShMessages messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+
+        if (!shader.parse(GetDefaultResources(), 100, false, messages))
+            throw std::runtime_error("failed to compile shader " + name + "!\n" + shader.getInfoLog());
+
+        glslang::TProgram program;
+        program.addShader(&shader);
+        if (!program.link(messages))
+            throw std::runtime_error("failed to link shader " + name + "!\n" + program.getInfoLog());
+
+        std::vector<uint32_t> spirv;
+        glslang::SpvOptions options{};
+        glslang::GlslangToSpv(*program.getIntermediate(stage), spirv, &options);
+        return spirv;
+    }
+
+
+
+    std::string ShaderCompiler::expandIncludes(
+        const std::string& filepath,
+        int sourceId,
+        std::vector<std::string>& includeStack,
+        std::vector<std::string>& includedFiles)
+    {
+        if (std::find(includeStack.begin(), includeStack.end(), filepath) != includeStack.end())
+            throw std::runtime_error("include cycle through " + filepath);
+
+        std::ifstream file{ filepath };
+        if (!file.is_open()) throw std::runtime_error("failed to open file: " + filepath);
+
+        includeStack.push_back(filepath);
+
+        std::filesystem::path directory = std::filesystem::path{ filepath }.parent_path();
+        std::string expanded;
+        std::string line;
+        int lineNumber = 0;
+
+        while (std::getline(file, line))
+        {
+            lineNumber++;
+
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                expanded += line + "\n";
+                continue;
+            }
+
+            size_t open = line.find('"', start);
+            size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+            if (close == std::string::npos)
+                throw std::runtime_error(filepath + ":" + std::to_string(lineNumber) + ": expected #include \"file\"");
+
+            std::string included = (directory / line.substr(open + 1, close - open - 1)).string();
+            includedFiles.push_back(included);
+            int includedId = static_cast<int>(includedFiles.size());
+
+            // errors inside the include are reported against its own lines, errors after it against this file's
+            expanded += "#line 1 " + std::to_string(includedId) + "\n";
+            expanded += expandIncludes(included, includedId, includeStack, includedFiles);
+            expanded += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceId) + "\n";
+        }
+
+        includeStack.pop_back();
+        return expanded;
+    }
+
+
+
+    bool ShaderCompiler::readCache(const std::string& cachePath, std::vector<uint32_t>& spirv) const
+    {
+        std::vector<char> bytes;
+        return readBinaryFile(cachePath, bytes) && toSpirv(bytes, spirv);
+    }
+
+
+    void ShaderCompiler::writeCache(const std::string& cachePath, const std::vector<uint32_t>& spirv) const
+    {
+        // written aside and renamed, a reader never sees half a file. Another thread compiling the
+        // same shader writes the same bytes, whichever rename comes last wins
+        std::error_code error;
+        std::filesystem::create_directories(cacheDirectory, error);
+
+        std::ostringstream tempPath;
+        tempPath << cachePath << ".tmp" << std::hash<std::thread::id>()(std::this_thread::get_id());
+
+        {
+            std::ofstream file{ tempPath.str(), std::ios::binary | std::ios::trunc };
+            if (!file.is_open()) return;
+            file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+        }
+
+        std::filesystem::rename(tempPath.str(), cachePath, error);
+        if (error) std::filesystem::remove(tempPath.str(), error);
+    }
+
+
+
+    std::unordered_set<std::string> ShaderCompiler::getDependents(const std::vector<std::string>& files) const
+    {
+        std::unordered_set<std::string> changed;
+        for (const auto& file : files) changed.insert(normalizePath(file));
+        std::unordered_set<std::string> dependents = changed;
+
+        // includes are recorded transitively, one pass finds sources including a file at any depth
+        std::lock_guard<std::mutex> lock{ mutex };
+        for (const auto& entry : includes)
+        {
+            for (const auto& included : entry.second)
+            {
+                if (changed.count(included) != 0)
+                {
+                    dependents.insert(entry.first);
+                    break;
+                }
+            }
+        }
+        return dependents;
+    }
+
+
+    std::string ShaderCompiler::normalizePath(const std::string& filepath)
+    {
+        return std::filesystem::path{ filepath }.lexically_normal().generic_string();
+    }
+
+
+
+    ShaderCompiler::Stats ShaderCompiler::getStats() const
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        return stats;
+    }
+
+
+    void ShaderCompiler::printStats(const std::string& label) const
+    {
+        Stats current = getStats();
+        std::cout << label << ": " << current.requests << " shaders loaded"
+            << ", " << current.cacheHits << " from the SPIR-V cache"
+            << ", " << current.compiled << " compiled in " << current.compileMilliseconds << " ms" << std::endl;
+    }
+}  // namespace lve
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "JobSystem.hpp"
+
+#include <glslang/Public/ShaderLang.h>
+
+// std
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace LeMU {
+
+	// GLSL to SPIR-V with glslang at runtime, results are kept in an on-disk cache. A cache file is named
+	// after the hash of the source with its includes expanded plus the defines, so a shader nothing
+	// changed in is read back instead of compiled, and an edit to the shader or anything it includes
+	// misses the cache
+	class ShaderCompiler {
+	public:
+		static constexpr const char* DEFAULT_CACHE_DIRECTORY = "shaders/cache";
+
+		struct Stats {
+			size_t requests = 0;				// load calls
+			size_t cacheHits = 0;				// sources read back from the cache
+			size_t compiled = 0;				// sources compiled by glslang
+			float compileMilliseconds = 0.0f;	// glslang time of the compiled ones
+		};
+
+		ShaderCompiler(const std::string &cacheDirectory = DEFAULT_CACHE_DIRECTORY);
+
+		ShaderCompiler(const ShaderCompiler&) = delete;
+		ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+		// SPIR-V of a shader file: .spv files are read as they are, .vert, .frag and .comp sources are
+		// compiled or taken from the cache. defines are NAME or NAME=VALUE. Throws with the glslang log
+		// when a source does not compile. Safe to call from several threads
+		std::vector<uint32_t> load(const std::string &filepath, const std::vector<std::string> &defines = {});
+
+		// load every file on the job system, one job per file, and return once all are done so the
+		// cache is warm before pipelines are created. Compile errors are logged, the pipeline using
+		// the shader throws them again when it is created
+		void precompile(const std::vector<std::string> &filepaths, JobSystem &jobSystem);
+
+		// compile without the cache, name only labels the errors
+		static std::vector<uint32_t> compileSource(
+			EShLanguage stage,
+			const std::string &source,
+			const std::string &name,
+			const std::vector<std::string> &defines = {});
+
+		// the GLSL sources loaded so far that are one of files or include one of them, plus files
+		// themselves. Paths are normalized
+		std::unordered_set<std::string> getDependents(const std::vector<std::string> &files) const;
+
+		// same spelling for every path naming a file, e.g. shaders/a/../b.vert is shaders/b.vert
+		static std::string normalizePath(const std::string &filepath);
+
+		Stats getStats() const;
+
+		// cache hits and compile time since startup
+		void printStats(const std::string &label) const;
+
+	private:
+		// contents of filepath with every #include "file" line replaced by that file, which is looked
+		// up next to the file including it. includeStack catches include cycles, includedFiles
+		// collects every file included on the way. Every included file gets the source string number
+		// of its position in includedFiles plus one, #line directives switch to it and back to sourceId
+		static std::string expandIncludes(
+			const std::string &filepath,
+			int sourceId,
+			std::vector<std::string> &includeStack,
+			std::vector<std::string> &includedFiles);
+
+		bool readCache(const std::string &cachePath, std::vector<uint32_t> &spirv) const;
+		void writeCache(const std::string &cachePath, const std::vector<uint32_t> &spirv) const;
+
+		std::string cacheDirectory;
+
+		mutable std::mutex mutex;	// stats and includes
+		Stats stats{};
+		std::unordered_map<std::string, std::vector<std::string>> includes;	// normalized source path to its includes
+	};
+}  // namespace lve
@@ -0,0 +1,114 @@
+#include "pch.h"
+
+#include "ShadowCascades.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace LeMU {
+
+    namespace {
+
+        // any turn of the light moves every shadow, only float noise is ignored
+        constexpr float SAME_DIRECTION_COS = 0.999999f;
+
+        // radii are rounded up to this, so float noise in the projection doesn't resize a region
+        constexpr float RADIUS_STEP = 1.0f / 16.0f;
+    }
+
+
+
+    ShadowCascades::ShadowCascades(const ShadowCascadeSettings& settings)
+        : settings{ settings }
+    {
+        assert(settings.cascadeCount > 0 && settings.cascadeCount <= MAX_SHADOW_CASCADES && "Invalid shadow cascade count");
+        assert(settings.resolution > 0 && "Shadow maps can't be empty");
+    }
+
+
+
+    float ShadowCascades::getTexelSize(uint32_t index) const
+    {
+        return 2.0f * regions[index].halfExtent / settings.resolution;
+    }
+
+
+
+    uint32_t ShadowCascades::update(const Camera& camera, const glm::vec3& lightDirection)
+    {
+        // near, far and the field of view from the projection, see LightClusterGrid::build
+        const glm::mat4& projection = camera.getProjectionMatrix();
+        assert(projection[2][3] == 1.0f && "Shadow cascades need a perspective projection");
+
+        float nearPlane = -projection[3][2] / projection[2][2];
+        float farPlane = projection[3][2] / (1.0f - projection[2][2]);
+        float tanHalfFovX = 1.0f / projection[0][0];
+        float tanHalfFovY = 1.0f / projection[1][1];
+        float cornerSlopeSquared = tanHalfFovX * tanHalfFovX + tanHalfFovY * tanHalfFovY;
+        float shadowFar = std::min(farPlane, settings.maxDistance);
+
+        glm::mat4 inverseView = glm::inverse(camera.getViewMatrix());
+
+        bool lightMoved = glm::dot(lightDirection, regionLightDirection) < SAME_DIRECTION_COS;
+        regionLightDirection = lightDirection;
+
+        // the light's orientation, the regions are boxes in its view space
+        Camera lightView{};
+        glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3{ 0.0f, 0.0f, 1.0f } : glm::vec3{ 0.0f, -1.0f, 0.0f };
+        lightView.setViewDirection(glm::vec3{ 0.0f }, lightDirection, up);
+
+        uint32_t dirtyCount = 0;
+        float sliceNear = nearPlane;
+        for (uint32_t i = 0; i < settings.cascadeCount; i++)
+        {
+            float t = static_cast<float>(i + 1) / settings.cascadeCount;
+            float logSplit = nearPlane * std::pow(shadowFar / nearPlane, t);
+            float linearSplit = nearPlane + (shadowFar - nearPlane) * t;
+            float sliceFar = settings.splitLambda * logSplit + (1.0f - settings.splitLambda) * linearSplit;
+
+            // smallest sphere around the slice's corners is centered on the view axis, at the depth
+            // equally far from the near and far corners, or on the far face for wide slices
+            float centerDepth = std::min((cornerSlopeSquared + 1.0f) * (sliceNear + sliceFar) * 0.5f, sliceFar);
+            float nearDistance = centerDepth - sliceNear;
+            float farDistance = sliceFar - centerDepth;
+            float radius = std::sqrt(std::max(
+                cornerSlopeSquared * sliceNear * sliceNear + nearDistance * nearDistance,
+                cornerSlopeSquared * sliceFar * sliceFar + farDistance * farDistance));
+            radius = std::ceil(radius / RADIUS_STEP) * RADIUS_STEP;
+
+            glm::vec3 center{ inverseView * glm::vec4{ 0.0f, 0.0f, centerDepth, 1.0f } };
+            glm::vec3 lightCenter{ lightView.getViewMatrix() * glm::vec4{ center, 1.0f } };
+            float halfExtent = radius * (1.0f + settings.stableMargin);
+
+            Region& region = regions[i];
+            glm::vec3 offset = glm::abs(lightCenter - region.center);
+            bool fits = region.valid && !lightMoved && region.halfExtent == halfExtent &&
+                std::max({ offset.x, offset.y, offset.z }) + radius <= halfExtent;
+
+            if (!fits)
+            {
+                float texelSize = 2.0f * halfExtent / settings.resolution;
+                region.center = glm::floor(lightCenter / texelSize + 0.5f) * texelSize;
+                region.halfExtent = halfExtent;
+                region.valid = true;
+            }
+
+            Cascade& cascade = cascades[i];
+            cascade.staticDirty = !fits || invalidated || !settings.cacheStaticCasters;
+            cascade.splitDepth = sliceFar;
+            cascade.lightCamera = lightView;
+            cascade.lightCamera.setOrthographicProjection(
+                region.center.x - halfExtent, region.center.x + halfExtent,
+                region.center.y - halfExtent, region.center.y + halfExtent,
+                region.center.z - halfExtent - settings.casterDistance, region.center.z + halfExtent);
+
+            dirtyCount += cascade.staticDirty ? 1 : 0;
+            sliceNear = sliceFar;
+        }
+
+        invalidated = false;
+        return dirtyCount;
+    }
+}  // namespace lve
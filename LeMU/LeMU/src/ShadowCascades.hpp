@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Camera.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+
+namespace LeMU {
+
+	constexpr uint32_t MAX_SHADOW_CASCADES = 4;
+
+	// the main light of the scene, infinitely far away
+	struct DirectionalLight {
+		glm::vec3 direction{ 0.4f, 1.0f, 0.3f };	// the light travels along it, normalized, y is down
+		glm::vec3 color{ 1.0f };
+		float intensity = 1.0f;
+	};
+
+	struct ShadowCascadeSettings {
+		uint32_t cascadeCount = 4;		// at most MAX_SHADOW_CASCADES
+		uint32_t resolution = 2048;		// texels per side of each cascade map
+		float maxDistance = 40.0f;		// the last cascade ends here, or at the far plane if it is nearer
+		float splitLambda = 0.75f;		// 0 splits the depth range evenly, 1 logarithmically
+		float stableMargin = 0.25f;		// share of a cascade's radius the camera can move before its static map is redrawn
+		float casterDistance = 50.0f;	// how far towards the light of a cascade casters are still drawn into it
+		bool cacheStaticCasters = true;	// false redraws the static casters of every cascade every frame
+	};
+
+	// cascades of a directional light fitted to slices of the camera's view. Each cascade covers a region
+	// a margin wider than the bounding sphere of its slice, centered on a texel of its own map, and keeps it
+	// while the sphere stays inside. The static casters drawn into it stay valid as long as the region and
+	// the light don't change. A region that has to move is centered on the nearest texel again, so the
+	// static shadows of the new region land on the same texel grid and don't shimmer. The sphere's radius
+	// only depends on the projection, so a region keeps its size however the camera moves or turns
+	class ShadowCascades {
+	public:
+		struct Cascade {
+			Camera lightCamera;			// orthographic projection of the cached region
+			float splitDepth = 0.0f;	// view space depth the cascade ends at
+			bool staticDirty = true;	// the static casters have to be drawn again this frame
+		};
+
+		ShadowCascades(const ShadowCascadeSettings &settings = {});
+
+		// fit the cascades to camera's perspective projection and view, and decide which static maps have
+		// to be redrawn. lightDirection is normalized. Returns the number of cascades whose static map is dirty
+		uint32_t update(const Camera &camera, const glm::vec3 &lightDirection);
+
+		// static casters were added, removed or moved, every static map is redrawn by the next update
+		inline void invalidate() { invalidated = true; }
+
+		inline uint32_t getCascadeCount() const { return settings.cascadeCount; }
+		inline const Cascade& getCascade(uint32_t index) const { return cascades[index]; }
+		inline const ShadowCascadeSettings& getSettings() const { return settings; }
+
+		// size of a texel of the cascade in world units
+		float getTexelSize(uint32_t index) const;
+
+	private:
+		// the cached region, in the light's view space
+		struct Region {
+			glm::vec3 center{ 0.0f };
+			float halfExtent = 0.0f;
+			bool valid = false;
+		};
+
+		ShadowCascadeSettings settings;
+		std::array<Cascade, MAX_SHADOW_CASCADES> cascades{};
+		std::array<Region, MAX_SHADOW_CASCADES> regions{};
+		glm::vec3 regionLightDirection{ 0.0f };
+		bool invalidated = true;
+	};
+}  // namespace lve
@@ -0,0 +1,364 @@
+#include "pch.h"
+
+#include "SoftwareOcclusion.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LEMU_OCCLUSION_X86
+#include <immintrin.h>
+#endif
+
+// msvc emits AVX instructions for intrinsics without /arch:AVX, gcc and clang need the target attribute
+#if defined(LEMU_OCCLUSION_X86) && (defined(__GNUC__) || defined(__clang__))
+#define LEMU_TARGET_AVX __attribute__((target("avx")))
+#else
+#define LEMU_TARGET_AVX
+#endif
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace LeMU {
+
+    std::shared_ptr<OccluderMesh> OccluderMesh::createBox(const glm::vec3& min, const glm::vec3& max)
+    {
+        auto mesh = std::make_shared<OccluderMesh>();
+        for (uint32_t corner = 0; corner < 8; corner++)
+        {
+            mesh->positions.push_back({
+                (corner & 1) ? max.x : min.x,
+                (corner & 2) ? max.y : min.y,
+                (corner & 4) ? max.z : min.z });
+        }
+
+        // two triangles per face, corner bits are x / y / z
+        mesh->indices = {
+            0, 2, 6,  0, 6, 4,		// -x
+            1, 5, 7,  1, 7, 3,		// +x
+            0, 4, 5,  0, 5, 1,		// -y
+            2, 3, 7,  2, 7, 6,		// +y
+            0, 1, 3,  0, 3, 2,		// -z
+            4, 6, 7,  4, 7, 5 };	// +z
+        return mesh;
+    }
+
+
+
+    SoftwareOcclusionBuffer::SoftwareOcclusionBuffer(CullingKernel kernel)
+        : kernel{kernel}, depth(WIDTH * HEIGHT, 1.0f)
+    {
+    }
+
+
+
+    void SoftwareOcclusionBuffer::render(const glm::mat4& viewProjection, std::vector<GameObject>& objects, JobSystem* jobSystem)
+    {
+        this->viewProjection = viewProjection;
+        std::fill(depth.begin(), depth.end(), 1.0f);
+
+        uint32_t chunkCount = jobSystem ? jobSystem->getThreadCount() : 1;
+        if (setupScratch.size() < chunkCount) setupScratch.resize(chunkCount);
+        for (auto& triangles : setupScratch) triangles.clear();
+
+        auto setup = [&](size_t begin, size_t end, uint32_t chunkIndex) {
+            for (size_t i = begin; i < end; i++)
+            {
+                auto& object = objects[i];
+                if (object.occluder)
+                    setupObject(*object.occluder, viewProjection * object.transform.mat4(), setupScratch[chunkIndex]);
+            }
+        };
+
+        // bands cover disjoint rows, so their jobs never write the same pixel
+        auto rasterize = [&](size_t begin, size_t end, uint32_t) {
+            for (size_t band = begin; band < end; band++) rasterizeBand(static_cast<uint32_t>(band));
+        };
+
+        if (jobSystem)
+        {
+            jobSystem->parallelFor(objects.size(), chunkCount, setup);
+            jobSystem->parallelFor(BAND_COUNT, rasterize);
+        }
+        else
+        {
+            setup(0, objects.size(), 0);
+            rasterize(0, BAND_COUNT, 0);
+        }
+
+        triangleCount = 0;
+        for (auto& triangles : setupScratch) triangleCount += triangles.size();
+    }
+
+
+
+    void SoftwareOcclusionBuffer::setupObject(const OccluderMesh& mesh, const glm::mat4& modelViewProjection, std::vector<Triangle>& triangles) const
+    {
+        std::vector<glm::vec4> clip(mesh.positions.size());
+        for (size_t i = 0; i < clip.size(); i++)
+            clip[i] = modelViewProjection * glm::vec4(mesh.positions[i], 1.0f);
+
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            const glm::vec4 corners[3] = { clip[mesh.indices[i]], clip[mesh.indices[i + 1]], clip[mesh.indices[i + 2]] };
+
+            if (corners[0].z >= 0.0f && corners[1].z >= 0.0f && corners[2].z >= 0.0f)
+            {
+                setupTriangle(corners[0], corners[1], corners[2], triangles);
+                continue;
+            }
+
+            // clip against the near plane (z = 0), a triangle becomes at most a quad
+            glm::vec4 polygon[4];
+            int polygonSize = 0;
+            for (int edge = 0; edge < 3; edge++)
+            {
+                const glm::vec4& from = corners[edge];
+                const glm::vec4& to = corners[(edge + 1) % 3];
+                if (from.z >= 0.0f) polygon[polygonSize++] = from;
+                if ((from.z >= 0.0f) != (to.z >= 0.0f))
+                    polygon[polygonSize++] = from + (to - from) * (from.z / (from.z - to.z));
+            }
+
+            for (int corner = 2; corner < polygonSize; corner++)
+                setupTriangle(polygon[0], polygon[corner - 1], polygon[corner], triangles);
+        }
+    }
+
+
+
+    void SoftwareOcclusionBuffer::setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, std::vector<Triangle>& triangles) const
+    {
+        // clip space to pixels, y down like the framebuffer
+        auto toScreen = [](const glm::vec4& v) {
+            return glm::vec3{
+                (v.x / v.w * 0.5f + 0.5f) * WIDTH,
+                (v.y / v.w * 0.5f + 0.5f) * HEIGHT,
+                v.z / v.w };
+        };
+        const glm::vec3 v[3] = { toScreen(a), toScreen(b), toScreen(c) };
+
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+        if (std::abs(area) < 1e-6f) return;
+
+        Triangle triangle{};
+
+        // pixels are sampled at their centers
+        float minX = std::min({ v[0].x, v[1].x, v[2].x }), maxX = std::max({ v[0].x, v[1].x, v[2].x });
+        float minY = std::min({ v[0].y, v[1].y, v[2].y }), maxY = std::max({ v[0].y, v[1].y, v[2].y });
+        triangle.minX = std::max(0, static_cast<int>(std::ceil(minX - 0.5f)));
+        triangle.maxX = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(std::floor(maxX - 0.5f)));
+        triangle.minY = std::max(0, static_cast<int>(std::ceil(minY - 0.5f)));
+        triangle.maxY = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+
+        // both windings are drawn, flip the edges of clockwise triangles
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        for (int edge = 0; edge < 3; edge++)
+        {
+            const glm::vec3& from = v[edge];
+            const glm::vec3& to = v[(edge + 1) % 3];
+            triangle.edgeX[edge] = sign * (from.y - to.y);
+            triangle.edgeY[edge] = sign * (to.x - from.x);
+            triangle.edgeC[edge] = sign * (from.x * to.y - from.y * to.x);
+        }
+
+        // depth after the perspective divide is linear in screen space
+        float dz1 = v[1].z - v[0].z, dz2 = v[2].z - v[0].z;
+        triangle.depthPlane.x = (dz1 * (v[2].y - v[0].y) - dz2 * (v[1].y - v[0].y)) / area;
+        triangle.depthPlane.y = (dz2 * (v[1].x - v[0].x) - dz1 * (v[2].x - v[0].x)) / area;
+        triangle.depthPlane.z = v[0].z - triangle.depthPlane.x * v[0].x - triangle.depthPlane.y * v[0].y;
+
+        triangles.push_back(triangle);
+    }
+
+
+
+    void SoftwareOcclusionBuffer::rasterizeBand(uint32_t band)
+    {
+        int bandMinY = static_cast<int>(band * BAND_HEIGHT);
+        int bandMaxY = bandMinY + static_cast<int>(BAND_HEIGHT) - 1;
+
+        for (auto& triangles : setupScratch)
+        {
+            for (auto& triangle : triangles)
+            {
+                int minY = std::max(triangle.minY, bandMinY);
+                int maxY = std::min(triangle.maxY, bandMaxY);
+                if (minY > maxY) continue;
+
+#ifdef LEMU_OCCLUSION_X86
+                if (kernel == CullingKernel::AVX)
+                {
+                    rasterizeAVX(triangle, minY, maxY);
+                    continue;
+                }
+#endif
+                rasterizeScalar(triangle, minY, maxY);
+            }
+        }
+    }
+
+
+
+    void SoftwareOcclusionBuffer::rasterizeScalar(const Triangle& triangle, int minY, int maxY)
+    {
+        for (int y = minY; y <= maxY; y++)
+        {
+            // same evaluation order as the AVX kernel, so both cover the same pixels
+            float pixelY = y + 0.5f;
+            glm::vec3 rowEdges = triangle.edgeY * pixelY + triangle.edgeC;
+            float rowZ = triangle.depthPlane.y * pixelY + triangle.depthPlane.z;
+
+            for (int x = triangle.minX; x <= triangle.maxX; x++)
+            {
+                float pixelX = x + 0.5f;
+                glm::vec3 edges = triangle.edgeX * pixelX + rowEdges;
+                if (edges.x < 0.0f || edges.y < 0.0f || edges.z < 0.0f) continue;
+
+                float z = triangle.depthPlane.x * pixelX + rowZ;
+                float& stored = tileRow(x, y)[x % TILE_WIDTH];
+                stored = std::min(stored, z);
+            }
+        }
+    }
+
+
+
+    bool SoftwareOcclusionBuffer::isRectHiddenScalar(int minX, int maxX, int minY, int maxY, float nearest) const
+    {
+        for (int y = minY; y <= maxY; y++)
+        {
+            for (int x = minX; x <= maxX; x++)
+            {
+                if (tileRow(x, y)[x % TILE_WIDTH] >= nearest) return false;
+            }
+        }
+        return true;
+    }
+
+
+#ifdef LEMU_OCCLUSION_X86
+    LEMU_TARGET_AVX void SoftwareOcclusionBuffer::rasterizeAVX(const Triangle& triangle, int minY, int maxY)
+    {
+        // lanes stay inside the buffer, tile rows never cross its right edge. Lanes left or right
+        // of the triangle's bounds fail the edge test like any other pixel outside it
+        const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        const int firstX = triangle.minX & ~static_cast<int>(TILE_WIDTH - 1);
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            float pixelY = y + 0.5f;
+            __m256 rowE0 = _mm256_set1_ps(triangle.edgeY.x * pixelY + triangle.edgeC.x);
+            __m256 rowE1 = _mm256_set1_ps(triangle.edgeY.y * pixelY + triangle.edgeC.y);
+            __m256 rowE2 = _mm256_set1_ps(triangle.edgeY.z * pixelY + triangle.edgeC.z);
+            __m256 rowZ = _mm256_set1_ps(triangle.depthPlane.y * pixelY + triangle.depthPlane.z);
+
+            for (int x = firstX; x <= triangle.maxX; x += TILE_WIDTH)
+            {
+                __m256 pixelX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets);
+
+                __m256 e0 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.edgeX.x), pixelX), rowE0);
+                __m256 e1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.edgeX.y), pixelX), rowE1);
+                __m256 e2 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.edgeX.z), pixelX), rowE2);
+                __m256 inside = _mm256_and_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+                    _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+                if (_mm256_movemask_ps(inside) == 0) continue;
+
+                __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.depthPlane.x), pixelX), rowZ);
+
+                float* row = tileRow(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+                __m256 stored = _mm256_loadu_ps(row);
+                _mm256_storeu_ps(row, _mm256_blendv_ps(stored, _mm256_min_ps(stored, z), inside));
+            }
+        }
+    }
+
+
+    LEMU_TARGET_AVX bool SoftwareOcclusionBuffer::isRectHiddenAVX(int minX, int maxX, int minY, int maxY, float nearest) const
+    {
+        const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        const __m256 first = _mm256_set1_ps(static_cast<float>(minX));
+        const __m256 last = _mm256_set1_ps(static_cast<float>(maxX));
+        const __m256 nearestDepth = _mm256_set1_ps(nearest);
+        const int firstX = minX & ~static_cast<int>(TILE_WIDTH - 1);
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            for (int x = firstX; x <= maxX; x += TILE_WIDTH)
+            {
+                __m256 pixelX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lanes);
+                __m256 covered = _mm256_and_ps(_mm256_cmp_ps(pixelX, first, _CMP_GE_OQ), _mm256_cmp_ps(pixelX, last, _CMP_LE_OQ));
+
+                // any covered pixel with nothing in front of the box makes it visible
+                __m256 stored = _mm256_loadu_ps(tileRow(static_cast<uint32_t>(x), static_cast<uint32_t>(y)));
+                __m256 open = _mm256_and_ps(covered, _mm256_cmp_ps(stored, nearestDepth, _CMP_GE_OQ));
+                if (_mm256_movemask_ps(open) != 0) return false;
+            }
+        }
+        return true;
+    }
+#endif
+
+
+
+    bool SoftwareOcclusionBuffer::isBoxVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& modelMatrix) const
+    {
+        glm::mat4 modelViewProjection = viewProjection * modelMatrix;
+
+        float minX = WIDTH, maxX = 0.0f, minY = HEIGHT, maxY = 0.0f;
+        float nearest = 1.0f;
+        for (uint32_t corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 clip = modelViewProjection * glm::vec4{
+                (corner & 1) ? boundsMax.x : boundsMin.x,
+                (corner & 2) ? boundsMax.y : boundsMin.y,
+                (corner & 4) ? boundsMax.z : boundsMin.z,
+                1.0f };
+            if (clip.z < 0.0f || clip.w <= 0.0f) return true;
+
+            float x = (clip.x / clip.w * 0.5f + 0.5f) * WIDTH;
+            float y = (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearest = std::min(nearest, clip.z / clip.w);
+        }
+
+        // every pixel the rectangle touches, not only the ones whose center it covers
+        int pixelMinX = std::max(0, static_cast<int>(std::floor(minX)));
+        int pixelMaxX = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(std::ceil(maxX)) - 1);
+        int pixelMinY = std::max(0, static_cast<int>(std::floor(minY)));
+        int pixelMaxY = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(std::ceil(maxY)) - 1);
+
+        // off screen boxes are left to frustum culling
+        if (pixelMinX > pixelMaxX || pixelMinY > pixelMaxY) return true;
+
+#ifdef LEMU_OCCLUSION_X86
+        if (kernel == CullingKernel::AVX)
+            return !isRectHiddenAVX(pixelMinX, pixelMaxX, pixelMinY, pixelMaxY, nearest);
+#endif
+        return !isRectHiddenScalar(pixelMinX, pixelMaxX, pixelMinY, pixelMaxY, nearest);
+    }
+
+
+
+    bool SoftwareOcclusionBuffer::isVisible(GameObject& object) const
+    {
+        if (!object.model || object.occluder) return true;
+
+        const auto& bounds = object.model->getBounds();
+        return isBoxVisible(bounds.min, bounds.max, object.transform.mat4());
+    }
+
+
+
+    float SoftwareOcclusionBuffer::getDepth(uint32_t x, uint32_t y) const
+    {
+        assert(x < WIDTH && y < HEIGHT && "pixel outside the occlusion buffer");
+        return tileRow(x, y)[x % TILE_WIDTH];
+    }
+}  // namespace lve
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Culling.hpp"
+#include "GameObject.hpp"
+#include "JobSystem.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace LeMU {
+
+	// low poly stand-in of an object, rasterized into the software occlusion buffer. It has to lie
+	// inside the geometry it stands for, or it hides objects that are actually visible
+	struct OccluderMesh {
+		std::vector<glm::vec3> positions;	// object space
+		std::vector<uint32_t> indices;		// triangle list, either winding
+
+		static std::shared_ptr<OccluderMesh> createBox(const glm::vec3 &min, const glm::vec3 &max);
+	};
+
+
+
+	// low resolution depth buffer filled on the CPU with the occluder meshes of the scene, object
+	// bounding boxes are tested against it before their draws are recorded. No GPU readback, so the
+	// result is available in the same frame. Depth is [0, 1] with nearer objects smaller.
+	// The buffer is stored in TILE_WIDTH x TILE_HEIGHT tiles, a tile row is one 8 wide vector
+	class SoftwareOcclusionBuffer {
+	public:
+		static constexpr uint32_t WIDTH = 256;
+		static constexpr uint32_t HEIGHT = 128;
+		static constexpr uint32_t TILE_WIDTH = 8;
+		static constexpr uint32_t TILE_HEIGHT = 4;
+		static constexpr uint32_t BAND_HEIGHT = 16;		// rows rasterized by one job
+		static constexpr uint32_t BAND_COUNT = HEIGHT / BAND_HEIGHT;
+
+		// the AVX kernel processes a tile row per iteration, SSE falls back to the scalar kernel
+		SoftwareOcclusionBuffer(CullingKernel kernel = detectCullingKernel());
+
+		SoftwareOcclusionBuffer(const SoftwareOcclusionBuffer&) = delete;
+		SoftwareOcclusionBuffer& operator=(const SoftwareOcclusionBuffer&) = delete;
+
+		// clear to the far plane and rasterize every object with an occluder mesh as seen through
+		// viewProjection. Triangle setup is split across objects and rasterization across horizontal
+		// bands of the buffer on the job system, jobSystem nullptr does everything on this thread
+		void render(const glm::mat4 &viewProjection, std::vector<GameObject> &objects, JobSystem *jobSystem = nullptr);
+
+		// false if the world space box of model bounds transformed by modelMatrix is behind the
+		// occluders everywhere it covers. Boxes crossing the near plane are always visible
+		bool isBoxVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::mat4 &modelMatrix) const;
+
+		// objects without a model are never hidden, neither are occluders, they would hide themselves
+		bool isVisible(GameObject &object) const;
+
+		// nearest occluder depth at pixel (x, y), y grows downwards like framebuffer coordinates
+		float getDepth(uint32_t x, uint32_t y) const;
+
+		inline void setKernel(CullingKernel kernel) { this->kernel = kernel; }
+		inline CullingKernel getKernel() const { return kernel; }
+
+		// triangles that reached rasterization in the last render, after near plane clipping
+		inline size_t getTriangleCount() const { return triangleCount; }
+
+	private:
+		// screen space triangle, edge functions are positive inside whatever the winding was
+		struct Triangle {
+			glm::vec3 edgeX;		// edge i is edgeX[i] * x + edgeY[i] * y + edgeC[i]
+			glm::vec3 edgeY;
+			glm::vec3 edgeC;
+			glm::vec3 depthPlane;	// depth is x * depthPlane.x + y * depthPlane.y + depthPlane.z
+			int minX, maxX, minY, maxY;	// pixel bounds, inclusive and clamped to the buffer
+		};
+
+		// clip space triangles of one object to screen space triangles appended to triangles
+		void setupObject(const OccluderMesh &mesh, const glm::mat4 &modelViewProjection, std::vector<Triangle> &triangles) const;
+		void setupTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c, std::vector<Triangle> &triangles) const;
+
+		void rasterizeBand(uint32_t band);
+		void rasterizeScalar(const Triangle &triangle, int minY, int maxY);
+		void rasterizeAVX(const Triangle &triangle, int minY, int maxY);
+
+		// true if every pixel of the inclusive rectangle has an occluder nearer than nearest
+		bool isRectHiddenScalar(int minX, int maxX, int minY, int maxY, float nearest) const;
+		bool isRectHiddenAVX(int minX, int maxX, int minY, int maxY, float nearest) const;
+
+		inline float* tileRow(uint32_t x, uint32_t y) {
+			return &depth[((y / TILE_HEIGHT) * (WIDTH / TILE_WIDTH) + x / TILE_WIDTH) * TILE_WIDTH * TILE_HEIGHT + (y % TILE_HEIGHT) * TILE_WIDTH];
+		}
+		inline const float* tileRow(uint32_t x, uint32_t y) const {
+			return &depth[((y / TILE_HEIGHT) * (WIDTH / TILE_WIDTH) + x / TILE_WIDTH) * TILE_WIDTH * TILE_HEIGHT + (y % TILE_HEIGHT) * TILE_WIDTH];
+		}
+
+		CullingKernel kernel;
+		glm::mat4 viewProjection{ 1.0f };
+		std::vector<float> depth;
+		std::vector<std::vector<Triangle>> setupScratch;	// one per setup chunk
+		size_t triangleCount = 0;
+	};
+}  // namespace lve
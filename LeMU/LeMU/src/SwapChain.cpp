@@ -1,29 +1,33 @@
+#include "pch.h"
+
 #include "SwapChain.hpp"
 
 
 #include "Image.hpp"
-#include "Descriptor.hpp"
 
 // std
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <set>
 #include <stdexcept>
 
 
 namespace LeMU {
 
-    SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent)
-        : device{ deviceRef }, windowExtent{ extent } {
+    SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, const SwapChainConfig& config)
+        : device{ deviceRef }, windowExtent{ extent }, config{ config } {
         init();
     }
 
 
-    SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, std::shared_ptr<SwapChain> previous)
-        : device{ deviceRef }, windowExtent{ extent }, oldSwapChain{ previous }
+    SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, std::shared_ptr<SwapChain> previous, const SwapChainConfig& config)
+        : device{ deviceRef }, windowExtent{ extent }, config{ config }, oldSwapChain{ previous }
     {
         init();
 
@@ -33,13 +37,93 @@ namespace LeMU {
 
     void SwapChain::init()
     {
+        assert(config.framesInFlight > 0 && "Swap chain needs at least one frame in flight");
+
         createSwapChain();
         createImageViews();
-        createRenderPass();
-        createDepthResources();
-        createFramebuffers();
-        createSyncObjects();
-        createUniformBuffer();
+        swapChainDepthFormat = findDepthFormat();
+        timelineSync = config.useTimelineSemaphore && device.getFeatures().timelineSemaphore;
+        dynamicRendering = config.useDynamicRendering && device.getFeatures().dynamicRendering;
+
+        // resources of the retired swap chain are reused whenever possible,
+        // so that a resize does not rebuild everything
+        if (!dynamicRendering && !adoptRenderPass()) createRenderPass();
+        if (!adoptDepthResources()) createDepthResources();
+        if (!dynamicRendering) createFramebuffers();
+        if (!adoptSyncObjects()) createSyncObjects();
+    }
+
+
+
+    bool SwapChain::adoptRenderPass()
+    {
+        if (oldSwapChain == nullptr || oldSwapChain->renderPass == VK_NULL_HANDLE) return false;
+
+        // render pass only depends on attachment formats, not on extent
+        if (oldSwapChain->swapChainImageFormat != swapChainImageFormat ||
+            oldSwapChain->swapChainDepthFormat != swapChainDepthFormat) return false;
+
+        renderPass = oldSwapChain->renderPass;
+        resumeRenderPass = oldSwapChain->resumeRenderPass;
+        oldSwapChain->renderPass = VK_NULL_HANDLE;  // ownership moved, old swap chain must not destroy it
+        oldSwapChain->resumeRenderPass = VK_NULL_HANDLE;
+        return true;
+    }
+
+
+
+    bool SwapChain::adoptDepthResources()
+    {
+        if (oldSwapChain == nullptr || oldSwapChain->depthImages.size() != imageCount()) return false;
+        if (oldSwapChain->swapChainDepthFormat != swapChainDepthFormat) return false;
+
+        // only reallocate when the extent grows, a larger depth image can back a smaller framebuffer
+        if (oldSwapChain->depthExtent.width < swapChainExtent.width ||
+            oldSwapChain->depthExtent.height < swapChainExtent.height) return false;
+
+        depthImages = std::move(oldSwapChain->depthImages);
+        depthImageMemorys = std::move(oldSwapChain->depthImageMemorys);
+        depthImageViews = std::move(oldSwapChain->depthImageViews);
+        depthExtent = oldSwapChain->depthExtent;
+
+        oldSwapChain->depthImages.clear();
+        oldSwapChain->depthImageMemorys.clear();
+        oldSwapChain->depthImageViews.clear();
+        return true;
+    }
+
+
+
+    bool SwapChain::adoptSyncObjects()
+    {
+        if (oldSwapChain == nullptr || oldSwapChain->imageAvailableSemaphores.empty()) return false;
+        if (oldSwapChain->timelineSync != timelineSync) return false;
+        if (oldSwapChain->imageAvailableSemaphores.size() != config.framesInFlight) return false;
+
+        // frames submitted through the old swap chain are still in flight, keep waiting on their
+        // fences / timeline values
+        imageAvailableSemaphores = std::move(oldSwapChain->imageAvailableSemaphores);
+        oldSwapChain->imageAvailableSemaphores.clear();
+        currentFrame = oldSwapChain->currentFrame;
+
+        if (timelineSync)
+        {
+            frameTimelineValues = std::move(oldSwapChain->frameTimelineValues);
+            oldSwapChain->frameTimelineValues.clear();
+
+            // one per image, the old ones may still be waited on by a pending present
+            createRenderFinishedSemaphores();
+        }
+        else
+        {
+            renderFinishedSemaphores = std::move(oldSwapChain->renderFinishedSemaphores);
+            inFlightFences = std::move(oldSwapChain->inFlightFences);
+            oldSwapChain->renderFinishedSemaphores.clear();
+            oldSwapChain->inFlightFences.clear();
+
+            imagesInFlight.assign(imageCount(), VK_NULL_HANDLE);
+        }
+        return true;
     }
 
 
@@ -65,20 +149,13 @@ namespace LeMU {
             vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
         }
 
-        vkDestroyRenderPass(device.device(), renderPass, nullptr);
-
-        // cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
-            vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(device.device(), inFlightFences[i], nullptr);
-        }
+        if (renderPass != VK_NULL_HANDLE) vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        if (resumeRenderPass != VK_NULL_HANDLE) vkDestroyRenderPass(device.device(), resumeRenderPass, nullptr);
 
-        for (size_t i = 0; i < swapChainImages.size(); i++)
-        {
-            vkDestroyBuffer(device.device(), uniformBuffers[i], nullptr);
-            vkFreeMemory(device.device(), uniformBufferMemory[i], nullptr);
-        }
+        // cleanup synchronization objects, empty if they were handed over to a new swap chain
+        for (auto semaphore : renderFinishedSemaphores) vkDestroySemaphore(device.device(), semaphore, nullptr);
+        for (auto semaphore : imageAvailableSemaphores) vkDestroySemaphore(device.device(), semaphore, nullptr);
+        for (auto fence : inFlightFences) vkDestroyFence(device.device(), fence, nullptr);
     }
 
     bool SwapChain::compareSwapFormats(const SwapChain& swapChain) const
@@ -90,12 +167,18 @@ namespace LeMU {
 
 
     VkResult SwapChain::acquireNextImage(uint32_t* imageIndex) {
-        vkWaitForFences(
-            device.device(),
-            1,
-            &inFlightFences[currentFrame],
-            VK_TRUE,
-            std::numeric_limits<uint64_t>::max());
+        if (timelineSync) {
+            // the only CPU wait of the frame: the last frame submitted from this slot has completed
+            device.waitForFrameValue(frameTimelineValues[currentFrame]);
+        }
+        else {
+            vkWaitForFences(
+                device.device(),
+                1,
+                &inFlightFences[currentFrame],
+                VK_TRUE,
+                std::numeric_limits<uint64_t>::max());
+        }
 
         VkResult result = vkAcquireNextImageKHR(
             device.device(),
@@ -108,11 +191,20 @@ namespace LeMU {
         return result;
     }
 
-    VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) {
-        if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-            vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+    bool SwapChain::isFrameComplete(size_t frame) {
+        if (timelineSync) return device.getCompletedFrameValue() >= frameTimelineValues[frame];
+        return vkGetFenceStatus(device.device(), inFlightFences[frame]) == VK_SUCCESS;
+    }
+
+    VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, uint64_t frameValue) {
+        // with binary sync an image may still be used by an older frame from a different slot.
+        // Timeline sync doesn't need this: per-image present semaphores and the slot wait cover it
+        if (!timelineSync) {
+            if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+                vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+            }
+            imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
         }
-        imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
 
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -126,21 +218,49 @@ namespace LeMU {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
 
-        VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
+        VkSemaphore presentSemaphore = timelineSync ? renderFinishedSemaphores[*imageIndex] : renderFinishedSemaphores[currentFrame];
+
+        // binary semaphore for present, plus the frame timeline in timeline mode
+        VkSemaphore signalSemaphores[] = { presentSemaphore, device.getFrameTimeline() };
+        uint64_t signalValues[] = { 0, frameValue };   // value of the binary semaphore is ignored
+        uint64_t waitValues[] = { 0 };
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        timelineInfo.signalSemaphoreValueCount = 2;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+        // uploads submit to the same queue from other threads
+        std::lock_guard<std::mutex> lock(device.getQueueMutex());
+
+        if (timelineSync) {
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.signalSemaphoreCount = 2;
+            frameTimelineValues[currentFrame] = frameValue;
+
+            if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
+        }
+        else {
+            submitInfo.signalSemaphoreCount = 1;
+
+            vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
+            if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
         }
 
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &presentSemaphore;
 
         VkSwapchainKHR swapChains[] = { swapChain };
         presentInfo.swapchainCount = 1;
@@ -150,7 +270,7 @@ namespace LeMU {
 
         auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % config.framesInFlight;
 
         return result;
     }
@@ -159,10 +279,13 @@ namespace LeMU {
         SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
         uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        if (config.imageCount > 0)
+            imageCount = std::max(config.imageCount, swapChainSupport.capabilities.minImageCount);
+
         if (swapChainSupport.capabilities.maxImageCount > 0 &&
             imageCount > swapChainSupport.capabilities.maxImageCount) {
             imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -177,7 +300,10 @@ namespace LeMU {
         createInfo.imageColorSpace = surfaceFormat.colorSpace;
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
-        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // images can also be the target of a blit, e.g. the upscale of a scene rendered at a lower resolution
+        imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+            (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        createInfo.imageUsage = imageUsage;
 
         QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
         uint32_t queueFamilyIndices[] = { indices.graphicsFamily, indices.presentFamily };
@@ -225,14 +351,20 @@ namespace LeMU {
     }
 
     void SwapChain::createRenderPass() {
+        renderPass = createSwapChainRenderPass(false);
+        resumeRenderPass = createSwapChainRenderPass(true);
+    }
+
+    VkRenderPass SwapChain::createSwapChainRenderPass(bool resume) {
+        // depth is stored, it can be read between the first pass and the resumed one (depth pyramid)
         VkAttachmentDescription depthAttachment{};
         depthAttachment.format = findDepthFormat();
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.loadOp = resume ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.initialLayout = resume ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
         depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
         VkAttachmentReference depthAttachmentRef{};
@@ -242,11 +374,11 @@ namespace LeMU {
         VkAttachmentDescription colorAttachment = {};
         colorAttachment.format = getSwapChainImageFormat();
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.loadOp = resume ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.initialLayout = resume ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
         colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentRef = {};
@@ -268,6 +400,13 @@ namespace LeMU {
         dependency.srcAccessMask = 0;
         dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 
+        // the loaded color comes from the first pass of this frame, depth is synchronized by
+        // whoever read it in between
+        if (resume) {
+            dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+        }
+
         std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
         VkRenderPassCreateInfo renderPassInfo = {};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -278,9 +417,11 @@ namespace LeMU {
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
 
-        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        VkRenderPass pass;
+        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &pass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
+        return pass;
     }
 
     void SwapChain::createFramebuffers() {
@@ -312,6 +453,7 @@ namespace LeMU {
         VkFormat depthFormat = findDepthFormat();
         swapChainDepthFormat = depthFormat;
         VkExtent2D swapChainExtent = getSwapChainExtent();
+        depthExtent = swapChainExtent;
 
         depthImages.resize(imageCount());
         depthImageMemorys.resize(imageCount());
@@ -329,7 +471,7 @@ namespace LeMU {
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
@@ -358,10 +500,7 @@ namespace LeMU {
     }
 
     void SwapChain::createSyncObjects() {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+        imageAvailableSemaphores.resize(config.framesInFlight);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -370,12 +509,41 @@ namespace LeMU {
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < config.framesInFlight; i++) {
             if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
-                VK_SUCCESS ||
-                vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-                VK_SUCCESS ||
-                vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+                VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+
+        if (timelineSync) {
+            // frame value 0 is signaled from the start, a fresh slot never waits
+            frameTimelineValues.assign(config.framesInFlight, 0);
+        }
+        else {
+            inFlightFences.resize(config.framesInFlight);
+            imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+
+            for (size_t i = 0; i < config.framesInFlight; i++) {
+                if (vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create synchronization objects for a frame!");
+                }
+            }
+        }
+
+        createRenderFinishedSemaphores();
+    }
+
+    void SwapChain::createRenderFinishedSemaphores() {
+        // timeline sync: one per image, free again once the image is re-acquired
+        // binary sync: one per frame in flight, guarded by the frame fence
+        renderFinishedSemaphores.resize(timelineSync ? imageCount() : config.framesInFlight);
+
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        for (auto& semaphore : renderFinishedSemaphores) {
+            if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
         }
@@ -395,22 +563,30 @@ namespace LeMU {
 
     VkPresentModeKHR SwapChain::chooseSwapPresentMode(
         const std::vector<VkPresentModeKHR>& availablePresentModes) {
+        VkPresentModeKHR chosenMode = VK_PRESENT_MODE_FIFO_KHR;
         for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                std::cout << "Present mode: Mailbox" << std::endl;
-                return availablePresentMode;
+            if (availablePresentMode == config.presentMode) {
+                chosenMode = availablePresentMode;
+                break;
             }
         }
 
-        // for (const auto &availablePresentMode : availablePresentModes) {
-        //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-        //     std::cout << "Present mode: Immediate" << std::endl;
-        //     return availablePresentMode;
-        //   }
-        // }
+        switch (chosenMode) {
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            std::cout << "Present mode: Mailbox" << std::endl;
+            break;
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            std::cout << "Present mode: Immediate" << std::endl;
+            break;
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            std::cout << "Present mode: Relaxed V-Sync" << std::endl;
+            break;
+        default:
+            std::cout << "Present mode: V-Sync" << std::endl;
+            break;
+        }
 
-        std::cout << "Present mode: V-Sync" << std::endl;
-        return VK_PRESENT_MODE_FIFO_KHR;
+        return chosenMode;
     }
 
     VkExtent2D SwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
@@ -434,30 +610,9 @@ namespace LeMU {
         return device.findSupportedFormat(
             { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
             VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
     }
 
 
 
-    void SwapChain::createUniformBuffer()
-    {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-        uniformBuffers.resize(swapChainImages.size());
-        uniformBufferMemory.resize(swapChainImages.size());
-
-        for (size_t i = 0; i < swapChainImages.size(); i++)
-        {
-            device.createBuffer(
-                bufferSize,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                uniformBuffers[i],
-                uniformBufferMemory[i]);
-        }
-    }
-
-
-
-
 }  // namespace lve
\ No newline at end of file
@@ -12,12 +12,26 @@
 
 namespace LeMU {
 
+    // runtime settings, trade throughput against input latency per deployment
+    struct SwapChainConfig {
+        uint32_t framesInFlight = 2;    // frames the CPU may record ahead of the GPU
+        uint32_t imageCount = 0;        // requested presentable images, 0 picks minImageCount + 1
+
+        // preferred present mode, falls back to FIFO (always supported) if unavailable
+        // FIFO / FIFO_RELAXED: v-synced, MAILBOX: low latency, no tearing, IMMEDIATE: may tear
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+
+        // synchronize frames with the device frame timeline instead of per-frame fences, if supported
+        bool useTimelineSemaphore = true;
+
+        // render with VK_KHR_dynamic_rendering, no render pass or framebuffers, if supported
+        bool useDynamicRendering = true;
+    };
+
     class SwapChain {
     public:
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-        SwapChain(Device& deviceRef, VkExtent2D windowExtent);
-        SwapChain(Device& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
+        SwapChain(Device& deviceRef, VkExtent2D windowExtent, const SwapChainConfig& config = {});
+        SwapChain(Device& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous, const SwapChainConfig& config = {});
         ~SwapChain();
 
         SwapChain(const SwapChain&) = delete;
@@ -25,7 +39,13 @@ namespace LeMU {
 
         VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
         VkRenderPass getRenderPass() { return renderPass; }
+        // compatible with getRenderPass, loads color and depth instead of clearing them
+        VkRenderPass getResumeRenderPass() { return resumeRenderPass; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+        VkImage getImage(int index) { return swapChainImages[index]; }
+        VkImage getDepthImage(int index) { return depthImages[index]; }
+        VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+        VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat; }
         size_t imageCount() { return swapChainImages.size(); }
         VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
         VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -38,11 +58,26 @@ namespace LeMU {
         VkFormat findDepthFormat();
 
         VkResult acquireNextImage(uint32_t* imageIndex);
-        VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+        // frameValue: frame number, signaled on the device frame timeline when the frame completes
+        VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, uint64_t frameValue);
 
         bool compareSwapFormats(const SwapChain& swapChain) const;
 
-        
+        // index of the frame-in-flight slot used by the next acquire/submit
+        size_t getCurrentFrame() const { return currentFrame; }
+        uint32_t getFramesInFlight() const { return config.framesInFlight; }
+        VkPresentModeKHR getPresentMode() const { return presentMode; }
+        bool usesTimelineSemaphore() const { return timelineSync; }
+
+        // no render pass / framebuffers in this mode, getRenderPass() returns VK_NULL_HANDLE
+        bool usesDynamicRendering() const { return dynamicRendering; }
+        // COLOR_ATTACHMENT, plus TRANSFER_DST where the surface supports it
+        VkImageUsageFlags getImageUsage() const { return imageUsage; }
+        const SwapChainConfig& getConfig() const { return config; }
+
+        // non-blocking check whether the last submission of a frame slot has finished on the GPU
+        bool isFrameComplete(size_t frame);
+
 
     private:
         void init();
@@ -50,9 +85,16 @@ namespace LeMU {
         void createImageViews();
         void createDepthResources();
         void createRenderPass();
+        VkRenderPass createSwapChainRenderPass(bool resume);
         void createFramebuffers();
-        void createUniformBuffer();
         void createSyncObjects();
+        void createRenderFinishedSemaphores();
+
+        // take over resources of the retired swap chain that are still valid for this one,
+        // return false if they have to be created from scratch
+        bool adoptRenderPass();
+        bool adoptDepthResources();
+        bool adoptSyncObjects();
 
         // Helper functions
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(
@@ -61,21 +103,26 @@ namespace LeMU {
             const std::vector<VkPresentModeKHR>& availablePresentModes);
         VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
+        VkPresentModeKHR presentMode;
         VkFormat swapChainImageFormat;
         VkFormat swapChainDepthFormat;
         VkExtent2D swapChainExtent;
+        VkImageUsageFlags imageUsage = 0;
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
-        VkRenderPass renderPass;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkRenderPass resumeRenderPass = VK_NULL_HANDLE;
 
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
         std::vector<VkImageView> depthImageViews;
+        VkExtent2D depthExtent{};   // depth images can be larger than the swap chain extent
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
 
         Device& device;
         VkExtent2D windowExtent;
+        SwapChainConfig config;
 
         VkSwapchainKHR swapChain;
         std::shared_ptr<SwapChain> oldSwapChain;
@@ -86,8 +133,10 @@ namespace LeMU {
         std::vector<VkFence> imagesInFlight;
         size_t currentFrame = 0;
 
-        std::vector<VkBuffer> uniformBuffers;
-        std::vector<VkDeviceMemory> uniformBufferMemory;
+        // timeline sync replaces the fences: frame value last submitted from each slot
+        bool timelineSync = false;
+        bool dynamicRendering = false;
+        std::vector<uint64_t> frameTimelineValues;
     };
 
 }  // namespace lve
\ No newline at end of file
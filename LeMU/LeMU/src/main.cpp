@@ -1,21 +1,36 @@
 #include "pch.h"
 
+#include "App.hpp"
+#include "Benchmarks.hpp"
 
-struct ShaderModule
-{
-    std::vector<unsigned int> SPIRV;
-    VkShaderModule shaderModule;
-};
+// std
+#include <string>
 
 
+// LeMU                         runs the app
+// LeMU --benchmark <name>      runs one of the benchmarks instead
+int main(int argc, char* argv[]) {
 
-size_t CompileShader(glslang_stage_t stage, const char* shaderSource, ShaderModule& shaderModule)
-{
-
-}
-
+    std::string benchmark;
+    bool validArguments = argc == 1;
+    if (argc == 3 && std::string(argv[1]) == "--benchmark")
+    {
+        benchmark = argv[2];
+        for (const std::string& name : LeMU::Benchmarks::getNames())
+        {
+            if (name == benchmark) validArguments = true;
+        }
+    }
 
-int main() {
+    if (!validArguments)
+    {
+        std::cerr << "usage: " << argv[0] << " [--benchmark <name>]\nbenchmarks:\n";
+        for (const std::string& name : LeMU::Benchmarks::getNames())
+        {
+            std::cerr << "    " << name << '\n';
+        }
+        return EXIT_FAILURE;
+    }
 
     // simple lambda to catch potential errors
     glfwSetErrorCallback(
@@ -28,10 +43,23 @@ int main() {
     // GLFW init
     if (!glfwInit()) exit(EXIT_FAILURE);
 
-    
-   
-
-    
+    try
+    {
+        LeMU::FirstApp app{};
+        if (benchmark.empty())
+        {
+            app.run();
+        }
+        else
+        {
+            app.runBenchmark(benchmark);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
     
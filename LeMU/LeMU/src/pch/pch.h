@@ -4,7 +4,7 @@
 #include <GLFW/glfw3.h>
 
 
-#define STB_IMAGE_IMPLEMENTATION
+// the implementation is compiled into Image.cpp
 #include <stb_image.h>
 
 #include <vulkan/vulkan.h>
@@ -16,6 +16,8 @@
 
 
 
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm.hpp>
 
 
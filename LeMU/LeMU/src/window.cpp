@@ -1,3 +1,5 @@
+#include "pch.h"
+
 #include "window.hpp"
 
 // std
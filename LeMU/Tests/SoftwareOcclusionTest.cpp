@@ -0,0 +1,81 @@
+// known visibility cases of the software occlusion buffer, no window or GPU needed.
+// Exits with EXIT_FAILURE if any case comes out wrong with any kernel
+
+#include "SoftwareOcclusion.hpp"
+#include "Camera.hpp"
+
+// std
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace LeMU;
+
+
+
+int main()
+{
+    // a wall 5 units ahead of the camera, boxes behind it, in front of it, past its edge and around the camera
+    Camera camera{};
+    camera.setViewYXZ(glm::vec3{ 0.0f }, glm::vec3{ 0.0f });
+    camera.setPerspectiveProjection(glm::radians(50.0f), 2.0f, 0.1f, 50.0f);
+    const glm::mat4 viewProjection = camera.getProjectionMatrix() * camera.getViewMatrix();
+
+    const glm::vec3 boundsMin{ -1.0f };
+    const glm::vec3 boundsMax{ 1.0f };
+
+    std::vector<GameObject> scene;
+    auto wall = GameObject::createGameObject();
+    wall.occluder = OccluderMesh::createBox(boundsMin, boundsMax);
+    wall.transform.translation = { 0.0f, 0.0f, 5.0f };
+    wall.transform.scale = { 3.0f, 2.0f, 0.1f };
+    scene.push_back(std::move(wall));
+
+    struct Case {
+        const char* name;
+        glm::vec3 position;
+        float scale;
+        bool visible;
+    };
+    const Case cases[] = {
+        { "straight behind", { 0.0f, 0.0f, 8.0f }, 0.3f, false },
+        { "far behind", { 0.0f, 1.5f, 20.0f }, 0.3f, false },
+        { "in front", { 0.0f, 0.0f, 3.0f }, 0.3f, true },
+        { "beside", { 6.0f, 0.0f, 8.0f }, 0.3f, true },
+        { "past the edge", { 5.0f, 0.0f, 8.0f }, 0.5f, true },
+        { "across the near plane", { 0.0f, 0.0f, 0.0f }, 0.5f, true } };
+
+    JobSystem jobSystem{ 4 };
+    SoftwareOcclusionBuffer occlusionBuffer{};
+
+    size_t wrong = 0;
+    size_t checked = 0;
+    for (CullingKernel kernel : { CullingKernel::Scalar, detectCullingKernel() })
+    {
+        for (JobSystem* jobs : { static_cast<JobSystem*>(nullptr), &jobSystem })
+        {
+            occlusionBuffer.setKernel(kernel);
+            occlusionBuffer.render(viewProjection, scene, jobs);
+
+            for (const auto& testCase : cases)
+            {
+                TransformComponent transform{};
+                transform.translation = testCase.position;
+                transform.scale = glm::vec3{ testCase.scale };
+                transform.rotation = glm::vec3{ 0.0f };
+
+                bool visible = occlusionBuffer.isBoxVisible(boundsMin, boundsMax, transform.mat4());
+                checked++;
+                if (visible != testCase.visible)
+                {
+                    wrong++;
+                    std::cerr << "FAILED: " << testCase.name << " box is " << (visible ? "visible" : "hidden")
+                        << " with the " << getCullingKernelName(kernel) << " kernel" << (jobs ? " on the job system" : "") << std::endl;
+                }
+            }
+        }
+    }
+
+    std::cout << "Software occlusion: " << checked - wrong << " of " << checked << " cases passed" << std::endl;
+    return wrong == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}